@@ -0,0 +1,20 @@
+# Copyright 2015 ARM Limited
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+# http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+# Build the standalone corpus analyzer, which needs no engine: only a C++11 compiler, tar and unzip.
+# It's written to Binaries/Linux/MaliOCAnalyzer, next to the folder the plugin downloads the offline compiler to.
+
+cd "$(dirname "$0")/.."
+mkdir -p Binaries/Linux
+${CXX:-g++} -std=c++11 -O2 -pthread -o Binaries/Linux/MaliOCAnalyzer Source/MaliOCAnalyzer/MaliOCAnalyzer.cpp -ldl
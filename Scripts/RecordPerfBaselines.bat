@@ -0,0 +1,20 @@
+:: Copyright 2015 ARM Limited
+::
+:: Licensed under the Apache License, Version 2.0 (the "License");
+:: you may not use this file except in compliance with the License.
+:: You may obtain a copy of the License at
+::
+:: http://www.apache.org/licenses/LICENSE-2.0
+::
+:: Unless required by applicable law or agreed to in writing, software
+:: distributed under the License is distributed on an "AS IS" BASIS,
+:: WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+:: See the License for the specific language governing permissions and
+:: limitations under the License.
+
+@echo off
+:: Record the MaliOC.Perf baselines of this host platform, writing each measurement into Resources\PerfBaselines.
+:: Run it on the machine the perf tests run on, with no other load, and check in the baseline file it changes.
+
+"%~dp0..\..\..\Binaries\Win64\UE4Editor-Cmd.exe" -log -forcelogflush -stdout -AllowStdOutLogVerbosity -nosplash -nosound -unattended -execcmds="automation runtests MaliOC.BlockUntilAllShaderCompilationComplete;quit"
+"%~dp0..\..\..\Binaries\Win64\UE4Editor-Cmd.exe" -log -forcelogflush -stdout -AllowStdOutLogVerbosity -nosplash -nosound -unattended -MaliOCRecordPerfBaselines -execcmds="automation runtests MaliOC.Perf;quit"
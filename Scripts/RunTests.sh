@@ -33,12 +33,10 @@ set -o pipefail
 echo "Running Tests"
 
 # Run the actual tests this time and track the output
-UE4Log=$($UE4Editor -log -forcelogflush -stdout -AllowStdOutLogVerbosity -nosplash -nosound -unattended -execcmds="automation runtests MaliOC.CompilationReport.MSM_Unlit;quit" | tee /dev/tty)
+UE4Log=$($UE4Editor -log -forcelogflush -stdout -AllowStdOutLogVerbosity -nosplash -nosound -unattended -execcmds="MaliOC.Tests.PrefetchReports 1;automation runtests MaliOC.CompilationReport;quit" | tee /dev/tty)
 
 UE4ExitCode=$?
 
-# We also have MaliOC.CompilationReport.MSM_DefaultLit tests which we don't run because they are very long running and they don't test anything that doesn't get tested with the MaliOC.CompilationReport.MSM_Unlit tests.
-
 FailureString="Automation Test Failed"
 SuccessString="AutomationTestingLog: Info ...Automation Test Succeeded"
 
@@ -49,9 +47,9 @@ NumSuccesses=$(echo "$UE4Log" | grep "$SuccessString" -c)
 if [ "$(uname)" = "Darwin" ];
 then
     # Fewer tests on OSX as the Mali-T600_r3p0-00rel0 compiler is unsupported
-    NumTests=202
+    NumTests=404
 else
-    NumTests=208
+    NumTests=416
 fi
 
 HasError=0
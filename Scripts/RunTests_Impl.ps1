@@ -22,11 +22,9 @@
 "Running Tests"
 
 # Run the actual tests this time and track the output
-../../../Binaries/Win64/UE4Editor-Cmd.exe " -log -forcelogflush -stdout -AllowStdOutLogVerbosity -nosplash -nosound -unattended -execcmds=`"automation runtests MaliOC.CompilationReport.MSM_Unlit`;quit`" " 2>&1 | Tee-Object -Variable UE4Log
+../../../Binaries/Win64/UE4Editor-Cmd.exe " -log -forcelogflush -stdout -AllowStdOutLogVerbosity -nosplash -nosound -unattended -execcmds=`"MaliOC.Tests.PrefetchReports 1`;automation runtests MaliOC.CompilationReport`;quit`" " 2>&1 | Tee-Object -Variable UE4Log
 $UE4ExitCode = $LASTEXITCODE
 
-# We also have MaliOC.CompilationReport.MSM_DefaultLit tests which we don't run because they are very long running and they don't test anything that doesn't get tested with the MaliOC.CompilationReport.MSM_Unlit tests.
-
 $Errors = @($UE4Log | Select-String -pattern "Automation Test Failed" -context 5,0)
 $NumErrors = @($Errors).Count
 
@@ -34,7 +32,7 @@ $Successes = @($UE4Log | Select-String -pattern "AutomationTestingLog: Info ...A
 $NumSuccesses = @($Successes).Count
 
 # Hard code the number of tests, in case UE4 cleanly exits early
-$NumTests=208
+$NumTests=416
 
 $HasError = 0
 
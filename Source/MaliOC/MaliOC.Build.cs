@@ -33,6 +33,7 @@ namespace UnrealBuildTool.Rules
                     "SlateCore",
                     "UnrealEd",
                     "CoreUObject",
+                    "DirectoryWatcher",
                     "RHI",
                     "OpenGLDrv"
                 }
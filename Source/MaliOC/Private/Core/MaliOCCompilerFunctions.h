@@ -0,0 +1,83 @@
+/*
+* Copyright 2015 ARM Limited
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+
+#pragma once
+#include "../compiler_manager/compiler_manager.h"
+
+// No engine headers in here: the standalone analyzer (Source/MaliOCAnalyzer) loads the compiler manager with this too.
+
+/** Every compiler manager function we use. FUNCTION is expanded once for each function name */
+#define MALIOC_COMPILER_MANAGER_FUNCTIONS(FUNCTION) \
+    FUNCTION(malicm_initialize_libraries) \
+    FUNCTION(malicm_release_libraries) \
+    FUNCTION(malicm_get_manager_version) \
+    FUNCTION(malicm_release_compiler_outputs) \
+    FUNCTION(malicm_get_driver_name) \
+    FUNCTION(malicm_get_core_name) \
+    FUNCTION(malicm_get_core_revision) \
+    FUNCTION(malicm_is_binary_output_supported) \
+    FUNCTION(malicm_is_prerotate_supported) \
+    FUNCTION(malicm_get_api_name) \
+    FUNCTION(malicm_get_highest_api_version) \
+    FUNCTION(malicm_get_extensions) \
+    FUNCTION(malicm_get_compilers) \
+    FUNCTION(malicm_release_compilers) \
+    FUNCTION(malicm_compile)
+
+/** The functions of one loaded copy of the compiler manager library */
+struct FMaliOCCompilerFunctions
+{
+#define MALIOC_DECLARE_FUNCTION(NAME) decltype(NAME)* _ ## NAME = nullptr;
+    MALIOC_COMPILER_MANAGER_FUNCTIONS(MALIOC_DECLARE_FUNCTION)
+#undef MALIOC_DECLARE_FUNCTION
+
+    /**
+     * Look up every function in the library.
+     * @param GetExport called with the name of each function, returns its address or nullptr if the library doesn't export it
+     * @return true if every function was found
+     */
+    template <typename GetExportType>
+    bool LoadFunctions(GetExportType GetExport)
+    {
+        bool allLoadedSuccessfully = true;
+
+#define MALIOC_LOAD_FUNCTION(NAME) _ ## NAME = (decltype(NAME)*)GetExport(#NAME); allLoadedSuccessfully = allLoadedSuccessfully && (( _ ## NAME ) != nullptr);
+        MALIOC_COMPILER_MANAGER_FUNCTIONS(MALIOC_LOAD_FUNCTION)
+#undef MALIOC_LOAD_FUNCTION
+
+        return allLoadedSuccessfully;
+    }
+
+    /** @return the compiler manager version we're written against */
+    static malicm_version GetExpectedVersion()
+    {
+        malicm_version version;
+        version.major = 4u;
+        version.minor = 0u;
+        version.patch = 1u;
+        return version;
+    }
+
+    /** Only valid once _malicm_initialize_libraries has succeeded. @return true if the library is the version we're written against */
+    bool IsExpectedVersion() const
+    {
+        malicm_version version;
+        _malicm_get_manager_version(&version);
+        const malicm_version expectedVersion = GetExpectedVersion();
+        return version.major == expectedVersion.major && version.minor == expectedVersion.minor && version.patch == expectedVersion.patch;
+    }
+};
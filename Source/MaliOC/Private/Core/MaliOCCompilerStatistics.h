@@ -0,0 +1,48 @@
+/*
+* Copyright 2015 ARM Limited
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+
+#pragma once
+
+// No engine headers in here: the standalone analyzer (Source/MaliOCAnalyzer) reports these too.
+
+/** The statistics of one render target of a shader compiled for a Midgard core */
+struct FMaliOCMidgardRenderTarget
+{
+    int render_target = 0;
+
+    int work_registers_used = 0;
+    int uniform_registers_used = 0;
+
+    float arithmetic_cycles = 0;
+    float arithmetic_shortest_path = 0;
+    float arithmetic_longest_path = 0;
+    float load_store_cycles = 0;
+    float load_store_shortest_path = 0;
+    float load_store_longest_path = 0;
+    float texture_cycles = 0;
+    float texture_shortest_path = 0;
+    float texture_longest_path = 0;
+    bool spilling_used = false;
+};
+
+/** The statistics of a shader compiled for a Utgard core */
+struct FMaliOCUtgardStatistics
+{
+    int min_number_of_cycles = 0;
+    int max_number_of_cycles = 0;
+    int n_instruction_words = 0;
+};
@@ -0,0 +1,209 @@
+/*
+* Copyright 2015 ARM Limited
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+
+#pragma once
+#include "../compiler_manager/malioc_api.h"
+#include "MaliOCCompilerStatistics.h"
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// No engine headers in here: AppendRawCompilerOutput() and the standalone analyzer (Source/MaliOCAnalyzer) both parse with this.
+
+/** One shader's compiler outputs, parsed */
+struct FMaliOCParsedOutputs
+{
+    enum class EResult
+    {
+        /** The shader didn't compile, or the outputs couldn't be understood. Errors says why */
+        Error,
+        /** RenderTargets holds the statistics */
+        Midgard,
+        /** Utgard holds the statistics */
+        Utgard
+    };
+
+    EResult Result = EResult::Error;
+    std::vector<std::string> Errors;
+    std::vector<std::string> Warnings;
+    std::vector<FMaliOCMidgardRenderTarget> RenderTargets;
+    FMaliOCUtgardStatistics Utgard;
+};
+
+/** Turns the compiler's key-value outputs into statistics */
+class FMaliOCOutputParser final
+{
+public:
+    /**
+     * Parse one shader's compiler outputs.
+     * @param bCompilerRan whether _malicm_compile returned true. If not, Outputs isn't looked at
+     * @param Outputs the compiler's outputs
+     * @param OutParsed emptied, then given the result
+     */
+    static void Parse(bool bCompilerRan, const malioc_outputs& Outputs, FMaliOCParsedOutputs& OutParsed)
+    {
+        OutParsed = FMaliOCParsedOutputs();
+
+        // Add an error if the compiler didn't even run
+        if (!bCompilerRan)
+        {
+            OutParsed.Errors.push_back("Compiler could not be run");
+            return;
+        }
+
+        // Outputs is only valid if the compiler actually ran
+        OutParsed.Warnings.assign(Outputs.warnings, Outputs.warnings + Outputs.number_of_warnings);
+
+        // Add an error if the compiler returned any errors
+        if (Outputs.number_of_errors != 0)
+        {
+            OutParsed.Errors.assign(Outputs.errors, Outputs.errors + Outputs.number_of_errors);
+            return;
+        }
+
+        // There must be at least one output to print
+        if (Outputs.number_of_flexible_outputs == 0)
+        {
+            OutParsed.Errors.push_back("No verbose output from compiler");
+            return;
+        }
+
+        // Each flexible output corresponds to one render target. The very first one has the architecture
+        const char* architecture = FindValue(Outputs.flexible_outputs[0], "architecture");
+
+        if (architecture != nullptr && strcmp(architecture, "midgard") == 0)
+        {
+            OutParsed.Result = FMaliOCParsedOutputs::EResult::Midgard;
+            OutParsed.RenderTargets.resize(Outputs.number_of_flexible_outputs);
+            for (unsigned int i = 0; i < Outputs.number_of_flexible_outputs; i++)
+            {
+                ParseMidgard(Outputs.flexible_outputs[i], OutParsed.RenderTargets[i]);
+            }
+        }
+        // Utgard has no render targets, so more than one output is a format we don't know
+        else if (architecture != nullptr && strcmp(architecture, "utgard") == 0 && Outputs.number_of_flexible_outputs == 1)
+        {
+            OutParsed.Result = FMaliOCParsedOutputs::EResult::Utgard;
+            ParseUtgard(Outputs.flexible_outputs[0], OutParsed.Utgard);
+        }
+        else
+        {
+            OutParsed.Errors.push_back("Unknown verbose output format from compiler");
+        }
+    }
+
+private:
+    /** @return the value of Key in a flexible output, or nullptr if it has none. Keys have even indices, and values odd */
+    static const char* FindValue(const malioc_key_value_pairs& FlexibleOutput, const char* Key)
+    {
+        for (unsigned int i = 0; i + 1 < FlexibleOutput.number_of_entries; i += 2)
+        {
+            if (strcmp(FlexibleOutput.list[i], Key) == 0)
+            {
+                return FlexibleOutput.list[i + 1];
+            }
+        }
+        return nullptr;
+    }
+
+    /** Parse one render target of a Midgard shader */
+    static void ParseMidgard(const malioc_key_value_pairs& FlexibleOutput, FMaliOCMidgardRenderTarget& OutRenderTarget)
+    {
+        for (unsigned int i = 0; i + 1 < FlexibleOutput.number_of_entries; i += 2)
+        {
+            const char* key = FlexibleOutput.list[i];
+            const char* value = FlexibleOutput.list[i + 1];
+
+            if (strcmp(key, "render_target") == 0)
+            {
+                OutRenderTarget.render_target = atoi(value);
+            }
+            else if (strcmp(key, "work_registers_used") == 0)
+            {
+                OutRenderTarget.work_registers_used = atoi(value);
+            }
+            else if (strcmp(key, "uniform_registers_used") == 0)
+            {
+                OutRenderTarget.uniform_registers_used = atoi(value);
+            }
+            else if (strcmp(key, "arithmetic_cycles") == 0)
+            {
+                OutRenderTarget.arithmetic_cycles = (float)atof(value);
+            }
+            else if (strcmp(key, "arithmetic_shortest_path") == 0)
+            {
+                OutRenderTarget.arithmetic_shortest_path = (float)atof(value);
+            }
+            else if (strcmp(key, "arithmetic_longest_path") == 0)
+            {
+                OutRenderTarget.arithmetic_longest_path = (float)atof(value);
+            }
+            else if (strcmp(key, "load_store_cycles") == 0)
+            {
+                OutRenderTarget.load_store_cycles = (float)atof(value);
+            }
+            else if (strcmp(key, "load_store_shortest_path") == 0)
+            {
+                OutRenderTarget.load_store_shortest_path = (float)atof(value);
+            }
+            else if (strcmp(key, "load_store_longest_path") == 0)
+            {
+                OutRenderTarget.load_store_longest_path = (float)atof(value);
+            }
+            else if (strcmp(key, "texture_cycles") == 0)
+            {
+                OutRenderTarget.texture_cycles = (float)atof(value);
+            }
+            else if (strcmp(key, "texture_shortest_path") == 0)
+            {
+                OutRenderTarget.texture_shortest_path = (float)atof(value);
+            }
+            else if (strcmp(key, "texture_longest_path") == 0)
+            {
+                OutRenderTarget.texture_longest_path = (float)atof(value);
+            }
+            else if (strcmp(key, "spilling_used") == 0)
+            {
+                OutRenderTarget.spilling_used = (strcmp(value, "true") == 0);
+            }
+        }
+    }
+
+    /** Parse the only output of a Utgard shader */
+    static void ParseUtgard(const malioc_key_value_pairs& FlexibleOutput, FMaliOCUtgardStatistics& OutStatistics)
+    {
+        for (unsigned int i = 0; i + 1 < FlexibleOutput.number_of_entries; i += 2)
+        {
+            const char* key = FlexibleOutput.list[i];
+            const char* value = FlexibleOutput.list[i + 1];
+
+            if (strcmp(key, "min_number_of_cycles") == 0)
+            {
+                OutStatistics.min_number_of_cycles = atoi(value);
+            }
+            else if (strcmp(key, "max_number_of_cycles") == 0)
+            {
+                OutStatistics.max_number_of_cycles = atoi(value);
+            }
+            else if (strcmp(key, "n_instruction_words") == 0)
+            {
+                OutStatistics.n_instruction_words = atoi(value);
+            }
+        }
+    }
+};
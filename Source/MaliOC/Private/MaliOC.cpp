@@ -18,6 +18,8 @@
 #include "MaliOCExtensionTab.h"
 #include "MaliOCStyle.h"
 #include "MaliOCAsyncCompiler.h"
+#include "MaliOCAsyncReportGenerator.h"
+#include "MaliOCCompileTrace.h"
 #include "SDockTab.h"
 
 #define LOCTEXT_NAMESPACE "MaliOC"
@@ -250,9 +252,10 @@ public:
         MEModule.OnMaterialFunctionEditorOpened().AddSP(this, &FMaliOC::OnMaterialFunctionEditorOpened);
         MEModule.OnMaterialInstanceEditorOpened().AddSP(this, &FMaliOC::OnMaterialInstanceEditorOpened);
 
-        // Attempt to load the Async compiler. This will fail if the user has not yet downloaded the compiler manager
-        // This scenario will be dealt with by the material editor tab generator
-        FAsyncCompiler::Initialize();
+        // Start loading the Async compiler in the background, so editor startup doesn't depend on how many compiler libraries there are
+        // This will fail if the user has not yet downloaded the compiler manager
+        // Both scenarios will be dealt with by the material editor tab generator
+        FAsyncCompiler::BeginInitialize();
     }
 
     /** Deinit the offline compiler module. This function makes no assumptions about whether initialisation was successful or not, so all deinit is safe */
@@ -287,9 +290,15 @@ public:
             MEModule->OnMaterialInstanceEditorOpened().RemoveAll(this);
         }
 
+        // Shared report generators may still hold compile jobs, which have to go before the compiler
+        FAsyncReportGenerator::ReleaseSharedGenerators();
+
         // Unload the Async compiler
         FAsyncCompiler::Deinitialize();
 
+        // Write out a compile trace that is still recording, now that no job can add to it
+        FMaliOCCompileTrace::Stop();
+
         // Unregister our commands
         FMaliOCCommands::Unregister();
 
@@ -17,6 +17,11 @@
 #include "MaliOCPrivatePCH.h"
 #include "MaliOCAsyncCompiler.h"
 #include "MaliOCCompilerManager.h"
+#include "MaliOCCompilerCatalogue.h"
+#include "MaliOCCompilerConcurrency.h"
+#include "Core/MaliOCOutputParser.h"
+#include "DirectoryWatcherModule.h"
+#include "IDirectoryWatcher.h"
 
 // Copied from various GL headers. Elected to copy this in rather than deal with unpleasant cross-platform ifdeffery
 // OpenGLShaders.h has dependencies on various GL headers and relies on the including source file to resolve them
@@ -51,153 +56,443 @@ bool IsDriverBlacklisted(const FString& DriverName)
     return false;
 }
 
-bool FAsyncCompiler::Initialize(bool Silent)
+static TAutoConsoleVariable<int32> CVarEnableAEP(
+    TEXT("MaliOC.EnableAEP"),
+    0,
+    TEXT("1: offer the OpenGL ES 3.1 AEP platform for drivers which support GL_ANDROID_extension_pack_es31a, so tessellation, geometry and compute shaders are compiled too.\n")
+    TEXT("0: only offer OpenGL ES 2.0 (default).\n")
+    TEXT("Read when the compiler list is built at startup, so set it in ConsoleVariables.ini."),
+    ECVF_Default);
+
+/**
+ * Build the core tree from the compiler catalogue. Safe to call from any thread.
+ * @param OutCores the cores, with their revisions, drivers and platforms, are added to this
+ */
+static void BuildCores(const FMaliOCCompilerCatalogue& Catalogue, TArray<TUniqueObj<FMaliCore>>& OutCores)
 {
-    // Abort if we're double initialising, as it's probably a symptom of erroneous programming somewhere
-    check(!AsyncCompiler.IsValid());
-    bool success = FCompilerManager::Initialize(Silent);
+    TMap<FString, int32> coreIndices;
+    const bool bEnableAEP = CVarEnableAEP.GetValueOnAnyThread() != 0;
 
-    if (!success)
+    // For each compiler, check if we haven't blacklisted it and add it to the list of cores we support
+    for (const FMaliOCCompilerCatalogue::FEntry& entry : Catalogue.Entries)
     {
-        if (!Silent)
+        if (IsCoreBlacklisted(entry.CoreName))
         {
-            UE_LOG(MaliOfflineCompiler, Error, TEXT("Could not initialise Async Compiler as compiler libraries were not successfully loaded"));
+            continue;
+        }
+        if (IsDriverBlacklisted(entry.DriverName))
+        {
+            continue;
+        }
+
+        // See if we already have a core with the same name as the current compiler core. If not, make one
+        int32* coreIndex = coreIndices.Find(entry.CoreName);
+        if (coreIndex == nullptr)
+        {
+            coreIndex = &coreIndices.Add(entry.CoreName, OutCores.Emplace(entry.CoreName));
+        }
+
+        TUniqueObj<FMaliCore>& core = OutCores[*coreIndex];
+        for (const FMaliOCCompilerCatalogue::FPlatform& platform : entry.Platforms)
+        {
+            // The catalogue lists AEP wherever the driver supports it, so the cache doesn't depend on the setting
+            if (platform.Platform == EShaderPlatform::SP_OPENGL_ES31_EXT && !bEnableAEP)
+            {
+                continue;
+            }
+            core->AddRevision(entry.RevisionName, entry.DriverName, entry.MaxAPI, entry.Extensions, platform.Name, platform.Platform);
         }
-        return false;
     }
+}
 
-    AsyncCompiler = MakeShareable(new FAsyncCompiler);
+/**
+ * Builds the compiler list on a worker thread, so editor startup doesn't wait for the vendor libraries.
+ * If the bundle hasn't changed since the last session, the list comes from the catalogue cache and no libraries are loaded at all.
+ */
+class FAsyncCompilerInitializationTask final : public FNonAbandonableTask
+{
+public:
+    FAsyncCompilerInitializationTask(bool bInSilent) :
+        bSilent(bInSilent)
+    {
+    }
 
-    if (AsyncCompiler->GetCores().Num() == 0)
+    void DoWork()
     {
-        // No point of having a compiler if we don't have any compilation targets
-        AsyncCompiler.Reset();
-        return false;
+        // Without the compiler manager there's nothing to compile with, whatever the cache says
+        if (!FCompilerManager::CompilerManagerDLLExists())
+        {
+            if (!bSilent)
+            {
+                UE_LOG(MaliOfflineCompiler, Error, TEXT("Could not initialise Async Compiler as the compiler manager DLL was not found"));
+            }
+            return;
+        }
+
+        const FSHAHash bundleKey = FMaliOCCompilerCatalogue::ComputeBundleKey(FCompilerManager::GetFullCompilerPath());
+
+        FMaliOCCompilerCatalogue catalogue;
+        if (!FMaliOCCompilerCatalogue::LoadFromCache(bundleKey, catalogue))
+        {
+            if (!FAsyncCompiler::LoadCompilerLibraries(bSilent))
+            {
+                if (!bSilent)
+                {
+                    UE_LOG(MaliOfflineCompiler, Error, TEXT("Could not initialise Async Compiler as compiler libraries were not successfully loaded"));
+                }
+                return;
+            }
+
+            catalogue = FMaliOCCompilerCatalogue::Enumerate(*FCompilerManager::Get());
+            if (catalogue.Entries.Num() > 0)
+            {
+                catalogue.SaveToCache(bundleKey);
+            }
+        }
+
+        BuildCores(catalogue, Cores);
     }
 
-    return true;
+    TStatId GetStatId() const
+    {
+        RETURN_QUICK_DECLARE_CYCLE_STAT(FAsyncCompilerInitializationTask, STATGROUP_ThreadPoolAsyncTasks);
+    }
+
+    /** The enumerated cores. Empty if the compiler libraries failed to load */
+    TArray<TUniqueObj<FMaliCore>> Cores;
+
+private:
+    const bool bSilent;
+};
+
+/** Guards loading the compiler libraries, which can happen on the initialization task, a compile job or the game thread */
+static FCriticalSection CompilerLibrariesCriticalSection;
+
+/** Background initialization, if one is running */
+static TUniquePtr<FAsyncTask<FAsyncCompilerInitializationTask>> InitializationTask;
+
+static FAsyncCompiler::FOnInitializationFinished InitializationFinishedEvent;
+
+/** Ticker which finishes initialization, and starts it again after the plugin folder changes. Only registered while there's something for it to do */
+static FDelegateHandle InitializationTickerHandle;
+
+/** Directory watcher callback on the plugin folder. Only registered while there's no compiler */
+static FDelegateHandle PluginFolderWatcherHandle;
+
+/** Whether the plugin folder has changed since initialization last failed */
+static bool bHasPluginFolderChanged = false;
+
+/** Time (in FPlatformTime::Seconds) of the last change to the plugin folder */
+static double LastPluginFolderChangeTime = 0.0;
+
+/** Time to wait after the last change to the plugin folder before initializing, so we don't load a half extracted bundle */
+static const double PluginFolderSettleTime = 1.0;
+
+static bool TickInitialization(float DeltaTime)
+{
+    // Finishes initialization, and tells everyone waiting for it, as soon as the task is done
+    if (FAsyncCompiler::IsInitializing())
+    {
+        return true;
+    }
+
+    if (bHasPluginFolderChanged)
+    {
+        // Files are probably still being extracted
+        if (FPlatformTime::Seconds() - LastPluginFolderChangeTime < PluginFolderSettleTime)
+        {
+            return true;
+        }
+
+        bHasPluginFolderChanged = false;
+        if (FAsyncCompiler::Get() == nullptr && FCompilerManager::CompilerManagerDLLExists())
+        {
+            FAsyncCompiler::BeginInitialize(true);
+            return true;
+        }
+    }
+
+    InitializationTickerHandle.Reset();
+    return false;
 }
 
-void FAsyncCompiler::Deinitialize()
+static void StartInitializationTicker()
 {
-    if (AsyncCompiler.IsValid())
+    if (!InitializationTickerHandle.IsValid())
     {
-        // Null the current job
-        // This should run its destructor, which will safely kill the job
-        // This MUST be done before we deinit the compiler manager, else the compiler DLL will be released while
-        // the job is still using it
-        AsyncCompiler->CurrentJob = nullptr;
-        AsyncCompiler.Reset();
+        InitializationTickerHandle = FTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateStatic(&TickInitialization));
     }
-    FCompilerManager::Deinitialize();
 }
 
-FAsyncCompiler* FAsyncCompiler::Get()
+static void StopInitializationTicker()
 {
-    return AsyncCompiler.Get();
+    if (InitializationTickerHandle.IsValid())
+    {
+        FTicker::GetCoreTicker().RemoveTicker(InitializationTickerHandle);
+        InitializationTickerHandle.Reset();
+    }
+}
+
+static void OnPluginFolderChanged(const TArray<FFileChangeData>& FileChanges)
+{
+    LastPluginFolderChangeTime = FPlatformTime::Seconds();
+    bHasPluginFolderChanged = true;
+    StartInitializationTicker();
 }
 
-FAsyncCompiler::FAsyncCompiler()
+/** Watch the plugin folder rather than the compiler folder, as the compiler folder doesn't exist until the user extracts it */
+static void StartWatchingPluginFolder()
 {
-    const FCompilerManager* compilerManager = FCompilerManager::Get();
-    check(compilerManager != nullptr);
+    if (PluginFolderWatcherHandle.IsValid())
+    {
+        return;
+    }
 
-    // Get an exhaustive list of all compilers
-    malicm_compiler* compilers;
-    unsigned int numCompilers = 0;
-    compilerManager->_malicm_get_compilers(&compilers, &numCompilers, nullptr, nullptr, nullptr, "openglessl", nullptr, 0);
+    FDirectoryWatcherModule& directoryWatcherModule = FModuleManager::LoadModuleChecked<FDirectoryWatcherModule>(TEXT("DirectoryWatcher"));
+    IDirectoryWatcher* directoryWatcher = directoryWatcherModule.Get();
+    if (directoryWatcher != nullptr)
+    {
+        directoryWatcher->RegisterDirectoryChangedCallback_Handle(GetMaliOCPluginFolderPath(), IDirectoryWatcher::FDirectoryChanged::CreateStatic(&OnPluginFolderChanged), PluginFolderWatcherHandle);
+    }
+}
 
-    // Create the list of compilers and its data
-    // For each compiler, check if we haven't blacklisted it and add it to the list of cores we support
+static void StopWatchingPluginFolder()
+{
+    if (!PluginFolderWatcherHandle.IsValid())
+    {
+        return;
+    }
+
+    // The directory watcher may already have been shut down if the editor is exiting
+    FDirectoryWatcherModule* directoryWatcherModule = FModuleManager::GetModulePtr<FDirectoryWatcherModule>(TEXT("DirectoryWatcher"));
+    if (directoryWatcherModule != nullptr && directoryWatcherModule->Get() != nullptr)
+    {
+        directoryWatcherModule->Get()->UnregisterDirectoryChangedCallback_Handle(GetMaliOCPluginFolderPath(), PluginFolderWatcherHandle);
+    }
+    PluginFolderWatcherHandle.Reset();
+    bHasPluginFolderChanged = false;
+}
+
+void FAsyncCompiler::BeginInitialize(bool Silent)
+{
+    // Abort if we're double initialising, as it's probably a symptom of erroneous programming somewhere
+    check(IsInGameThread());
+    check(!AsyncCompiler.IsValid() && !InitializationTask.IsValid());
+
+    InitializationTask.Reset(new FAsyncTask<FAsyncCompilerInitializationTask>(Silent));
+    InitializationTask->StartBackgroundTask();
+    StartInitializationTicker();
+}
+
+FAsyncCompiler::FOnInitializationFinished& FAsyncCompiler::OnInitializationFinished()
+{
+    return InitializationFinishedEvent;
+}
+
+bool FAsyncCompiler::IsInitializing()
+{
+    check(IsInGameThread());
+
+    if (InitializationTask.IsValid() && InitializationTask->IsDone())
+    {
+        FinishInitialization();
+    }
+
+    return InitializationTask.IsValid();
+}
 
-    for (unsigned int i = 0; i < numCompilers; i++)
+bool FAsyncCompiler::FinishInitialization()
+{
+    check(IsInGameThread());
+
+    if (InitializationTask.IsValid())
     {
-        const malicm_compiler compiler = compilers[i];
-        const FString coreName = compilerManager->_malicm_get_core_name(compilers[i]);
-        const FString revisionName = compilerManager->_malicm_get_core_revision(compilers[i]);
-        const FString driverName = compilerManager->_malicm_get_driver_name(compilers[i]);
-        const unsigned int MaxAPI = compilerManager->_malicm_get_highest_api_version(compilers[i]);
+        InitializationTask->EnsureCompletion();
+        TArray<TUniqueObj<FMaliCore>>& cores = InitializationTask->GetTask().Cores;
 
-        if (IsCoreBlacklisted(coreName))
+        // No point of having a compiler if we don't have any compilation targets.
+        // The compiler is a tickable object, so it has to be created here on the game thread rather than by the task.
+        if (cores.Num() > 0)
         {
-            continue;
+            AsyncCompiler = MakeShareable(new FAsyncCompiler(MoveTemp(cores)));
         }
-        if (IsDriverBlacklisted(driverName))
+        else
         {
-            continue;
+            FCompilerManager::Deinitialize();
         }
 
-        TUniqueObj<FMaliCore>* core = nullptr;
+        InitializationTask.Reset();
 
-        // See if we already have a core with the same name as the current compiler core
-        for (TUniqueObj<FMaliCore>& maliCore : MaliCores)
+        // Until there's a compiler, wait for the user to extract one into the plugin folder
+        if (AsyncCompiler.IsValid())
         {
-            if (maliCore->GetName().Equals(coreName))
-            {
-                core = &maliCore;
-                break;
-            }
+            StopWatchingPluginFolder();
         }
-
-        // If we didn't have a core with the same name, make one
-        if (core == nullptr)
+        else
         {
-            core = &MaliCores[MaliCores.Emplace(coreName)];
+            StartWatchingPluginFolder();
         }
 
-        const FString Extensions = compilerManager->_malicm_get_extensions(compiler);
+        InitializationFinishedEvent.Broadcast(AsyncCompiler.IsValid());
+    }
+
+    return AsyncCompiler.IsValid();
+}
+
+void FAsyncCompiler::Deinitialize()
+{
+    StopWatchingPluginFolder();
+    StopInitializationTicker();
+
+    // The task may be using the compiler manager, so it has to finish before we tear anything down
+    if (InitializationTask.IsValid())
+    {
+        InitializationTask->EnsureCompletion();
+        InitializationTask.Reset();
+    }
+
+    if (AsyncCompiler.IsValid())
+    {
+        // Report generators, tabs and cost attributions hold job handles of their own, so releasing ours doesn't stop their jobs.
+        // Every job must be cancelled and waited for before we deinit the compiler manager, else the compiler DLL will be released while
+        // a job is still using it
+        AsyncCompiler->CancelAllJobs();
+        AsyncCompiler.Reset();
+    }
+    FMaliOCCompilerConcurrency::Deinitialize();
+    FCompilerManager::Deinitialize();
+}
+
+bool FAsyncCompiler::LoadCompilerLibraries(bool Silent)
+{
+    FScopeLock lock(&CompilerLibrariesCriticalSection);
+
+    if (FCompilerManager::Get() != nullptr)
+    {
+        return true;
+    }
+
+    return FCompilerManager::Initialize(Silent);
+}
+
+FAsyncCompiler* FAsyncCompiler::Get()
+{
+    // Callers which can't afford to wait check IsInitializing() first
+    FinishInitialization();
+    return AsyncCompiler.Get();
+}
+
+FAsyncCompiler::FAsyncCompiler(TArray<TUniqueObj<FMaliCore>>&& Cores) :
+    MaliCores(MoveTemp(Cores))
+{
+    for (int32 coreIndex = 0; coreIndex < MaliCores.Num(); coreIndex++)
+    {
+        const FMaliCore& core = *MaliCores[coreIndex];
+        CoreIndices.Add(core.GetName(), coreIndex);
 
-        // The AEP platform will be enabled in some future release
-        if (false)
+        for (const auto& revision : core.GetRevisions())
         {
-            // Add AEP if supported
-            if (Extensions.Contains(TEXT("GL_ANDROID_extension_pack_es31a")) && Extensions.Contains(TEXT("GL_EXT_color_buffer_half_float")))
+            for (const auto& driver : revision->GetDrivers())
             {
-                (*core)->AddRevision(revisionName, driverName, compiler, MaxAPI, Extensions, FString(TEXT("OpenGL ES 3.1 AEP")), EShaderPlatform::SP_OPENGL_ES31_EXT);
+                for (const auto& platform : driver->GetPlatforms())
+                {
+                    Platforms.Add(&platform.Get());
+                    PlatformsById.Add(platform->GetId(), &platform.Get());
+                }
             }
         }
+    }
+}
+
+void FAsyncCompiler::Tick(float DeltaTime)
+{
+    StartPendingJobs();
+
+    // The self-test starts with the first compile. It can only be started from the game thread, so jobs started elsewhere leave it to the next tick.
+    if (FCompileJobHandle::JobCounter.GetValue() > 0)
+    {
+        FMaliOCCompilerConcurrency::BeginDetection(Platforms);
+    }
+}
+
+void FAsyncCompiler::CancelAllJobs()
+{
+    FScopeLock lock(&RunningJobsCriticalSection);
+    bIsShuttingDown = true;
 
-        // GLES2 is always supported
-        (*core)->AddRevision(revisionName, driverName, compiler, MaxAPI, Extensions, FString(TEXT("OpenGL ES 2.0")), EShaderPlatform::SP_OPENGL_ES2_ANDROID);
+    // Queued jobs have never started, so they never touch the compiler
+    TSharedPtr<FCompileJobHandle, ESPMode::ThreadSafe> queuedJob;
+    while (Jobs.Dequeue(queuedJob))
+    {
     }
 
-    compilerManager->_malicm_release_compilers(&compilers, numCompilers);
+    // A job stays in RunningJobs from when it starts until it has finished, however many other references there are to it.
+    // Jobs never take RunningJobsCriticalSection, so they can finish while we hold it
+    for (const auto& job : RunningJobs)
+    {
+        job->Cancel();
+    }
+    for (const auto& job : RunningJobs)
+    {
+        while (!job->IsCompilationFinished())
+        {
+            FPlatformProcess::Sleep(0.001f);
+        }
+    }
+    RunningJobs.Empty();
 }
 
-void FAsyncCompiler::Tick(float DeltaTime)
+int32 FAsyncCompiler::StartPendingJobs()
 {
-    // The job we were running is now complete. Release the reference
-    if (CurrentJob.IsValid() && CurrentJob->IsCompilationFinished())
+    FScopeLock lock(&RunningJobsCriticalSection);
+
+    // Once the jobs have been cancelled, nothing new may start using the compiler
+    if (bIsShuttingDown)
     {
-        CurrentJob = nullptr;
+        return RunningJobs.Num();
     }
 
-    // No running job, but there are pending jobs. Let's start one
-    if (!CurrentJob.IsValid() && !Jobs.IsEmpty())
+    // Release the references to the jobs that are now complete
+    RunningJobs.RemoveAll([](const TSharedPtr<FCompileJobHandle, ESPMode::ThreadSafe>& Job) { return Job->IsCompilationFinished(); });
+
+    // Start pending jobs while there are free slots. The number of slots only goes above one once the concurrency self-test has passed
+    TSharedPtr<FCompileJobHandle, ESPMode::ThreadSafe> nextJob;
+    while (RunningJobs.Num() < FMaliOCCompilerConcurrency::GetMaxConcurrentJobs() && Jobs.Peek(nextJob))
     {
-        Jobs.Dequeue(CurrentJob);
-        CurrentJob->BeginCompilationAsync();
+        // If each compiler can only be used by one thread, a second job for the same driver would just wait on the first, so keep it queued
+        if (FMaliOCCompilerConcurrency::GetReentrancy() == EMaliOCCompilerReentrancy::PerCompiler && FCompilerManager::GetMaxIsolatedInstances() == 0 &&
+            RunningJobs.ContainsByPredicate([&](const TSharedPtr<FCompileJobHandle, ESPMode::ThreadSafe>& Job) { return &Job->Platform.GetDriver() == &nextJob->Platform.GetDriver(); }))
+        {
+            break;
+        }
+
+        Jobs.Dequeue(nextJob);
+        RunningJobs.Add(nextJob);
+        nextJob->BeginCompilationAsync();
     }
+
+    return RunningJobs.Num();
 }
 
-TSharedRef<const FCompileJobHandle> FAsyncCompiler::AddJob(TRefCountPtr<FMaterialShaderMap> ShaderMap, const FMaliPlatform& Platform)
+TSharedRef<const FCompileJobHandle, ESPMode::ThreadSafe> FAsyncCompiler::AddJob(const TArray<FCompileJobShaderMap>& ShaderMaps, const FMaliPlatform& Platform, const FCompileJobOptions& Options)
 {
-    // Create the job handle and add it to the job queue. New jobs get set in motion in Tick()
-    TSharedRef<FCompileJobHandle> handle = MakeShareable(new FCompileJobHandle(ShaderMap, Platform));
+    // Create the job handle and add it to the job queue. Building the shader list happens before taking the lock, so producers don't hold each other up.
+    TSharedRef<FCompileJobHandle, ESPMode::ThreadSafe> handle = MakeShareable(new FCompileJobHandle(ShaderMaps, Platform, Options));
 
     Jobs.Enqueue(handle);
 
+    // Start it straight away if there's a free slot, rather than waiting for the editor to tick
+    StartPendingJobs();
+
     return handle;
 }
 
 void FAsyncCompiler::FinishCompilation()
 {
-    // Ticking here makes sure that, if something was waiting in the queue, it moves into the current job slot
-    Tick(0.0f);
-    while (CurrentJob.IsValid())
+    // Starting pending jobs here makes sure that, if something was waiting in the queue, it gets started
+    while (StartPendingJobs() > 0)
     {
         FPlatformProcess::Sleep(0.01f);
-        Tick(0.0f);
     }
 }
 
@@ -206,6 +501,23 @@ const TArray<TUniqueObj<FMaliCore>>& FAsyncCompiler::GetCores() const
     return MaliCores;
 }
 
+const FMaliCore* FAsyncCompiler::FindCore(const FString& CoreName) const
+{
+    const int32* coreIndex = CoreIndices.Find(CoreName);
+    return coreIndex != nullptr ? &MaliCores[*coreIndex].Get() : nullptr;
+}
+
+const TArray<const FMaliPlatform*>& FAsyncCompiler::GetPlatforms() const
+{
+    return Platforms;
+}
+
+const FMaliPlatform* FAsyncCompiler::FindPlatform(const FMaliPlatformId& Id) const
+{
+    const FMaliPlatform* const* platform = PlatformsById.Find(Id);
+    return platform != nullptr ? *platform : nullptr;
+}
+
 /** Get the GL Device capabilities for the specified Mali platform, used for processing the GLSL outputted by the cross compiler */
 void GetMaliPlatformOpenGLShaderDeviceCapabilities(const FMaliPlatform& Platform, FOpenGLShaderDeviceCapabilities& Capabilities)
 {
@@ -246,40 +558,214 @@ void GetMaliPlatformOpenGLShaderDeviceCapabilities(const FMaliPlatform& Platform
     Capabilities.bRequiresTexture2DPrecisionHack = false;
 }
 
-uint32 FCompileJobHandle::JobCounter(0);
+FThreadSafeCounter FCompileJobHandle::JobCounter(0);
 
 void FCompileJobHandle::BeginCompilationAsync()
 {
-    // All threads are launched from the UI thread, so we don't need to worry about JobCounter being non atomic
-    Thread = FRunnableThread::Create(this, *FString::Printf(TEXT("MaliOCCompileJob %d"), JobCounter));
-    JobCounter += 1;
+    Thread = FRunnableThread::Create(this, *FString::Printf(TEXT("MaliOCCompileJob %d"), JobCounter.Increment() - 1));
 }
 
 void FCompileJobHandle::Exit()
 {
-    bIsCompilationComplete = true;
+    // A full barrier, so the raw output and counters are all visible to whoever sees the job as finished
+    FPlatformAtomics::InterlockedExchange(&CompilationComplete, 1);
+}
+
+/** Identifies an entry in one of the arrays of FMaliOCRawCompilerOutput */
+struct FRawOutputLocation
+{
+    enum class EKind
+    {
+        Error,
+        Midgard,
+        Utgard
+    };
+
+    EKind Kind;
+    int32 Index;
+};
+
+/** @return the common output of the entry at Location */
+static FMaliOCRawCompilerOutput::FCommonOutput& GetCommonOutput(FMaliOCRawCompilerOutput& Output, const FRawOutputLocation& Location)
+{
+    switch (Location.Kind)
+    {
+    case FRawOutputLocation::EKind::Midgard:
+        return Output.MidgardOutput[Location.Index].CommonOutput;
+    case FRawOutputLocation::EKind::Utgard:
+        return Output.UtgardOutput[Location.Index].CommonOutput;
+    default:
+        return Output.ErrorOutput[Location.Index].CommonOutput;
+    }
+}
+
+const char* GetCompilerShaderType(EShaderFrequency Frequency)
+{
+    switch (Frequency)
+    {
+    case SF_Vertex:
+        return "vertex";
+    case SF_Hull:
+        return "tessellation_control";
+    case SF_Domain:
+        return "tessellation_evaluation";
+    case SF_Pixel:
+        return "fragment";
+    case SF_Geometry:
+        return "geometry";
+    case SF_Compute:
+        return "compute";
+    default:
+        return nullptr;
+    }
+}
+
+/** @return the GL shader type of a frequency GetCompilerShaderType() supports, for GLSLToDeviceCompatibleGLSL */
+static GLenum GetGLShaderType(EShaderFrequency Frequency)
+{
+    switch (Frequency)
+    {
+    case SF_Vertex:
+        return GL_VERTEX_SHADER;
+    case SF_Hull:
+        return GL_TESS_CONTROL_SHADER;
+    case SF_Domain:
+        return GL_TESS_EVALUATION_SHADER;
+    case SF_Geometry:
+        return GL_GEOMETRY_SHADER;
+    case SF_Compute:
+        return GL_COMPUTE_SHADER;
+    default:
+        return GL_FRAGMENT_SHADER;
+    }
 }
 
+/** Number of shaders a job compiles at once. The compiler stays locked for a whole batch, so this is also how long other jobs may have to wait for it */
+static const int32 CompileBatchSize = 16;
+
 uint32 FCompileJobHandle::Run()
 {
-    for (const TPair<FShaderId, FShader*> shader : OutShaders)
+    // Shaders that cross compiled to the same GLSL for several quality levels share one compiler output.
+    // Keyed on the device GLSL, shader type and vertex factory, so that only the quality level mask differs between duplicates.
+    TMap<FSHAHash, FRawOutputLocation> compiledShaders;
+
+    // The compiler list usually comes from the catalogue cache, in which case this is where the vendor libraries get loaded
+    malicm_compiler compiler;
+    if (!FAsyncCompiler::LoadCompilerLibraries() || !Platform.GetDriver().GetCompiler(compiler))
+    {
+        FMaliOCRawCompilerOutput::FErrorOutput error;
+        error.CommonOutput.ShaderName = FName(TEXT("Offline Compiler"));
+        error.CommonOutput.Frequency = SF_NumFrequencies;
+        error.Errors.Add(FString::Printf(TEXT("Could not load the offline compiler for %s %s %s"), *Platform.GetDriver().GetRevision().GetCore().GetName(), *Platform.GetDriver().GetRevision().GetName(), *Platform.GetDriver().GetName()));
+        error.Errors.Add(TEXT("The Mali Offline Compiler folder may have changed since the editor started. Restart the editor to refresh the list of compilers."));
+        RawCompilerOutput->ErrorOutput.Add(MoveTemp(error));
+        NumCompiledShaders.Set(TotalNumShaders);
+        return 0;
+    }
+
+    // On Linux, a copy of the compiler libraries of our own means this job never waits for another one
+    const FMaliDriver& driver = Platform.GetDriver();
+    const FCompilerManager* compilerManager = FCompilerManager::AcquireIsolatedInstance();
+    if (compilerManager == nullptr || !compilerManager->FindCompiler(driver.GetName(), driver.GetRevision().GetCore().GetName(), driver.GetRevision().GetName(), compiler))
+    {
+        FCompilerManager::ReleaseIsolatedInstance(compilerManager);
+        compilerManager = FCompilerManager::Get();
+    }
+
+    // Shaders waiting to be compiled in the next batch
+    struct FPendingCompile
+    {
+        TArray<ANSICHAR> GlslCode;
+        const char* Type;
+        FShader* Shader;
+        FMaliOCQualityLevelMask QualityLevelMask;
+        FSHAHash GlslHash;
+        /** Number of job shaders that this compile stands for, including duplicates found while it was waiting */
+        int32 NumShaders;
+    };
+
+    TArray<FPendingCompile> pending;
+    TMap<FSHAHash, int32> pendingHashes;
+    TArray<FMaliOCCompileInput> batchInputs;
+    FMaliOCCompileOutputBuffer batchOutputs;
+
+    // Compile everything that's waiting, then handle the output of the compiler and remember which entry each shader went into
+    const auto compilePending = [&]()
+    {
+        if (pending.Num() == 0)
+        {
+            return;
+        }
+
+        batchInputs.Reset(pending.Num());
+        for (const FPendingCompile& pendingCompile : pending)
+        {
+            FMaliOCCompileInput input;
+            input.Source = pendingCompile.GlslCode.GetData();
+            input.ShaderType = pendingCompile.Type;
+            batchInputs.Add(input);
+        }
+
+        compilerManager->CompileBatch(compiler, batchInputs.GetData(), batchInputs.Num(), batchOutputs);
+
+        for (int32 i = 0; i < pending.Num(); i++)
+        {
+            const FPendingCompile& pendingCompile = pending[i];
+
+            malioc_outputs outputs;
+            const bool ran = batchOutputs.GetOutputs(i, outputs);
+
+            const int32 numErrors = RawCompilerOutput->ErrorOutput.Num();
+            const int32 numMidgard = RawCompilerOutput->MidgardOutput.Num();
+
+            AppendNewRawCompilerOutput(ran, outputs, pendingCompile.GlslCode.GetData(), pendingCompile.Shader, pendingCompile.QualityLevelMask);
+
+            if (RawCompilerOutput->ErrorOutput.Num() != numErrors)
+            {
+                compiledShaders.Add(pendingCompile.GlslHash, FRawOutputLocation{ FRawOutputLocation::EKind::Error, numErrors });
+            }
+            else if (RawCompilerOutput->MidgardOutput.Num() != numMidgard)
+            {
+                compiledShaders.Add(pendingCompile.GlslHash, FRawOutputLocation{ FRawOutputLocation::EKind::Midgard, numMidgard });
+            }
+            else
+            {
+                compiledShaders.Add(pendingCompile.GlslHash, FRawOutputLocation{ FRawOutputLocation::EKind::Utgard, RawCompilerOutput->UtgardOutput.Num() - 1 });
+            }
+
+            NumCompiledShaders.Add(pendingCompile.NumShaders);
+        }
+
+        pending.Reset();
+        pendingHashes.Reset();
+    };
+
+    for (const FJobShader& jobShader : OutShaders)
     {
-        const EShaderFrequency freq = shader.Value->GetType()->GetFrequency();
+        // Cancelled jobs stop between shaders, leaving their output incomplete
+        if (StopRequested.GetValue() != 0)
+        {
+            break;
+        }
+
+        FShader* const shader = jobShader.Shader;
+        const EShaderFrequency freq = shader->GetType()->GetFrequency();
 
-        // We only support vertex and fragment shaders for now
-        if (freq != EShaderFrequency::SF_Pixel && freq != EShaderFrequency::SF_Vertex)
+        const char* compilerShaderType = GetCompilerShaderType(freq);
+        if (compilerShaderType == nullptr)
         {
             FMaliOCRawCompilerOutput::FErrorOutput error;
-            error.CommonOutput.ShaderName = shader.Value->GetType()->GetName();
+            error.CommonOutput.ShaderName = FName(shader->GetType()->GetName());
             error.CommonOutput.Frequency = freq;
-            error.Errors.Add(TEXT("Cross compiler produced invalid output"));
-            error.Errors.Add(TEXT("The shader type is neither fragment nor vertex"));
+            error.CommonOutput.QualityLevelMask = jobShader.QualityLevelMask;
+            error.Errors.Add(TEXT("Unsupported shader stage"));
+            error.Errors.Add(TEXT("The offline compiler can only compile vertex, tessellation, geometry, fragment and compute shaders"));
             RawCompilerOutput->ErrorOutput.Add(MoveTemp(error));
         }
         else
         {
             // Extract the GLSL code from the shader
-            const TArray<uint8>& code = shader.Value->GetCode();
+            const TArray<uint8>& code = shader->GetCode();
 
             FShaderCodeReader ShaderCode(code);
             FMemoryReader Ar(code, true);
@@ -296,147 +782,80 @@ uint32 FCompileJobHandle::Run()
             const ANSICHAR* source = (ANSICHAR*)code.GetData() + CodeOffset;
             GlslCodeOriginal.Append(source, FCStringAnsi::Strlen(source) + 1);
 
-            const GLenum TypeEnum = [&]() -> GLenum
-            {
-                if (freq == EShaderFrequency::SF_Vertex) return GL_VERTEX_SHADER;
-                if (freq == EShaderFrequency::SF_Pixel) return GL_FRAGMENT_SHADER;
-                check(false);
-                return 0;
-            }();
-
             // Get the capabilites that the selected Mali device supports
             FOpenGLShaderDeviceCapabilities Capabilities;
             GetMaliPlatformOpenGLShaderDeviceCapabilities(Platform, Capabilities);
 
             // Take the generic GLSL that came out of the cross compiler and add in whatever hacks/workarounds/special features are required for the best results for the Mali core
             TArray<ANSICHAR> GlslCode;
-            GLSLToDeviceCompatibleGLSL(GlslCodeOriginal, Header.ShaderName, TypeEnum, Capabilities, GlslCode);
+            GLSLToDeviceCompatibleGLSL(GlslCodeOriginal, Header.ShaderName, GetGLShaderType(freq), Capabilities, GlslCode);
 
-            // Take the specialized shader code and run it through the offline compiler
-            const char* type = nullptr;
-            if (freq == EShaderFrequency::SF_Pixel)
-            {
-                type = "fragment";
-            }
-            else if (freq == EShaderFrequency::SF_Vertex)
+            // If we've already compiled exactly this shader for another quality level, just mark that output as also belonging to this one
+            const FShaderType* shaderType = shader->GetType();
+            const FVertexFactoryType* vertexFactoryType = shader->GetVertexFactoryType();
+
+            FSHA1 hashState;
+            hashState.Update((const uint8*)GlslCode.GetData(), GlslCode.Num() * sizeof(ANSICHAR));
+            hashState.UpdateWithString(shaderType->GetName(), FCString::Strlen(shaderType->GetName()));
+            if (vertexFactoryType != nullptr)
             {
-                type = "vertex";
+                hashState.UpdateWithString(vertexFactoryType->GetName(), FCString::Strlen(vertexFactoryType->GetName()));
             }
+            hashState.Final();
 
-            malioc_outputs outputs;
-
-            const bool ran = FCompilerManager::Get()->_malicm_compile(&outputs, GlslCode.GetData(), type, nullptr, 0, false, false, nullptr, 0, Platform.GetDriver().GetCompiler());
-
-            // Handle the output of the compiler
-            AppendNewRawCompilerOutput(ran, outputs, GlslCode.GetData(), shader.Value);
-
-            FCompilerManager::Get()->_malicm_release_compiler_outputs(&outputs);
-        }
+            FSHAHash glslHash;
+            hashState.GetHash(&glslHash.Hash[0]);
 
-        NumCompiledShaders.Increment();
-    }
-    return 0;
-}
-
-FMaliOCRawCompilerOutput::FMidgardOutput ParseMidgardFlexibleOutputs(const malioc_key_value_pairs* const flexible_outputs, unsigned int size)
-{
-    FMaliOCRawCompilerOutput::FMidgardOutput output;
-
-    for (unsigned int i = 0; i < size; ++i)
-    {
-        FMaliOCRawCompilerOutput::FMidgardOutput::FRenderTarget rt;
-
-        /* Pull out the data from the flexible output list. */
-        for (unsigned int j = 0; j < flexible_outputs[i].number_of_entries - 1; j += 2)
-        {
-            if (FCStringAnsi::Strcmp(flexible_outputs[i].list[j], "render_target") == 0)
-            {
-                rt.render_target = FCStringAnsi::Atoi(flexible_outputs[i].list[j + 1]);
-            }
-            else if (FCStringAnsi::Strcmp(flexible_outputs[i].list[j], "work_registers_used") == 0)
-            {
-                rt.work_registers_used = FCStringAnsi::Atoi(flexible_outputs[i].list[j + 1]);
-            }
-            else if (FCStringAnsi::Strcmp(flexible_outputs[i].list[j], "uniform_registers_used") == 0)
-            {
-                rt.uniform_registers_used = FCStringAnsi::Atoi(flexible_outputs[i].list[j + 1]);
-            }
-            else if (FCStringAnsi::Strcmp(flexible_outputs[i].list[j], "arithmetic_cycles") == 0)
-            {
-                rt.arithmetic_cycles = FCStringAnsi::Atof(flexible_outputs[i].list[j + 1]);
-            }
-            else if (FCStringAnsi::Strcmp(flexible_outputs[i].list[j], "arithmetic_shortest_path") == 0)
-            {
-                rt.arithmetic_shortest_path = FCStringAnsi::Atof(flexible_outputs[i].list[j + 1]);
-            }
-            else if (FCStringAnsi::Strcmp(flexible_outputs[i].list[j], "arithmetic_longest_path") == 0)
-            {
-                rt.arithmetic_longest_path = FCStringAnsi::Atof(flexible_outputs[i].list[j + 1]);
-            }
-            else if (FCStringAnsi::Strcmp(flexible_outputs[i].list[j], "load_store_cycles") == 0)
-            {
-                rt.load_store_cycles = FCStringAnsi::Atof(flexible_outputs[i].list[j + 1]);
-            }
-            else if (FCStringAnsi::Strcmp(flexible_outputs[i].list[j], "load_store_shortest_path") == 0)
-            {
-                rt.load_store_shortest_path = FCStringAnsi::Atof(flexible_outputs[i].list[j + 1]);
-            }
-            else if (FCStringAnsi::Strcmp(flexible_outputs[i].list[j], "load_store_longest_path") == 0)
-            {
-                rt.load_store_longest_path = FCStringAnsi::Atof(flexible_outputs[i].list[j + 1]);
-            }
-            else if (FCStringAnsi::Strcmp(flexible_outputs[i].list[j], "texture_cycles") == 0)
+            const FRawOutputLocation* existingOutput = compiledShaders.Find(glslHash);
+            if (existingOutput != nullptr)
             {
-                rt.texture_cycles = FCStringAnsi::Atof(flexible_outputs[i].list[j + 1]);
+                GetCommonOutput(*RawCompilerOutput, *existingOutput).QualityLevelMask |= jobShader.QualityLevelMask;
+                NumCompiledShaders.Increment();
+                continue;
             }
-            else if (FCStringAnsi::Strcmp(flexible_outputs[i].list[j], "texture_shortest_path") == 0)
-            {
-                rt.texture_shortest_path = FCStringAnsi::Atof(flexible_outputs[i].list[j + 1]);
-            }
-            else if (FCStringAnsi::Strcmp(flexible_outputs[i].list[j], "texture_longest_path") == 0)
+
+            // Or it may be waiting in the current batch
+            const int32* pendingIndex = pendingHashes.Find(glslHash);
+            if (pendingIndex != nullptr)
             {
-                rt.texture_longest_path = FCStringAnsi::Atof(flexible_outputs[i].list[j + 1]);
+                pending[*pendingIndex].QualityLevelMask |= jobShader.QualityLevelMask;
+                pending[*pendingIndex].NumShaders++;
+                continue;
             }
-            else if (FCStringAnsi::Strcmp(flexible_outputs[i].list[j], "spilling_used") == 0)
+
+            // Queue the specialized shader code to be run through the offline compiler
+            FPendingCompile& pendingCompile = pending[pending.AddDefaulted()];
+            pendingCompile.GlslCode = MoveTemp(GlslCode);
+            pendingCompile.Type = compilerShaderType;
+            pendingCompile.Shader = shader;
+            pendingCompile.QualityLevelMask = jobShader.QualityLevelMask;
+            pendingCompile.GlslHash = glslHash;
+            pendingCompile.NumShaders = 1;
+            pendingHashes.Add(glslHash, pending.Num() - 1);
+
+            if (pending.Num() == CompileBatchSize)
             {
-                rt.spilling_used = (FCStringAnsi::Strcmp(flexible_outputs[i].list[j + 1], "true") == 0);
+                compilePending();
             }
+            continue;
         }
 
-        output.RenderTargets.Add(MoveTemp(rt));
+        NumCompiledShaders.Increment();
     }
 
-    return output;
-}
-
-FMaliOCRawCompilerOutput::FUtgardOutput ParseUtgardFlexibleOutputs(const malioc_key_value_pairs* const flexible_outputs, unsigned int size)
-{
-    FMaliOCRawCompilerOutput::FUtgardOutput output;
-
-    /* Pull out the data from the flexible output list. */
-    for (unsigned int i = 0; i < flexible_outputs[0].number_of_entries - 1; i += 2)
+    if (StopRequested.GetValue() == 0)
     {
-        if (FCStringAnsi::Strcmp(flexible_outputs[0].list[i], "min_number_of_cycles") == 0)
-        {
-            output.min_number_of_cycles = FCStringAnsi::Atoi(flexible_outputs[0].list[i + 1]);
-        }
-        else if (FCStringAnsi::Strcmp(flexible_outputs[0].list[i], "max_number_of_cycles") == 0)
-        {
-            output.max_number_of_cycles = FCStringAnsi::Atoi(flexible_outputs[0].list[i + 1]);
-        }
-        else if (FCStringAnsi::Strcmp(flexible_outputs[0].list[i], "n_instruction_words") == 0)
-        {
-            output.n_instruction_words = FCStringAnsi::Atoi(flexible_outputs[0].list[i + 1]);
-        }
+        compilePending();
     }
 
-    return output;
+    FCompilerManager::ReleaseIsolatedInstance(compilerManager);
+    return 0;
 }
 
 /** Mappings between programmatic vertex factory name and pretty vertex factory name */
-static const TMap<FString, FString> VertexFactoryPrettyNameMap = []()
+static const TMap<FName, FName> VertexFactoryPrettyNameMap = []()
 {
-    TMap<FString, FString> map;
+    TMap<FName, FName> map;
 
     map.Add(TEXT("FLocalVertexFactory"), TEXT("Default Usage"));
     map.Add(TEXT("TGPUSkinVertexFactoryfalse"), TEXT("Used with Skeletal Mesh"));
@@ -460,136 +879,83 @@ static const TMap<FString, FString> VertexFactoryPrettyNameMap = []()
     return map;
 }();
 
-/**
- * @param VertexFactoryName the vertex factory name
- * @return The pretty vertex factory name corresponding to VertexFactoryName
- */
-FString GetBeautifiedVertexFactoryName(const FString& VertexFactoryName)
+FName GetBeautifiedVertexFactoryName(FName VertexFactoryName)
 {
-    const FString* prettyName = VertexFactoryPrettyNameMap.Find(VertexFactoryName);
+    static const FName NoVertexFactoryName(TEXT("No Vertex Factory"));
+
+    const FName* prettyName = VertexFactoryPrettyNameMap.Find(VertexFactoryName);
     if (prettyName != nullptr)
     {
         return *prettyName;
     }
 
-    check(VertexFactoryName.Len() == 0); // Programming error if we let through a case which has a name
+    check(VertexFactoryName.IsNone()); // Programming error if we let through a case which has a name
 
-    return TEXT("No Vertex Factory");
+    return NoVertexFactoryName;
 }
 
-void FCompileJobHandle::AppendNewRawCompilerOutput(bool bCompilerRan, malioc_outputs& outputs, const char* GLSL, FShader* Shader)
+void FCompileJobHandle::AppendNewRawCompilerOutput(bool bCompilerRan, malioc_outputs& outputs, const char* GLSL, FShader* Shader, FMaliOCQualityLevelMask QualityLevelMask)
 {
     FMaliOCRawCompilerOutput::FCommonOutput commonOutput;
-    commonOutput.ShaderName = Shader->GetType()->GetName();
+    commonOutput.ShaderName = FName(Shader->GetType()->GetName());
     commonOutput.Frequency = Shader->GetType()->GetFrequency();
-    FString VertexFactoryType;
+    commonOutput.QualityLevelMask = QualityLevelMask;
+    FName VertexFactoryType;
     const auto* vft = Shader->GetVertexFactoryType();
     if (vft)
     {
-        VertexFactoryType = vft->GetName();
+        VertexFactoryType = FName(vft->GetName());
     }
 
     commonOutput.VertexFactoryName = GetBeautifiedVertexFactoryName(VertexFactoryType);
 
-    commonOutput.SourceCode = ANSI_TO_TCHAR(GLSL);
-
-    // Add an error if the compiler didn't even run
-    if (!bCompilerRan)
+    if (Options.bRetainSourceCode)
     {
-        FMaliOCRawCompilerOutput::FErrorOutput error;
-        error.CommonOutput = MoveTemp(commonOutput);
-        error.Errors.Add(TEXT("Compiler could not be run"));
-        RawCompilerOutput->ErrorOutput.Add(MoveTemp(error));
-        return;
+        commonOutput.SourceCode = FMaliOCShaderSource::Create(GLSL);
     }
 
-    // outputs is only valid if the compiler actually ran
-    for (unsigned int i = 0; i < outputs.number_of_warnings; i++)
-    {
-        commonOutput.Warnings.Add(ANSI_TO_TCHAR(outputs.warnings[i]));
-    }
+    AppendRawCompilerOutput(bCompilerRan, outputs, MoveTemp(commonOutput), *RawCompilerOutput);
+}
 
-    // Add an error if the compiler returned any errors
-    if (outputs.number_of_errors != 0)
-    {
-        FMaliOCRawCompilerOutput::FErrorOutput error;
-        error.CommonOutput = MoveTemp(commonOutput);
-        for (unsigned int i = 0; i < outputs.number_of_errors; i++)
-        {
-            error.Errors.Add(ANSI_TO_TCHAR(outputs.errors[i]));
-        }
-        RawCompilerOutput->ErrorOutput.Add(MoveTemp(error));
-        return;
-    }
+void AppendRawCompilerOutput(bool bCompilerRan, const malioc_outputs& Outputs, FMaliOCRawCompilerOutput::FCommonOutput&& CommonOutput, FMaliOCRawCompilerOutput& OutRawOutput)
+{
+    FMaliOCParsedOutputs parsed;
+    FMaliOCOutputParser::Parse(bCompilerRan, Outputs, parsed);
 
-    // There must be at least one output to print
-    if (outputs.number_of_flexible_outputs == 0)
+    for (const std::string& warning : parsed.Warnings)
     {
-        FMaliOCRawCompilerOutput::FErrorOutput error;
-        error.CommonOutput = MoveTemp(commonOutput);
-        error.Errors.Add(TEXT("No verbose output from compiler"));
-        RawCompilerOutput->ErrorOutput.Add(MoveTemp(error));
-        return;
+        CommonOutput.Warnings.Add(ANSI_TO_TCHAR(warning.c_str()));
     }
 
-    // Each flexible output corresponds to one render target
-    // Each flexible output has a list of key-value pairs. Keys have even indexes, and values odd
-
-    enum class EMaliArch
+    switch (parsed.Result)
     {
-        None,
-        Utgard,
-        Midgard
-    };
-
-    EMaliArch outputArch = EMaliArch::None;
-
-    // Check the very first flexible output for the architecture information
-    for (unsigned int i = 0; i < outputs.flexible_outputs[0].number_of_entries - 1; i += 2)
+    case FMaliOCParsedOutputs::EResult::Error:
     {
-        if (strcmp(outputs.flexible_outputs[0].list[i], "architecture") == 0)
+        FMaliOCRawCompilerOutput::FErrorOutput error;
+        error.CommonOutput = MoveTemp(CommonOutput);
+        for (const std::string& message : parsed.Errors)
         {
-            if (strcmp(outputs.flexible_outputs[0].list[i + 1], "midgard") == 0)
-            {
-                outputArch = EMaliArch::Midgard;
-                break;
-            }
-            else if (strcmp(outputs.flexible_outputs[0].list[i + 1], "utgard") == 0)
-            {
-                outputArch = EMaliArch::Utgard;
-                break;
-            }
+            error.Errors.Add(ANSI_TO_TCHAR(message.c_str()));
         }
+        OutRawOutput.ErrorOutput.Add(MoveTemp(error));
+        break;
     }
-
-    const bool bNoArch = (outputArch == EMaliArch::None);
-    const bool bUtgardTooManyRTs = (outputArch == EMaliArch::Utgard) && (outputs.number_of_flexible_outputs != 1);
-
-    // Either we didn't find an architecture or we received an invalid format for Utgard
-    if (bNoArch || bUtgardTooManyRTs)
-    {
-        FMaliOCRawCompilerOutput::FErrorOutput error;
-        error.CommonOutput = MoveTemp(commonOutput);
-        error.Errors.Add(TEXT("Unknown verbose output format from compiler"));
-        RawCompilerOutput->ErrorOutput.Add(MoveTemp(error));
-        return;
-    }
-
-    // We have valid output. Create either a midgard or utgard report depending on the output
-    switch (outputArch)
+    case FMaliOCParsedOutputs::EResult::Midgard:
     {
-    case EMaliArch::Midgard:
-    {
-        FMaliOCRawCompilerOutput::FMidgardOutput MidgardOutput = ParseMidgardFlexibleOutputs(outputs.flexible_outputs, outputs.number_of_flexible_outputs);
-        MidgardOutput.CommonOutput = MoveTemp(commonOutput);
-        RawCompilerOutput->MidgardOutput.Add(MoveTemp(MidgardOutput));
+        FMaliOCRawCompilerOutput::FMidgardOutput MidgardOutput;
+        MidgardOutput.CommonOutput = MoveTemp(CommonOutput);
+        MidgardOutput.RenderTargets.Append(parsed.RenderTargets.data(), (int32)parsed.RenderTargets.size());
+        OutRawOutput.MidgardOutput.Add(MoveTemp(MidgardOutput));
         break;
     }
-    case EMaliArch::Utgard:
+    case FMaliOCParsedOutputs::EResult::Utgard:
     {
-        FMaliOCRawCompilerOutput::FUtgardOutput UtgardOutput = ParseUtgardFlexibleOutputs(outputs.flexible_outputs, outputs.number_of_flexible_outputs);
-        UtgardOutput.CommonOutput = MoveTemp(commonOutput);
-        RawCompilerOutput->UtgardOutput.Add(MoveTemp(UtgardOutput));
+        FMaliOCRawCompilerOutput::FUtgardOutput UtgardOutput;
+        UtgardOutput.CommonOutput = MoveTemp(CommonOutput);
+        UtgardOutput.min_number_of_cycles = parsed.Utgard.min_number_of_cycles;
+        UtgardOutput.max_number_of_cycles = parsed.Utgard.max_number_of_cycles;
+        UtgardOutput.n_instruction_words = parsed.Utgard.n_instruction_words;
+        OutRawOutput.UtgardOutput.Add(MoveTemp(UtgardOutput));
         break;
     }
     default:
@@ -604,25 +970,15 @@ CoreName(MaliCoreName)
 {
 }
 
-void FMaliCore::AddRevision(const FString& RevisionName, const FString& DriverName, malicm_compiler Compiler, unsigned int MaxAPI, const FString Extensions, const FString& PlatformName, EShaderPlatform Platform)
+void FMaliCore::AddRevision(const FString& RevisionName, const FString& DriverName, unsigned int MaxAPI, const FString Extensions, const FString& PlatformName, EShaderPlatform Platform)
 {
-    TUniqueObj<FMaliCoreRevision>* Rev = nullptr;
-
-    for (auto& Revision : Revisions)
-    {
-        if (Revision->GetName().Equals(RevisionName))
-        {
-            Rev = &Revision;
-            break;
-        }
-    }
-
-    if (Rev == nullptr)
+    int32* RevisionIndex = RevisionIndices.Find(RevisionName);
+    if (RevisionIndex == nullptr)
     {
-        Rev = &Revisions[Revisions.Emplace(RevisionName, *this)];
+        RevisionIndex = &RevisionIndices.Add(RevisionName, Revisions.Emplace(RevisionName, *this));
     }
 
-    (*Rev)->AddDriver(DriverName, Compiler, MaxAPI, Extensions, PlatformName, Platform);
+    Revisions[*RevisionIndex]->AddDriver(DriverName, MaxAPI, Extensions, PlatformName, Platform);
 }
 
 const FString& FMaliCore::GetName() const
@@ -635,31 +991,27 @@ const TArray<TUniqueObj<FMaliCoreRevision>>& FMaliCore::GetRevisions() const
     return Revisions;
 }
 
+const FMaliCoreRevision* FMaliCore::FindRevision(const FString& RevisionName) const
+{
+    const int32* RevisionIndex = RevisionIndices.Find(RevisionName);
+    return RevisionIndex != nullptr ? &Revisions[*RevisionIndex].Get() : nullptr;
+}
+
 FMaliCoreRevision::FMaliCoreRevision(const FString& MaliRevisionName, const FMaliCore& MaliCore) :
 RevisionName(MaliRevisionName),
 Core(MaliCore)
 {
 }
 
-void FMaliCoreRevision::AddDriver(const FString& DriverName, malicm_compiler Compiler, unsigned int MaxAPI, const FString Extensions, const FString& PlatformName, EShaderPlatform Platform)
+void FMaliCoreRevision::AddDriver(const FString& DriverName, unsigned int MaxAPI, const FString Extensions, const FString& PlatformName, EShaderPlatform Platform)
 {
-    TUniqueObj<FMaliDriver>* Dri = nullptr;
-
-    for (auto& Driver : Drivers)
+    int32* DriverIndex = DriverIndices.Find(DriverName);
+    if (DriverIndex == nullptr)
     {
-        if (Driver->GetName().Equals(DriverName))
-        {
-            Dri = &Driver;
-            break;
-        }
-    }
-
-    if (Dri == nullptr)
-    {
-        Dri = &Drivers[Drivers.Emplace(DriverName, *this, Compiler, MaxAPI, Extensions)];
+        DriverIndex = &DriverIndices.Add(DriverName, Drivers.Emplace(DriverName, *this, MaxAPI, Extensions));
     }
 
-    (*Dri)->AddShaderPlatform(PlatformName, Platform);
+    Drivers[*DriverIndex]->AddShaderPlatform(PlatformName, Platform);
 }
 
 const FString& FMaliCoreRevision::GetName() const
@@ -677,10 +1029,15 @@ const TArray<TUniqueObj<FMaliDriver>>& FMaliCoreRevision::GetDrivers() const
     return Drivers;
 }
 
-FMaliDriver::FMaliDriver(const FString& MaliDriverName, const FMaliCoreRevision& MaliRevision, malicm_compiler MaliCompiler, unsigned int MaliMaxAPI, const FString MaliExtensions) :
+const FMaliDriver* FMaliCoreRevision::FindDriver(const FString& DriverName) const
+{
+    const int32* DriverIndex = DriverIndices.Find(DriverName);
+    return DriverIndex != nullptr ? &Drivers[*DriverIndex].Get() : nullptr;
+}
+
+FMaliDriver::FMaliDriver(const FString& MaliDriverName, const FMaliCoreRevision& MaliRevision, unsigned int MaliMaxAPI, const FString MaliExtensions) :
 DriverName(MaliDriverName),
 Revision(MaliRevision),
-Compiler(MaliCompiler),
 MaxAPI(MaliMaxAPI),
 Extensions(MaliExtensions)
 {
@@ -688,7 +1045,11 @@ Extensions(MaliExtensions)
 
 void FMaliDriver::AddShaderPlatform(const FString& PlatformName, EShaderPlatform Platform)
 {
-    Platforms.Emplace(PlatformName, *this, Platform);
+    // A platform ID must identify exactly one platform
+    if (!PlatformIndices.Contains(PlatformName))
+    {
+        PlatformIndices.Add(PlatformName, Platforms.Emplace(PlatformName, *this, Platform));
+    }
 }
 
 const FString& FMaliDriver::GetName() const
@@ -700,9 +1061,21 @@ const FMaliCoreRevision& FMaliDriver::GetRevision() const
     return Revision;
 }
 
-malicm_compiler FMaliDriver::GetCompiler() const
+bool FMaliDriver::GetCompiler(malicm_compiler& OutCompiler) const
 {
-    return Compiler;
+    FScopeLock lock(&CompilerLibrariesCriticalSection);
+
+    if (!bIsCompilerResolved)
+    {
+        const FCompilerManager* compilerManager = FCompilerManager::Get();
+        check(compilerManager != nullptr);
+
+        bHasCompiler = compilerManager->FindCompiler(DriverName, Revision.GetCore().GetName(), Revision.GetName(), Compiler);
+        bIsCompilerResolved = true;
+    }
+
+    OutCompiler = Compiler;
+    return bHasCompiler;
 }
 
 unsigned int FMaliDriver::GetMaxAPI() const
@@ -720,10 +1093,27 @@ const TArray<TUniqueObj<FMaliPlatform>>& FMaliDriver::GetPlatforms() const
     return Platforms;
 }
 
+const FMaliPlatform* FMaliDriver::FindPlatform(const FString& PlatformName) const
+{
+    const int32* PlatformIndex = PlatformIndices.Find(PlatformName);
+    return PlatformIndex != nullptr ? &Platforms[*PlatformIndex].Get() : nullptr;
+}
+
+static FMaliPlatformId MakePlatformId(const FMaliDriver& Driver, const FString& PlatformName)
+{
+    FMaliPlatformId id;
+    id.CoreName = Driver.GetRevision().GetCore().GetName();
+    id.RevisionName = Driver.GetRevision().GetName();
+    id.DriverName = Driver.GetName();
+    id.PlatformName = PlatformName;
+    return id;
+}
+
 FMaliPlatform::FMaliPlatform(const FString& MaliPlatformName, const FMaliDriver& MaliDriver, EShaderPlatform MaliPlatform) :
 PlatformName(MaliPlatformName),
 Driver(MaliDriver),
-Platform(MaliPlatform)
+Platform(MaliPlatform),
+Id(MakePlatformId(MaliDriver, MaliPlatformName))
 {
 }
 
@@ -740,3 +1130,66 @@ EShaderPlatform FMaliPlatform::GetPlatform() const
 {
     return Platform;
 }
+
+const FMaliPlatformId& FMaliPlatform::GetId() const
+{
+    return Id;
+}
+
+/** Escape the separator, and the escape character itself, in one name of a platform ID */
+static FString EscapePlatformIdPart(const FString& Part)
+{
+    return Part.Replace(TEXT("%"), TEXT("%25")).Replace(TEXT("/"), TEXT("%2F"));
+}
+
+/** @return false if Part has an escape EscapePlatformIdPart() wouldn't have written */
+static bool UnescapePlatformIdPart(const FString& Part, FString& OutPart)
+{
+    OutPart.Empty(Part.Len());
+    for (int32 i = 0; i < Part.Len(); i++)
+    {
+        if (Part[i] != TEXT('%'))
+        {
+            OutPart.AppendChar(Part[i]);
+        }
+        else if (Part.Mid(i + 1, 2) == TEXT("25"))
+        {
+            OutPart.AppendChar(TEXT('%'));
+            i += 2;
+        }
+        else if (Part.Mid(i + 1, 2).Equals(TEXT("2F"), ESearchCase::IgnoreCase))
+        {
+            OutPart.AppendChar(TEXT('/'));
+            i += 2;
+        }
+        else
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+FString FMaliPlatformId::ToString() const
+{
+    return FString::Printf(TEXT("%s/%s/%s/%s"), *EscapePlatformIdPart(CoreName), *EscapePlatformIdPart(RevisionName), *EscapePlatformIdPart(DriverName), *EscapePlatformIdPart(PlatformName));
+}
+
+bool FMaliPlatformId::Parse(const FString& IdString, FMaliPlatformId& OutId)
+{
+    TArray<FString> parts;
+    if (IdString.ParseIntoArray(parts, TEXT("/"), false) != 4)
+    {
+        return false;
+    }
+
+    FMaliPlatformId id;
+    if (!UnescapePlatformIdPart(parts[0], id.CoreName) || !UnescapePlatformIdPart(parts[1], id.RevisionName) ||
+        !UnescapePlatformIdPart(parts[2], id.DriverName) || !UnescapePlatformIdPart(parts[3], id.PlatformName))
+    {
+        return false;
+    }
+
+    OutId = MoveTemp(id);
+    return true;
+}
@@ -17,12 +17,53 @@
 #pragma once
 #include "MaliOCPrivatePCH.h"
 #include "compiler_manager/compiler_manager.h"
+#include "Core/MaliOCCompilerStatistics.h"
+#include "MaliOCShaderSource.h"
+#include "MaliOCPermutationFilter.h"
+#include "MaliOCSampling.h"
 
 /* Hierarchy is Core->Revision->Driver->Platform as this is how we display things in the UI */
 class FMaliCoreRevision;
 class FMaliDriver;
 class FMaliPlatform;
 
+/**
+ * Identifies a Mali Platform by the names along its path in the hierarchy.
+ * Unlike array indices or compiler handles, the names don't change between editor sessions or when other drivers are added to or removed from the bundle,
+ * so IDs can be stored in caches, baselines and batch configurations.
+ */
+struct FMaliPlatformId
+{
+    FString CoreName;
+    FString RevisionName;
+    FString DriverName;
+    FString PlatformName;
+
+    /** @return the ID as a single string, e.g. "Mali-T760/r0p0/Mali-T760_r5p0-00rel0/OpenGL ES 2.0". Any / or % in a name is written as %2F or %25 */
+    FString ToString() const;
+
+    /**
+     * Parse an ID written by ToString()
+     * @return false if IdString isn't a valid ID, in which case OutId is untouched
+     */
+    static bool Parse(const FString& IdString, FMaliPlatformId& OutId);
+
+    bool operator==(const FMaliPlatformId& Other) const
+    {
+        return CoreName == Other.CoreName && RevisionName == Other.RevisionName && DriverName == Other.DriverName && PlatformName == Other.PlatformName;
+    }
+
+    friend uint32 GetTypeHash(const FMaliPlatformId& Id)
+    {
+        return HashCombine(HashCombine(GetTypeHash(Id.CoreName), GetTypeHash(Id.RevisionName)), HashCombine(GetTypeHash(Id.DriverName), GetTypeHash(Id.PlatformName)));
+    }
+
+    friend FArchive& operator<<(FArchive& Ar, FMaliPlatformId& Id)
+    {
+        return Ar << Id.CoreName << Id.RevisionName << Id.DriverName << Id.PlatformName;
+    }
+};
+
 /** A Mali Core (i.e. Mali-400, Mali-T600, etc.)*/
 class FMaliCore final
 {
@@ -35,13 +76,17 @@ public:
     FMaliCore& operator=(FMaliCore&&) = delete;
 
     /** Add a new revision to this core with the given params */
-    void AddRevision(const FString& RevisionName, const FString& DriverName, malicm_compiler Compiler, unsigned int MaxAPI, const FString Extensions, const FString& PlatformName, EShaderPlatform Platform);
+    void AddRevision(const FString& RevisionName, const FString& DriverName, unsigned int MaxAPI, const FString Extensions, const FString& PlatformName, EShaderPlatform Platform);
     const FString& GetName() const;
     /** Get an array of the revisions that this core has */
     const TArray<TUniqueObj<FMaliCoreRevision>>& GetRevisions() const;
+    /** @return the revision with the given name, or nullptr if this core doesn't have one */
+    const FMaliCoreRevision* FindRevision(const FString& RevisionName) const;
 private:
     const FString CoreName;
     TArray<TUniqueObj<FMaliCoreRevision>> Revisions;
+    /** Index into Revisions of each revision name */
+    TMap<FString, int32> RevisionIndices;
 };
 
 /** A Mali Core Revision (i.e. Mali-T600 r0p1, etc.) */
@@ -56,23 +101,27 @@ public:
     FMaliCoreRevision& operator=(FMaliCoreRevision&&) = delete;
 
     /** Add a new driver to this core revision with the given params */
-    void AddDriver(const FString& DriverName, malicm_compiler Compiler, unsigned int MaxAPI, const FString Extensions, const FString& PlatformName, EShaderPlatform Platform);
+    void AddDriver(const FString& DriverName, unsigned int MaxAPI, const FString Extensions, const FString& PlatformName, EShaderPlatform Platform);
     const FString& GetName() const;
     /** Get the core that this revision belongs to */
     const FMaliCore& GetCore() const;
     /** Get an array of the drivers that this core revision has */
     const TArray<TUniqueObj<FMaliDriver>>& GetDrivers() const;
+    /** @return the driver with the given name, or nullptr if this revision doesn't have one */
+    const FMaliDriver* FindDriver(const FString& DriverName) const;
 private:
     const FString RevisionName;
     const FMaliCore& Core;
     TArray<TUniqueObj<FMaliDriver>> Drivers;
+    /** Index into Drivers of each driver name */
+    TMap<FString, int32> DriverIndices;
 };
 
 /** A Mali Core Revision Driver (i.e. Mali-T600_r5p0-00rel0, etc.) */
 class FMaliDriver final
 {
 public:
-    FMaliDriver(const FString& MaliDriverName, const FMaliCoreRevision& MaliRevision, malicm_compiler MaliCompiler, unsigned int MaliMaxAPI, const FString MaliExtensions);
+    FMaliDriver(const FString& MaliDriverName, const FMaliCoreRevision& MaliRevision, unsigned int MaliMaxAPI, const FString MaliExtensions);
     ~FMaliDriver() = default;
     FMaliDriver(const FMaliDriver&) = delete;
     FMaliDriver(FMaliDriver&&) = delete;
@@ -84,19 +133,31 @@ public:
     const FString& GetName() const;
     /** Get the core revision that this driver belongs to */
     const FMaliCoreRevision& GetRevision() const;
-    /** Get the compiler for this core revision and driver*/
-    malicm_compiler GetCompiler() const;
+    /**
+     * Get the compiler for this core revision and driver. The compiler libraries must have been loaded with FAsyncCompiler::LoadCompilerLibraries().
+     * The compiler is looked up by name the first time, as the drivers usually come from the cached catalogue. Thread safe.
+     * @param OutCompiler set to the compiler, if there is one
+     * @return false if the loaded libraries don't have a compiler for this driver (i.e. the bundle changed since the catalogue was built)
+     */
+    bool GetCompiler(malicm_compiler& OutCompiler) const;
     /** Get the highest GLES API version this supports. 100 means ES 2.0, 300 means ES 3.0, 310 means ES 3.1 */
     unsigned int GetMaxAPI() const;
     /** Get an array of the platforms that this core revision and driver supports */
     const TArray<TUniqueObj<FMaliPlatform>>& GetPlatforms() const;
+    /** @return the platform with the given name, or nullptr if this driver doesn't support it */
+    const FMaliPlatform* FindPlatform(const FString& PlatformName) const;
     /** Get a space separated list of the extensions this core revision driver supports */
     const FString& GetExtensions() const;
 private:
     const FString DriverName;
     const FMaliCoreRevision& Revision;
-    const malicm_compiler Compiler;
+    /** Compiler handle. Only valid once bIsCompilerResolved is set, and only if bHasCompiler is */
+    mutable malicm_compiler Compiler = 0;
+    mutable bool bIsCompilerResolved = false;
+    mutable bool bHasCompiler = false;
     TArray<TUniqueObj<FMaliPlatform>> Platforms;
+    /** Index into Platforms of each platform name */
+    TMap<FString, int32> PlatformIndices;
     const unsigned int MaxAPI;
     const FString Extensions;
 };
@@ -117,22 +178,45 @@ public:
     const FMaliDriver& GetDriver() const;
     /** Get the UE4 platform that corresponds to this Mali Platform */
     EShaderPlatform GetPlatform() const;
+    /** Get the ID that identifies this platform across sessions */
+    const FMaliPlatformId& GetId() const;
 private:
     const FString PlatformName;
     const FMaliDriver& Driver;
     const EShaderPlatform Platform;
+    const FMaliPlatformId Id;
 };
 
+/** Set of material quality levels, one bit per EMaterialQualityLevel::Type */
+typedef uint32 FMaliOCQualityLevelMask;
+
+/** @return the mask containing only QualityLevel */
+inline FMaliOCQualityLevelMask QualityLevelToMask(EMaterialQualityLevel::Type QualityLevel)
+{
+    return 1u << QualityLevel;
+}
+
+/**
+ * @param VertexFactoryName the vertex factory type name. None for shaders without a vertex factory
+ * @return the pretty vertex factory name shown in reports
+ */
+FName GetBeautifiedVertexFactoryName(FName VertexFactoryName);
+
 /** Raw output of the offline compiler (parsed into a nice structure) */
 struct FMaliOCRawCompilerOutput
 {
     struct FCommonOutput
     {
-        FString ShaderName;
+        /** Shader type name. Names are interned, so this is just an ID into the global name table */
+        FName ShaderName;
         EShaderFrequency Frequency;
-        FString VertexFactoryName;
-        FString SourceCode;
+        /** Pretty vertex factory name (see GetBeautifiedVertexFactoryName) */
+        FName VertexFactoryName;
+        /** Compressed device GLSL. Null if the job was told not to retain source code */
+        FMaliOCShaderSourceRef SourceCode;
         TArray<FString> Warnings;
+        /** Material quality levels that produced this exact shader (see FMaliOCQualityLevelMask) */
+        FMaliOCQualityLevelMask QualityLevelMask = 0;
     };
 
     struct FErrorOutput
@@ -143,24 +227,7 @@ struct FMaliOCRawCompilerOutput
 
     struct FMidgardOutput
     {
-        struct FRenderTarget
-        {
-            int render_target = 0;
-
-            int work_registers_used = 0;
-            int uniform_registers_used = 0;
-
-            float arithmetic_cycles = 0;
-            float arithmetic_shortest_path = 0;
-            float arithmetic_longest_path = 0;
-            float load_store_cycles = 0;
-            float load_store_shortest_path = 0;
-            float load_store_longest_path = 0;
-            float texture_cycles = 0;
-            float texture_shortest_path = 0;
-            float texture_longest_path = 0;
-            bool spilling_used = false;
-        };
+        typedef FMaliOCMidgardRenderTarget FRenderTarget;
 
         FCommonOutput CommonOutput;
         TArray<FRenderTarget> RenderTargets;
@@ -179,14 +246,51 @@ struct FMaliOCRawCompilerOutput
     TArray<FUtgardOutput> UtgardOutput;
 };
 
-/** Compilation job handle. Used to start a job */
+/**
+ * Hull, domain, geometry and compute shaders only exist on the OpenGL ES 3.1 AEP platform, which is only offered if MaliOC.EnableAEP is set.
+ * @param Frequency the frequency of a shader from the cross compiler
+ * @return the offline compiler's name for the shader type, or nullptr if it can't compile shaders of this frequency
+ */
+const char* GetCompilerShaderType(EShaderFrequency Frequency);
+
+/**
+ * Parse one shader's compiler outputs into an error, Midgard or Utgard entry of a raw output.
+ * @param bCompilerRan whether _malicm_compile returned true. If not, Outputs isn't looked at
+ * @param Outputs the compiler's outputs
+ * @param CommonOutput everything about the shader that doesn't come from the compiler. Warnings are added to it
+ * @param OutRawOutput the raw output to add the entry to
+ */
+void AppendRawCompilerOutput(bool bCompilerRan, const malioc_outputs& Outputs, FMaliOCRawCompilerOutput::FCommonOutput&& CommonOutput, FMaliOCRawCompilerOutput& OutRawOutput);
+
+/** Options controlling what a compile job does */
+struct FCompileJobOptions
+{
+    /** Keep the (compressed) source code of each compiled shader so it can be shown in the report */
+    bool bRetainSourceCode = true;
+    /** Permutations which don't pass the filter are skipped before their GLSL is extracted */
+    FMaliOCPermutationFilter Filter;
+    /** If enabled, only a sample of the permutations is cross compiled and the report estimates statistics for the rest */
+    FMaliOCSamplingOptions Sampling;
+    /** Only cross compile the representative shaders shown in the report's summary. Overrides sampling */
+    bool bOnlySummaryShaders = false;
+};
+
+/** A cross compiled shader map to put through the offline compiler, and the material quality levels it was cross compiled for */
+struct FCompileJobShaderMap
+{
+    TRefCountPtr<FMaterialShaderMap> ShaderMap;
+    FMaliOCQualityLevelMask QualityLevelMask;
+};
+
+/** Compilation job handle. Used to start a job. The accessors are thread safe */
 class FCompileJobHandle final : private FRunnable
 {
 public:
-    /** Return true if compilation has completed */
+    /** Return true if compilation has completed. Once it has, everything the job wrote is visible to the calling thread */
     bool IsCompilationFinished() const
     {
-        return bIsCompilationComplete;
+        // A full barrier, so nothing the caller reads after seeing the flag can be from before the job finished
+        return FPlatformAtomics::InterlockedCompareExchange(&CompilationComplete, 0, 0) != 0;
     }
 
     /** Return the total number of shaders to be compiled */
@@ -201,6 +305,12 @@ public:
         return NumCompiledShaders.GetValue();
     }
 
+    /** Return the number of shaders in the shader maps which were skipped by the permutation filter */
+    uint32 GetNumSkippedShaders() const
+    {
+        return NumSkippedShaders;
+    }
+
     /**
      * @return the raw output of the compiler (packaged into a convenient data structure).
      * IsCompilationFinished() must have returned true before it is valid to call this function, else an assertion is triggered
@@ -213,6 +323,7 @@ public:
 
     virtual ~FCompileJobHandle() override
     {
+        // Jobs which were never started have no thread
         if (Thread)
         {
             // Wait for the thread to complete, if it's still running
@@ -230,13 +341,27 @@ private:
     // We want only the async compiler to be able to create handles and start compilations
     friend class FAsyncCompiler;
 
-    FCompileJobHandle(TRefCountPtr<FMaterialShaderMap> MaterialShaderMap, const FMaliPlatform& MaliPlatform) :
-        ShaderMap(MaterialShaderMap),
+    FCompileJobHandle(const TArray<FCompileJobShaderMap>& MaterialShaderMaps, const FMaliPlatform& MaliPlatform, const FCompileJobOptions& JobOptions) :
+        ShaderMaps(MaterialShaderMaps),
         Platform(MaliPlatform),
+        Options(JobOptions),
         RawCompilerOutput(MakeShareable(new FMaliOCRawCompilerOutput))
     {
-        // Get the list of shaders from the shader map and put them in OutShaders
-        ShaderMap->GetShaderList(OutShaders);
+        // Get the list of shaders from each shader map and put them in OutShaders
+        for (const auto& shaderMap : ShaderMaps)
+        {
+            TMap<FShaderId, FShader*> shaderList;
+            shaderMap.ShaderMap->GetShaderList(shaderList);
+            for (const auto& shader : shaderList)
+            {
+                if (!Options.Filter.ShouldCompile(shader.Value->GetType(), shader.Value->GetVertexFactoryType()))
+                {
+                    NumSkippedShaders++;
+                    continue;
+                }
+                OutShaders.Add(FJobShader{ shader.Value, shaderMap.QualityLevelMask });
+            }
+        }
         TotalNumShaders = OutShaders.Num();
     }
 
@@ -247,39 +372,89 @@ private:
     /** Begin compilation on another thread. */
     void BeginCompilationAsync();
 
+    /** Thread safe. Ask the job to stop before its next shader. It still finishes, with incomplete output, so wait for IsCompilationFinished() */
+    void Cancel()
+    {
+        StopRequested.Set(1);
+    }
+
+    virtual void Stop() override
+    {
+        Cancel();
+    }
+
     /** Add another compiler output to our compiler output array */
-    void AppendNewRawCompilerOutput(bool bCompilerRan, malioc_outputs& outputs, const char* GLSL, FShader* Shader);
+    void AppendNewRawCompilerOutput(bool bCompilerRan, malioc_outputs& outputs, const char* GLSL, FShader* Shader, FMaliOCQualityLevelMask QualityLevelMask);
 
-    /** Shader map from the material we're compiling for */
-    TRefCountPtr<FMaterialShaderMap> ShaderMap;
-    /** List of shaders in the shader map */
-    TMap< FShaderId, FShader* > OutShaders;
+    /** A shader to compile, and the quality levels of the shader map it came from */
+    struct FJobShader
+    {
+        FShader* Shader;
+        FMaliOCQualityLevelMask QualityLevelMask;
+    };
+
+    /** Shader maps from the material we're compiling for */
+    TArray<FCompileJobShaderMap> ShaderMaps;
+    /** List of shaders in all the shader maps */
+    TArray<FJobShader> OutShaders;
     /** Mali platform (core, revision, driver and API) we're compiling for */
     const FMaliPlatform& Platform;
+    /** Options this job was created with */
+    const FCompileJobOptions Options;
     /** Raw output of the offline compiler*/
     TSharedRef<FMaliOCRawCompilerOutput> RawCompilerOutput;
-    /** Thread we perform compilation on */
-    FRunnableThread* Thread;
+    /** Thread we perform compilation on. Null until the job is started */
+    FRunnableThread* Thread = nullptr;
     /** The total number of shaders we'll be compiling */
     uint32 TotalNumShaders;
+    /** The number of shaders the permutation filter removed */
+    uint32 NumSkippedShaders = 0;
     /** Threadsafe counter that will be incremented by the compiling thread and read by the UI thread */
     FThreadSafeCounter NumCompiledShaders = 0;
-    /** True when compilation is complete */
-    bool bIsCompilationComplete = false;
+    /** Non-zero once the job has been cancelled */
+    FThreadSafeCounter StopRequested;
+    /** Non-zero when compilation is complete. Written by the compiling thread once all its output is in place, and read from any thread */
+    mutable volatile int32 CompilationComplete = 0;
 
-    /** Job counter used to give each thread a unique ID*/
-    static uint32 JobCounter;
+    /** Job counter used to give each thread a unique ID. Jobs can be started from any thread */
+    static FThreadSafeCounter JobCounter;
 };
 
 class FAsyncCompiler final : private FTickableEditorObject
 {
 public:
     /**
-     * Initialize the async compiler. Also initialises the compiler manager.
+     * Start initializing the async compiler on a worker thread. Also initialises the compiler manager.
+     * Loading the compiler libraries and enumerating the compilers can take a while, so the caller doesn't wait for it.
+     * Initialization finishes by itself once the task is done, and OnInitializationFinished() is broadcast.
+     * If it fails, the plugin folder is watched, and initialization starts again once the offline compiler has been extracted into it.
      * @param Silent if true, suppress error log output on failure
+     */
+    static void BeginInitialize(bool Silent = false);
+
+    /** Broadcast on the game thread whenever initialization finishes. The parameter is true if the async compiler is now available */
+    DECLARE_MULTICAST_DELEGATE_OneParam(FOnInitializationFinished, bool);
+    static FOnInitializationFinished& OnInitializationFinished();
+
+    /**
+     * Doesn't block. If background initialization has just finished, this completes it.
+     * @return true while background initialization is still running
+     */
+    static bool IsInitializing();
+
+    /**
+     * Block until background initialization (if any) has finished.
      * @return true if initialization success
      */
-    static bool Initialize(bool Silent = false);
+    static bool FinishInitialization();
+
+    /**
+     * Load the vendor compiler libraries, if they haven't been loaded yet. Thread safe.
+     * The compiler list normally comes from a cache, so the libraries aren't loaded until the first compile needs them.
+     * @param Silent if true, suppress error log output on failure
+     * @return true if the libraries are loaded
+     */
+    static bool LoadCompilerLibraries(bool Silent = false);
 
     /**
      * Deinit the compiler. Safe to call even if initialization failed. Will gracefully clean up any pending jobs.
@@ -287,18 +462,24 @@ public:
      */
     static void Deinitialize();
 
-    /** @return a valid pointer to the async compiler if init success, else nullptr */
+    /**
+     * Game thread only. Blocks if background initialization is still running.
+     * @return a valid pointer to the async compiler if init success, else nullptr
+     */
     static FAsyncCompiler* Get();
 
     /**
-     * Constructs and adds a new job to the queue.
-     * @param ShaderMap the material shader map
+     * Constructs and adds a new job to the queue, and starts it if there's a free slot. Thread safe, so any thread can submit jobs without going through the game thread.
+     * Queued jobs are started as running ones finish, by the next call to AddJob(), FinishCompilation() or the editor tick.
+     * Shaders which come out of the cross compiler identically for several shader maps (e.g. for different quality levels) are only compiled once.
+     * @param ShaderMaps the material shader maps, and the quality levels they were cross compiled for
      * @param Platform the Mali platform to compile for
-     * @return a shared ref to the handle of the job that can be used to track progress
+     * @param Options options controlling what the job does
+     * @return a thread safe shared ref to the handle of the job that can be used to track progress. The queue and the caller may be on different threads, so handles must only be held through thread safe refs
      */
-    TSharedRef<const FCompileJobHandle> AddJob(TRefCountPtr<FMaterialShaderMap> ShaderMap, const FMaliPlatform& Platform);
+    TSharedRef<const FCompileJobHandle, ESPMode::ThreadSafe> AddJob(const TArray<FCompileJobShaderMap>& ShaderMaps, const FMaliPlatform& Platform, const FCompileJobOptions& Options = FCompileJobOptions());
 
-    /** Block until all compilation has completed */
+    /** Block until all compilation has completed, including jobs other threads add in the meantime. Thread safe */
     void FinishCompilation();
 
     /**
@@ -308,23 +489,51 @@ public:
      */
     const TArray<TUniqueObj<FMaliCore>>& GetCores() const;
 
+    /** @return the core with the given name, or nullptr if there isn't one */
+    const FMaliCore* FindCore(const FString& CoreName) const;
+
+    /** @return every platform of every core, in the same order as walking GetCores() */
+    const TArray<const FMaliPlatform*>& GetPlatforms() const;
+
+    /** @return the platform with the given ID, or nullptr if it isn't in the bundle */
+    const FMaliPlatform* FindPlatform(const FMaliPlatformId& Id) const;
+
     ~FAsyncCompiler() = default;
     FAsyncCompiler(const FAsyncCompiler&) = delete;
     FAsyncCompiler(FAsyncCompiler&&) = delete;
     FAsyncCompiler& operator=(const FAsyncCompiler&) = delete;
     FAsyncCompiler& operator=(FAsyncCompiler&&) = delete;
 private:
-    FAsyncCompiler();
+    FAsyncCompiler(TArray<TUniqueObj<FMaliCore>>&& Cores);
 
     /** Compiler singleton */
     static TSharedPtr<class FAsyncCompiler> AsyncCompiler;
 
-    /** Compiler's current job, if it has one */
-    TSharedPtr<FCompileJobHandle> CurrentJob = nullptr;
-    /** Single producer single consumer queue of all outstanding jobs */
-    TQueue<TSharedPtr<FCompileJobHandle>, EQueueMode::Type::Spsc> Jobs;
+    /** Jobs which have been started and haven't finished yet. More than one only if the compiler libraries pass the concurrency self-test. Guarded by RunningJobsCriticalSection */
+    TArray<TSharedPtr<FCompileJobHandle, ESPMode::ThreadSafe>> RunningJobs;
+    /** Guards RunningJobs and bIsShuttingDown, and makes whoever holds it the only consumer of Jobs */
+    FCriticalSection RunningJobsCriticalSection;
+    /** Set by CancelAllJobs(), after which no job is started */
+    bool bIsShuttingDown = false;
+    /** Queue of all outstanding jobs. Any thread may add to it; jobs are only taken off it while holding RunningJobsCriticalSection */
+    TQueue<TSharedPtr<FCompileJobHandle, ESPMode::ThreadSafe>, EQueueMode::Type::Mpsc> Jobs;
     /** Array of all Mali cores we can compile for, and their revisions, drivers, and supported APIs */
     TArray<TUniqueObj<FMaliCore>> MaliCores;
+    /** Index into MaliCores of each core name */
+    TMap<FString, int32> CoreIndices;
+    /** Every platform, flattened out of MaliCores */
+    TArray<const FMaliPlatform*> Platforms;
+    /** Every platform, by ID */
+    TMap<FMaliPlatformId, const FMaliPlatform*> PlatformsById;
+
+    /**
+     * Release the jobs that have finished, and start queued jobs while there are free slots. Thread safe
+     * @return the number of jobs still running
+     */
+    int32 StartPendingJobs();
+
+    /** Thread safe. Drop the queued jobs, and cancel every running job and wait for it to finish, however many handles to it are held elsewhere */
+    void CancelAllJobs();
 
     // FTickableEditorObject functions
 
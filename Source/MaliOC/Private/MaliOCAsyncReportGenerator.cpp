@@ -17,80 +17,804 @@
 #include "MaliOCPrivatePCH.h"
 #include "MaliOCAsyncReportGenerator.h"
 
-FAsyncReportGenerator::FAsyncReportGenerator(UMaterialInterface* MaterialInterface, const FMaliPlatform& MaliPlatform) :
-Platform(MaliPlatform),
-Resource(TUniqueObj<FMaterialResource>(*(new FMaterialResource)))
+/** Everything the report builder needs. Gathered on the game thread so that the build itself can run on any thread */
+struct FMaliOCReportBuildInputs
 {
-    check(MaterialInterface != nullptr);
+    /** Whether cross compilation failed before we ever got to run the offline compiler */
+    bool bWasCompilationError = false;
+    /** All the quality levels the material was compiled for */
+    FMaliOCQualityLevelMask QualityLevelMask = 0;
+    /** Errors reported by the cross compiler */
+    TArray<FString> CompileErrors;
+    /** Representative shader names and their descriptions, used to build the summary */
+    TMap<FName, FString> ShaderTypeNamesAndDescriptions;
+    /** Raw output of the offline compiler. Null if there was a cross compilation error */
+    TSharedPtr<const FMaliOCRawCompilerOutput> RawOutput = nullptr;
+    /** Partitions which had to be cross compiled more than once */
+    TArray<FMaliOCReport::FCrossCompileRetry> CrossCompileRetries;
+    /** Number of permutations removed by the permutation filter */
+    uint32 NumSkippedPermutations = 0;
+    /** Sampling options the material was compiled with */
+    FMaliOCSamplingOptions SamplingOptions;
+    /** Number of permutations in each stratum, if the material was sampled */
+    TMap<FMaliOCSamplingStratum, uint32> StratumSizes;
+};
 
-    UMaterialInstance* MaterialInstance = Cast<UMaterialInstance>(MaterialInterface);
+/** Build a report from the raw compiler output. Only touches the data in Inputs, so is safe to call from a worker thread */
+static TSharedRef<FMaliOCReport> BuildReport(const FMaliOCReportBuildInputs& Inputs);
 
-    // Set the material resource's material to the one passed in
-    if (MaterialInstance != nullptr)
+/** Thread pool task which builds the report */
+class FMaliOCReportBuildTask final : public FNonAbandonableTask
+{
+public:
+    FMaliOCReportBuildTask(FMaliOCReportBuildInputs&& ReportInputs) :
+        Inputs(MoveTemp(ReportInputs))
     {
-        Resource->SetMaterial(MaterialInstance->GetMaterial(), EMaterialQualityLevel::High, false, GetMaxSupportedFeatureLevel(Platform.GetPlatform()), MaterialInstance);
     }
-    else
+
+    void DoWork()
+    {
+        // Shared pointers are not thread safe, so the worker must only dereference the inputs, never copy them.
+        // The task is created and destroyed on the game thread, which is where the reference counts get touched.
+        Report = BuildReport(Inputs);
+    }
+
+    TStatId GetStatId() const
     {
-        Resource->SetMaterial(MaterialInterface->GetMaterial(), EMaterialQualityLevel::High, false, GetMaxSupportedFeatureLevel(Platform.GetPlatform()));
+        RETURN_QUICK_DECLARE_CYCLE_STAT(FMaliOCReportBuildTask, STATGROUP_ThreadPoolAsyncTasks);
     }
 
-    // Begin shader cross compilation
-    bool success = Resource->CacheShaders(Platform.GetPlatform(), false);
+    /** The finished report. Valid once the task is done */
+    TSharedPtr<const FMaliOCReport> Report = nullptr;
+
+private:
+    const FMaliOCReportBuildInputs Inputs;
+};
 
-    if (!success)
+/** Maximum number of times a partition which failed cross compilation without errors is retried */
+static const uint32 MaxCrossCompileRetries = 3;
+/** Delay before the first retry of a partition, in seconds. Doubles with every retry */
+static const double CrossCompileRetryDelay = 0.25;
+
+/** The permutations of one vertex factory type */
+struct FMaliOCVertexFactoryPartition
+{
+    /** nullptr for the shaders which don't use a vertex factory */
+    const FVertexFactoryType* VertexFactoryType;
+    /** Shader types the material will cache with the vertex factory, in type list order */
+    TArray<const FShaderType*> ShaderTypes;
+};
+
+/**
+ * Find the vertex factory types that the material will cache permutations for on Platform. These are the partitions that get cross compiled independently.
+ * @param Filter permutations which don't pass the filter don't count towards a partition
+ * @return the number of permutations the engine would have cached, but which didn't pass the filter
+ */
+static uint32 GetVertexFactoryPartitions(const FMaterial& Material, EShaderPlatform Platform, const FMaliOCPermutationFilter& Filter, TArray<FMaliOCVertexFactoryPartition>& OutPartitions)
+{
+    uint32 numFiltered = 0;
+
+    // Shaders without a vertex factory
+    FMaliOCVertexFactoryPartition materialShaders = { nullptr };
+    for (TLinkedList<FShaderType*>::TIterator shaderTypeIt(FShaderType::GetTypeList()); shaderTypeIt; shaderTypeIt.Next())
     {
-        bWasCompilationError = true;
-        Progress = EProgress::COMPILATION_COMPLETE;
+        const FMaterialShaderType* materialShaderType = shaderTypeIt->GetMaterialShaderType();
+        if (materialShaderType != nullptr && materialShaderType->ShouldCache(Platform, &Material))
+        {
+            if (Filter.ShouldCompile(materialShaderType, nullptr))
+            {
+                materialShaders.ShaderTypes.Add(materialShaderType);
+            }
+            else
+            {
+                numFiltered++;
+            }
+        }
+    }
+
+    if (materialShaders.ShaderTypes.Num() > 0)
+    {
+        OutPartitions.Add(MoveTemp(materialShaders));
     }
+
+    // Mesh shaders, which are cached once per vertex factory
+    for (TLinkedList<FVertexFactoryType*>::TIterator vertexFactoryTypeIt(FVertexFactoryType::GetTypeList()); vertexFactoryTypeIt; vertexFactoryTypeIt.Next())
+    {
+        FVertexFactoryType* vertexFactoryType = *vertexFactoryTypeIt;
+        if (!vertexFactoryType->IsUsedWithMaterials())
+        {
+            continue;
+        }
+
+        FMaliOCVertexFactoryPartition meshShaders = { vertexFactoryType };
+        for (TLinkedList<FShaderType*>::TIterator shaderTypeIt(FShaderType::GetTypeList()); shaderTypeIt; shaderTypeIt.Next())
+        {
+            const FMeshMaterialShaderType* meshShaderType = shaderTypeIt->GetMeshMaterialShaderType();
+            if (meshShaderType != nullptr && meshShaderType->ShouldCache(Platform, &Material, vertexFactoryType) && vertexFactoryType->ShouldCache(Platform, &Material, meshShaderType))
+            {
+                if (Filter.ShouldCompile(meshShaderType, vertexFactoryType))
+                {
+                    meshShaders.ShaderTypes.Add(meshShaderType);
+                }
+                else
+                {
+                    numFiltered++;
+                }
+            }
+        }
+
+        if (meshShaders.ShaderTypes.Num() > 0)
+        {
+            OutPartitions.Add(MoveTemp(meshShaders));
+        }
+    }
+
+    return numFiltered;
 }
 
-void FAsyncReportGenerator::Tick(float DeltaTime)
+/**
+ * An instance without a static permutation resource (no static parameter or base property overrides) renders with its parent's shaders,
+ * so compiling it would only repeat the parent's compile. Parameter overrides don't change any shader statistics.
+ * @return the material interface whose shaders MaterialInterface renders with
+ */
+static UMaterialInterface* GetShaderOwner(UMaterialInterface* MaterialInterface)
 {
-    // Early return if the job is complete
-    if (Progress == EProgress::COMPILATION_COMPLETE)
+    UMaterialInstance* materialInstance = Cast<UMaterialInstance>(MaterialInterface);
+    while (materialInstance != nullptr && !materialInstance->bHasStaticPermutationResource && materialInstance->Parent != nullptr)
     {
-        return;
+        MaterialInterface = materialInstance->Parent;
+        materialInstance = Cast<UMaterialInstance>(MaterialInterface);
     }
 
-    // Cross compilation from HLSL to GLSL is in Progress
-    if (Progress == EProgress::CROSS_COMPILATION_IN_PROGRESS)
+    return MaterialInterface;
+}
+
+/**
+ * Cross compiles a material for one shader platform, split into partitions so that any which fail without errors can be retried.
+ * Every Mali platform with the same shader platform puts the same GLSL through the offline compiler, so report generators for the same material,
+ * shader platform, options and quality levels share a cross compile rather than each running their own.
+ */
+class FMaliOCCrossCompile final : private FGCObject
+{
+public:
+    enum class EState
+    {
+        IN_PROGRESS,
+        SUCCEEDED,
+        FAILED
+    };
+
+    /** Start cross compiling. Parameters are the same as FAsyncReportGenerator's, except that only the platform's shader platform matters */
+    FMaliOCCrossCompile(UMaterialInterface* MaterialInterface, EShaderPlatform Platform, const FCompileJobOptions& Options, FMaliOCQualityLevelMask QualityLevels);
+
+    /** Check on the partitions, retrying any that failed without errors. Game thread only. @return the state after the update */
+    EState Update();
+
+    /** Block until the partitions which are compiling have finished. Partitions waiting for a retry still need more updates */
+    void FinishCompilation();
+
+    EState GetState() const
     {
-        if (!Resource->IsCompilationFinished())
+        return State;
+    }
+
+    /** The partitions. Once the state is SUCCEEDED, each one has a game thread shader map */
+    const TIndirectArray<FMaliOCMaterialResource>& GetResources() const
+    {
+        return Resources;
+    }
+
+    /** @return the number of permutations the permutation filter kept from being cross compiled */
+    uint32 GetNumFilteredPermutations() const
+    {
+        return NumFilteredPermutations;
+    }
+
+    /** @return the number of permutations in each stratum. Only filled in when sampling */
+    const TMap<FMaliOCSamplingStratum, uint32>& GetStratumSizes() const
+    {
+        return StratumSizes;
+    }
+
+private:
+    /** Shader platform we're cross compiling for */
+    const EShaderPlatform ShaderPlatform;
+    /** Material we're cross compiling. The resources point at it, so we keep it from being garbage collected */
+    UMaterial* Material = nullptr;
+    /** Material instance we're cross compiling, if it is one */
+    UMaterialInstance* MaterialInstance = nullptr;
+    /** Material resources we're extracting shaders from. One per vertex factory partition, for each group of quality levels that compile differently */
+    TIndirectArray<FMaliOCMaterialResource> Resources;
+    /** See GetNumFilteredPermutations() */
+    uint32 NumFilteredPermutations = 0;
+    /** See GetStratumSizes() */
+    TMap<FMaliOCSamplingStratum, uint32> StratumSizes;
+    EState State = EState::IN_PROGRESS;
+
+    // FGCObject functions
+
+    virtual void AddReferencedObjects(FReferenceCollector& Collector) override;
+};
+
+FMaliOCCrossCompile::FMaliOCCrossCompile(UMaterialInterface* MaterialInterface, EShaderPlatform Platform, const FCompileJobOptions& Options, FMaliOCQualityLevelMask QualityLevelMask) :
+ShaderPlatform(Platform)
+{
+    MaterialInstance = Cast<UMaterialInstance>(MaterialInterface);
+    Material = MaterialInterface->GetMaterial();
+
+    // Quality levels which aren't used by any quality switch node all evaluate the switches' default inputs, so they compile to the same shaders.
+    // Group them so each distinct set of shaders is only cross compiled once. If no level is used, everything collapses into one group.
+    TArray<bool, TInlineAllocator<EMaterialQualityLevel::Num>> qualityLevelsUsed;
+    Material->GetQualityLevelNodeUsage(qualityLevelsUsed);
+
+    TArray<FMaliOCQualityLevelMask> resourceQualityLevels;
+    FMaliOCQualityLevelMask defaultQualityLevels = 0;
+    for (int32 level = 0; level < EMaterialQualityLevel::Num; level++)
+    {
+        const FMaliOCQualityLevelMask levelMask = QualityLevelToMask((EMaterialQualityLevel::Type)level);
+        if ((QualityLevelMask & levelMask) == 0)
         {
-            return;
+            continue;
         }
 
-        // Should be a no-op. Guarantees that the results are all in the correct place.
-        Resource->FinishCompilation();
+        if (qualityLevelsUsed[level])
+        {
+            resourceQualityLevels.Add(levelMask);
+        }
+        else
+        {
+            defaultQualityLevels |= levelMask;
+        }
+    }
+
+    if (defaultQualityLevels != 0)
+    {
+        resourceQualityLevels.Add(defaultQualityLevels);
+    }
+
+    const auto SetMaterial = [&](FMaterialResource& Resource, EMaterialQualityLevel::Type QualityLevel)
+    {
+        // Set the material resource's material to the one passed in
+        if (MaterialInstance != nullptr)
+        {
+            Resource.SetMaterial(Material, QualityLevel, false, GetMaxSupportedFeatureLevel(ShaderPlatform), MaterialInstance);
+        }
+        else
+        {
+            Resource.SetMaterial(Material, QualityLevel, false, GetMaxSupportedFeatureLevel(ShaderPlatform));
+        }
+    };
+
+    for (const FMaliOCQualityLevelMask levels : resourceQualityLevels)
+    {
+        // Any level in the group gives the same shaders, so compile the first one
+        EMaterialQualityLevel::Type qualityLevel = EMaterialQualityLevel::Num;
+        for (int32 level = 0; level < EMaterialQualityLevel::Num; level++)
+        {
+            if (levels & QualityLevelToMask((EMaterialQualityLevel::Type)level))
+            {
+                qualityLevel = (EMaterialQualityLevel::Type)level;
+                break;
+            }
+        }
+        check(qualityLevel != EMaterialQualityLevel::Num);
+
+        // Split the material into one partition per vertex factory, so a partition that fails can be retried on its own
+        FMaterialResource probe;
+        SetMaterial(probe, qualityLevel);
+
+        TArray<FMaliOCVertexFactoryPartition> partitions;
+        NumFilteredPermutations += GetVertexFactoryPartitions(probe, ShaderPlatform, Options.Filter, partitions);
+        if (partitions.Num() == 0)
+        {
+            partitions.Add(FMaliOCVertexFactoryPartition{ nullptr });
+        }
+
+        TMap<FName, FString> representativeShaderTypes;
+        if (Options.Sampling.IsEnabled() || Options.bOnlySummaryShaders)
+        {
+            probe.GetRepresentativeShaderTypesAndDescriptions(representativeShaderTypes);
+        }
+
+        // Every quality level has the same permutations, so only count the strata once
+        const bool bCountStrata = Options.Sampling.IsEnabled() && StratumSizes.Num() == 0;
+
+        for (const auto& partition : partitions)
+        {
+            TSet<const FShaderType*> sample;
+
+            if (Options.bOnlySummaryShaders)
+            {
+                for (const FShaderType* shaderType : partition.ShaderTypes)
+                {
+                    if (representativeShaderTypes.Contains(FName(shaderType->GetName())))
+                    {
+                        sample.Add(shaderType);
+                    }
+                }
+
+                // An empty sample would compile the whole partition
+                if (sample.Num() == 0)
+                {
+                    continue;
+                }
+            }
+            else if (Options.Sampling.IsEnabled())
+            {
+                // Stratify by frequency, as vertex and pixel shaders have very different costs
+                TArray<const FShaderType*> strata[SF_NumFrequencies];
+                for (const FShaderType* shaderType : partition.ShaderTypes)
+                {
+                    strata[shaderType->GetFrequency()].Add(shaderType);
+                }
+
+                const FName vertexFactoryName = GetBeautifiedVertexFactoryName(partition.VertexFactoryType != nullptr ? FName(partition.VertexFactoryType->GetName()) : NAME_None);
+                for (int32 frequency = 0; frequency < SF_NumFrequencies; frequency++)
+                {
+                    if (strata[frequency].Num() == 0)
+                    {
+                        continue;
+                    }
+
+                    TArray<const FShaderType*> stratumSample;
+                    SelectStratumSample(strata[frequency], representativeShaderTypes, Options.Sampling.SamplesPerStratum, stratumSample);
+                    sample.Append(stratumSample);
+
+                    if (bCountStrata)
+                    {
+                        // Several vertex factories can share a pretty name, in which case they share a stratum
+                        StratumSizes.FindOrAdd(FMaliOCSamplingStratum{ vertexFactoryName, (EShaderFrequency)frequency }) += strata[frequency].Num();
+                    }
+                }
+            }
+
+            FMaliOCMaterialResource* resource = new FMaliOCMaterialResource(partition.VertexFactoryType, levels, Options.Filter, MoveTemp(sample));
+            SetMaterial(*resource, qualityLevel);
+            Resources.Add(resource);
+        }
+    }
+
+    // Begin shader cross compilation. All the resources are submitted before we wait on any, so the shader compiling manager works on them in parallel
+    bool success = true;
+    for (auto& resource : Resources)
+    {
+        success = resource.CacheShaders(ShaderPlatform, false) && success;
+    }
+
+    // There's nothing to compile if the permutation filter rejected every summary shader
+    if (!success || Resources.Num() == 0)
+    {
+        State = EState::FAILED;
+    }
+}
+
+bool ResolveCrossCompilePartitions(const TArray<EMaliOCPartitionState>& PartitionStates, bool& bOutFailed)
+{
+    const bool bAnyFailed = PartitionStates.Contains(EMaliOCPartitionState::Failed);
 
-        auto ShaderMap = Resource->GetGameThreadShaderMap();
+    for (const EMaliOCPartitionState state : PartitionStates)
+    {
+        // Partitions waiting for a retry only hold the cross compile up if they'll actually be retried
+        if (state == EMaliOCPartitionState::Compiling || (state == EMaliOCPartitionState::Retrying && !bAnyFailed))
+        {
+            return false;
+        }
+    }
+
+    bOutFailed = bAnyFailed;
+    return true;
+}
+
+FMaliOCCrossCompile::EState FMaliOCCrossCompile::Update()
+{
+    if (State != EState::IN_PROGRESS)
+    {
+        return State;
+    }
+
+    TArray<EMaliOCPartitionState> partitionStates;
+    partitionStates.Reserve(Resources.Num());
+
+    for (auto& resource : Resources)
+    {
+        if (!resource.IsCompilationFinished())
+        {
+            partitionStates.Add(EMaliOCPartitionState::Compiling);
+            continue;
+        }
+
+        // Should be a no-op. Guarantees that the results are all in the correct place.
+        resource.FinishCompilation();
 
         // No output shader map means that there were some compilation errors pre cross-compilation
         // This usually happens when a feature that GLES doesn't support is used
-        if (ShaderMap == nullptr)
+        if (resource.GetGameThreadShaderMap() == nullptr)
         {
             // Sometimes, cross compilation will fail without any errors
             // This typically happens when lots of shader permutations (100+) are being cross compiled
-            // Attempting compilation one more time typically fixes it
-            if (Resource->GetCompileErrors().Num() == 0 && NumAttempts == 0)
+            // Attempting compilation again typically fixes it, so such partitions get retried below
+            const bool bFailedForGood = resource.GetCompileErrors().Num() != 0 || resource.NumRetries >= MaxCrossCompileRetries;
+            partitionStates.Add(bFailedForGood ? EMaliOCPartitionState::Failed : EMaliOCPartitionState::Retrying);
+        }
+        else
+        {
+            partitionStates.Add(EMaliOCPartitionState::Succeeded);
+        }
+    }
+
+    bool bFailed = false;
+    if (ResolveCrossCompilePartitions(partitionStates, bFailed))
+    {
+        State = bFailed ? EState::FAILED : EState::SUCCEEDED;
+        return State;
+    }
+
+    // Only retry the partitions that failed without errors, backing off between attempts. There's no point if something has failed for good.
+    if (!partitionStates.Contains(EMaliOCPartitionState::Failed))
+    {
+        const double currentTime = FPlatformTime::Seconds();
+
+        for (int32 i = 0; i < Resources.Num(); i++)
+        {
+            if (partitionStates[i] != EMaliOCPartitionState::Retrying)
             {
-                Resource->CacheShaders(Platform.GetPlatform(), false);
-                NumAttempts++;
-                return;
+                continue;
             }
-            else
+
+            FMaliOCMaterialResource& resource = Resources[i];
+            if (resource.NextRetryTime == 0.0)
+            {
+                resource.NextRetryTime = currentTime + CrossCompileRetryDelay * (1 << resource.NumRetries);
+            }
+            else if (currentTime >= resource.NextRetryTime)
             {
-                bWasCompilationError = true;
-                Progress = EProgress::COMPILATION_COMPLETE;
-                return;
+                resource.NumRetries++;
+                resource.NextRetryTime = 0.0;
+                resource.CacheShaders(ShaderPlatform, false);
             }
         }
+    }
+
+    return State;
+}
 
-        // Start the async compile job
-        check(!JobHandle.IsValid());
-        JobHandle = FAsyncCompiler::Get()->AddJob(Resource->GetGameThreadShaderMap(), Platform);
-        Progress = EProgress::MALIOC_COMPILATION_IN_PROGRESS;
+void FMaliOCCrossCompile::FinishCompilation()
+{
+    for (auto& resource : Resources)
+    {
+        resource.FinishCompilation();
+    }
+}
+
+void FMaliOCCrossCompile::AddReferencedObjects(FReferenceCollector& Collector)
+{
+    Collector.AddReferencedObject(Material);
+    Collector.AddReferencedObject(MaterialInstance);
+}
+
+/** @return the options a generator actually compiles with */
+static FCompileJobOptions GetEffectiveJobOptions(const FCompileJobOptions& Options)
+{
+    FCompileJobOptions effectiveOptions = Options;
+
+    // Batch runs never look at the source, so don't pay to keep it
+    effectiveOptions.bRetainSourceCode = Options.bRetainSourceCode && ShouldRetainShaderSource();
+
+    // The summary shaders are always part of a sample, so there's nothing left to estimate
+    if (effectiveOptions.bOnlySummaryShaders)
+    {
+        effectiveOptions.Sampling = FMaliOCSamplingOptions();
+    }
+
+    return effectiveOptions;
+}
+
+/** Hash of everything a cross compile depends on. Requests with the same key cross compile to the same shader maps */
+static FSHAHash ComputeCrossCompileKey(UMaterialInterface* MaterialInterface, EShaderPlatform ShaderPlatform, const FCompileJobOptions& Options, FMaliOCQualityLevelMask QualityLevels)
+{
+    check(MaterialInterface != nullptr);
+    FSHA1 hashState;
+
+    // The engine decides whether two materials compile to the same shaders by their shader map IDs, so use the same test.
+    // Material editors open on the same material work on copies of it, but the copies have the same IDs.
+    UMaterialInstance* materialInstance = Cast<UMaterialInstance>(MaterialInterface);
+    UMaterial* material = MaterialInterface->GetMaterial();
+    for (int32 level = 0; level < EMaterialQualityLevel::Num; level++)
+    {
+        if ((QualityLevels & QualityLevelToMask((EMaterialQualityLevel::Type)level)) == 0)
+        {
+            continue;
+        }
+
+        FMaterialResource probe;
+        probe.SetMaterial(material, (EMaterialQualityLevel::Type)level, false, GetMaxSupportedFeatureLevel(ShaderPlatform), materialInstance);
+
+        FMaterialShaderMapId shaderMapId;
+        probe.GetShaderMapId(ShaderPlatform, shaderMapId);
+
+        FSHAHash materialHash;
+        shaderMapId.GetMaterialHash(materialHash);
+        hashState.Update(materialHash.Hash, sizeof(materialHash.Hash));
+    }
+
+    const int32 shaderPlatform = ShaderPlatform;
+    hashState.Update((const uint8*)&shaderPlatform, sizeof(shaderPlatform));
+    hashState.Update((const uint8*)&QualityLevels, sizeof(QualityLevels));
+
+    // Every option that changes what gets cross compiled
+    const int32 numVertexFactoryTypes = Options.Filter.VertexFactoryTypes.Num();
+    hashState.Update((const uint8*)&numVertexFactoryTypes, sizeof(numVertexFactoryTypes));
+    for (const FName vertexFactoryType : Options.Filter.VertexFactoryTypes)
+    {
+        const FString name = vertexFactoryType.ToString();
+        hashState.UpdateWithString(*name, name.Len() + 1);
+    }
+    hashState.Update((const uint8*)&Options.Filter.FrequencyMask, sizeof(Options.Filter.FrequencyMask));
+    const int32 numShaderTypePatterns = Options.Filter.ShaderTypePatterns.Num();
+    hashState.Update((const uint8*)&numShaderTypePatterns, sizeof(numShaderTypePatterns));
+    for (const FString& pattern : Options.Filter.ShaderTypePatterns)
+    {
+        hashState.UpdateWithString(*pattern, pattern.Len() + 1);
+    }
+
+    hashState.Update((const uint8*)&Options.Sampling.SamplesPerStratum, sizeof(Options.Sampling.SamplesPerStratum));
+
+    const uint8 bOnlySummaryShaders = Options.bOnlySummaryShaders;
+    hashState.Update(&bOnlySummaryShaders, sizeof(bOnlySummaryShaders));
+
+    hashState.Final();
+
+    FSHAHash key;
+    hashState.GetHash(&key.Hash[0]);
+    return key;
+}
+
+/** Hash of everything a report depends on, given the key of its cross compile. Requests with the same key get the same report */
+static FSHAHash ComputeReportRequestKey(const FSHAHash& CrossCompileKey, const FMaliPlatform& Platform, const FCompileJobOptions& Options)
+{
+    FSHA1 hashState;
+
+    hashState.Update(CrossCompileKey.Hash, sizeof(CrossCompileKey.Hash));
+
+    const FString platformId = Platform.GetId().ToString();
+    hashState.UpdateWithString(*platformId, platformId.Len());
+
+    // Every option that changes the offline compile or what goes in the report
+    const uint8 bRetainSourceCode = Options.bRetainSourceCode;
+    hashState.Update(&bRetainSourceCode, sizeof(bRetainSourceCode));
+
+    hashState.Update((const uint8*)&Options.Sampling.FlagCycleThreshold, sizeof(Options.Sampling.FlagCycleThreshold));
+
+    hashState.Final();
+
+    FSHAHash key;
+    hashState.GetHash(&key.Hash[0]);
+    return key;
+}
+
+/** Cross compiles which some report generator is still using, by cross compile key. Game thread only */
+static TMap<FSHAHash, TWeakPtr<FMaliOCCrossCompile>> SharedCrossCompiles;
+
+/**
+ * @param Key the request's ComputeCrossCompileKey()
+ * @return a cross compile for the request, sharing one that's still in use if there is one
+ */
+static TSharedRef<FMaliOCCrossCompile> FindOrCreateCrossCompile(const FSHAHash& Key, UMaterialInterface* MaterialInterface, EShaderPlatform ShaderPlatform, const FCompileJobOptions& Options, FMaliOCQualityLevelMask QualityLevels)
+{
+    check(IsInGameThread());
+
+    // Whether it's still cross compiling or already finished, its shader maps are exactly the ones we need
+    const TWeakPtr<FMaliOCCrossCompile>* existingCrossCompile = SharedCrossCompiles.Find(Key);
+    if (existingCrossCompile != nullptr)
+    {
+        TSharedPtr<FMaliOCCrossCompile> crossCompile = existingCrossCompile->Pin();
+        if (crossCompile.IsValid())
+        {
+            return crossCompile.ToSharedRef();
+        }
+    }
+
+    for (auto it = SharedCrossCompiles.CreateIterator(); it; ++it)
+    {
+        if (!it.Value().IsValid())
+        {
+            it.RemoveCurrent();
+        }
+    }
+
+    TSharedRef<FMaliOCCrossCompile> crossCompile = MakeShareable(new FMaliOCCrossCompile(MaterialInterface, ShaderPlatform, Options, QualityLevels));
+    SharedCrossCompiles.Add(Key, crossCompile);
+    return crossCompile;
+}
+
+/** Report generators which someone is still using, by request key. Game thread only */
+static TMap<FSHAHash, TWeakPtr<FAsyncReportGenerator>> SharedReportGenerators;
+
+/** The most recently requested report generators, most recent first. Kept alive so that repeating a request (e.g. for another instance of the same parent) doesn't compile again */
+static TArray<TSharedRef<FAsyncReportGenerator>> RecentReportGenerators;
+
+/** Maximum length of RecentReportGenerators. Finished generators only hold their report, so this is cheap */
+static const int32 MaxRecentReportGenerators = 16;
+
+static void MarkReportGeneratorUsed(const TSharedRef<FAsyncReportGenerator>& Generator)
+{
+    RecentReportGenerators.Remove(Generator);
+    RecentReportGenerators.Insert(Generator, 0);
+    if (RecentReportGenerators.Num() > MaxRecentReportGenerators)
+    {
+        RecentReportGenerators.RemoveAt(MaxRecentReportGenerators, RecentReportGenerators.Num() - MaxRecentReportGenerators);
+    }
+}
+
+/** Number of report generators that exist. Game thread only */
+static int32 NumLiveReportGenerators = 0;
+
+int32 FAsyncReportGenerator::GetNumLiveGenerators()
+{
+    return NumLiveReportGenerators;
+}
+
+FAsyncReportGenerator::FOnReleaseSharedGenerators& FAsyncReportGenerator::OnReleaseSharedGenerators()
+{
+    static FOnReleaseSharedGenerators onReleaseSharedGenerators;
+    return onReleaseSharedGenerators;
+}
+
+void FAsyncReportGenerator::ReleaseSharedGenerators()
+{
+    OnReleaseSharedGenerators().Broadcast();
+    RecentReportGenerators.Empty();
+    SharedReportGenerators.Empty();
+    SharedCrossCompiles.Empty();
+}
+
+TSharedRef<FAsyncReportGenerator> FAsyncReportGenerator::FindOrCreate(UMaterialInterface* MaterialInterface, const FMaliPlatform& Platform, const FCompileJobOptions& Options, FMaliOCQualityLevelMask QualityLevels)
+{
+    check(IsInGameThread());
+    check(MaterialInterface != nullptr);
+
+    // Instances that render with their parent's shaders share the parent's request
+    MaterialInterface = GetShaderOwner(MaterialInterface);
+    const FCompileJobOptions effectiveOptions = GetEffectiveJobOptions(Options);
+
+    // Working out the cross compile key creates a material resource for each quality level, so it's only done once, and handed to a new generator
+    const FSHAHash crossCompileKey = ComputeCrossCompileKey(MaterialInterface, Platform.GetPlatform(), effectiveOptions, QualityLevels);
+    const FSHAHash key = ComputeReportRequestKey(crossCompileKey, Platform, effectiveOptions);
+
+    // Whether it's still compiling or already finished, an identical request is just attached to it
+    const TWeakPtr<FAsyncReportGenerator>* existingGenerator = SharedReportGenerators.Find(key);
+    if (existingGenerator != nullptr)
+    {
+        TSharedPtr<FAsyncReportGenerator> generator = existingGenerator->Pin();
+        if (generator.IsValid())
+        {
+            MarkReportGeneratorUsed(generator.ToSharedRef());
+            return generator.ToSharedRef();
+        }
+    }
+
+    // Forget generators that nobody uses any more, so the map doesn't grow with every compile
+    for (auto it = SharedReportGenerators.CreateIterator(); it; ++it)
+    {
+        if (!it.Value().IsValid())
+        {
+            it.RemoveCurrent();
+        }
+    }
+
+    TSharedRef<FAsyncReportGenerator> generator = MakeShareable(new FAsyncReportGenerator(MaterialInterface, Platform, effectiveOptions, QualityLevels, crossCompileKey));
+    SharedReportGenerators.Add(key, generator);
+    MarkReportGeneratorUsed(generator);
+    return generator;
+}
+
+FAsyncReportGenerator::FAsyncReportGenerator(UMaterialInterface* MaterialInterface, const FMaliPlatform& MaliPlatform, const FCompileJobOptions& Options, FMaliOCQualityLevelMask QualityLevels) :
+FAsyncReportGenerator(GetShaderOwner(MaterialInterface), MaliPlatform, GetEffectiveJobOptions(Options), QualityLevels,
+    ComputeCrossCompileKey(GetShaderOwner(MaterialInterface), MaliPlatform.GetPlatform(), GetEffectiveJobOptions(Options), QualityLevels))
+{
+}
+
+FAsyncReportGenerator::FAsyncReportGenerator(UMaterialInterface* ShaderOwner, const FMaliPlatform& MaliPlatform, const FCompileJobOptions& EffectiveOptions, FMaliOCQualityLevelMask QualityLevels,
+    const FSHAHash& CrossCompileKey) :
+Platform(MaliPlatform),
+JobOptions(EffectiveOptions),
+QualityLevelMask(QualityLevels)
+{
+    check(ShaderOwner != nullptr);
+    check(QualityLevelMask != 0);
+
+    NumLiveReportGenerators++;
+
+    // Platforms with the same shader platform share the cross compile, which may already be under way or finished
+    CrossCompile = FindOrCreateCrossCompile(CrossCompileKey, ShaderOwner, Platform.GetPlatform(), JobOptions, QualityLevelMask);
+    if (CrossCompile->GetState() == FMaliOCCrossCompile::EState::FAILED)
+    {
+        bWasCompilationError = true;
+        BeginReportGenerationAsync();
+    }
+}
+
+FAsyncReportGenerator::~FAsyncReportGenerator()
+{
+    NumLiveReportGenerators--;
+
+    // The build task references data owned by us, so it must finish before we go away
+    if (ReportTask.IsValid())
+    {
+        ReportTask->EnsureCompletion();
+    }
+}
+
+void FAsyncReportGenerator::BeginReportGenerationAsync()
+{
+    check(!ReportTask.IsValid());
+    check(CrossCompile.IsValid());
+
+    const TIndirectArray<FMaliOCMaterialResource>& resources = CrossCompile->GetResources();
+
+    FMaliOCReportBuildInputs inputs;
+    inputs.bWasCompilationError = bWasCompilationError;
+    inputs.QualityLevelMask = QualityLevelMask;
+    inputs.NumSkippedPermutations = CrossCompile->GetNumFilteredPermutations();
+    inputs.SamplingOptions = JobOptions.Sampling;
+    inputs.StratumSizes = CrossCompile->GetStratumSizes();
+
+    if (resources.Num() == 0)
+    {
+        inputs.CompileErrors.Add(TEXT("None of the summary shaders passed the permutation filter"));
+    }
+
+    for (const auto& resource : resources)
+    {
+        // Partitions share most of their code, so they tend to report the same errors
+        for (const auto& error : resource.GetCompileErrors())
+        {
+            inputs.CompileErrors.AddUnique(error);
+        }
+
+        if (resource.NumRetries > 0)
+        {
+            FMaliOCReport::FCrossCompileRetry retry;
+            const FVertexFactoryType* vertexFactoryType = resource.GetVertexFactoryType();
+            if (vertexFactoryType != nullptr)
+            {
+                retry.VertexFactoryName = FName(vertexFactoryType->GetName());
+            }
+            retry.QualityLevelMask = resource.GetQualityLevelMask();
+            retry.NumRetries = resource.NumRetries;
+            retry.bSucceeded = resource.GetGameThreadShaderMap() != nullptr;
+            inputs.CrossCompileRetries.Add(retry);
+        }
+    }
+
+    if (!bWasCompilationError)
+    {
+        check(JobHandle.IsValid());
+        inputs.RawOutput = JobHandle->GetRawCompilerOutput();
+        inputs.NumSkippedPermutations += JobHandle->GetNumSkippedShaders();
+
+        // This walks the material and shader types, so it has to happen on the game thread.
+        // The representative shaders don't depend on the quality level, so any resource will do.
+        resources[0].GetRepresentativeShaderTypesAndDescriptions(inputs.ShaderTypeNamesAndDescriptions);
+    }
+
+    ReportTask.Reset(new FAsyncTask<FMaliOCReportBuildTask>(MoveTemp(inputs)));
+    ReportTask->StartBackgroundTask();
+    Progress = EProgress::REPORT_GENERATION_IN_PROGRESS;
+}
+
+void FAsyncReportGenerator::Tick(float DeltaTime)
+{
+    // Early return if the job is complete
+    if (Progress == EProgress::COMPILATION_COMPLETE)
+    {
+        return;
+    }
+
+    // Cross compilation from HLSL to GLSL is in Progress
+    if (Progress == EProgress::CROSS_COMPILATION_IN_PROGRESS)
+    {
+        UpdateCrossCompilation();
     }
 
     if (Progress == EProgress::MALIOC_COMPILATION_IN_PROGRESS)
@@ -100,35 +824,107 @@ void FAsyncReportGenerator::Tick(float DeltaTime)
         {
             return;
         }
+
+        // Report generation involves formatting and sorting every shader, which can take a noticeable amount of time for big shader maps.
+        // Do it on a worker so the UI thread only ever sees the finished report.
+        BeginReportGenerationAsync();
     }
 
-    // In theory, we could do the report generation asynchronously here as well
-    // In practice, it's fast enough* that we just do it lazily on the UI thread (it's just string manipulation)
-    // *(At least on a machine that meets the recommended specifications)
+    if (Progress == EProgress::REPORT_GENERATION_IN_PROGRESS)
+    {
+        if (!ReportTask->IsDone())
+        {
+            return;
+        }
+
+        Report = ReportTask->GetTask().Report;
+        ReportTask.Reset();
+        Progress = EProgress::COMPILATION_COMPLETE;
 
-    Progress = EProgress::COMPILATION_COMPLETE;
+        // Everything is in the report now. Let go of the shader maps and the material, as finished generators may be kept around to share the report.
+        // The cross compile goes away with the last generator using it.
+        CompletedProgress = GetMaliOCCompilationProgress();
+        JobHandle = nullptr;
+        CrossCompile.Reset();
+    }
 }
 
-void FAsyncReportGenerator::FinishReportGeneration()
+void FAsyncReportGenerator::UpdateCrossCompilation()
 {
-    if (Progress == EProgress::COMPILATION_COMPLETE)
+    check(Progress == EProgress::CROSS_COMPILATION_IN_PROGRESS);
+
+    // Every generator sharing the cross compile updates it. Whichever gets there first does the work, the rest just see the new state.
+    const FMaliOCCrossCompile::EState crossCompileState = CrossCompile->Update();
+    if (crossCompileState == FMaliOCCrossCompile::EState::IN_PROGRESS)
     {
         return;
     }
 
+    if (crossCompileState == FMaliOCCrossCompile::EState::FAILED)
+    {
+        bWasCompilationError = true;
+        BeginReportGenerationAsync();
+        return;
+    }
+
+    TArray<FCompileJobShaderMap> shaderMaps;
+    for (const auto& resource : CrossCompile->GetResources())
+    {
+        shaderMaps.Add(FCompileJobShaderMap{ resource.GetGameThreadShaderMap(), resource.GetQualityLevelMask() });
+    }
+
+    // Start the async compile job
+    check(!JobHandle.IsValid());
+    JobHandle = FAsyncCompiler::Get()->AddJob(shaderMaps, Platform, JobOptions);
+    Progress = EProgress::MALIOC_COMPILATION_IN_PROGRESS;
+}
+
+void FAsyncReportGenerator::FinishCompilation()
+{
     if (Progress == EProgress::CROSS_COMPILATION_IN_PROGRESS)
     {
-        // Block until the shader map has finished compilation
-        Resource->FinishCompilation();
-        // Update the internal state machine
-        Tick(0.0f);
-        check(Progress == EProgress::MALIOC_COMPILATION_IN_PROGRESS);
+        // Block until the shader maps have finished compilation. Partitions being retried need more than one round.
+        while (Progress == EProgress::CROSS_COMPILATION_IN_PROGRESS)
+        {
+            CrossCompile->FinishCompilation();
+            // Update the internal state machine, without going on to build the report
+            UpdateCrossCompilation();
+
+            if (Progress == EProgress::CROSS_COMPILATION_IN_PROGRESS)
+            {
+                // Waiting out a retry backoff
+                FPlatformProcess::Sleep(0.01f);
+            }
+        }
+        check(Progress == EProgress::MALIOC_COMPILATION_IN_PROGRESS || Progress == EProgress::REPORT_GENERATION_IN_PROGRESS);
     }
 
     if (Progress == EProgress::MALIOC_COMPILATION_IN_PROGRESS)
     {
         // Block until the offline shader compile job has finished
         FAsyncCompiler::Get()->FinishCompilation();
+    }
+}
+
+void FAsyncReportGenerator::FinishReportGeneration()
+{
+    if (Progress == EProgress::COMPILATION_COMPLETE)
+    {
+        return;
+    }
+
+    FinishCompilation();
+
+    if (Progress == EProgress::MALIOC_COMPILATION_IN_PROGRESS)
+    {
+        // Update the internal state machine, which starts building the report
+        Tick(0.0f);
+    }
+
+    if (Progress == EProgress::REPORT_GENERATION_IN_PROGRESS)
+    {
+        // Block until the report has been built
+        ReportTask->EnsureCompletion();
         // Update the internal state machine
         Tick(0.0f);
     }
@@ -145,7 +941,7 @@ FAsyncReportGenerator::EProgress FAsyncReportGenerator::GetProgress() const
 
 FAsyncReportGenerator::FMaliOCCompilationProgress FAsyncReportGenerator::GetMaliOCCompilationProgress() const
 {
-    FMaliOCCompilationProgress ret;
+    FMaliOCCompilationProgress ret = CompletedProgress;
 
     if (JobHandle.IsValid())
     {
@@ -155,95 +951,94 @@ FAsyncReportGenerator::FMaliOCCompilationProgress FAsyncReportGenerator::GetMali
     return ret;
 }
 
-struct FMidgardBoundPipes
+/* @return Text wrapped in bold markup, as an interned name */
+FName MakeBoldDetail(const FString& Text)
 {
-    FString ShortestBound;
-    FString LongestBound;
-};
-
-/* Get the limiting pipe on Midgard for a render target */
-FMidgardBoundPipes GetMidgardBoundPipes(const FMaliOCRawCompilerOutput::FMidgardOutput::FRenderTarget& RenderTarget)
-{
-    FMidgardBoundPipes bounds;
-
-    const auto GetMidgardBoundPipe = [](uint32 a, uint32 ls, uint32 t) -> FString
-    {
-        uint32 max = FMath::Max3(a, ls, t);
-
-        if (max == a)
-        {
-            return TEXT("Arithmetic");
-        }
-        if (max == ls)
-        {
-            return TEXT("Load/Store");
-        }
-        return TEXT("Texture");
-    };
-
-    bounds.ShortestBound = GetMidgardBoundPipe(RenderTarget.arithmetic_shortest_path, RenderTarget.load_store_shortest_path, RenderTarget.texture_shortest_path);
-
-    bounds.LongestBound = GetMidgardBoundPipe(RenderTarget.arithmetic_longest_path, RenderTarget.load_store_longest_path, RenderTarget.texture_longest_path);
-
-    return bounds;
+    return FName(*FString::Printf(TEXT("<Text.Bold>%s</>"), *Text));
 }
 
-/* Take the raw common output from the compiler and return a beautified array of strings for the user to read */
-TArray<TSharedRef<FString>> GetDetailsFromCommonOutput(const FMaliOCRawCompilerOutput::FCommonOutput& CommonOutput)
+/* Take the raw common output from the compiler and return a beautified array of lines for the user to read */
+TArray<FName> GetDetailsFromCommonOutput(const FMaliOCRawCompilerOutput::FCommonOutput& CommonOutput)
 {
-    TArray<TSharedRef<FString>> details;
+    static const FName FragmentShaderDetail(TEXT("<Text.Bold>Fragment Shader</>"));
+    static const FName VertexShaderDetail(TEXT("<Text.Bold>Vertex Shader</>"));
+    static const FName TessellationControlShaderDetail(TEXT("<Text.Bold>Tessellation Control Shader</>"));
+    static const FName TessellationEvaluationShaderDetail(TEXT("<Text.Bold>Tessellation Evaluation Shader</>"));
+    static const FName GeometryShaderDetail(TEXT("<Text.Bold>Geometry Shader</>"));
+    static const FName ComputeShaderDetail(TEXT("<Text.Bold>Compute Shader</>"));
 
-    if (CommonOutput.Frequency == EShaderFrequency::SF_Pixel)
-    {
-        details.Add(MakeShareable(new FString(TEXT("<Text.Bold>Fragment Shader</>"))));
-    }
-    else if (CommonOutput.Frequency == EShaderFrequency::SF_Vertex)
+    TArray<FName> details;
+
+    switch (CommonOutput.Frequency)
     {
-        details.Add(MakeShareable(new FString(TEXT("<Text.Bold>Vertex Shader</>"))));
+    case EShaderFrequency::SF_Pixel:
+        details.Add(FragmentShaderDetail);
+        break;
+    case EShaderFrequency::SF_Vertex:
+        details.Add(VertexShaderDetail);
+        break;
+    case EShaderFrequency::SF_Hull:
+        details.Add(TessellationControlShaderDetail);
+        break;
+    case EShaderFrequency::SF_Domain:
+        details.Add(TessellationEvaluationShaderDetail);
+        break;
+    case EShaderFrequency::SF_Geometry:
+        details.Add(GeometryShaderDetail);
+        break;
+    case EShaderFrequency::SF_Compute:
+        details.Add(ComputeShaderDetail);
+        break;
+    default:
+        break;
     }
 
     return details;
 }
 
-TSharedRef<FMaliOCReport> FAsyncReportGenerator::GetReport() const
+TSharedRef<const FMaliOCReport> FAsyncReportGenerator::GetReport() const
 {
     check(Progress == EProgress::COMPILATION_COMPLETE);
+    check(Report.IsValid());
+    return Report.ToSharedRef();
+}
 
-    if (CachedReport.IsValid())
-    {
-        return CachedReport.ToSharedRef();
-    }
-
-    CachedReport = MakeShareable(new FMaliOCReport);
+static TSharedRef<FMaliOCReport> BuildReport(const FMaliOCReportBuildInputs& Inputs)
+{
+    TSharedRef<FMaliOCReport> newReport = MakeShareable(new FMaliOCReport);
+    newReport->QualityLevelMask = Inputs.QualityLevelMask;
+    newReport->CrossCompileRetries = Inputs.CrossCompileRetries;
+    newReport->NumSkippedPermutations = Inputs.NumSkippedPermutations;
 
-    if (bWasCompilationError)
+    if (Inputs.bWasCompilationError)
     {
         // We never got far enough to make a job handle
         // Write out all compilation errors
 
         TSharedRef<FMaliOCReport::FErrorReport> errorReport = MakeShareable(new FMaliOCReport::FErrorReport);
-        errorReport->TitleName = TEXT("Cross Compilation Errors");
+        errorReport->TitleName = FName(TEXT("Cross Compilation Errors"));
+        errorReport->QualityLevelMask = Inputs.QualityLevelMask;
 
-        const auto& compileErrors = Resource->GetCompileErrors();
+        const auto& compileErrors = Inputs.CompileErrors;
 
         if (compileErrors.Num() == 0)
         {
-            errorReport->Errors.Add(MakeShareable(new FString(TEXT("An unknown error occurred. Try again."))));
+            errorReport->Errors.Add(TEXT("An unknown error occurred. Try again."));
         }
         else
         {
-            for (const auto& error : Resource->GetCompileErrors())
+            for (const auto& error : compileErrors)
             {
-                errorReport->Errors.Add(MakeShareable(new FString(error)));
+                errorReport->Errors.Add(error);
             }
         }
 
-        CachedReport->ErrorList.Add(errorReport);
+        newReport->ErrorList.Add(errorReport);
     }
     else
     {
-        check(JobHandle.IsValid());
-        const auto& rawReport = *JobHandle->GetRawCompilerOutput();
+        check(Inputs.RawOutput.IsValid());
+        const auto& rawReport = *Inputs.RawOutput;
 
         // Package up all errors
         for (const auto& rawError : rawReport.ErrorOutput)
@@ -252,24 +1047,16 @@ TSharedRef<FMaliOCReport> FAsyncReportGenerator::GetReport() const
             errorReport->TitleName = rawError.CommonOutput.ShaderName;
             errorReport->Details = GetDetailsFromCommonOutput(rawError.CommonOutput);
             errorReport->SourceCode = rawError.CommonOutput.SourceCode;
+            errorReport->QualityLevelMask = rawError.CommonOutput.QualityLevelMask;
 
-            for (const auto& warning : rawError.CommonOutput.Warnings)
-            {
-                errorReport->Warnings.Add(MakeShareable(new FString(warning)));
-            }
+            errorReport->Warnings = rawError.CommonOutput.Warnings;
+            errorReport->Errors = rawError.Errors;
 
-            for (const auto& error : rawError.Errors)
-            {
-                errorReport->Errors.Add(MakeShareable(new FString(error)));
-            }
-
-            CachedReport->ErrorList.Add(errorReport);
+            newReport->ErrorList.Add(errorReport);
         }
 
-        TMap<FName, FString> shaderTypeNamesAndDescriptions;
-
-        // Get representative shader names and their descriptions so the widget generator can generate the summary
-        Resource->GetRepresentativeShaderTypesAndDescriptions(shaderTypeNamesAndDescriptions);
+        // Representative shader names and their descriptions so the widget generator can generate the summary
+        const TMap<FName, FString>& shaderTypeNamesAndDescriptions = Inputs.ShaderTypeNamesAndDescriptions;
 
         // Package up any Midgard output
         // Midgard output and Utgard output should be mutually exclusive
@@ -280,81 +1067,22 @@ TSharedRef<FMaliOCReport> FAsyncReportGenerator::GetReport() const
             report->VertexFactoryName = output.CommonOutput.VertexFactoryName;
             report->Details = GetDetailsFromCommonOutput(output.CommonOutput);
             report->SourceCode = output.CommonOutput.SourceCode;
+            report->QualityLevelMask = output.CommonOutput.QualityLevelMask;
 
-            for (const auto& warning : output.CommonOutput.Warnings)
-            {
-                report->Warnings.Add(MakeShareable(new FString(warning)));
-            }
-
-            // For each render target, package up all the stats in a 5*4 table
-            for (const auto& rt : output.RenderTargets)
-            {
-                TSharedRef<FMaliOCReport::FMidgardReport::FRenderTarget> rtReport = MakeShareable(new FMaliOCReport::FMidgardReport::FRenderTarget);
-
-                auto BoundPipes = GetMidgardBoundPipes(rt);
-
-                rtReport->Index = rt.render_target;
-
-                const auto AsText = [](const FString& fs) -> TSharedPtr < FText >
-                {
-                    return MakeShareable(new FText(FText::FromString(fs)));
-                };
-
-                // Header line
-                rtReport->StatsTable[0] = MakeShareable(new FText());
-                rtReport->StatsTable[1] = AsText(TEXT("A"));
-                rtReport->StatsTable[2] = AsText(TEXT("L/S"));
-                rtReport->StatsTable[3] = AsText(TEXT("T"));
-                rtReport->StatsTable[4] = AsText(TEXT("Bound"));
-
-                // Shortest Path
-                rtReport->StatsTable[5] = AsText(TEXT("Shortest Path (Cycles)"));
-                rtReport->StatsTable[6] = AsText(FString::Printf(TEXT("%.4g"), rt.arithmetic_shortest_path));
-                rtReport->StatsTable[7] = AsText(FString::Printf(TEXT("%.4g"), rt.load_store_shortest_path));
-                rtReport->StatsTable[8] = AsText(FString::Printf(TEXT("%.4g"), rt.texture_shortest_path));
-                rtReport->StatsTable[9] = AsText(BoundPipes.ShortestBound);
-
-                // Longest Path
-                rtReport->StatsTable[10] = AsText(TEXT("Longest Path (Cycles)"));
-                rtReport->StatsTable[11] = AsText(FString::Printf(TEXT("%.4g"), rt.arithmetic_longest_path));
-                rtReport->StatsTable[12] = AsText(FString::Printf(TEXT("%.4g"), rt.load_store_longest_path));
-                rtReport->StatsTable[13] = AsText(FString::Printf(TEXT("%.4g"), rt.texture_longest_path));
-                rtReport->StatsTable[14] = AsText(BoundPipes.LongestBound);
-
-                // Instructions Emitted line
-                rtReport->StatsTable[15] = AsText(TEXT("Instructions Emitted"));
-                rtReport->StatsTable[16] = AsText(FString::Printf(TEXT("%.4g"), rt.arithmetic_cycles));
-                rtReport->StatsTable[17] = AsText(FString::Printf(TEXT("%.4g"), rt.load_store_cycles));
-                rtReport->StatsTable[18] = AsText(FString::Printf(TEXT("%.4g"), rt.texture_cycles));
-                rtReport->StatsTable[19] = MakeShareable(new FText());
-
-                // Register and spilling info
-                rtReport->ExtraDetails.Add(MakeShareable(new FString(FString::Printf(TEXT("%u work registers used"), rt.work_registers_used))));
-                rtReport->ExtraDetails.Add(MakeShareable(new FString(FString::Printf(TEXT("%u uniform registers used"), rt.uniform_registers_used))));
-
-                if (rt.spilling_used)
-                {
-                    rtReport->ExtraDetails.Add(MakeShareable(new FString(TEXT("<Text.Warning>Register spilling used</>"))));
-                }
-                else
-                {
-                    rtReport->ExtraDetails.Add(MakeShareable(new FString(TEXT("Register spilling not used"))));
-                }
-
-                report->RenderTargets.Add(rtReport);
-            }
+            report->Warnings = output.CommonOutput.Warnings;
+            report->RenderTargets = output.RenderTargets;
 
-            CachedReport->MidgardReports.Add(report);
+            newReport->MidgardReports.Add(report);
 
-            const FString* shaderDescription = shaderTypeNamesAndDescriptions.Find(FName(*report->TitleName));
+            const FString* shaderDescription = shaderTypeNamesAndDescriptions.Find(report->TitleName);
 
             if (shaderDescription != nullptr)
             {
                 TSharedRef<FMaliOCReport::FMidgardReport> reportCopy = MakeShareable(new FMaliOCReport::FMidgardReport(*report));
 
-                reportCopy->Details.Add(MakeShareable(new FString(FString::Printf(TEXT("<Text.Bold>%s</>"), *report->VertexFactoryName))));
-                reportCopy->Details.Add(MakeShareable(new FString(FString::Printf(TEXT("<Text.Bold>%s</>"), **shaderDescription))));
-                CachedReport->MidgardSummaryReports.Add(reportCopy);
+                reportCopy->Details.Add(MakeBoldDetail(report->VertexFactoryName.ToString()));
+                reportCopy->Details.Add(MakeBoldDetail(*shaderDescription));
+                newReport->MidgardSummaryReports.Add(reportCopy);
             }
         }
 
@@ -366,59 +1094,68 @@ TSharedRef<FMaliOCReport> FAsyncReportGenerator::GetReport() const
             report->VertexFactoryName = output.CommonOutput.VertexFactoryName;
             report->Details = GetDetailsFromCommonOutput(output.CommonOutput);
             report->SourceCode = output.CommonOutput.SourceCode;
+            report->QualityLevelMask = output.CommonOutput.QualityLevelMask;
 
-            for (const auto& warning : output.CommonOutput.Warnings)
-            {
-                report->Warnings.Add(MakeShareable(new FString(warning)));
-            }
-
-            report->ExtraDetails.Add(MakeShareable(new FString(FString::Printf(TEXT("Number of instruction words emitted: %u"), output.n_instruction_words))));
-            report->ExtraDetails.Add(MakeShareable(new FString(FString::Printf(TEXT("Number of cycles for shortest code path: %u"), output.min_number_of_cycles))));
-            report->ExtraDetails.Add(MakeShareable(new FString(FString::Printf(TEXT("Number of cycles for longest code path: %u"), output.max_number_of_cycles))));
+            report->Warnings = output.CommonOutput.Warnings;
+            report->NumInstructionWords = output.n_instruction_words;
+            report->MinNumberOfCycles = output.min_number_of_cycles;
+            report->MaxNumberOfCycles = output.max_number_of_cycles;
 
-            CachedReport->UtgardReports.Add(report);
+            newReport->UtgardReports.Add(report);
 
-            const FString* shaderDescription = shaderTypeNamesAndDescriptions.Find(FName(*report->TitleName));
+            const FString* shaderDescription = shaderTypeNamesAndDescriptions.Find(report->TitleName);
 
             if (shaderDescription != nullptr)
             {
                 TSharedRef<FMaliOCReport::FUtgardReport> reportCopy = MakeShareable(new FMaliOCReport::FUtgardReport(*report));
 
-                reportCopy->Details.Add(MakeShareable(new FString(FString::Printf(TEXT("<Text.Bold>%s</>"), *report->VertexFactoryName))));
-                reportCopy->Details.Add(MakeShareable(new FString(FString::Printf(TEXT("<Text.Bold>%s</>"), **shaderDescription))));
-                CachedReport->UtgardSummaryReports.Add(reportCopy);
+                reportCopy->Details.Add(MakeBoldDetail(report->VertexFactoryName.ToString()));
+                reportCopy->Details.Add(MakeBoldDetail(*shaderDescription));
+                newReport->UtgardSummaryReports.Add(reportCopy);
             }
         }
 
         // Explain what A, L/S and T mean if we're showing Midgard output
         if (rawReport.MidgardOutput.Num() != 0)
         {
-            CachedReport->ShaderSummaryStrings.Add(MakeShareable(new FString(TEXT("<Text.Bold>A = Arithmetic, L/S = Load/Store, T = Texture</>"))));
+            newReport->ShaderSummaryStrings.Add(TEXT("<Text.Bold>A = Arithmetic, L/S = Load/Store, T = Texture</>"));
         }
         // Add the disclaimers
-        CachedReport->ShaderSummaryStrings.Add(MakeShareable(new FString(TEXT("<Text.Bold>The cycle counts do not include possible stalls due to cache misses.</>"))));
-        CachedReport->ShaderSummaryStrings.Add(MakeShareable(new FString(TEXT("<Text.Bold>Shaders with loops may return \" - 1\" for cycle counts if the number of cycles cannot be statically determined.</>"))));
+        newReport->ShaderSummaryStrings.Add(TEXT("<Text.Bold>The cycle counts do not include possible stalls due to cache misses.</>"));
+        newReport->ShaderSummaryStrings.Add(TEXT("<Text.Bold>Shaders with loops may return \" - 1\" for cycle counts if the number of cycles cannot be statically determined.</>"));
+
+        if (Inputs.NumSkippedPermutations > 0)
+        {
+            newReport->ShaderSummaryStrings.Add(FString::Printf(TEXT("<Text.Warning>%u shader permutations were skipped by the permutation filter.</>"), Inputs.NumSkippedPermutations));
+        }
+
+        if (Inputs.SamplingOptions.IsEnabled())
+        {
+            newReport->Sampling = EstimateFromSample(rawReport, Inputs.StratumSizes, Inputs.SamplingOptions);
+            newReport->ShaderSummaryStrings.Add(FString::Printf(TEXT("<Text.Warning>Only %u of %u shader permutations were compiled. See the sampling estimate for the rest.</>"),
+                newReport->Sampling.NumSampled, newReport->Sampling.NumPermutations));
+        }
 
         // Sort all the dumped statistics into alphabetical order
         // We don't sort the summary in order to maintain the same order as the inbuilt statistics
         const auto errorSorter = [](const TSharedRef<FMaliOCReport::FErrorReport>& a, const TSharedRef<FMaliOCReport::FErrorReport>& b) -> bool
         {
-            return a->TitleName < b->TitleName;
+            return a->TitleName.Compare(b->TitleName) < 0;
         };
-        CachedReport->ErrorList.Sort(errorSorter);
+        newReport->ErrorList.Sort(errorSorter);
 
         const auto midgardSorter = [](const TSharedRef<FMaliOCReport::FMidgardReport>& a, const TSharedRef<FMaliOCReport::FMidgardReport>& b) -> bool
         {
-            return a->TitleName < b->TitleName;
+            return a->TitleName.Compare(b->TitleName) < 0;
         };
-        CachedReport->MidgardReports.Sort(midgardSorter);
+        newReport->MidgardReports.Sort(midgardSorter);
 
         const auto utgardSorter = [](const TSharedRef<FMaliOCReport::FUtgardReport>& a, const TSharedRef<FMaliOCReport::FUtgardReport>& b) -> bool
         {
-            return a->TitleName < b->TitleName;
+            return a->TitleName.Compare(b->TitleName) < 0;
         };
-        CachedReport->UtgardReports.Sort(utgardSorter);
+        newReport->UtgardReports.Sort(utgardSorter);
     }
 
-    return CachedReport.ToSharedRef();
+    return newReport;
 }
@@ -18,70 +18,200 @@
 #include "MaliOCPrivatePCH.h"
 #include "MaliOCAsyncCompiler.h"
 
-/** Report structure. Created from raw output in AsyncCompiler */
+/**
+ * Report structure. Created from raw output in AsyncCompiler.
+ * The report is plain data: statistics are kept as numbers and are only formatted by the widget generator when a row is displayed.
+ * Names and detail lines repeat for every shader, so they are held as FNames (IDs into the global name table) rather than strings.
+ */
 struct FMaliOCReport
 {
     struct FErrorReport
     {
-        FString TitleName;
-        TArray<TSharedRef<FString>> Details;
-        TArray<TSharedRef<FString>> Errors;
-        TArray<TSharedRef<FString>> Warnings;
-        FString SourceCode;
+        FName TitleName;
+        TArray<FName> Details;
+        TArray<FString> Errors;
+        TArray<FString> Warnings;
+        FMaliOCShaderSourceRef SourceCode;
+        FMaliOCQualityLevelMask QualityLevelMask = 0;
     };
 
     struct FMidgardReport
     {
-        struct FRenderTarget
-        {
-            uint32 Index;
-            TStaticArray<TSharedPtr<FText>, 20> StatsTable;
-            TArray<TSharedRef<FString>> ExtraDetails;
-        };
-
-        FString TitleName;
-        FString VertexFactoryName;
-        TArray<TSharedRef<FString>> Details;
-        TArray<TSharedRef<FRenderTarget>> RenderTargets;
-        TArray<TSharedRef<FString>> Warnings;
-        FString SourceCode;
+        /** Statistics for one render target */
+        typedef FMaliOCRawCompilerOutput::FMidgardOutput::FRenderTarget FRenderTarget;
+
+        FName TitleName;
+        FName VertexFactoryName;
+        TArray<FName> Details;
+        TArray<FRenderTarget> RenderTargets;
+        TArray<FString> Warnings;
+        FMaliOCShaderSourceRef SourceCode;
+        /** Quality levels this shader's statistics apply to */
+        FMaliOCQualityLevelMask QualityLevelMask = 0;
     };
 
     struct FUtgardReport
     {
-        FString TitleName;
-        FString VertexFactoryName;
-        TArray<TSharedRef<FString>> Details;
-        TArray<TSharedRef<FString>> ExtraDetails;
-        TArray<TSharedRef<FString>> Warnings;
-        FString SourceCode;
+        FName TitleName;
+        FName VertexFactoryName;
+        TArray<FName> Details;
+        int32 NumInstructionWords = 0;
+        int32 MinNumberOfCycles = 0;
+        int32 MaxNumberOfCycles = 0;
+        TArray<FString> Warnings;
+        FMaliOCShaderSourceRef SourceCode;
+        /** Quality levels this shader's statistics apply to */
+        FMaliOCQualityLevelMask QualityLevelMask = 0;
     };
 
     TArray<TSharedRef<FErrorReport>> ErrorList;
-    TArray<TSharedRef<FString>> ShaderSummaryStrings;
+    TArray<FString> ShaderSummaryStrings;
     TArray<TSharedRef<FMidgardReport>> MidgardSummaryReports;
     TArray<TSharedRef<FMidgardReport>> MidgardReports;
     TArray<TSharedRef<FUtgardReport>> UtgardSummaryReports;
     TArray<TSharedRef<FUtgardReport>> UtgardReports;
+    /** All the quality levels the material was compiled for */
+    FMaliOCQualityLevelMask QualityLevelMask = 0;
+
+    /** A group of permutations which had to be cross compiled more than once */
+    struct FCrossCompileRetry
+    {
+        /** Vertex factory type name of the permutations. None for the shaders which don't use a vertex factory */
+        FName VertexFactoryName;
+        FMaliOCQualityLevelMask QualityLevelMask = 0;
+        uint32 NumRetries = 0;
+        /** False if the permutations still failed after the last retry */
+        bool bSucceeded = false;
+    };
+
+    TArray<FCrossCompileRetry> CrossCompileRetries;
+
+    /** Number of permutations that the permutation filter kept out of the report */
+    uint32 NumSkippedPermutations = 0;
+
+    /** Estimated statistics, if only a sample of the permutations was compiled */
+    FMaliOCSamplingSummary Sampling;
 };
 
+/**
+ * Material resource which only caches the permutations of a single vertex factory type (or only the shaders without a vertex factory).
+ * Materials are cross compiled as several of these so that a permutation which fails can be retried without redoing all the others.
+ * The filter feeds into the shader map ID, so partitions never share a shader map.
+ */
+class FMaliOCMaterialResource final : public FMaterialResource
+{
+public:
+    /**
+     * @param PartitionVertexFactoryType the vertex factory type whose permutations should be cached. nullptr for the shaders without a vertex factory
+     * @param PartitionQualityLevels the quality levels this resource's shaders stand for
+     * @param PermutationFilter permutations which don't pass this filter are never cross compiled
+     * @param Sample if not empty, only these shader types are cross compiled
+     */
+    FMaliOCMaterialResource(const FVertexFactoryType* PartitionVertexFactoryType, FMaliOCQualityLevelMask PartitionQualityLevels, const FMaliOCPermutationFilter& PermutationFilter,
+        TSet<const FShaderType*>&& Sample = TSet<const FShaderType*>()) :
+        VertexFactoryType(PartitionVertexFactoryType),
+        QualityLevelMask(PartitionQualityLevels),
+        Filter(PermutationFilter),
+        SampledShaderTypes(MoveTemp(Sample))
+    {
+    }
+
+    virtual bool ShouldCache(EShaderPlatform Platform, const FShaderType* ShaderType, const FVertexFactoryType* InVertexFactoryType) const override
+    {
+        return InVertexFactoryType == VertexFactoryType && Filter.ShouldCompile(ShaderType, InVertexFactoryType) &&
+            (SampledShaderTypes.Num() == 0 || SampledShaderTypes.Contains(ShaderType));
+    }
+
+    const FVertexFactoryType* GetVertexFactoryType() const
+    {
+        return VertexFactoryType;
+    }
+
+    FMaliOCQualityLevelMask GetQualityLevelMask() const
+    {
+        return QualityLevelMask;
+    }
+
+    /** Number of times cross compilation of this partition has been retried */
+    uint32 NumRetries = 0;
+    /** Time (in FPlatformTime::Seconds) at which the next retry may start */
+    double NextRetryTime = 0.0;
+
+private:
+    const FVertexFactoryType* const VertexFactoryType;
+    const FMaliOCQualityLevelMask QualityLevelMask;
+    const FMaliOCPermutationFilter Filter;
+    const TSet<const FShaderType*> SampledShaderTypes;
+};
+
+/** How one partition of a cross compile is doing */
+enum class EMaliOCPartitionState
+{
+    /** Still being cross compiled */
+    Compiling,
+    Succeeded,
+    /** Failed without errors, so it will be tried again */
+    Retrying,
+    /** Failed with errors, or has run out of retries */
+    Failed,
+};
+
+/**
+ * Decide whether a cross compile has finished from the states of its partitions.
+ * Nothing is retried once a partition has failed for good, so the cross compile fails as soon as no partition is still compiling.
+ * @param bOutFailed set to whether the cross compile failed, if it has finished
+ * @return true if the cross compile has finished
+ */
+bool ResolveCrossCompilePartitions(const TArray<EMaliOCPartitionState>& PartitionStates, bool& bOutFailed);
+
 /** Compiles the given non-null Material Interface with the given Mali Platform asynchronously */
 class FAsyncReportGenerator final : private FTickableEditorObject
 {
 public:
 
+    /**
+     * Get a report generator for the request, sharing one that's still in use by anyone else if it was made for an identical request. Game thread only.
+     * Requests are identical if the material compiles to the same shaders (it has the same shader map IDs) for the same platform, options and quality levels,
+     * so material editors open on the same material, and batch runs, share the cross compile, the offline compile and the report.
+     * Requests for different platforms with the same shader platform still share the cross compile.
+     * Material instances which only override parameters render with their parent's shaders, so they share the parent's report.
+     * The most recently requested generators are kept alive, so their reports are shared even after everyone has stopped using them.
+     * Parameters are the same as the constructor's.
+     */
+    static TSharedRef<FAsyncReportGenerator> FindOrCreate(UMaterialInterface* MaterialInterface, const FMaliPlatform& Platform, const FCompileJobOptions& Options = FCompileJobOptions(),
+        FMaliOCQualityLevelMask QualityLevels = QualityLevelToMask(EMaterialQualityLevel::High));
+
+    /** Let go of the generators kept alive for sharing. Must be called before the async compiler is deinitialized */
+    static void ReleaseSharedGenerators();
+
+    DECLARE_MULTICAST_DELEGATE(FOnReleaseSharedGenerators);
+    /** Broadcast by ReleaseSharedGenerators(), so that anything else keeping generators alive (e.g. the tests) lets go of them too */
+    static FOnReleaseSharedGenerators& OnReleaseSharedGenerators();
+
+    /** Game thread only. @return the number of report generators that exist, each of which refers to its platform */
+    static int32 GetNumLiveGenerators();
+
     /**
      * Creates a report generator which will asynchronously compile the material and generate a report
-     * @param MaterialInterface the non-null material interface we want to get a compilation report for
+     * @param MaterialInterface the non-null material interface we want to get a compilation report for. Instances that render with their parent's shaders compile the parent
      * @param Platform the Mali platform to compile for
+     * @param Options options for the compile job. Source code is never retained if ShouldRetainShaderSource() is false
+     * @param QualityLevels the material quality levels to compile. Levels the material doesn't distinguish between are only compiled once.
      */
-    FAsyncReportGenerator(UMaterialInterface* MaterialInterface, const FMaliPlatform& Platform);
-    ~FAsyncReportGenerator() = default;
+    FAsyncReportGenerator(UMaterialInterface* MaterialInterface, const FMaliPlatform& Platform, const FCompileJobOptions& Options = FCompileJobOptions(),
+        FMaliOCQualityLevelMask QualityLevels = QualityLevelToMask(EMaterialQualityLevel::High));
+    ~FAsyncReportGenerator();
     FAsyncReportGenerator(const FAsyncReportGenerator&) = delete;
     FAsyncReportGenerator(FAsyncReportGenerator&&) = delete;
     FAsyncReportGenerator& operator=(const FAsyncReportGenerator&) = delete;
     FAsyncReportGenerator& operator=(FAsyncReportGenerator&&) = delete;
 
+    /**
+     * Block until the offline compile has finished, without building the report.
+     * The report is built by the next tick, or by FinishReportGeneration(). Does nothing once the report is being built.
+     */
+    void FinishCompilation();
+
     /* Block until the report is ready */
     void FinishReportGeneration();
 
@@ -89,6 +219,7 @@ public:
     {
         CROSS_COMPILATION_IN_PROGRESS,
         MALIOC_COMPILATION_IN_PROGRESS,
+        REPORT_GENERATION_IN_PROGRESS,
         COMPILATION_COMPLETE
     };
 
@@ -108,25 +239,46 @@ public:
     FMaliOCCompilationProgress GetMaliOCCompilationProgress() const;
 
     /* This is only valid to be called when GetProgress() returns COMPILATION_COMPLETE. Will assert otherwise.
-     * @return the report generated after compilation has completed.
+     * @return the report generated after compilation has completed. The report is built on a worker thread and is immutable once handed out.
      */
-    TSharedRef<FMaliOCReport> GetReport() const;
+    TSharedRef<const FMaliOCReport> GetReport() const;
 
 private:
+    /**
+     * Used by FindOrCreate(), which has already worked out the cross compile key
+     * @param ShaderOwner the material interface whose shaders are compiled, from GetShaderOwner()
+     * @param EffectiveOptions the options after the constructor's adjustments
+     * @param CrossCompileKey the request's cross compile key, so it isn't worked out again
+     */
+    FAsyncReportGenerator(UMaterialInterface* ShaderOwner, const FMaliPlatform& Platform, const FCompileJobOptions& EffectiveOptions, FMaliOCQualityLevelMask QualityLevels,
+        const FSHAHash& CrossCompileKey);
+
     /** Platform we're compiling for */
     const FMaliPlatform& Platform;
-    /** Material resource we're extracting shaders from */
-    TUniqueObj<FMaterialResource> Resource;
+    /** Options for the compile job */
+    FCompileJobOptions JobOptions;
+    /** Cross compile of the material, shared with every generator for the same material and shader platform. It keeps the material from being garbage collected. Released once the report is complete */
+    TSharedPtr<class FMaliOCCrossCompile> CrossCompile;
+    /** All the quality levels we were asked to compile */
+    const FMaliOCQualityLevelMask QualityLevelMask;
     /** Whether there was a compilation error during shader cross compilation (i.e. not our fault) */
     bool bWasCompilationError = false;
     /** Current progress of compilation */
     EProgress Progress = EProgress::CROSS_COMPILATION_IN_PROGRESS;
-    /** Handle to the async compilation job */
-    TSharedPtr<const FCompileJobHandle> JobHandle = nullptr;
-    /** Cached instance of the report we create once compilation is complete */
-    mutable TSharedPtr<FMaliOCReport> CachedReport = nullptr;
-    /** Number of attempts we've made for cross compilation. Used due to a bug where cross compilation fails without errors*/
-    uint32 NumAttempts = 0;
+    /** Handle to the async compilation job. Released once the report is complete */
+    TSharedPtr<const FCompileJobHandle, ESPMode::ThreadSafe> JobHandle = nullptr;
+    /** Progress of the job when it was released */
+    FMaliOCCompilationProgress CompletedProgress;
+    /** Task that builds the report on a worker thread once the raw compiler output is ready */
+    TUniquePtr<FAsyncTask<class FMaliOCReportBuildTask>> ReportTask;
+    /** The finished report. Only valid once Progress is COMPILATION_COMPLETE */
+    TSharedPtr<const FMaliOCReport> Report = nullptr;
+
+    /** Gather everything the report needs from the game thread and start building it on a worker thread */
+    void BeginReportGenerationAsync();
+
+    /** Update the shared cross compile, and start the offline compile job once it has succeeded. Only while cross compilation is in progress */
+    void UpdateCrossCompilation();
 
     // FTickableEditorObject functions
 
@@ -0,0 +1,473 @@
+/*
+* Copyright 2015 ARM Limited
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include "MaliOCPrivatePCH.h"
+#include "MaliOCCompileTrace.h"
+
+/** Identifies the trace file format. Bump TraceVersion whenever the layout of a record changes */
+static const uint32 TraceMagic = 0x4D4F4354; // "MOCT"
+static const uint32 TraceVersion = 1;
+
+/** Largest uncompressed trace that will be loaded. Far more than any real trace, but small enough to allocate */
+static const int32 MaxUncompressedTraceSize = 1 << 30;
+/** zlib can't compress by more than this, so a header claiming more is corrupt */
+static const int64 MaxCompressionRatio = 1032;
+
+/** The active trace. Guarded by ActiveTraceCriticalSection, as compile jobs pick it up from their own threads */
+static TSharedPtr<FMaliOCCompileTrace, ESPMode::ThreadSafe> ActiveTrace;
+static FCriticalSection ActiveTraceCriticalSection;
+
+/** Copy a list of compiler strings onto the end of OutStrings */
+static void AppendStrings(const char* const* List, uint32 Num, TArray<TArray<ANSICHAR>>& OutStrings)
+{
+    for (uint32 i = 0; i < Num; i++)
+    {
+        TArray<ANSICHAR>& string = OutStrings[OutStrings.AddDefaulted()];
+        string.Append(List[i], FCStringAnsi::Strlen(List[i]) + 1);
+    }
+}
+
+void FMaliOCCompileTraceRecord::SetOutputs(bool bInCompilerRan, const malioc_outputs& Outputs)
+{
+    bCompilerRan = bInCompilerRan;
+    Strings.Reset();
+    FlexibleOutputSizes.Reset();
+    NumErrors = 0;
+    NumWarnings = 0;
+
+    if (!bCompilerRan)
+    {
+        return;
+    }
+
+    NumErrors = Outputs.number_of_errors;
+    AppendStrings(Outputs.errors, Outputs.number_of_errors, Strings);
+    NumWarnings = Outputs.number_of_warnings;
+    AppendStrings(Outputs.warnings, Outputs.number_of_warnings, Strings);
+    for (unsigned int i = 0; i < Outputs.number_of_flexible_outputs; i++)
+    {
+        FlexibleOutputSizes.Add(Outputs.flexible_outputs[i].number_of_entries);
+        AppendStrings(Outputs.flexible_outputs[i].list, Outputs.flexible_outputs[i].number_of_entries, Strings);
+    }
+}
+
+/** @return true if String is non-empty and ends in its null terminator */
+static bool IsNullTerminated(const TArray<ANSICHAR>& String)
+{
+    return String.Num() > 0 && String.Last() == '\0';
+}
+
+bool FMaliOCCompileTraceRecord::FinishLoading()
+{
+    StringPointers.Reset();
+    FlexibleOutputs.Reset();
+
+    if (!IsNullTerminated(ShaderType) || !IsNullTerminated(Source))
+    {
+        return false;
+    }
+
+    for (const TArray<ANSICHAR>& string : Strings)
+    {
+        if (!IsNullTerminated(string))
+        {
+            return false;
+        }
+    }
+
+    // Counted in 64 bits, so a corrupt count can't wrap around to a valid total
+    uint64 numStrings = (uint64)NumErrors + NumWarnings;
+    for (uint32 size : FlexibleOutputSizes)
+    {
+        numStrings += size;
+    }
+    if (numStrings != (uint64)Strings.Num())
+    {
+        return false;
+    }
+
+    StringPointers.Reserve(Strings.Num());
+    for (TArray<ANSICHAR>& string : Strings)
+    {
+        StringPointers.Add(string.GetData());
+    }
+
+    FlexibleOutputs.Reset(FlexibleOutputSizes.Num());
+    int32 firstString = NumErrors + NumWarnings;
+    for (uint32 size : FlexibleOutputSizes)
+    {
+        malioc_key_value_pairs pairs;
+        pairs.number_of_entries = size;
+        pairs.list = StringPointers.GetData() + firstString;
+        FlexibleOutputs.Add(pairs);
+        firstString += size;
+    }
+    return true;
+}
+
+bool FMaliOCCompileTraceRecord::GetOutputs(malioc_outputs& OutOutputs) const
+{
+    FMemory::Memzero(OutOutputs);
+    if (!bCompilerRan)
+    {
+        return false;
+    }
+
+    // The compiler's outputs aren't const, but nothing writes through them
+    char** const strings = const_cast<char**>(StringPointers.GetData());
+
+    OutOutputs.number_of_errors = NumErrors;
+    OutOutputs.errors = strings;
+    OutOutputs.number_of_warnings = NumWarnings;
+    OutOutputs.warnings = strings + NumErrors;
+    OutOutputs.number_of_flexible_outputs = FlexibleOutputs.Num();
+    OutOutputs.flexible_outputs = const_cast<malioc_key_value_pairs*>(FlexibleOutputs.GetData());
+    return true;
+}
+
+/**
+ * Loading only. Read an array count, and fail the archive if fewer than that many elements of MinElementSize bytes are left,
+ * so a corrupt count can't allocate more than the file could hold.
+ * @return the count, or 0 if it was rejected
+ */
+static int32 LoadCount(FArchive& Ar, int64 MinElementSize)
+{
+    int32 count = 0;
+    Ar << count;
+    if (Ar.IsError() || count < 0 || count > (Ar.TotalSize() - Ar.Tell()) / MinElementSize)
+    {
+        Ar.ArIsError = true;
+        return 0;
+    }
+    return count;
+}
+
+/** Loading only. Read a byte array in the layout TArray's operator<< writes, checking its count first */
+static void LoadBytes(FArchive& Ar, TArray<ANSICHAR>& OutBytes)
+{
+    const int32 count = LoadCount(Ar, 1);
+    OutBytes.SetNumUninitialized(count);
+    Ar.Serialize(OutBytes.GetData(), count);
+}
+
+FArchive& operator<<(FArchive& Ar, FMaliOCCompileTraceRecord& Record)
+{
+    if (Ar.IsLoading())
+    {
+        // Traces may come from anywhere, so every count is checked against the bytes left before anything is allocated for it.
+        // FString stores wide strings with a negative count, so peek at it and leave the reading to FString
+        const int64 identityPosition = Ar.Tell();
+        int32 identityCount = 0;
+        Ar << identityCount;
+        const int64 identityBytes = identityCount < 0 ? -(int64)identityCount * (int64)sizeof(UCS2CHAR) : identityCount;
+        if (Ar.IsError() || identityBytes > Ar.TotalSize() - Ar.Tell())
+        {
+            Ar.ArIsError = true;
+            return Ar;
+        }
+        Ar.Seek(identityPosition);
+        Ar << Record.CompilerIdentity;
+
+        LoadBytes(Ar, Record.ShaderType);
+        LoadBytes(Ar, Record.Source);
+        Ar << Record.bCompilerRan;
+
+        // Each string takes at least its count
+        Record.Strings.SetNum(LoadCount(Ar, sizeof(int32)));
+        for (TArray<ANSICHAR>& string : Record.Strings)
+        {
+            LoadBytes(Ar, string);
+        }
+
+        Ar << Record.NumErrors;
+        Ar << Record.NumWarnings;
+
+        Record.FlexibleOutputSizes.SetNumUninitialized(LoadCount(Ar, sizeof(uint32)));
+        for (uint32& size : Record.FlexibleOutputSizes)
+        {
+            Ar << size;
+        }
+        return Ar;
+    }
+
+    Ar << Record.CompilerIdentity;
+    Ar << Record.ShaderType;
+    Ar << Record.Source;
+    Ar << Record.bCompilerRan;
+    Ar << Record.Strings;
+    Ar << Record.NumErrors;
+    Ar << Record.NumWarnings;
+    Ar << Record.FlexibleOutputSizes;
+    return Ar;
+}
+
+TSharedPtr<FMaliOCCompileTrace, ESPMode::ThreadSafe> FMaliOCCompileTrace::GetActive()
+{
+    FScopeLock lock(&ActiveTraceCriticalSection);
+    return ActiveTrace;
+}
+
+void FMaliOCCompileTrace::BeginRecording(const FString& Path)
+{
+    check(IsInGameThread());
+    Stop();
+
+    TSharedPtr<FMaliOCCompileTrace, ESPMode::ThreadSafe> trace = MakeShareable(new FMaliOCCompileTrace(Path, false));
+
+    FScopeLock lock(&ActiveTraceCriticalSection);
+    ActiveTrace = trace;
+    UE_LOG(MaliOfflineCompiler, Log, TEXT("Recording offline compiles to %s"), *Path);
+}
+
+bool FMaliOCCompileTrace::BeginReplay(const FString& Path)
+{
+    check(IsInGameThread());
+    Stop();
+
+    TSharedPtr<FMaliOCCompileTrace, ESPMode::ThreadSafe> trace = MakeShareable(new FMaliOCCompileTrace(Path, true));
+    if (!trace->Load())
+    {
+        // Compiles just run as normal without a trace, so this isn't an error. It also lets the tests feed in corrupt traces
+        UE_LOG(MaliOfflineCompiler, Warning, TEXT("Could not load the compile trace %s"), *Path);
+        return false;
+    }
+
+    FScopeLock lock(&ActiveTraceCriticalSection);
+    ActiveTrace = trace;
+    UE_LOG(MaliOfflineCompiler, Log, TEXT("Replaying %d offline compiles from %s"), trace->Records.Num(), *Path);
+    return true;
+}
+
+void FMaliOCCompileTrace::Stop()
+{
+    check(IsInGameThread());
+
+    TSharedPtr<FMaliOCCompileTrace, ESPMode::ThreadSafe> trace;
+    {
+        FScopeLock lock(&ActiveTraceCriticalSection);
+        trace = ActiveTrace;
+        ActiveTrace.Reset();
+    }
+
+    if (!trace.IsValid())
+    {
+        return;
+    }
+
+    if (trace->bIsReplaying)
+    {
+        UE_LOG(MaliOfflineCompiler, Log, TEXT("Stopped replaying %s. %d compiles weren't in the trace"), *trace->Path, trace->NumMisses.GetValue());
+    }
+    else
+    {
+        // Jobs still compiling may add more records, but they're too late to be saved
+        trace->Save();
+    }
+}
+
+FMaliOCCompileTrace::FMaliOCCompileTrace(const FString& InPath, bool bInIsReplaying) :
+Path(InPath),
+bIsReplaying(bInIsReplaying)
+{
+}
+
+FSHAHash FMaliOCCompileTrace::ComputeKey(const FString& CompilerIdentity, const char* ShaderType, const ANSICHAR* Source)
+{
+    FSHA1 hashState;
+    hashState.UpdateWithString(*CompilerIdentity, CompilerIdentity.Len() + 1);
+    hashState.Update((const uint8*)ShaderType, FCStringAnsi::Strlen(ShaderType) + 1);
+    hashState.Update((const uint8*)Source, FCStringAnsi::Strlen(Source));
+    hashState.Final();
+
+    FSHAHash key;
+    hashState.GetHash(&key.Hash[0]);
+    return key;
+}
+
+const FMaliOCCompileTraceRecord* FMaliOCCompileTrace::Find(const FString& CompilerIdentity, const char* ShaderType, const ANSICHAR* Source) const
+{
+    check(bIsReplaying);
+
+    const int32* index = RecordIndices.Find(ComputeKey(CompilerIdentity, ShaderType, Source));
+    if (index == nullptr)
+    {
+        NumMisses.Increment();
+        return nullptr;
+    }
+    return &Records[*index];
+}
+
+void FMaliOCCompileTrace::Add(const FString& CompilerIdentity, const char* ShaderType, const ANSICHAR* Source, bool bCompilerRan, const malioc_outputs& Outputs)
+{
+    check(!bIsReplaying);
+
+    const FSHAHash key = ComputeKey(CompilerIdentity, ShaderType, Source);
+    {
+        FScopeLock lock(&RecordsCriticalSection);
+        if (RecordIndices.Contains(key))
+        {
+            return;
+        }
+    }
+
+    // Copy the outputs outside of the lock, so jobs don't wait on each other
+    FMaliOCCompileTraceRecord* record = new FMaliOCCompileTraceRecord;
+    record->CompilerIdentity = CompilerIdentity;
+    record->ShaderType.Append(ShaderType, FCStringAnsi::Strlen(ShaderType) + 1);
+    record->Source.Append(Source, FCStringAnsi::Strlen(Source) + 1);
+    record->SetOutputs(bCompilerRan, Outputs);
+
+    FScopeLock lock(&RecordsCriticalSection);
+
+    // Another job may have recorded the same compile in the meantime
+    if (RecordIndices.Contains(key))
+    {
+        delete record;
+        return;
+    }
+    RecordIndices.Add(key, Records.Add(record));
+}
+
+bool FMaliOCCompileTrace::Load()
+{
+    TArray<uint8> bytes;
+    if (!FFileHelper::LoadFileToArray(bytes, *Path, FILEREAD_Silent))
+    {
+        return false;
+    }
+
+    FMemoryReader reader(bytes);
+
+    uint32 magic = 0;
+    uint32 version = 0;
+    int32 uncompressedSize = 0;
+    reader << magic;
+    reader << version;
+    reader << uncompressedSize;
+    if (reader.IsError() || magic != TraceMagic || version != TraceVersion || uncompressedSize < 0)
+    {
+        return false;
+    }
+
+    // The size comes from the file, so it's checked before it's allocated
+    const int32 headerSize = reader.Tell();
+    if (uncompressedSize > MaxUncompressedTraceSize || uncompressedSize > (int64)(bytes.Num() - headerSize) * MaxCompressionRatio)
+    {
+        UE_LOG(MaliOfflineCompiler, Warning, TEXT("The compile trace %s claims an impossible size of %d bytes"), *Path, uncompressedSize);
+        return false;
+    }
+
+    // GLSL and compiler output are mostly text, so the records are stored compressed
+    TArray<uint8> uncompressed;
+    uncompressed.AddUninitialized(uncompressedSize);
+    if (!FCompression::UncompressMemory(COMPRESS_ZLIB, uncompressed.GetData(), uncompressedSize, bytes.GetData() + headerSize, bytes.Num() - headerSize))
+    {
+        return false;
+    }
+
+    FMemoryReader recordReader(uncompressed);
+    int32 numRecords = 0;
+    recordReader << numRecords;
+    for (int32 i = 0; i < numRecords && !recordReader.IsError(); i++)
+    {
+        FMaliOCCompileTraceRecord* record = new FMaliOCCompileTraceRecord;
+        recordReader << *record;
+        if (recordReader.IsError() || !record->FinishLoading())
+        {
+            UE_LOG(MaliOfflineCompiler, Warning, TEXT("Record %d of the compile trace %s is corrupt"), i, *Path);
+            delete record;
+            return false;
+        }
+        RecordIndices.Add(ComputeKey(record->CompilerIdentity, record->ShaderType.GetData(), record->Source.GetData()), Records.Add(record));
+    }
+
+    // A truncated or corrupt trace is treated as missing
+    return !recordReader.IsError();
+}
+
+void FMaliOCCompileTrace::Save() const
+{
+    TArray<uint8> uncompressed;
+    FMemoryWriter recordWriter(uncompressed);
+    {
+        FScopeLock lock(&RecordsCriticalSection);
+
+        int32 numRecords = Records.Num();
+        recordWriter << numRecords;
+        for (int32 i = 0; i < numRecords; i++)
+        {
+            // Serializing only reads the record, but FArchive's operators aren't const
+            recordWriter << const_cast<FMaliOCCompileTraceRecord&>(Records[i]);
+        }
+        UE_LOG(MaliOfflineCompiler, Log, TEXT("Writing %d offline compiles to %s"), numRecords, *Path);
+    }
+
+    TArray<uint8> bytes;
+    FMemoryWriter writer(bytes);
+
+    uint32 magic = TraceMagic;
+    uint32 version = TraceVersion;
+    int32 uncompressedSize = uncompressed.Num();
+    writer << magic;
+    writer << version;
+    writer << uncompressedSize;
+
+    const int32 headerSize = bytes.Num();
+    int32 compressedSize = FCompression::CompressMemoryBound(COMPRESS_ZLIB, uncompressedSize);
+    bytes.AddUninitialized(compressedSize);
+    if (!FCompression::CompressMemory(COMPRESS_ZLIB, bytes.GetData() + headerSize, compressedSize, uncompressed.GetData(), uncompressedSize))
+    {
+        UE_LOG(MaliOfflineCompiler, Warning, TEXT("Could not compress the compile trace"));
+        return;
+    }
+    bytes.SetNum(headerSize + compressedSize, false);
+
+    if (!FFileHelper::SaveArrayToFile(bytes, *Path))
+    {
+        UE_LOG(MaliOfflineCompiler, Warning, TEXT("Could not write the compile trace to %s"), *Path);
+    }
+}
+
+/** @return the path given to a trace command, or the default trace file in the saved folder */
+static FString GetTracePath(const TArray<FString>& Args)
+{
+    return Args.Num() > 0 ? Args[0] : FPaths::Combine(*FPaths::GameSavedDir(), TEXT("MaliOC"), TEXT("CompileTrace.bin"));
+}
+
+static void RecordCompileTrace(const TArray<FString>& Args)
+{
+    FMaliOCCompileTrace::BeginRecording(GetTracePath(Args));
+}
+
+static void ReplayCompileTrace(const TArray<FString>& Args)
+{
+    FMaliOCCompileTrace::BeginReplay(GetTracePath(Args));
+}
+
+static FAutoConsoleCommand RecordCompileTraceCommand(
+    TEXT("MaliOC.CompileTrace.Record"),
+    TEXT("Record every offline compile, with its outputs, to the given file (by default Saved/MaliOC/CompileTrace.bin). The file is written by MaliOC.CompileTrace.Stop."),
+    FConsoleCommandWithArgsDelegate::CreateStatic(&RecordCompileTrace));
+
+static FAutoConsoleCommand ReplayCompileTraceCommand(
+    TEXT("MaliOC.CompileTrace.Replay"),
+    TEXT("Serve offline compiles from the given trace file (by default Saved/MaliOC/CompileTrace.bin) instead of running the compiler. Compiles that aren't in the trace run as normal."),
+    FConsoleCommandWithArgsDelegate::CreateStatic(&ReplayCompileTrace));
+
+static FAutoConsoleCommand StopCompileTraceCommand(
+    TEXT("MaliOC.CompileTrace.Stop"),
+    TEXT("Stop recording or replaying offline compiles. A recording is written out."),
+    FConsoleCommandDelegate::CreateStatic(&FMaliOCCompileTrace::Stop));
@@ -0,0 +1,130 @@
+/*
+* Copyright 2015 ARM Limited
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#pragma once
+#include "MaliOCPrivatePCH.h"
+#include "compiler_manager/compiler_manager.h"
+
+/** One recorded compile: what was given to the compiler, and everything it returned */
+class FMaliOCCompileTraceRecord final
+{
+public:
+    /** The compiler's core, revision and driver names */
+    FString CompilerIdentity;
+    /** The compiler's name for the shader type, e.g. "vertex" */
+    TArray<ANSICHAR> ShaderType;
+    /** Null terminated device GLSL */
+    TArray<ANSICHAR> Source;
+    /** Whether _malicm_compile returned true */
+    bool bCompilerRan = false;
+    /** Each output string, null terminated. Errors first, then warnings, then the entries of each flexible output in turn */
+    TArray<TArray<ANSICHAR>> Strings;
+    uint32 NumErrors = 0;
+    uint32 NumWarnings = 0;
+    /** Number of entries in each flexible output */
+    TArray<uint32> FlexibleOutputSizes;
+
+    /** Copy the compiler's outputs into the record */
+    void SetOutputs(bool bInCompilerRan, const malioc_outputs& Outputs);
+
+    /**
+     * Check that the record is consistent, and point the output views at the strings. Must be called once the record won't change again.
+     * Traces may come from anywhere, so nothing in a record is trusted until this has passed.
+     * @return false if the inputs or any string aren't null terminated, or the output counts don't add up to the number of strings
+     */
+    bool FinishLoading();
+
+    /**
+     * Get the outputs in the same form the compiler returns them. They point into the record, and must not be given to _malicm_release_compiler_outputs.
+     * @return true if the compiler ran
+     */
+    bool GetOutputs(malioc_outputs& OutOutputs) const;
+
+    friend FArchive& operator<<(FArchive& Ar, FMaliOCCompileTraceRecord& Record);
+
+private:
+    TArray<char*> StringPointers;
+    TArray<malioc_key_value_pairs> FlexibleOutputs;
+};
+
+/**
+ * A trace of offline compiles, for benchmarking and profiling the plugin without the cost or noise of the compiler itself.
+ * While recording, every compile's inputs and outputs are captured, and the trace is written out when recording stops.
+ * While replaying, compiles that are in the trace get the recorded outputs straight away without running the compiler; any others are compiled as normal.
+ * Controlled with the MaliOC.CompileTrace.Record <file>, MaliOC.CompileTrace.Replay <file> and MaliOC.CompileTrace.Stop console commands.
+ */
+class FMaliOCCompileTrace final
+{
+public:
+    /** @return the trace compiles should go through, if one is active. Thread safe. Hold on to it for a whole batch, as it may be stopped at any time */
+    static TSharedPtr<FMaliOCCompileTrace, ESPMode::ThreadSafe> GetActive();
+
+    /** Start recording every compile, stopping any active trace first. Game thread only */
+    static void BeginRecording(const FString& Path);
+
+    /**
+     * Start serving compiles from a trace file, stopping any active trace first. Game thread only
+     * @return false if the file couldn't be loaded
+     */
+    static bool BeginReplay(const FString& Path);
+
+    /** Stop the active trace, if there is one, writing it out if it was recording. Game thread only */
+    static void Stop();
+
+    /** @return true if the trace serves compiles rather than recording them */
+    bool IsReplaying() const
+    {
+        return bIsReplaying;
+    }
+
+    /**
+     * Replaying only. Thread safe
+     * @return the recorded compile with exactly these inputs, or nullptr if the trace doesn't have one
+     */
+    const FMaliOCCompileTraceRecord* Find(const FString& CompilerIdentity, const char* ShaderType, const ANSICHAR* Source) const;
+
+    /** Recording only. Thread safe. A compile with the same inputs as one already recorded is only stored once */
+    void Add(const FString& CompilerIdentity, const char* ShaderType, const ANSICHAR* Source, bool bCompilerRan, const malioc_outputs& Outputs);
+
+    FMaliOCCompileTrace(const FString& InPath, bool bInIsReplaying);
+    ~FMaliOCCompileTrace() = default;
+    FMaliOCCompileTrace(const FMaliOCCompileTrace&) = delete;
+    FMaliOCCompileTrace(FMaliOCCompileTrace&&) = delete;
+    FMaliOCCompileTrace& operator=(const FMaliOCCompileTrace&) = delete;
+    FMaliOCCompileTrace& operator=(FMaliOCCompileTrace&&) = delete;
+
+private:
+    /** File the trace is read from or written to */
+    const FString Path;
+    const bool bIsReplaying;
+
+    /** Guards Records and RecordIndices while recording. Nothing changes them while replaying */
+    mutable FCriticalSection RecordsCriticalSection;
+    TIndirectArray<FMaliOCCompileTraceRecord> Records;
+    /** Index into Records of each compile, by the hash of its inputs */
+    TMap<FSHAHash, int32> RecordIndices;
+    /** Number of compiles replaying couldn't find in the trace */
+    mutable FThreadSafeCounter NumMisses;
+
+    /** @return the hash of a compile's inputs */
+    static FSHAHash ComputeKey(const FString& CompilerIdentity, const char* ShaderType, const ANSICHAR* Source);
+
+    /** Read the trace file. @return false if it isn't a valid trace */
+    bool Load();
+
+    /** Write the trace file */
+    void Save() const;
+};
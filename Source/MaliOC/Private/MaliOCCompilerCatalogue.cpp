@@ -0,0 +1,168 @@
+/*
+* Copyright 2015 ARM Limited
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+
+#include "MaliOCPrivatePCH.h"
+#include "MaliOCCompilerCatalogue.h"
+#include "MaliOCCompilerManager.h"
+
+/** Identifies the cache file format. Bump CacheVersion whenever the layout of the catalogue changes */
+static const uint32 CacheMagic = 0x4D4F4343; // "MOCC"
+static const uint32 CacheVersion = 2;
+
+FArchive& operator<<(FArchive& Ar, FMaliOCCompilerCatalogue::FPlatform& Platform)
+{
+    Ar << Platform.Name;
+
+    uint32 shaderPlatform = Platform.Platform;
+    Ar << shaderPlatform;
+    Platform.Platform = (EShaderPlatform)shaderPlatform;
+
+    return Ar;
+}
+
+FArchive& operator<<(FArchive& Ar, FMaliOCCompilerCatalogue::FEntry& Entry)
+{
+    Ar << Entry.CoreName;
+    Ar << Entry.RevisionName;
+    Ar << Entry.DriverName;
+    Ar << Entry.MaxAPI;
+    Ar << Entry.Extensions;
+    Ar << Entry.Platforms;
+    return Ar;
+}
+
+FMaliOCCompilerCatalogue FMaliOCCompilerCatalogue::Enumerate(const FCompilerManager& CompilerManager)
+{
+    FMaliOCCompilerCatalogue catalogue;
+
+    // Get an exhaustive list of all compilers
+    malicm_compiler* compilers;
+    unsigned int numCompilers = 0;
+    CompilerManager._malicm_get_compilers(&compilers, &numCompilers, nullptr, nullptr, nullptr, "openglessl", nullptr, 0);
+
+    for (unsigned int i = 0; i < numCompilers; i++)
+    {
+        FEntry& entry = catalogue.Entries[catalogue.Entries.AddDefaulted()];
+        entry.CoreName = CompilerManager._malicm_get_core_name(compilers[i]);
+        entry.RevisionName = CompilerManager._malicm_get_core_revision(compilers[i]);
+        entry.DriverName = CompilerManager._malicm_get_driver_name(compilers[i]);
+        entry.MaxAPI = CompilerManager._malicm_get_highest_api_version(compilers[i]);
+        entry.Extensions = CompilerManager._malicm_get_extensions(compilers[i]);
+
+        // Add AEP if supported. It's only offered if MaliOC.EnableAEP is set, but it's always listed so the cache doesn't depend on the setting
+        if (entry.Extensions.Contains(TEXT("GL_ANDROID_extension_pack_es31a")) && entry.Extensions.Contains(TEXT("GL_EXT_color_buffer_half_float")))
+        {
+            entry.Platforms.Add(FPlatform{ TEXT("OpenGL ES 3.1 AEP"), EShaderPlatform::SP_OPENGL_ES31_EXT });
+        }
+
+        // GLES2 is always supported
+        entry.Platforms.Add(FPlatform{ TEXT("OpenGL ES 2.0"), EShaderPlatform::SP_OPENGL_ES2_ANDROID });
+    }
+
+    CompilerManager._malicm_release_compilers(&compilers, numCompilers);
+
+    return catalogue;
+}
+
+FSHAHash FMaliOCCompilerCatalogue::ComputeBundleKey(const FString& BundlePath)
+{
+    TArray<FString> files;
+    IFileManager::Get().FindFilesRecursive(files, *BundlePath, TEXT("*"), true, false);
+    // The order files are found in isn't guaranteed
+    files.Sort();
+
+    FSHA1 hashState;
+    hashState.UpdateWithString(*BundlePath, BundlePath.Len());
+    for (const FString& file : files)
+    {
+        const int64 size = IFileManager::Get().FileSize(*file);
+        const int64 modificationTime = IFileManager::Get().GetTimeStamp(*file).GetTicks();
+
+        hashState.UpdateWithString(*file, file.Len());
+        hashState.Update((const uint8*)&size, sizeof(size));
+        hashState.Update((const uint8*)&modificationTime, sizeof(modificationTime));
+    }
+    hashState.Final();
+
+    FSHAHash key;
+    hashState.GetHash(&key.Hash[0]);
+    return key;
+}
+
+bool FMaliOCCompilerCatalogue::LoadFromCache(const FSHAHash& BundleKey, FMaliOCCompilerCatalogue& OutCatalogue)
+{
+    TArray<uint8> bytes;
+    if (!FFileHelper::LoadFileToArray(bytes, *GetCacheFilePath(), FILEREAD_Silent))
+    {
+        return false;
+    }
+
+    FMemoryReader reader(bytes);
+
+    uint32 magic = 0;
+    uint32 version = 0;
+    reader << magic;
+    reader << version;
+    if (reader.IsError() || magic != CacheMagic || version != CacheVersion)
+    {
+        return false;
+    }
+
+    FSHAHash key;
+    reader << key;
+    if (reader.IsError() || key != BundleKey)
+    {
+        return false;
+    }
+
+    FMaliOCCompilerCatalogue catalogue;
+    reader << catalogue.Entries;
+
+    // A truncated or corrupt cache is treated as missing
+    if (reader.IsError() || catalogue.Entries.Num() == 0)
+    {
+        return false;
+    }
+
+    OutCatalogue = MoveTemp(catalogue);
+    return true;
+}
+
+void FMaliOCCompilerCatalogue::SaveToCache(const FSHAHash& BundleKey) const
+{
+    TArray<uint8> bytes;
+    FMemoryWriter writer(bytes);
+
+    uint32 magic = CacheMagic;
+    uint32 version = CacheVersion;
+    FSHAHash key = BundleKey;
+    writer << magic;
+    writer << version;
+    writer << key;
+    // FArchive's operators take non-const references, but a saving archive only reads what it serializes, so there's no need to copy the entries
+    writer << const_cast<TArray<FEntry>&>(Entries);
+
+    if (!FFileHelper::SaveArrayToFile(bytes, *GetCacheFilePath()))
+    {
+        UE_LOG(MaliOfflineCompiler, Warning, TEXT("Could not write the compiler catalogue cache to %s"), *GetCacheFilePath());
+    }
+}
+
+FString FMaliOCCompilerCatalogue::GetCacheFilePath()
+{
+    return FPaths::Combine(*FPaths::GameSavedDir(), TEXT("MaliOC"), TEXT("CompilerCatalogue.bin"));
+}
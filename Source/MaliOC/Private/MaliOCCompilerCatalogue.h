@@ -0,0 +1,77 @@
+/*
+* Copyright 2015 ARM Limited
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+
+#pragma once
+#include "MaliOCPrivatePCH.h"
+
+class FCompilerManager;
+
+/**
+ * Everything the plugin needs to know about the compilers in the offline compiler bundle to fill in the core, revision, driver and platform lists.
+ * Enumerating the compilers means loading every vendor library, so the catalogue is cached on disk and only rebuilt when the bundle changes.
+ * The compiler handles themselves aren't part of the catalogue: they're looked up when something is compiled (see FMaliDriver::GetCompiler).
+ */
+struct FMaliOCCompilerCatalogue
+{
+    /** A shader platform a compiler can compile for */
+    struct FPlatform
+    {
+        FString Name;
+        EShaderPlatform Platform;
+    };
+
+    /** One compiler in the bundle */
+    struct FEntry
+    {
+        FString CoreName;
+        FString RevisionName;
+        FString DriverName;
+        /** Highest GLES API version. 100 means ES 2.0, 300 means ES 3.0, 310 means ES 3.1 */
+        uint32 MaxAPI = 0;
+        /** Space separated list of extensions */
+        FString Extensions;
+        TArray<FPlatform> Platforms;
+    };
+
+    TArray<FEntry> Entries;
+
+    /**
+     * Enumerate the compilers of a loaded compiler manager
+     * @return the catalogue of every compiler which can compile GLSL
+     */
+    static FMaliOCCompilerCatalogue Enumerate(const FCompilerManager& CompilerManager);
+
+    /**
+     * Hash the bundle's path and the name, size and modification time of every file in it. Doesn't open any files.
+     * @param BundlePath path to the offline compiler bundle
+     */
+    static FSHAHash ComputeBundleKey(const FString& BundlePath);
+
+    /**
+     * Load the catalogue from the cache file
+     * @param BundleKey the current key of the bundle. The cache is ignored if it was saved for a different key
+     * @param OutCatalogue filled in if the cache is valid
+     * @return true if the cache was valid and was loaded
+     */
+    static bool LoadFromCache(const FSHAHash& BundleKey, FMaliOCCompilerCatalogue& OutCatalogue);
+
+    /** Save the catalogue to the cache file, overwriting any previous cache */
+    void SaveToCache(const FSHAHash& BundleKey) const;
+
+    /** @return the path of the cache file */
+    static FString GetCacheFilePath();
+};
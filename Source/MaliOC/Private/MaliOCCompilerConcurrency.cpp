@@ -0,0 +1,421 @@
+/*
+* Copyright 2015 ARM Limited
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+
+#include "MaliOCPrivatePCH.h"
+#include "MaliOCCompilerConcurrency.h"
+#include "MaliOCAsyncCompiler.h"
+
+static TAutoConsoleVariable<int32> CVarCompilerReentrancy(
+    TEXT("MaliOC.CompilerReentrancy"),
+    -1,
+    TEXT("How much concurrent use of the offline compiler libraries is safe. Read at the start of every compile.\n")
+    TEXT("-1: detect it with a self-test the first time something is compiled (default)\n")
+    TEXT(" 0: serialize every call\n")
+    TEXT(" 1: different compilers may run at the same time\n")
+    TEXT(" 2: any compiler may run on any number of threads"),
+    ECVF_Default);
+
+/** Number of times each self-test thread compiles the shader */
+static const int32 SelfTestIterations = 4;
+
+/** Shader the self-test compiles. Valid for every driver, as all of them support GLES2 */
+static const ANSICHAR* const SelfTestShader =
+    "#version 100\n"
+    "precision mediump float;\n"
+    "uniform sampler2D Texture;\n"
+    "uniform vec4 Tint;\n"
+    "varying vec2 TexCoord;\n"
+    "void main()\n"
+    "{\n"
+    "    vec4 color = texture2D(Texture, TexCoord) * Tint;\n"
+    "    gl_FragColor = vec4(pow(color.rgb, vec3(1.0 / 2.2)), color.a);\n"
+    "}\n";
+
+/** Taken when the level is Serialized */
+static FCriticalSection GlobalCompilerCriticalSection;
+
+/** Guards CompilerLocks */
+static FCriticalSection CompilerLocksCriticalSection;
+
+/** Taken when the level is Serialized or PerCompiler. One per compiler handle, created on first use and kept until the module unloads */
+static TMap<malicm_compiler, TSharedRef<FCriticalSection, ESPMode::ThreadSafe>> CompilerLocks;
+
+/** Level found by the self-test */
+static FThreadSafeCounter DetectedReentrancy((int32)EMaliOCCompilerReentrancy::Serialized);
+
+/** Compilers the self-test ran, which are the only ones DetectedReentrancy is known to hold for. Guarded by CompilerLocksCriticalSection */
+static TSet<malicm_compiler> TestedCompilers;
+
+const TCHAR* GetCompilerReentrancyName(EMaliOCCompilerReentrancy Reentrancy)
+{
+    switch (Reentrancy)
+    {
+    case EMaliOCCompilerReentrancy::Reentrant:
+        return TEXT("reentrant");
+    case EMaliOCCompilerReentrancy::PerCompiler:
+        return TEXT("per compiler");
+    default:
+        return TEXT("serialized");
+    }
+}
+
+static FCriticalSection* GetCompilerLock(malicm_compiler Compiler)
+{
+    FScopeLock lock(&CompilerLocksCriticalSection);
+
+    const TSharedRef<FCriticalSection, ESPMode::ThreadSafe>* compilerLock = CompilerLocks.Find(Compiler);
+    if (compilerLock == nullptr)
+    {
+        compilerLock = &CompilerLocks.Add(Compiler, MakeShareable(new FCriticalSection));
+    }
+
+    return &compilerLock->Get();
+}
+
+FMaliOCCompilerScopeLock::FMaliOCCompilerScopeLock(const FCompilerManager& CompilerManager, malicm_compiler Compiler)
+{
+    if (CompilerManager.IsIsolated())
+    {
+        return;
+    }
+
+    const EMaliOCCompilerReentrancy reentrancy = FMaliOCCompilerConcurrency::GetReentrancy(Compiler);
+
+    // Serialized callers take the compiler lock as well, so they're still safe from PerCompiler callers if the level goes up while they wait
+    if (reentrancy == EMaliOCCompilerReentrancy::Serialized)
+    {
+        GlobalLock = &GlobalCompilerCriticalSection;
+        GlobalLock->Lock();
+    }
+    if (reentrancy != EMaliOCCompilerReentrancy::Reentrant)
+    {
+        CompilerLock = GetCompilerLock(Compiler);
+        CompilerLock->Lock();
+    }
+}
+
+FMaliOCCompilerScopeLock::~FMaliOCCompilerScopeLock()
+{
+    if (CompilerLock != nullptr)
+    {
+        CompilerLock->Unlock();
+    }
+    if (GlobalLock != nullptr)
+    {
+        GlobalLock->Unlock();
+    }
+}
+
+EMaliOCCompilerReentrancy FMaliOCCompilerConcurrency::GetReentrancy()
+{
+    const int32 configured = CVarCompilerReentrancy.GetValueOnAnyThread();
+    if (configured >= (int32)EMaliOCCompilerReentrancy::Serialized && configured <= (int32)EMaliOCCompilerReentrancy::Reentrant)
+    {
+        return (EMaliOCCompilerReentrancy)configured;
+    }
+
+    return (EMaliOCCompilerReentrancy)DetectedReentrancy.GetValue();
+}
+
+EMaliOCCompilerReentrancy FMaliOCCompilerConcurrency::GetReentrancy(malicm_compiler Compiler)
+{
+    const int32 configured = CVarCompilerReentrancy.GetValueOnAnyThread();
+    const EMaliOCCompilerReentrancy reentrancy = GetReentrancy();
+    if (configured >= (int32)EMaliOCCompilerReentrancy::Serialized || reentrancy != EMaliOCCompilerReentrancy::Reentrant)
+    {
+        return reentrancy;
+    }
+
+    // An untested compiler may be backed by a driver library that was never run on several threads at once
+    FScopeLock lock(&CompilerLocksCriticalSection);
+    return TestedCompilers.Contains(Compiler) ? reentrancy : EMaliOCCompilerReentrancy::PerCompiler;
+}
+
+int32 FMaliOCCompilerConcurrency::GetMaxConcurrentJobs()
+{
+    // Jobs which don't get an isolated copy share the main compiler manager
+    const int32 sharedJobs = GetReentrancy() == EMaliOCCompilerReentrancy::Serialized ? 1 : FMath::Max(FPlatformMisc::NumberOfCores(), 1);
+    return FMath::Max(sharedJobs, 1 + FCompilerManager::GetMaxIsolatedInstances());
+}
+
+/**
+ * Compile the self-test shader
+ * @return a description of everything the compiler returned, or an empty string if it didn't run
+ */
+static FString CompileSelfTestShader(malicm_compiler Compiler)
+{
+    const FCompilerManager* compilerManager = FCompilerManager::Get();
+
+    malioc_outputs outputs;
+    if (!compilerManager->_malicm_compile(&outputs, SelfTestShader, "fragment", nullptr, 0, false, false, nullptr, 0, Compiler))
+    {
+        return FString();
+    }
+
+    FString result = TEXT("Compiled\n");
+    for (unsigned int i = 0; i < outputs.number_of_errors; i++)
+    {
+        result += FString::Printf(TEXT("Error: %s\n"), ANSI_TO_TCHAR(outputs.errors[i]));
+    }
+    for (unsigned int i = 0; i < outputs.number_of_warnings; i++)
+    {
+        result += FString::Printf(TEXT("Warning: %s\n"), ANSI_TO_TCHAR(outputs.warnings[i]));
+    }
+    for (unsigned int i = 0; i < outputs.number_of_flexible_outputs; i++)
+    {
+        const malioc_key_value_pairs& pairs = outputs.flexible_outputs[i];
+        for (unsigned int j = 0; j < pairs.number_of_entries; j++)
+        {
+            result += FString::Printf(TEXT("%u: %s\n"), i, ANSI_TO_TCHAR(pairs.list[j]));
+        }
+    }
+
+    compilerManager->_malicm_release_compiler_outputs(&outputs);
+    return result;
+}
+
+/** Compiles the self-test shader on its own thread, once every thread has been created */
+class FMaliOCSelfTestRunnable final : public FRunnable
+{
+public:
+    FMaliOCSelfTestRunnable(malicm_compiler InCompiler, const FThreadSafeCounter& InStartSignal) :
+        Compiler(InCompiler),
+        StartSignal(InStartSignal)
+    {
+    }
+
+    virtual uint32 Run() override
+    {
+        // Start together so the compiles overlap as much as possible
+        while (StartSignal.GetValue() == 0)
+        {
+            FPlatformProcess::Sleep(0.0f);
+        }
+
+        for (int32 i = 0; i < SelfTestIterations; i++)
+        {
+            Results.Add(CompileSelfTestShader(Compiler));
+        }
+        return 0;
+    }
+
+    const malicm_compiler Compiler;
+    TArray<FString> Results;
+
+private:
+    const FThreadSafeCounter& StartSignal;
+};
+
+/**
+ * Compile the self-test shader concurrently, one thread per entry in ThreadCompilers
+ * @param References what each compiler produced when run on its own
+ * @return true if every thread started and every result matched its compiler's reference
+ */
+static bool RunConcurrentCompiles(const TArray<malicm_compiler>& ThreadCompilers, const TMap<malicm_compiler, FString>& References)
+{
+    FThreadSafeCounter startSignal;
+    TIndirectArray<FMaliOCSelfTestRunnable> runnables;
+    TArray<FRunnableThread*> threads;
+    bool bSucceeded = true;
+
+    for (int32 i = 0; i < ThreadCompilers.Num(); i++)
+    {
+        FMaliOCSelfTestRunnable* runnable = new FMaliOCSelfTestRunnable(ThreadCompilers[i], startSignal);
+        runnables.Add(runnable);
+
+        FRunnableThread* thread = FRunnableThread::Create(runnable, *FString::Printf(TEXT("MaliOCSelfTest %d"), i));
+        if (thread == nullptr)
+        {
+            bSucceeded = false;
+            break;
+        }
+        threads.Add(thread);
+    }
+
+    startSignal.Increment();
+
+    for (int32 i = 0; i < threads.Num(); i++)
+    {
+        threads[i]->WaitForCompletion();
+        delete threads[i];
+
+        const FString& reference = References.FindChecked(runnables[i].Compiler);
+        for (const FString& result : runnables[i].Results)
+        {
+            // Compiler messages are compared exactly
+            bSucceeded &= result.Equals(reference, ESearchCase::CaseSensitive);
+        }
+    }
+
+    return bSucceeded;
+}
+
+bool FMaliOCCompilerConcurrency::RunSelfTest(const TArray<malicm_compiler>& Compilers, int32 NumThreads, EMaliOCCompilerReentrancy& OutReentrancy)
+{
+    FScopeLock lock(&GlobalCompilerCriticalSection);
+
+    OutReentrancy = EMaliOCCompilerReentrancy::Serialized;
+
+    TArray<malicm_compiler> compilers;
+    TMap<malicm_compiler, FString> references;
+    for (malicm_compiler compiler : Compilers)
+    {
+        if (references.Contains(compiler))
+        {
+            continue;
+        }
+
+        FString reference = CompileSelfTestShader(compiler);
+        if (reference.IsEmpty())
+        {
+            return false;
+        }
+
+        compilers.Add(compiler);
+        references.Add(compiler, MoveTemp(reference));
+    }
+
+    if (compilers.Num() == 0 || NumThreads < 2)
+    {
+        return compilers.Num() > 0;
+    }
+
+    // Different compilers at once, NumThreads at a time, until every compiler has run alongside others.
+    // The last group is filled up from the start of the list, so no compiler runs alone. With a single compiler this is no different from Serialized, so go straight to the next test
+    if (compilers.Num() > 1)
+    {
+        for (int32 first = 0; first < compilers.Num(); first += NumThreads)
+        {
+            TArray<malicm_compiler> threadCompilers;
+            for (int32 i = 0; i < FMath::Min(NumThreads, compilers.Num()); i++)
+            {
+                threadCompilers.Add(compilers[(first + i) % compilers.Num()]);
+            }
+
+            if (!RunConcurrentCompiles(threadCompilers, references))
+            {
+                return true;
+            }
+        }
+        OutReentrancy = EMaliOCCompilerReentrancy::PerCompiler;
+    }
+
+    // Each compiler on every thread
+    for (malicm_compiler compiler : compilers)
+    {
+        TArray<malicm_compiler> threadCompilers;
+        threadCompilers.Init(compiler, NumThreads);
+        if (!RunConcurrentCompiles(threadCompilers, references))
+        {
+            return true;
+        }
+    }
+    OutReentrancy = EMaliOCCompilerReentrancy::Reentrant;
+
+    return true;
+}
+
+/** Runs the self-test on a worker thread, so the first job doesn't have to wait for it */
+class FMaliOCReentrancyDetectionTask final : public FNonAbandonableTask
+{
+public:
+    FMaliOCReentrancyDetectionTask(const TArray<const FMaliDriver*>& InDrivers) :
+        Drivers(InDrivers)
+    {
+    }
+
+    void DoWork()
+    {
+        if (!FAsyncCompiler::LoadCompilerLibraries(true))
+        {
+            return;
+        }
+
+        TArray<malicm_compiler> compilers;
+        for (const FMaliDriver* driver : Drivers)
+        {
+            malicm_compiler compiler;
+            if (driver->GetCompiler(compiler))
+            {
+                compilers.Add(compiler);
+            }
+        }
+
+        EMaliOCCompilerReentrancy reentrancy;
+        if (!FMaliOCCompilerConcurrency::RunSelfTest(compilers, FMath::Clamp(FPlatformMisc::NumberOfCores(), 2, 8), reentrancy))
+        {
+            UE_LOG(MaliOfflineCompiler, Warning, TEXT("The compiler self-test couldn't compile its shader, so compiles will be serialized"));
+            return;
+        }
+
+        UE_LOG(MaliOfflineCompiler, Log, TEXT("Compiler self-test passed at the %s level"), GetCompilerReentrancyName(reentrancy));
+        {
+            FScopeLock lock(&CompilerLocksCriticalSection);
+            for (malicm_compiler compiler : compilers)
+            {
+                TestedCompilers.Add(compiler);
+            }
+        }
+        DetectedReentrancy.Set((int32)reentrancy);
+    }
+
+    TStatId GetStatId() const
+    {
+        RETURN_QUICK_DECLARE_CYCLE_STAT(FMaliOCReentrancyDetectionTask, STATGROUP_ThreadPoolAsyncTasks);
+    }
+
+private:
+    const TArray<const FMaliDriver*> Drivers;
+};
+
+/** The self-test, once it has been started */
+static TUniquePtr<FAsyncTask<FMaliOCReentrancyDetectionTask>> DetectionTask;
+
+void FMaliOCCompilerConcurrency::BeginDetection(const TArray<const FMaliPlatform*>& Platforms)
+{
+    check(IsInGameThread());
+
+    if (DetectionTask.IsValid() || CVarCompilerReentrancy.GetValueOnGameThread() >= 0)
+    {
+        return;
+    }
+
+    // The self-test only needs one compiler per driver
+    TArray<const FMaliDriver*> drivers;
+    for (const FMaliPlatform* platform : Platforms)
+    {
+        drivers.AddUnique(&platform->GetDriver());
+    }
+
+    DetectionTask.Reset(new FAsyncTask<FMaliOCReentrancyDetectionTask>(drivers));
+    DetectionTask->StartBackgroundTask();
+}
+
+void FMaliOCCompilerConcurrency::Deinitialize()
+{
+    if (DetectionTask.IsValid())
+    {
+        DetectionTask->EnsureCompletion();
+        DetectionTask.Reset();
+    }
+
+    // Handles may be reused if the libraries are loaded again
+    FScopeLock lock(&CompilerLocksCriticalSection);
+    CompilerLocks.Empty();
+    TestedCompilers.Empty();
+    DetectedReentrancy.Set((int32)EMaliOCCompilerReentrancy::Serialized);
+}
@@ -0,0 +1,96 @@
+/*
+* Copyright 2015 ARM Limited
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#pragma once
+#include "MaliOCPrivatePCH.h"
+#include "MaliOCCompilerManager.h"
+
+class FMaliPlatform;
+
+/** How much concurrent use of the compiler libraries is safe. Each level allows everything the levels below it do */
+enum class EMaliOCCompilerReentrancy : int32
+{
+    /** Only one call into the compiler libraries at a time */
+    Serialized = 0,
+    /** Different compilers can be used at the same time, but each compiler by only one thread at a time */
+    PerCompiler = 1,
+    /** Any compiler can be used by any number of threads at the same time */
+    Reentrant = 2,
+};
+
+/** @return the name of the reentrancy level, for logging */
+const TCHAR* GetCompilerReentrancyName(EMaliOCCompilerReentrancy Reentrancy);
+
+/**
+ * Decides how many compiles may run at once.
+ * The compiler libraries don't document whether they're thread safe, so unless MaliOC.CompilerReentrancy says otherwise,
+ * every call is serialized until a self-test has shown that concurrent compiles give the same results as serial ones.
+ */
+class FMaliOCCompilerConcurrency
+{
+public:
+    /** Thread safe. @return the reentrancy level to lock for. Serialized until detection has finished, unless MaliOC.CompilerReentrancy sets it */
+    static EMaliOCCompilerReentrancy GetReentrancy();
+
+    /**
+     * Thread safe. A detected level only holds for the compilers the self-test ran, so any other is never given more than PerCompiler.
+     * @return the reentrancy level to lock for when using one compiler
+     */
+    static EMaliOCCompilerReentrancy GetReentrancy(malicm_compiler Compiler);
+
+    /** Thread safe. @return the number of compile jobs that may run at once, including the ones that get an isolated copy of the compiler manager */
+    static int32 GetMaxConcurrentJobs();
+
+    /**
+     * Game thread only. Start running the self-test on a worker thread, unless it has already been started or MaliOC.CompilerReentrancy sets the level.
+     * @param Platforms platforms whose drivers' compilers the self-test may use
+     */
+    static void BeginDetection(const TArray<const FMaliPlatform*>& Platforms);
+
+    /** Wait for the self-test, if it's running. Must be called before the compiler libraries are released */
+    static void Deinitialize();
+
+    /**
+     * Compile the same shader from several threads at once, and compare every result with the one compiled on its own.
+     * Different compilers are tried first, until every compiler has run alongside others, then each compiler in turn shared by every thread.
+     * Compilers may be backed by different driver libraries, so a level is only reached if every compiler passes it.
+     * Takes the global compiler lock, so it must only be called while the level is Serialized or nothing else is compiling.
+     * @param Compilers the compilers to test. Duplicates are ignored
+     * @param NumThreads number of threads to compile from
+     * @param OutReentrancy the highest level at which every result matched
+     * @return false if the shader couldn't be compiled at all, in which case nothing was run concurrently and OutReentrancy is Serialized
+     */
+    static bool RunSelfTest(const TArray<malicm_compiler>& Compilers, int32 NumThreads, EMaliOCCompilerReentrancy& OutReentrancy);
+};
+
+/**
+ * Takes whichever locks the current reentrancy level calls for, until it goes out of scope.
+ * Hold one around every call that uses a compiler, including releasing its outputs.
+ * Isolated copies of the compiler manager are only ever used by one thread, so they never need a lock.
+ */
+class FMaliOCCompilerScopeLock final
+{
+public:
+    FMaliOCCompilerScopeLock(const FCompilerManager& CompilerManager, malicm_compiler Compiler);
+    ~FMaliOCCompilerScopeLock();
+
+    FMaliOCCompilerScopeLock(const FMaliOCCompilerScopeLock&) = delete;
+    FMaliOCCompilerScopeLock& operator=(const FMaliOCCompilerScopeLock&) = delete;
+
+private:
+    FCriticalSection* GlobalLock = nullptr;
+    FCriticalSection* CompilerLock = nullptr;
+};
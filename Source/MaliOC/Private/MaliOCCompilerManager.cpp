@@ -16,6 +16,12 @@
 
 #include "MaliOCPrivatePCH.h"
 #include "MaliOCCompilerManager.h"
+#include "MaliOCCompilerConcurrency.h"
+#include "MaliOCCompileTrace.h"
+
+#if PLATFORM_LINUX
+#include <dlfcn.h>
+#endif
 
 static const FString MOC_FTP_URL = TEXT("http://malideveloper.arm.com/downloads/tools/moc/5.3/");
 static const FString EULA_URL = FPaths::Combine(*MOC_FTP_URL, TEXT("EULA.txt"));
@@ -38,13 +44,29 @@ static const FString FULL_COMPILER_PATH = FPaths::Combine(*GetMaliOCPluginFolder
 
 static const FString FULL_DLL_PATH = FPaths::Combine(*FULL_COMPILER_PATH, *DLL_NAME);
 
+static TAutoConsoleVariable<int32> CVarIsolatedCompilers(
+    TEXT("MaliOC.IsolatedCompilers"),
+    0,
+    TEXT("Linux only. Number of extra copies of the offline compiler libraries to load, each into its own linker namespace, so compile jobs can run in parallel even if the libraries aren't reentrant. 0 (default) disables this."),
+    ECVF_Default);
+
+/** glibc has 16 linker namespaces, and the default one is already taken */
+static const int32 MaxLinkerNamespaces = 15;
+
+/** Guards the isolated copies */
+static FCriticalSection IsolatedInstancesCriticalSection;
+/** Every isolated copy that has been loaded */
+static TArray<TSharedPtr<FCompilerManager>> IsolatedInstances;
+/** Isolated copies that nobody holds */
+static TArray<const FCompilerManager*> FreeIsolatedInstances;
+/** Isolated copies that are being loaded, which count towards the limit */
+static int32 NumLoadingIsolatedInstances = 0;
+/** Set if a copy fails to load, so we don't keep trying */
+static bool bHasIsolationFailed = false;
+
 malicm_version FCompilerManager::GetExpectedCompilerManagerVersion()
 {
-    malicm_version version;
-    version.major = 4u;
-    version.minor = 0u;
-    version.patch = 1u;
-    return version;
+    return GetExpectedVersion();
 }
 
 const FString& FCompilerManager::GetFullCompilerPath()
@@ -82,25 +104,22 @@ const FString& FCompilerManager::GetOfflineCompilerFolderToExtract()
     return OFFLINE_COMPILER_FOLDER_TO_EXTRACT;
 }
 
-bool FCompilerManager::Initialize(bool Silent)
+TSharedPtr<FCompilerManager> FCompilerManager::Load(bool bIsolated, bool Silent)
 {
-    // Abort if we're double initialising, as it's probably a symptom of erroneous programming somewhere
-    check(!CompilerManager.IsValid());
-    CompilerManager = MakeShareable(new FCompilerManager);
+    TSharedPtr<FCompilerManager> manager = MakeShareable(new FCompilerManager(bIsolated));
 
-    if (!CompilerManager->bIsValid)
+    if (!manager->bIsValid)
     {
         if (!Silent)
         {
             UE_LOG(MaliOfflineCompiler, Error, TEXT("Failed to load compiler manager DLL"));
         }
-        CompilerManager.Reset();
-        return false;
+        return nullptr;
     }
 
     const FString CompilerPath = GetFullCompilerPath();
 
-    bool success = CompilerManager->_malicm_initialize_libraries(TCHAR_TO_ANSI(*CompilerPath));
+    bool success = manager->_malicm_initialize_libraries(TCHAR_TO_ANSI(*CompilerPath));
 
     if (!success)
     {
@@ -108,33 +127,203 @@ bool FCompilerManager::Initialize(bool Silent)
         {
             UE_LOG(MaliOfflineCompiler, Error, TEXT("Could not initialize compiler libraries"));
         }
-        CompilerManager.Reset();
-        return false;
+        return nullptr;
     }
+    manager->bAreLibrariesInitialized = true;
 
-    malicm_version version;
-    CompilerManager->_malicm_get_manager_version(&version);
-    const malicm_version expectedVersion = GetExpectedCompilerManagerVersion();
-    if (version.major != expectedVersion.major || version.minor != expectedVersion.minor || version.patch != expectedVersion.patch)
+    if (!manager->IsExpectedVersion())
     {
         if (!Silent)
         {
             UE_LOG(MaliOfflineCompiler, Error, TEXT("Compiler manager version is not expected version"));
         }
-        CompilerManager.Reset();
-        return false;
+        return nullptr;
     }
 
-    return true;
+    return manager;
+}
+
+bool FCompilerManager::Initialize(bool Silent)
+{
+    // Abort if we're double initialising, as it's probably a symptom of erroneous programming somewhere
+    check(!CompilerManager.IsValid());
+    CompilerManager = Load(false, Silent);
+    return CompilerManager.IsValid();
 }
 
 void FCompilerManager::Deinitialize()
 {
-    if (CompilerManager.IsValid())
     {
-        CompilerManager->_malicm_release_libraries();
-        CompilerManager.Reset();
+        FScopeLock lock(&IsolatedInstancesCriticalSection);
+        check(NumLoadingIsolatedInstances == 0 && FreeIsolatedInstances.Num() == IsolatedInstances.Num());
+        FreeIsolatedInstances.Empty();
+        IsolatedInstances.Empty();
+        bHasIsolationFailed = false;
+    }
+
+    CompilerManager.Reset();
+}
+
+const FCompilerManager* FCompilerManager::AcquireIsolatedInstance()
+{
+    {
+        FScopeLock lock(&IsolatedInstancesCriticalSection);
+
+        if (FreeIsolatedInstances.Num() > 0)
+        {
+            return FreeIsolatedInstances.Pop();
+        }
+
+        if (bHasIsolationFailed || IsolatedInstances.Num() + NumLoadingIsolatedInstances >= GetMaxIsolatedInstances())
+        {
+            return nullptr;
+        }
+
+        NumLoadingIsolatedInstances++;
+    }
+
+    // Loading initializes every backend library, so don't hold anyone else up while it runs
+    TSharedPtr<FCompilerManager> instance = Load(true, true);
+
+    FScopeLock lock(&IsolatedInstancesCriticalSection);
+    NumLoadingIsolatedInstances--;
+
+    if (!instance.IsValid())
+    {
+        // Usually glibc running out of namespaces or static TLS. Later jobs just share the main compiler manager
+        if (!bHasIsolationFailed)
+        {
+            UE_LOG(MaliOfflineCompiler, Warning, TEXT("Could not load another isolated copy of the compiler libraries (%d are loaded)"), IsolatedInstances.Num());
+            bHasIsolationFailed = true;
+        }
+        return nullptr;
+    }
+
+    IsolatedInstances.Add(instance);
+    return instance.Get();
+}
+
+void FCompilerManager::ReleaseIsolatedInstance(const FCompilerManager* Instance)
+{
+    if (Instance == nullptr || !Instance->IsIsolated())
+    {
+        return;
     }
+
+    FScopeLock lock(&IsolatedInstancesCriticalSection);
+    FreeIsolatedInstances.Add(Instance);
+}
+
+int32 FCompilerManager::GetMaxIsolatedInstances()
+{
+#if PLATFORM_LINUX
+    return FMath::Clamp(CVarIsolatedCompilers.GetValueOnAnyThread(), 0, MaxLinkerNamespaces);
+#else
+    return 0;
+#endif
+}
+
+bool FCompilerManager::FindCompiler(const FString& DriverName, const FString& CoreName, const FString& RevisionName, malicm_compiler& OutCompiler) const
+{
+    malicm_compiler* compilers;
+    unsigned int numCompilers = 0;
+    _malicm_get_compilers(&compilers, &numCompilers, TCHAR_TO_ANSI(*DriverName), TCHAR_TO_ANSI(*CoreName), TCHAR_TO_ANSI(*RevisionName), "openglessl", nullptr, 0);
+
+    const bool bFound = numCompilers > 0;
+    if (bFound)
+    {
+        OutCompiler = compilers[0];
+    }
+
+    _malicm_release_compilers(&compilers, numCompilers);
+    return bFound;
+}
+
+FString FCompilerManager::GetCompilerIdentity(malicm_compiler Compiler) const
+{
+    {
+        FScopeLock lock(&CompilerIdentitiesCriticalSection);
+        const FString* identity = CompilerIdentities.Find(Compiler);
+        if (identity != nullptr)
+        {
+            return *identity;
+        }
+    }
+
+    FString identity;
+    {
+        // Nothing says the name queries are any safer to call concurrently than compiling
+        FMaliOCCompilerScopeLock compilerLock(*this, Compiler);
+        identity = FString::Printf(TEXT("%s %s %s"), ANSI_TO_TCHAR(_malicm_get_core_name(Compiler)), ANSI_TO_TCHAR(_malicm_get_core_revision(Compiler)), ANSI_TO_TCHAR(_malicm_get_driver_name(Compiler)));
+    }
+
+    FScopeLock lock(&CompilerIdentitiesCriticalSection);
+    CompilerIdentities.Add(Compiler, identity);
+    return identity;
+}
+
+void FCompilerManager::CompileBatch(malicm_compiler Compiler, const FMaliOCCompileInput* Inputs, int32 NumInputs, FMaliOCCompileOutputBuffer& OutBuffer) const
+{
+    OutBuffer.Reset();
+
+    // Held for the whole batch, as the trace may be stopped at any time
+    const TSharedPtr<FMaliOCCompileTrace, ESPMode::ThreadSafe> trace = FMaliOCCompileTrace::GetActive();
+    const FString compilerIdentity = trace.IsValid() ? GetCompilerIdentity(Compiler) : FString();
+
+    // When replaying, look up the whole batch first. The compiler is only locked if some of it has to be compiled after all.
+    TArray<const FMaliOCCompileTraceRecord*, TInlineAllocator<16>> replayedRecords;
+    replayedRecords.AddZeroed(NumInputs);
+    bool bAnyToCompile = true;
+    if (trace.IsValid() && trace->IsReplaying())
+    {
+        bAnyToCompile = false;
+        for (int32 i = 0; i < NumInputs; i++)
+        {
+            replayedRecords[i] = trace->Find(compilerIdentity, Inputs[i].ShaderType, Inputs[i].Source);
+            bAnyToCompile = bAnyToCompile || replayedRecords[i] == nullptr;
+        }
+    }
+
+    const auto compileOrReplay = [&](int32 Index)
+    {
+        malioc_outputs outputs;
+        if (replayedRecords[Index] != nullptr)
+        {
+            const bool ran = replayedRecords[Index]->GetOutputs(outputs);
+            OutBuffer.Append(ran, outputs);
+            return;
+        }
+
+        const bool ran = _malicm_compile(&outputs, Inputs[Index].Source, Inputs[Index].ShaderType, nullptr, 0, false, false, nullptr, 0, Compiler);
+
+        OutBuffer.Append(ran, outputs);
+        if (trace.IsValid() && !trace->IsReplaying())
+        {
+            trace->Add(compilerIdentity, Inputs[Index].ShaderType, Inputs[Index].Source, ran, outputs);
+        }
+
+        _malicm_release_compiler_outputs(&outputs);
+    };
+
+    if (bAnyToCompile)
+    {
+        // Other jobs may be compiling at the same time, so hold the lock until the last outputs are released
+        FMaliOCCompilerScopeLock compilerLock(*this, Compiler);
+
+        for (int32 i = 0; i < NumInputs; i++)
+        {
+            compileOrReplay(i);
+        }
+    }
+    else
+    {
+        for (int32 i = 0; i < NumInputs; i++)
+        {
+            compileOrReplay(i);
+        }
+    }
+
+    OutBuffer.FinishBatch();
 }
 
 const FCompilerManager* FCompilerManager::Get()
@@ -153,47 +342,43 @@ TSharedPtr<class FCompilerManager> FCompilerManager::CompilerManager = nullptr;
 
 FCompilerManager::~FCompilerManager()
 {
+    if (bAreLibrariesInitialized)
+    {
+        _malicm_release_libraries();
+    }
+
     if (DLLHandle != nullptr)
     {
         FPlatformProcess::FreeDllHandle(DLLHandle);
     }
 }
 
-FCompilerManager::FCompilerManager()
+FCompilerManager::FCompilerManager(bool bIsolated) :
+    bIsIsolated(bIsolated)
 {
     if (!CompilerManagerDLLExists())
     {
         return;
     }
 
+#if PLATFORM_LINUX
+    // The compiler manager opens its backend libraries with dlopen, which loads them into the caller's namespace, so they're isolated too.
+    // dlsym and dlclose work the same on either kind of handle, so only loading differs.
+    DLLHandle = bIsolated ? dlmopen(LM_ID_NEWLM, TCHAR_TO_UTF8(*GetFullDLLPath()), RTLD_NOW | RTLD_LOCAL) : FPlatformProcess::GetDllHandle(*GetFullDLLPath());
+#else
+    check(!bIsolated);
     DLLHandle = FPlatformProcess::GetDllHandle(*GetFullDLLPath());
+#endif
 
     if (DLLHandle == nullptr)
     {
         return;
     }
 
-    bool allLoadedSuccessfully = true;
-
-#define LOAD_FUNCTION(HANDLE_NAME) _ ## HANDLE_NAME = (decltype(HANDLE_NAME)*)FPlatformProcess::GetDllExport(DLLHandle, TEXT(#HANDLE_NAME)); allLoadedSuccessfully = allLoadedSuccessfully && (( _ ## HANDLE_NAME ) != nullptr);
-
-    LOAD_FUNCTION(malicm_initialize_libraries);
-    LOAD_FUNCTION(malicm_release_libraries);
-    LOAD_FUNCTION(malicm_get_manager_version);
-    LOAD_FUNCTION(malicm_release_compiler_outputs);
-    LOAD_FUNCTION(malicm_get_driver_name);
-    LOAD_FUNCTION(malicm_get_core_name);
-    LOAD_FUNCTION(malicm_get_core_revision);
-    LOAD_FUNCTION(malicm_is_binary_output_supported);
-    LOAD_FUNCTION(malicm_is_prerotate_supported);
-    LOAD_FUNCTION(malicm_get_api_name);
-    LOAD_FUNCTION(malicm_get_highest_api_version);
-    LOAD_FUNCTION(malicm_get_extensions);
-    LOAD_FUNCTION(malicm_get_compilers);
-    LOAD_FUNCTION(malicm_release_compilers);
-    LOAD_FUNCTION(malicm_compile);
-
-#undef LOAD_FUNCTION
+    const bool allLoadedSuccessfully = LoadFunctions([this](const char* Name)
+    {
+        return FPlatformProcess::GetDllExport(DLLHandle, ANSI_TO_TCHAR(Name));
+    });
 
     if (!allLoadedSuccessfully)
     {
@@ -202,3 +387,90 @@ FCompilerManager::FCompilerManager()
 
     bIsValid = true;
 }
+
+bool FMaliOCCompileOutputBuffer::GetOutputs(int32 Index, malioc_outputs& OutOutputs) const
+{
+    FMemory::Memzero(OutOutputs);
+
+    const FEntry& entry = Entries[Index];
+    if (!entry.bCompilerRan)
+    {
+        return false;
+    }
+
+    // The compiler's outputs aren't const, but nothing writes through them
+    char** const strings = const_cast<char**>(StringPointers.GetData());
+
+    OutOutputs.number_of_errors = entry.NumErrors;
+    OutOutputs.errors = strings + entry.FirstError;
+    OutOutputs.number_of_warnings = entry.NumWarnings;
+    OutOutputs.warnings = strings + entry.FirstWarning;
+    OutOutputs.number_of_flexible_outputs = entry.NumFlexibleOutputs;
+    OutOutputs.flexible_outputs = const_cast<malioc_key_value_pairs*>(FlexibleOutputs.GetData()) + entry.FirstFlexibleOutput;
+    return true;
+}
+
+void FMaliOCCompileOutputBuffer::Reset()
+{
+    Entries.Reset();
+    Strings.Reset();
+    StringOffsets.Reset();
+    StringPointers.Reset();
+    FlexibleOutputs.Reset();
+    FlexibleOutputFirstStrings.Reset();
+}
+
+void FMaliOCCompileOutputBuffer::Append(bool bCompilerRan, const malioc_outputs& Outputs)
+{
+    FEntry entry;
+    FMemory::Memzero(entry);
+    entry.bCompilerRan = bCompilerRan;
+
+    if (bCompilerRan)
+    {
+        entry.FirstError = AddStrings(Outputs.errors, Outputs.number_of_errors);
+        entry.NumErrors = Outputs.number_of_errors;
+        entry.FirstWarning = AddStrings(Outputs.warnings, Outputs.number_of_warnings);
+        entry.NumWarnings = Outputs.number_of_warnings;
+        entry.FirstFlexibleOutput = FlexibleOutputs.Num();
+        entry.NumFlexibleOutputs = Outputs.number_of_flexible_outputs;
+
+        for (unsigned int i = 0; i < Outputs.number_of_flexible_outputs; i++)
+        {
+            const malioc_key_value_pairs& pairs = Outputs.flexible_outputs[i];
+            FlexibleOutputFirstStrings.Add(AddStrings(pairs.list, pairs.number_of_entries));
+
+            malioc_key_value_pairs copy;
+            copy.number_of_entries = pairs.number_of_entries;
+            copy.list = nullptr;
+            FlexibleOutputs.Add(copy);
+        }
+    }
+
+    Entries.Add(entry);
+}
+
+void FMaliOCCompileOutputBuffer::FinishBatch()
+{
+    StringPointers.Reset(StringOffsets.Num());
+    for (int32 offset : StringOffsets)
+    {
+        StringPointers.Add(Strings.GetData() + offset);
+    }
+
+    for (int32 i = 0; i < FlexibleOutputs.Num(); i++)
+    {
+        FlexibleOutputs[i].list = StringPointers.GetData() + FlexibleOutputFirstStrings[i];
+    }
+}
+
+int32 FMaliOCCompileOutputBuffer::AddStrings(const char* const* List, uint32 Num)
+{
+    const int32 first = StringOffsets.Num();
+    for (uint32 i = 0; i < Num; i++)
+    {
+        StringOffsets.Add(Strings.Num());
+        Strings.Append(List[i], FCStringAnsi::Strlen(List[i]) + 1);
+    }
+    return first;
+}
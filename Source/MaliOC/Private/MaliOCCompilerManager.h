@@ -17,8 +17,86 @@
 #pragma once
 #include "MaliOCPrivatePCH.h"
 #include "compiler_manager/compiler_manager.h"
+#include "Core/MaliOCCompilerFunctions.h"
 
-class FCompilerManager final
+/** One shader for FCompilerManager::CompileBatch() */
+struct FMaliOCCompileInput
+{
+    /** Null terminated GLSL. Must stay valid until the batch has been compiled */
+    const ANSICHAR* Source;
+    /** The compiler's name for the shader type, e.g. "vertex", "fragment" or "compute" */
+    const char* ShaderType;
+};
+
+/**
+ * The outputs of every shader in a batch, copied out of the compiler so that its own outputs can be released straight away.
+ * Keep one buffer for every batch a job compiles: each batch empties it without freeing its memory.
+ */
+class FMaliOCCompileOutputBuffer final
+{
+public:
+    /** @return the number of shaders in the last batch */
+    int32 Num() const
+    {
+        return Entries.Num();
+    }
+
+    /**
+     * Get the outputs of one shader in the last batch, in the same form the compiler returns them.
+     * They point into this buffer, so they're only valid until the next batch, and must not be given to _malicm_release_compiler_outputs.
+     * @return true if the compiler ran. If it didn't, OutOutputs is empty
+     */
+    bool GetOutputs(int32 Index, malioc_outputs& OutOutputs) const;
+
+private:
+    friend class FCompilerManager;
+
+    /** Forget the last batch, keeping the memory */
+    void Reset();
+
+    /** Copy the outputs of the next shader in the batch */
+    void Append(bool bCompilerRan, const malioc_outputs& Outputs);
+
+    /** Point the output lists at the copied strings, once the batch has finished and Strings won't be reallocated again */
+    void FinishBatch();
+
+    /** Copy a list of strings, and return the index of the first one in StringOffsets */
+    int32 AddStrings(const char* const* List, uint32 Num);
+
+    /** Where one shader's outputs are in the buffer */
+    struct FEntry
+    {
+        bool bCompilerRan;
+        /** Indices into StringOffsets */
+        int32 FirstError;
+        uint32 NumErrors;
+        int32 FirstWarning;
+        uint32 NumWarnings;
+        /** Index into FlexibleOutputs */
+        int32 FirstFlexibleOutput;
+        uint32 NumFlexibleOutputs;
+    };
+
+    TArray<FEntry> Entries;
+
+    /** Every copied string, each null terminated */
+    TArray<ANSICHAR> Strings;
+
+    /** Offset of each copied string in Strings */
+    TArray<int32> StringOffsets;
+
+    /** Each copied string, once the batch has finished. Indices match StringOffsets */
+    TArray<char*> StringPointers;
+
+    /** Each flexible output. number_of_entries is set as it's copied, but list only once the batch has finished */
+    TArray<malioc_key_value_pairs> FlexibleOutputs;
+
+    /** Index into StringOffsets of each flexible output's first entry */
+    TArray<int32> FlexibleOutputFirstStrings;
+};
+
+/** The compiler manager library, with its functions in the members inherited from FMaliOCCompilerFunctions */
+class FCompilerManager final : public FMaliOCCompilerFunctions
 {
     // Static interface
 public:
@@ -35,7 +113,10 @@ public:
      */
     static void Deinitialize();
 
-    /* @return a valid pointer to the compiler manager if init success, else nullptr */
+    /*
+     * The async compiler initializes the compiler manager on a worker thread, so only rely on this once FAsyncCompiler::Get() is non-null.
+     * @return a valid pointer to the compiler manager if init success, else nullptr
+     */
     static const FCompilerManager* Get();
 
     /** Expected compiler manager version */
@@ -65,27 +146,54 @@ public:
     /** @return the folder to extract from the Offline Compiler download */
     static const FString& GetOfflineCompilerFolderToExtract();
 
+    /**
+     * Thread safe. Take a copy of the compiler manager that was loaded into its own linker namespace, loading a new one if MaliOC.IsolatedCompilers allows.
+     * A copy shares no state with the main compiler manager or with any other copy, so its owner can compile with it without taking any locks.
+     * Only supported on Linux. Get() must be valid.
+     * @return the copy, or nullptr if there's no copy free and no more can be loaded
+     */
+    static const FCompilerManager* AcquireIsolatedInstance();
+
+    /** Thread safe. Give back a copy returned by AcquireIsolatedInstance() */
+    static void ReleaseIsolatedInstance(const FCompilerManager* Instance);
+
+    /** Thread safe. @return the number of isolated copies that may be loaded. Always 0 on platforms other than Linux */
+    static int32 GetMaxIsolatedInstances();
+
 private:
     /** Compiler Manager singleton */
     static TSharedPtr<class FCompilerManager> CompilerManager;
 
+    /** Load the libraries of a new compiler manager and check its version. Shared by the singleton and isolated copies */
+    static TSharedPtr<class FCompilerManager> Load(bool bIsolated, bool Silent);
+
     // Instance interface
 public:
-    decltype(malicm_initialize_libraries)* _malicm_initialize_libraries = nullptr;
-    decltype(malicm_release_libraries)* _malicm_release_libraries = nullptr;
-    decltype(malicm_get_manager_version)* _malicm_get_manager_version = nullptr;
-    decltype(malicm_release_compiler_outputs)* _malicm_release_compiler_outputs = nullptr;
-    decltype(malicm_get_driver_name)* _malicm_get_driver_name = nullptr;
-    decltype(malicm_get_core_name)* _malicm_get_core_name = nullptr;
-    decltype(malicm_get_core_revision)* _malicm_get_core_revision = nullptr;
-    decltype(malicm_is_binary_output_supported)* _malicm_is_binary_output_supported = nullptr;
-    decltype(malicm_is_prerotate_supported)* _malicm_is_prerotate_supported = nullptr;
-    decltype(malicm_get_api_name)* _malicm_get_api_name = nullptr;
-    decltype(malicm_get_highest_api_version)* _malicm_get_highest_api_version = nullptr;
-    decltype(malicm_get_extensions)* _malicm_get_extensions = nullptr;
-    decltype(malicm_get_compilers)* _malicm_get_compilers = nullptr;
-    decltype(malicm_release_compilers)* _malicm_release_compilers = nullptr;
-    decltype(malicm_compile)* _malicm_compile = nullptr;
+    /**
+     * Look up a compiler by name. Compiler handles aren't shared between copies of the compiler manager, so each copy has to look its own up.
+     * @return true if this compiler manager has the compiler
+     */
+    bool FindCompiler(const FString& DriverName, const FString& CoreName, const FString& RevisionName, malicm_compiler& OutCompiler) const;
+
+    /**
+     * Compile several shaders with one compiler, under a single FMaliOCCompilerScopeLock.
+     * The compiler libraries only take one shader per call, but batching keeps one compiler busy for a whole batch rather than trading the lock with other jobs after every shader.
+     * Each shader's outputs are copied into OutBuffer and released before the next shader is compiled.
+     * If a compile trace is active, every compile is recorded to it, or served from it without taking the lock if all of the batch is in the trace.
+     * @param Inputs the shaders to compile
+     * @param NumInputs number of shaders in Inputs
+     * @param OutBuffer emptied, then given the outputs of each shader in the same order as Inputs
+     */
+    void CompileBatch(malicm_compiler Compiler, const FMaliOCCompileInput* Inputs, int32 NumInputs, FMaliOCCompileOutputBuffer& OutBuffer) const;
+
+    /** Thread safe. @return the compiler's core, revision and driver names, which identify it across sessions and copies of the compiler manager */
+    FString GetCompilerIdentity(malicm_compiler Compiler) const;
+
+    /** @return true if this is a copy from AcquireIsolatedInstance() */
+    bool IsIsolated() const
+    {
+        return bIsIsolated;
+    }
 
     ~FCompilerManager();
     FCompilerManager(const FCompilerManager&) = delete;
@@ -94,10 +202,18 @@ public:
     FCompilerManager& operator=(FCompilerManager&&) = delete;
 
 private:
-    FCompilerManager();
+    /** @param bIsolated load the DLL into a new linker namespace rather than the default one */
+    FCompilerManager(bool bIsolated);
 
     /** Whether the compiler manager was successfully initialized */
     bool bIsValid = false;
+    /** Whether the DLL was loaded into a linker namespace of its own */
+    const bool bIsIsolated;
+    /** Whether _malicm_initialize_libraries succeeded, so _malicm_release_libraries needs calling */
+    bool bAreLibrariesInitialized = false;
     /** Handle to the DLL*/
     void* DLLHandle = nullptr;
+    /** Identity of each compiler that has been asked for one. Guarded by CompilerIdentitiesCriticalSection */
+    mutable TMap<malicm_compiler, FString> CompilerIdentities;
+    mutable FCriticalSection CompilerIdentitiesCriticalSection;
 };
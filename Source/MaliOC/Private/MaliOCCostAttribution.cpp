@@ -0,0 +1,297 @@
+/*
+* Copyright 2015 ARM Limited
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include "MaliOCPrivatePCH.h"
+#include "MaliOCCostAttribution.h"
+#include "Materials/MaterialExpressionComment.h"
+#include "Materials/MaterialExpressionConstant.h"
+#include "Materials/MaterialExpressionConstant2Vector.h"
+#include "Materials/MaterialExpressionConstant3Vector.h"
+#include "Materials/MaterialExpressionConstant4Vector.h"
+
+/**
+ * Value that replaces an expression's output in a variant.
+ * Not 0 or 1, so that the compiler can't also optimize away the arithmetic the output fed into, which would be counted against the expression
+ */
+static const float ReplacementConstant = 0.5f;
+
+bool FMaliOCSummaryCycles::FromReport(const FMaliOCReport& Report, FMaliOCSummaryCycles& OutCycles)
+{
+    OutCycles = FMaliOCSummaryCycles();
+
+    if (Report.ErrorList.Num() != 0 || (Report.MidgardSummaryReports.Num() == 0 && Report.UtgardSummaryReports.Num() == 0))
+    {
+        return false;
+    }
+
+    for (const auto& summary : Report.MidgardSummaryReports)
+    {
+        for (const auto& renderTarget : summary->RenderTargets)
+        {
+            OutCycles.Arithmetic += renderTarget.arithmetic_longest_path;
+            OutCycles.LoadStore += renderTarget.load_store_longest_path;
+            OutCycles.Texture += renderTarget.texture_longest_path;
+            OutCycles.Bound += FMath::Max3(renderTarget.arithmetic_longest_path, renderTarget.load_store_longest_path, renderTarget.texture_longest_path);
+        }
+    }
+
+    for (const auto& summary : Report.UtgardSummaryReports)
+    {
+        OutCycles.Arithmetic += summary->MaxNumberOfCycles;
+        OutCycles.Bound += summary->MaxNumberOfCycles;
+    }
+
+    return true;
+}
+
+FMaliOCSummaryCycles FMaliOCSummaryCycles::operator-(const FMaliOCSummaryCycles& Other) const
+{
+    FMaliOCSummaryCycles difference;
+    difference.Arithmetic = Arithmetic - Other.Arithmetic;
+    difference.LoadStore = LoadStore - Other.LoadStore;
+    difference.Texture = Texture - Other.Texture;
+    difference.Bound = Bound - Other.Bound;
+    return difference;
+}
+
+/** @return true if the expression's output can be replaced with a scalar constant, and doing so could make the material any cheaper */
+static bool CanAttributeExpression(UMaterialExpression* Expression)
+{
+    // These cost nothing, or have no outputs
+    if (Expression->IsA<UMaterialExpressionComment>() || Expression->IsA<UMaterialExpressionConstant>() || Expression->IsA<UMaterialExpressionConstant2Vector>() ||
+        Expression->IsA<UMaterialExpressionConstant3Vector>() || Expression->IsA<UMaterialExpressionConstant4Vector>())
+    {
+        return false;
+    }
+
+    const TArray<FExpressionOutput>& outputs = Expression->GetOutputs();
+    if (outputs.Num() == 0)
+    {
+        return false;
+    }
+
+    // A scalar can stand in for any number of components, but not for a texture, a static bool or a set of material attributes
+    for (int32 i = 0; i < outputs.Num(); i++)
+    {
+        if (Expression->IsResultMaterialAttributes(i) || (Expression->GetOutputType(i) & (MCT_Texture | MCT_StaticBool)) != 0)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * Point every input connected to one expression at another instead, including the material's own property inputs
+ * @param To the expression to connect instead. nullptr to only count the connections
+ * @return the number of inputs connected to From
+ */
+static int32 ReplaceExpressionConnections(UMaterial* Material, UMaterialExpression* From, UMaterialExpression* To)
+{
+    int32 numConnections = 0;
+
+    const auto ReplaceInput = [&](FExpressionInput* Input)
+    {
+        if (Input == nullptr || Input->Expression != From)
+        {
+            return;
+        }
+
+        numConnections++;
+        if (To != nullptr)
+        {
+            // The constant is a scalar with a single output, so there's nothing to mask
+            Input->Expression = To;
+            Input->OutputIndex = 0;
+            Input->Mask = 0;
+            Input->MaskR = 0;
+            Input->MaskG = 0;
+            Input->MaskB = 0;
+            Input->MaskA = 0;
+        }
+    };
+
+    for (UMaterialExpression* expression : Material->Expressions)
+    {
+        if (expression == nullptr)
+        {
+            continue;
+        }
+
+        for (FExpressionInput* input : expression->GetInputs())
+        {
+            ReplaceInput(input);
+        }
+    }
+
+    for (int32 property = 0; property < MP_MAX; property++)
+    {
+        ReplaceInput(Material->GetExpressionInputForProperty((EMaterialProperty)property));
+    }
+
+    return numConnections;
+}
+
+FMaliOCCostAttribution::FMaliOCCostAttribution(UMaterial* InMaterial, const FMaliPlatform& MaliPlatform, const FCompileJobOptions& Options, FMaliOCQualityLevelMask QualityLevels) :
+Platform(MaliPlatform),
+JobOptions(Options),
+QualityLevelMask(QualityLevels)
+{
+    check(IsInGameThread());
+    check(InMaterial != nullptr);
+
+    JobOptions.bOnlySummaryShaders = true;
+    JobOptions.bRetainSourceCode = false;
+
+    // The graph can still be edited while the variants compile, so they're all made from this copy rather than from the material.
+    // Duplicating keeps the order of the expressions, so an index into the copy's list is the same expression in the material's.
+    Snapshot = DuplicateObject<UMaterial>(InMaterial, GetTransientPackage());
+    check(Snapshot->Expressions.Num() == InMaterial->Expressions.Num());
+
+    // Expressions which nothing is connected to can't cost anything
+    for (int32 i = 0; i < Snapshot->Expressions.Num(); i++)
+    {
+        UMaterialExpression* expression = Snapshot->Expressions[i];
+        if (expression == nullptr || !CanAttributeExpression(expression) || ReplaceExpressionConnections(Snapshot, expression, nullptr) == 0)
+        {
+            continue;
+        }
+
+        TArray<FString> captions;
+        expression->GetCaption(captions);
+
+        // Costs point at the material's own expressions, which are the ones the user can find in the graph
+        FMaliOCExpressionCost cost;
+        cost.Expression = InMaterial->Expressions[i];
+        cost.Caption = FString::Join(captions, TEXT(" "));
+        Costs.Add(cost);
+        ExpressionIndices.Add(i);
+    }
+
+    // The baseline comes from the snapshot too, so every variant differs from it by exactly one expression.
+    // Duplicated materials get a new state ID, so nobody else will ask for it either
+    BaselineGenerator = MakeShareable(new FAsyncReportGenerator(Snapshot, Platform, JobOptions, QualityLevelMask));
+}
+
+void FMaliOCCostAttribution::BeginVariant(int32 CostIndex)
+{
+    // Duplicated materials get a new state ID, so the variant never shares a shader map with the snapshot.
+    // Nothing edits the snapshot, so the copy's expressions are in the same order
+    UMaterial* variant = DuplicateObject<UMaterial>(Snapshot, GetTransientPackage());
+    check(variant->Expressions.Num() == Snapshot->Expressions.Num());
+
+    UMaterialExpressionConstant* constant = NewObject<UMaterialExpressionConstant>(variant);
+    constant->R = ReplacementConstant;
+    constant->Material = variant;
+    variant->Expressions.Add(constant);
+
+    ReplaceExpressionConnections(variant, variant->Expressions[ExpressionIndices[CostIndex]], constant);
+
+    // Not shared, as nobody else will ever ask for the variant
+    TSharedRef<FAsyncReportGenerator> generator = MakeShareable(new FAsyncReportGenerator(variant, Platform, JobOptions, QualityLevelMask));
+    VariantsInFlight.Add(FVariant{ CostIndex, variant, generator });
+}
+
+void FMaliOCCostAttribution::Tick(float DeltaTime)
+{
+    if (bIsComplete)
+    {
+        return;
+    }
+
+    // Without the unmodified material's cycles, there's nothing to compare the variants with
+    if (BaselineGenerator.IsValid())
+    {
+        if (BaselineGenerator->GetProgress() != FAsyncReportGenerator::EProgress::COMPILATION_COMPLETE)
+        {
+            return;
+        }
+
+        const bool bCompiled = FMaliOCSummaryCycles::FromReport(*BaselineGenerator->GetReport(), BaselineCycles);
+        BaselineGenerator.Reset();
+        NumCompiledVariants++;
+
+        if (!bCompiled)
+        {
+            Errors.Add(TEXT("The material has errors. Fix them, and check that it compiles, before attributing its cost."));
+            Complete();
+            return;
+        }
+    }
+
+    for (int32 i = VariantsInFlight.Num() - 1; i >= 0; i--)
+    {
+        const FVariant& variant = VariantsInFlight[i];
+        if (variant.Generator->GetProgress() != FAsyncReportGenerator::EProgress::COMPILATION_COMPLETE)
+        {
+            continue;
+        }
+
+        FMaliOCExpressionCost& cost = Costs[variant.CostIndex];
+        FMaliOCSummaryCycles variantCycles;
+        cost.bCompiled = FMaliOCSummaryCycles::FromReport(*variant.Generator->GetReport(), variantCycles);
+        if (cost.bCompiled)
+        {
+            cost.Savings = BaselineCycles - variantCycles;
+        }
+
+        // The variant material is garbage collected once it's out of the list
+        VariantsInFlight.RemoveAt(i);
+        NumCompiledVariants++;
+    }
+
+    while (VariantsInFlight.Num() < MaxVariantsInFlight && NextVariant < Costs.Num())
+    {
+        BeginVariant(NextVariant++);
+    }
+
+    if (VariantsInFlight.Num() == 0 && NextVariant == Costs.Num())
+    {
+        Complete();
+    }
+}
+
+void FMaliOCCostAttribution::Complete()
+{
+    Costs.Sort([](const FMaliOCExpressionCost& A, const FMaliOCExpressionCost& B)
+    {
+        if (A.bCompiled != B.bCompiled)
+        {
+            return A.bCompiled;
+        }
+        if (A.Savings.Bound != B.Savings.Bound)
+        {
+            return A.Savings.Bound > B.Savings.Bound;
+        }
+        return (A.Savings.Arithmetic + A.Savings.LoadStore + A.Savings.Texture) > (B.Savings.Arithmetic + B.Savings.LoadStore + B.Savings.Texture);
+    });
+
+    // The indices were only needed to make the variants, and no longer match the sorted costs
+    ExpressionIndices.Empty();
+    VariantsInFlight.Empty();
+    Snapshot = nullptr;
+    bIsComplete = true;
+}
+
+void FMaliOCCostAttribution::AddReferencedObjects(FReferenceCollector& Collector)
+{
+    Collector.AddReferencedObject(Snapshot);
+    for (FVariant& variant : VariantsInFlight)
+    {
+        Collector.AddReferencedObject(variant.Material);
+    }
+}
@@ -0,0 +1,177 @@
+/*
+* Copyright 2015 ARM Limited
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#pragma once
+#include "MaliOCPrivatePCH.h"
+#include "MaliOCAsyncReportGenerator.h"
+
+/** Cycles of a report's summary shaders, added together */
+struct FMaliOCSummaryCycles
+{
+    /** Longest path cycles on each Midgard pipe. Utgard has a single pipe, which counts as arithmetic */
+    float Arithmetic = 0.0f;
+    float LoadStore = 0.0f;
+    float Texture = 0.0f;
+    /** Longest path cycles on each shader's bound pipe, which is what the shader costs as the pipes run in parallel */
+    float Bound = 0.0f;
+
+    /**
+     * Add up the summary shaders of a report
+     * @return false if the report has errors or no summary, in which case OutCycles is zero
+     */
+    static bool FromReport(const FMaliOCReport& Report, FMaliOCSummaryCycles& OutCycles);
+
+    FMaliOCSummaryCycles operator-(const FMaliOCSummaryCycles& Other) const;
+};
+
+/** The cost of one expression in a material graph */
+struct FMaliOCExpressionCost
+{
+    /** The expression, in the material that was attributed. Weak, as the expression may be deleted while the variants compile */
+    TWeakObjectPtr<UMaterialExpression> Expression;
+    /** The expression's caption when the attribution started */
+    FString Caption;
+    /** Cycles saved by replacing the expression's output with a constant. This includes everything upstream of it that nothing else uses */
+    FMaliOCSummaryCycles Savings;
+    /** False if the variant without the expression didn't compile, in which case Savings is zero */
+    bool bCompiled = false;
+};
+
+/**
+ * Attributes the cost of a material to the expressions in its graph.
+ * A variant of the material is made for each expression, with the expression's output replaced by a constant, and the summary shaders of every variant
+ * are compiled, several at once, by report generators. The cycles each variant saves compared to the unmodified material are the expression's cost.
+ */
+class FMaliOCCostAttribution final : private FTickableEditorObject, private FGCObject
+{
+public:
+    /**
+     * Take a copy of the material and start compiling it. Variants are made from the same copy and compiled as it ticks, so editing the graph meanwhile changes nothing
+     * @param Material the non-null material to attribute. Material instances can't change the graph, so only base materials can be attributed
+     * @param Platform the Mali platform to compile for
+     * @param Options options for every compile. Only the summary shaders are ever compiled, and source code is never retained
+     * @param QualityLevels the material quality levels to compile. Cycles are added up over every level
+     */
+    FMaliOCCostAttribution(UMaterial* Material, const FMaliPlatform& Platform, const FCompileJobOptions& Options, FMaliOCQualityLevelMask QualityLevels);
+    ~FMaliOCCostAttribution() = default;
+    FMaliOCCostAttribution(const FMaliOCCostAttribution&) = delete;
+    FMaliOCCostAttribution(FMaliOCCostAttribution&&) = delete;
+    FMaliOCCostAttribution& operator=(const FMaliOCCostAttribution&) = delete;
+    FMaliOCCostAttribution& operator=(FMaliOCCostAttribution&&) = delete;
+
+    /** @return true once every variant has been compiled */
+    bool IsComplete() const
+    {
+        return bIsComplete;
+    }
+
+    /** @return the number of variants whose reports are finished, counting the unmodified material as one */
+    int32 GetNumCompiledVariants() const
+    {
+        return NumCompiledVariants;
+    }
+
+    /** @return the number of variants to compile, counting the unmodified material as one */
+    int32 GetNumVariants() const
+    {
+        return Costs.Num() + 1;
+    }
+
+    /** Only valid once complete. @return the cost of each expression which feeds into the material, most expensive first */
+    const TArray<FMaliOCExpressionCost>& GetCosts() const
+    {
+        check(bIsComplete);
+        return Costs;
+    }
+
+    /** Only valid once complete. @return the cycles of the unmodified material */
+    const FMaliOCSummaryCycles& GetBaselineCycles() const
+    {
+        check(bIsComplete);
+        return BaselineCycles;
+    }
+
+    /** Only valid once complete. @return why the costs couldn't be attributed. Empty if they could */
+    const TArray<FString>& GetErrors() const
+    {
+        check(bIsComplete);
+        return Errors;
+    }
+
+private:
+    /** Number of variants compiled at once. Each one cross compiles and offline compiles on its own, so this bounds the memory used */
+    static const int32 MaxVariantsInFlight = 8;
+
+    /** A variant of the material which is being compiled */
+    struct FVariant
+    {
+        /** Index into Costs */
+        int32 CostIndex;
+        /** The copy of the material with the expression replaced */
+        UMaterial* Material;
+        TSharedRef<FAsyncReportGenerator> Generator;
+    };
+
+    /** Platform we're compiling for */
+    const FMaliPlatform& Platform;
+    /** Options for every compile */
+    FCompileJobOptions JobOptions;
+    /** The quality levels to compile */
+    const FMaliOCQualityLevelMask QualityLevelMask;
+    /** Copy of the material being attributed, taken when the attribution started. The baseline and every variant are compiled from it. Null once complete */
+    UMaterial* Snapshot = nullptr;
+    /** Index in the snapshot's expression list of the expression each cost is for. Parallel to Costs */
+    TArray<int32> ExpressionIndices;
+    /** One entry per expression that feeds into the material */
+    TArray<FMaliOCExpressionCost> Costs;
+    /** Report generator for the unmodified material. Released once its report is read */
+    TSharedPtr<FAsyncReportGenerator> BaselineGenerator;
+    /** Cycles of the unmodified material */
+    FMaliOCSummaryCycles BaselineCycles;
+    /** Variants being compiled */
+    TArray<FVariant> VariantsInFlight;
+    /** Index into Costs of the next variant to make */
+    int32 NextVariant = 0;
+    /** See GetNumCompiledVariants() */
+    int32 NumCompiledVariants = 0;
+    /** See GetErrors() */
+    TArray<FString> Errors;
+    bool bIsComplete = false;
+
+    /** Make a copy of the snapshot with one expression's output replaced by a constant, and start compiling it */
+    void BeginVariant(int32 CostIndex);
+
+    /** Sort the costs and let go of the snapshot */
+    void Complete();
+
+    // FGCObject functions
+
+    virtual void AddReferencedObjects(FReferenceCollector& Collector) override;
+
+    // FTickableEditorObject functions
+
+    virtual bool IsTickable() const override
+    {
+        return !bIsComplete;
+    }
+
+    virtual void Tick(float DeltaTime) override;
+
+    virtual TStatId GetStatId() const override
+    {
+        RETURN_QUICK_DECLARE_CYCLE_STAT(FMaliOCCostAttribution, STATGROUP_Tickables);
+    }
+};
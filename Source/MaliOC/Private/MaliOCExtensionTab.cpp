@@ -42,7 +42,13 @@ public:
         return ExtensionTab.ToSharedRef();
     }
 
-    virtual ~FMaterialEditorTabGeneratorImpl() = default;
+    /** Number of these that exist. Game thread only */
+    static int32 NumLiveTabs;
+
+    virtual ~FMaterialEditorTabGeneratorImpl()
+    {
+        NumLiveTabs--;
+    }
     FMaterialEditorTabGeneratorImpl(const FMaterialEditorTabGeneratorImpl&) = delete;
     FMaterialEditorTabGeneratorImpl(FMaterialEditorTabGeneratorImpl&&) = delete;
     FMaterialEditorTabGeneratorImpl& operator=(const FMaterialEditorTabGeneratorImpl&) = delete;
@@ -84,15 +90,38 @@ private:
     /* Currently selected platform. Will never be null after initialization */
     const FMaliPlatform* SelectedPlatform;
 
+    /* Material quality level selection dropdown menu */
+    TSharedPtr<STextComboBox> QualityDropDown = nullptr;
+    /* Array of quality level names for the quality dropdown menu. Parallel to QualityLevelMasks */
+    TArray<TSharedPtr<FString>> QualityNames;
+    /* The quality levels each entry of the quality dropdown compiles */
+    TArray<FMaliOCQualityLevelMask> QualityLevelMasks;
+    /* Currently selected quality levels */
+    FMaliOCQualityLevelMask SelectedQualityLevels = QualityLevelToMask(EMaterialQualityLevel::High);
+
+    /* Permutation filter text box */
+    TSharedPtr<SEditableTextBox> FilterTextBox = nullptr;
+    /* Permutation filter parsed from the text box */
+    FMaliOCPermutationFilter SelectedFilter;
+    /* False if the text box doesn't hold a valid filter, in which case we refuse to compile */
+    bool bIsFilterValid = true;
+
+    /* True if only a sample of the permutations should be compiled */
+    bool bSamplePermutations = false;
+
     /* Widget slot where the output of the widget generator goes */
     SVerticalBox::FSlot* OutputSlot = nullptr;
 
     /* Report widget generator. Generates the shader report widget from the output of the shader compiler */
     TSharedPtr<FReportWidgetGenerator> WidgetGenerator = nullptr;
 
+    /* Cost attribution widget generator. Only one of this and WidgetGenerator is valid at a time */
+    TSharedPtr<FCostAttributionWidgetGenerator> AttributionWidgetGenerator = nullptr;
+
     FMaterialEditorTabGeneratorImpl(TWeakPtr<IMaterialEditor> Editor)
         : MaterialEditor(Editor)
     {
+        NumLiveTabs++;
     }
 
     BEGIN_SLATE_FUNCTION_BUILD_OPTIMIZATION;
@@ -110,6 +139,7 @@ private:
         UpdateRevisionList();
         UpdateDriverList();
         UpdateAPIList();
+        CreateQualityList();
 
         const auto AreButtonsPressable = [&]() -> bool
         {
@@ -235,20 +265,117 @@ private:
                                     .InitiallySelectedItem(PlatformNames[0])
                                 ]
                         ]
+                    + SVerticalBox::Slot()
+                        .Padding(2.0f, 2.0f)
+                        [
+                            SNew(SHorizontalBox)
+                            + SHorizontalBox::Slot()
+                            .FillWidth(0.35f)
+                            .MaxWidth(70.0f)
+                            .Padding(2.0f, 0.0f)
+                            .VAlign(VAlign_Center)
+                            [
+                                SNew(STextBlock)
+                                .Text(LOCTEXT("QualityDDLabel", "Quality"))
+                                .Font(FMaliOCStyle::GetNormalFontStyle())
+                            ]
+                            + SHorizontalBox::Slot()
+                                .FillWidth(1.0f)
+                                .MaxWidth(200.0f)
+                                .Padding(2.0f, 0.0f)
+                                [
+                                    SAssignNew(QualityDropDown, STextComboBox)
+                                    .OptionsSource(&QualityNames)
+                                    .OnSelectionChanged(this, &FMaterialEditorTabGeneratorImpl::OnQualitySelectionChanged)
+                                    .Font(FMaliOCStyle::GetNormalFontStyle())
+                                    .IsEnabled_Lambda(AreButtonsPressable)
+                                    .InitiallySelectedItem(QualityNames[0])
+                                ]
+                        ]
+                    + SVerticalBox::Slot()
+                        .Padding(2.0f, 2.0f)
+                        [
+                            SNew(SHorizontalBox)
+                            + SHorizontalBox::Slot()
+                            .FillWidth(0.35f)
+                            .MaxWidth(70.0f)
+                            .Padding(2.0f, 0.0f)
+                            .VAlign(VAlign_Center)
+                            [
+                                SNew(STextBlock)
+                                .Text(LOCTEXT("FilterLabel", "Filter"))
+                                .Font(FMaliOCStyle::GetNormalFontStyle())
+                            ]
+                            + SHorizontalBox::Slot()
+                                .FillWidth(1.0f)
+                                .MaxWidth(200.0f)
+                                .Padding(2.0f, 0.0f)
+                                [
+                                    SAssignNew(FilterTextBox, SEditableTextBox)
+                                    .HintText(LOCTEXT("FilterHint", "All permutations"))
+                                    .ToolTipText(LOCTEXT("FilterToolTip", "Only compile some shader permutations. Semicolon separated criteria, with lists separated by |, e.g.\nVertexFactory=FLocalVertexFactory|FInstancedStaticMeshVertexFactory;Frequency=Pixel;Type=TBasePass*"))
+                                    .OnTextCommitted(this, &FMaterialEditorTabGeneratorImpl::OnFilterTextCommitted)
+                                    .Font(FMaliOCStyle::GetNormalFontStyle())
+                                    .IsEnabled_Lambda(AreButtonsPressable)
+                                ]
+                        ]
+                    + SVerticalBox::Slot()
+                        .Padding(2.0f, 2.0f)
+                        [
+                            SNew(SHorizontalBox)
+                            + SHorizontalBox::Slot()
+                            .FillWidth(0.35f)
+                            .MaxWidth(70.0f)
+                            .Padding(2.0f, 0.0f)
+                            .VAlign(VAlign_Center)
+                            [
+                                SNew(STextBlock)
+                                .Text(LOCTEXT("SampleLabel", "Sample"))
+                                .Font(FMaliOCStyle::GetNormalFontStyle())
+                            ]
+                            + SHorizontalBox::Slot()
+                                .AutoWidth()
+                                .Padding(2.0f, 0.0f)
+                                [
+                                    SNew(SCheckBox)
+                                    .ToolTipText(LOCTEXT("SampleToolTip", "Only compile a few permutations of each vertex factory and shader frequency, and estimate the statistics of the rest. The report says whether a full compile is worth doing."))
+                                    .IsChecked_Lambda([this]() { return bSamplePermutations ? ECheckBoxState::Checked : ECheckBoxState::Unchecked; })
+                                    .OnCheckStateChanged_Lambda([this](ECheckBoxState NewState) { bSamplePermutations = NewState == ECheckBoxState::Checked; })
+                                    .IsEnabled_Lambda(AreButtonsPressable)
+                                ]
+                        ]
                 ]
-                // Compile button
+                // Compile and cost attribution buttons
                 + SHorizontalBox::Slot()
                     .AutoWidth()
                     .Padding(2.0f, 2.0f)
                     [
-                        SNew(SButton)
-                        .Text(LOCTEXT("CompileShadersButton", "Compile"))
-                        .ToolTipText(LOCTEXT("CompileShadersButtonToolTip", "Compile all shaders for this material using the selected ARM Mali GPU core, core revision, and driver."))
-                        .ContentPadding(3)
-                        .OnClicked(this, &FMaterialEditorTabGeneratorImpl::BeginReportGenerationAsync)
-                        .VAlign(VAlign_Center)
-                        .HAlign(HAlign_Center)
-                        .IsEnabled_Lambda(AreButtonsPressable)
+                        SNew(SVerticalBox)
+                        + SVerticalBox::Slot()
+                        .AutoHeight()
+                        .Padding(0.0f, 0.0f, 0.0f, 2.0f)
+                        [
+                            SNew(SButton)
+                            .Text(LOCTEXT("CompileShadersButton", "Compile"))
+                            .ToolTipText(LOCTEXT("CompileShadersButtonToolTip", "Compile all shaders for this material using the selected ARM Mali GPU core, core revision, and driver."))
+                            .ContentPadding(3)
+                            .OnClicked(this, &FMaterialEditorTabGeneratorImpl::BeginReportGenerationAsync)
+                            .VAlign(VAlign_Center)
+                            .HAlign(HAlign_Center)
+                            .IsEnabled_Lambda(AreButtonsPressable)
+                        ]
+                        + SVerticalBox::Slot()
+                            .AutoHeight()
+                            [
+                                SNew(SButton)
+                                .Text(LOCTEXT("AttributeCostsButton", "Node Costs"))
+                                .ToolTipText(LOCTEXT("AttributeCostsButtonToolTip", "Rank the nodes of this material by how many cycles of the summary shaders they cost. Compiles a copy of the material for each node, with the node replaced by a constant. Only available in the Material Editor."))
+                                .ContentPadding(3)
+                                .OnClicked(this, &FMaterialEditorTabGeneratorImpl::BeginCostAttribution)
+                                .VAlign(VAlign_Center)
+                                .HAlign(HAlign_Center)
+                                .IsEnabled_Lambda([this, AreButtonsPressable]() { return AreButtonsPressable() && GetEditedMaterial() != nullptr; })
+                            ]
                     ]
             ]
         // Separator
@@ -292,10 +419,28 @@ private:
         auto matint = ME->GetMaterialInterface();
 
         // This should start report creation on a worker thread
-        auto ReportGenerator = MakeShareable(new FAsyncReportGenerator(matint, *SelectedPlatform));
+        // Pick up the filter even if the user clicked compile without committing the text box
+        OnFilterTextCommitted(FilterTextBox->GetText(), ETextCommit::Default);
+        if (!bIsFilterValid)
+        {
+            return FReply::Handled();
+        }
+
+        FCompileJobOptions options;
+        options.Filter = SelectedFilter;
+        if (bSamplePermutations)
+        {
+            // The console variables can ask for bigger samples and set the flagging threshold
+            options.Sampling = FMaliOCSamplingOptions::GetConsoleVariableOptions();
+            options.Sampling.SamplesPerStratum = FMath::Max<uint32>(options.Sampling.SamplesPerStratum, FMaliOCSamplingOptions::DefaultSamplesPerStratum);
+        }
+
+        // Another material editor may already be compiling the same material for the same platform, in which case we share its work
+        auto ReportGenerator = FAsyncReportGenerator::FindOrCreate(matint, *SelectedPlatform, options, SelectedQualityLevels);
 
         // Wrap up the report generator in an object that takes the report and generates us a nice widget to display
         WidgetGenerator = MakeShareable(new FReportWidgetGenerator(ReportGenerator));
+        AttributionWidgetGenerator.Reset();
 
         // The report won't be ready yet so the widget generator should show us its throbber
         OutputSlot->AttachWidget(WidgetGenerator->GetWidget());
@@ -303,6 +448,41 @@ private:
         return FReply::Handled();
     }
 
+    /* @return the material being edited, or nullptr if this is a Material Instance Editor. Instances can't change the graph, so their costs can't be attributed */
+    UMaterial* GetEditedMaterial() const
+    {
+        auto ME = MaterialEditor.Pin();
+        return ME.IsValid() ? Cast<UMaterial>(ME->GetMaterialInterface()) : nullptr;
+    }
+
+    /* Start compiling a variant of the material for each node when the user clicks Node Costs */
+    FReply BeginCostAttribution()
+    {
+        UMaterial* material = GetEditedMaterial();
+        if (IsCompilationInProgress() || material == nullptr)
+        {
+            return FReply::Handled();
+        }
+
+        OnFilterTextCommitted(FilterTextBox->GetText(), ETextCommit::Default);
+        if (!bIsFilterValid)
+        {
+            return FReply::Handled();
+        }
+
+        // Only the summary shaders are compiled, so sampling doesn't apply
+        FCompileJobOptions options;
+        options.Filter = SelectedFilter;
+
+        TSharedRef<FMaliOCCostAttribution> attribution = MakeShareable(new FMaliOCCostAttribution(material, *SelectedPlatform, options, SelectedQualityLevels));
+        AttributionWidgetGenerator = MakeShareable(new FCostAttributionWidgetGenerator(attribution));
+        WidgetGenerator.Reset();
+
+        OutputSlot->AttachWidget(AttributionWidgetGenerator->GetWidget());
+
+        return FReply::Handled();
+    }
+
     /* Check the currently selected core and update the set of revisions and currently selected revision */
     void UpdateRevisionList()
     {
@@ -339,6 +519,23 @@ private:
         SelectedPlatform = &platforms[0].Get();
     }
 
+    /* Create the set of quality level choices. The list never changes */
+    void CreateQualityList()
+    {
+        const auto AddQualityChoice = [&](const TCHAR* Name, FMaliOCQualityLevelMask Levels)
+        {
+            QualityNames.Add(MakeShareable(new FString(Name)));
+            QualityLevelMasks.Add(Levels);
+        };
+
+        AddQualityChoice(TEXT("High"), QualityLevelToMask(EMaterialQualityLevel::High));
+        AddQualityChoice(TEXT("Medium"), QualityLevelToMask(EMaterialQualityLevel::Medium));
+        AddQualityChoice(TEXT("Low"), QualityLevelToMask(EMaterialQualityLevel::Low));
+        AddQualityChoice(TEXT("All Quality Levels"), QualityLevelToMask(EMaterialQualityLevel::High) | QualityLevelToMask(EMaterialQualityLevel::Medium) | QualityLevelToMask(EMaterialQualityLevel::Low));
+
+        SelectedQualityLevels = QualityLevelMasks[0];
+    }
+
     /* Update the content of the revision dropdown */
     void UpdateRevisionDropDown()
     {
@@ -374,20 +571,8 @@ private:
         }
 
         // Validate that the user made a physically possible selection
-        bool found = false;
-
-        const auto& cores = FAsyncCompiler::Get()->GetCores();
-        for (const auto& core : cores)
-        {
-            if (core->GetName().Equals(*selectedCoreName))
-            {
-                SelectedCore = &core.Get();
-                found = true;
-                break;
-            }
-        }
-
-        check(found);
+        SelectedCore = FAsyncCompiler::Get()->FindCore(*selectedCoreName);
+        check(SelectedCore != nullptr);
 
         // Update dependent dropdowns
         UpdateRevisionDropDown();
@@ -405,20 +590,8 @@ private:
         }
 
         // Validate that the user made a physically possible selection
-        bool found = false;
-
-        const auto& revisions = SelectedCore->GetRevisions();
-        for (const auto& revision : revisions)
-        {
-            if (revision->GetName().Equals(*selectedRevName))
-            {
-                SelectedRev = &revision.Get();
-                found = true;
-                break;
-            }
-        }
-
-        check(found);
+        SelectedRev = SelectedCore->FindRevision(*selectedRevName);
+        check(SelectedRev != nullptr);
 
         // Update dependent dropdowns
         UpdateDriverDropDown();
@@ -435,19 +608,8 @@ private:
         }
 
         // Validate that the user made a physically possible selection
-        bool found = false;
-
-        const auto& drivers = SelectedRev->GetDrivers();
-        for (const auto& driver : drivers)
-        {
-            if (driver->GetName().Equals(*selectedDriverName))
-            {
-                SelectedDriver = &driver.Get();
-                found = true;
-                break;
-            }
-        }
-        check(found);
+        SelectedDriver = SelectedRev->FindDriver(*selectedDriverName);
+        check(SelectedDriver != nullptr);
 
         // Update dependent dropdowns
         UpdatePlatformDropDown();
@@ -463,25 +625,31 @@ private:
         }
 
         // Validate that the user made a physically possible selection
-        bool found = false;
+        SelectedPlatform = SelectedDriver->FindPlatform(*SelectedPlatformName);
+        check(SelectedPlatform != nullptr);
+    }
 
-        const auto& platforms = SelectedDriver->GetPlatforms();
-        for (const auto& pla : platforms)
-        {
-            if (pla->GetName().Equals(*SelectedPlatformName))
-            {
-                SelectedPlatform = &pla.Get();
-                found = true;
-                break;
-            }
-        }
-        check(found);
+    /* Callback when the user changes the selected quality levels */
+    void OnQualitySelectionChanged(TSharedPtr<FString> SelectedQualityName, ESelectInfo::Type InSelectionInfo)
+    {
+        const int32 index = QualityNames.Find(SelectedQualityName);
+        check(index != INDEX_NONE);
+        SelectedQualityLevels = QualityLevelMasks[index];
+    }
+
+    /* Callback when the user edits the permutation filter */
+    void OnFilterTextCommitted(const FText& FilterText, ETextCommit::Type CommitType)
+    {
+        FString error;
+        bIsFilterValid = FMaliOCPermutationFilter::Parse(FilterText.ToString(), SelectedFilter, error);
+        FilterTextBox->SetError(bIsFilterValid ? FText::GetEmpty() : FText::FromString(error));
     }
 
-    /* Return true if compilation is currently in progress */
+    /* Return true if compilation (or cost attribution) is currently in progress */
     bool IsCompilationInProgress() const
     {
-        return WidgetGenerator.IsValid() && (WidgetGenerator->IsCompilationComplete() != true);
+        return (WidgetGenerator.IsValid() && (WidgetGenerator->IsCompilationComplete() != true)) ||
+            (AttributionWidgetGenerator.IsValid() && (AttributionWidgetGenerator->IsAttributionComplete() != true));
     }
 
     virtual bool IsTickable() const override
@@ -497,6 +665,10 @@ private:
         {
             OutputSlot->AttachWidget(WidgetGenerator->GetWidget());
         }
+        else if (AttributionWidgetGenerator.IsValid())
+        {
+            OutputSlot->AttachWidget(AttributionWidgetGenerator->GetWidget());
+        }
     }
 
     virtual TStatId GetStatId() const override
@@ -505,8 +677,8 @@ private:
     }
 };
 
-/* Wrapper around the Material Editor tab generator. Used to prompt the user to download the compiler manager. Once the compiler manager has been downloaded, will automatically replace itself with the material editor tab generator.*/
-class FMaterialEditorTabGeneratorImplWrapper final : public ITabGenerator, public TSharedFromThis<FMaterialEditorTabGeneratorImplWrapper>, private FTickableEditorObject
+/* Wrapper around the Material Editor tab generator. Shows a loading message while the compilers are enumerated in the background, and prompts the user to download the compiler manager if there isn't one. Once the compiler manager has loaded, will automatically replace itself with the material editor tab generator.*/
+class FMaterialEditorTabGeneratorImplWrapper final : public ITabGenerator, public TSharedFromThis<FMaterialEditorTabGeneratorImplWrapper>
 {
 public:
     static TSharedRef<ITabGenerator> create(TSharedRef<IMaterialEditor> Editor)
@@ -514,6 +686,15 @@ public:
         TSharedRef<FMaterialEditorTabGeneratorImplWrapper> generator(new FMaterialEditorTabGeneratorImplWrapper(Editor));
         generator->InitializeWidgets();
 
+        // Every waiting tab is woken by the same event, so none of them need to poll
+        FAsyncCompiler::OnInitializationFinished().AddSP(generator, &FMaterialEditorTabGeneratorImplWrapper::OnInitializationFinished);
+
+        // Initialization may have finished while the widgets were being made, before we were listening
+        if (!FAsyncCompiler::IsInitializing() && FAsyncCompiler::Get() != nullptr)
+        {
+            generator->OnInitializationFinished(true);
+        }
+
         return generator;
     }
 
@@ -522,7 +703,11 @@ public:
         return ExtensionTab.ToSharedRef();
     }
 
-    virtual ~FMaterialEditorTabGeneratorImplWrapper() = default;
+    virtual ~FMaterialEditorTabGeneratorImplWrapper()
+    {
+        FAsyncCompiler::OnInitializationFinished().RemoveAll(this);
+    }
+
     FMaterialEditorTabGeneratorImplWrapper(const FMaterialEditorTabGeneratorImplWrapper&) = delete;
     FMaterialEditorTabGeneratorImplWrapper(FMaterialEditorTabGeneratorImplWrapper&&) = delete;
     FMaterialEditorTabGeneratorImplWrapper& operator=(const FMaterialEditorTabGeneratorImplWrapper&) = delete;
@@ -538,12 +723,12 @@ private:
     TWeakPtr<IMaterialEditor> MaterialEditor;
     /* The content of the tab in the material editor */
     TSharedPtr<SHorizontalBox> ExtensionTab;
+    /* Instructions for downloading the compiler manager. Only shown once we know it couldn't be loaded */
+    TSharedPtr<SWidget> DownloadPrompt;
+    /* True once the download prompt has replaced the loading message */
+    bool bIsShowingDownloadPrompt = false;
     /* Tab Generator we're a wrapper around. Will be null until conditions are met */
     TSharedPtr<ITabGenerator> WrappedGenerator = nullptr;
-    /* Timer for polling whether the compiler manager DLL exists and we can load it */
-    float lastInitAttempt = 0;
-    /* Period between initialization attempts */
-    const float InitializationPeriod = 1.0f;
 
     BEGIN_SLATE_FUNCTION_BUILD_OPTIMIZATION;
     void InitializeWidgets()
@@ -563,140 +748,151 @@ private:
             FPlatformProcess::LaunchURL(*FCompilerManager::GetEULADownloadURL(), nullptr, nullptr);
         };
 
-        ExtensionTab =
-            SNew(SHorizontalBox)
-            + SHorizontalBox::Slot()
-            .FillWidth(1.0f)
-            .VAlign(VAlign_Center)
-            .HAlign(HAlign_Center)
+        DownloadPrompt =
+            SNew(SScrollBox)
+            + SScrollBox::Slot()
             [
-                SNew(SScrollBox)
-                + SScrollBox::Slot()
+                SNew(SVerticalBox)
+                + SVerticalBox::Slot()
+                .AutoHeight()
                 [
-                    SNew(SVerticalBox)
-                    + SVerticalBox::Slot()
+                    SNew(STextBlock)
+                    .Text(LOCTEXT("TabGenWrapperEULAIntro", "Some additional files are required to use the Mali Offline Compiler Plugin for Unreal Engine 4. By downloading these files, you acknowledge that you accept the End User License Agreement for the Mali GPU Offline Compiler."))
+                    .AutoWrapText(true)
+                    .MinDesiredWidth(10000.0f)
+                    .Margin(10.0f)
+                ]
+                + SVerticalBox::Slot()
+                    .AutoHeight()
+                    .HAlign(HAlign_Center)
+                    [
+                        SNew(SHorizontalBox)
+                        + SHorizontalBox::Slot()
+                        .Padding(10.0f)
+                        .AutoWidth()
+                        [
+                            SNew(SHyperlink)
+                            .Text(LOCTEXT("EULADisplayName", "End User Licence Agreement for the Mali Offline Compiler"))
+                            .ToolTipText(FText::FromString(FCompilerManager::GetEULADownloadURL()))
+                            .OnNavigate_Lambda(LaunchEULAURL)
+                        ]
+                    ]
+                + SVerticalBox::Slot()
                     .AutoHeight()
                     [
                         SNew(STextBlock)
-                        .Text(LOCTEXT("TabGenWrapperEULAIntro", "Some additional files are required to use the Mali Offline Compiler Plugin for Unreal Engine 4. By downloading these files, you acknowledge that you accept the End User License Agreement for the Mali GPU Offline Compiler."))
+                        .Text(LOCTEXT("TabGenWrapperIntro", "To use the Mali Offline Compiler Plugin for Unreal Engine 4, you need to click below to download the Mali Offline Compiler:"))
                         .AutoWrapText(true)
                         .MinDesiredWidth(10000.0f)
                         .Margin(10.0f)
                     ]
-                    + SVerticalBox::Slot()
-                        .AutoHeight()
-                        .HAlign(HAlign_Center)
-                        [
-                            SNew(SHorizontalBox)
-                            + SHorizontalBox::Slot()
-                            .Padding(10.0f)
-                            .AutoWidth()
-                            [
-                                SNew(SHyperlink)
-                                .Text(LOCTEXT("EULADisplayName", "End User Licence Agreement for the Mali Offline Compiler"))
-                                .ToolTipText(FText::FromString(FCompilerManager::GetEULADownloadURL()))
-                                .OnNavigate_Lambda(LaunchEULAURL)
-                            ]
-                        ]
-                    + SVerticalBox::Slot()
-                        .AutoHeight()
-                        [
-                            SNew(STextBlock)
-                            .Text(LOCTEXT("TabGenWrapperIntro", "To use the Mali Offline Compiler Plugin for Unreal Engine 4, you need to click below to download the Mali Offline Compiler:"))
-                            .AutoWrapText(true)
-                            .MinDesiredWidth(10000.0f)
-                            .Margin(10.0f)
-                        ]
-                    + SVerticalBox::Slot()
-                        .AutoHeight()
-                        .HAlign(HAlign_Center)
-                        [
-                            SNew(SHorizontalBox)
-                            + SHorizontalBox::Slot()
-                            .Padding(10.0f)
-                            .AutoWidth()
-                            [
-                                SNew(SHyperlink)
-                                .Text(FText::FromString(FCompilerManager::GetOfflineCompilerDownloadName()))
-                                .ToolTipText(FText::FromString(FCompilerManager::GetOfflineCompilerDownloadURL()))
-                                .OnNavigate_Lambda(LaunchDownloadURL)
-                            ]
-                        ]
-                    + SVerticalBox::Slot()
-                        .AutoHeight()
-                        [
-                            SNew(STextBlock)
-                            .Text(FText::Format(LOCTEXT("TabGenWrapperExtract", "And extract the {0} folder from the archive into:"), FText::FromString(FCompilerManager::GetOfflineCompilerFolderToExtract())))
-                            .AutoWrapText(true)
-                            .MinDesiredWidth(10000.0f)
-                            .Margin(10.0f)
-                        ]
-                    + SVerticalBox::Slot()
-                        .AutoHeight()
-                        .HAlign(HAlign_Center)
+                + SVerticalBox::Slot()
+                    .AutoHeight()
+                    .HAlign(HAlign_Center)
+                    [
+                        SNew(SHorizontalBox)
+                        + SHorizontalBox::Slot()
+                        .Padding(10.0f)
+                        .AutoWidth()
                         [
-                            SNew(SHorizontalBox)
-                            + SHorizontalBox::Slot()
-                            .Padding(10.0f)
-                            .AutoWidth()
-                            [
-                                SNew(SHyperlink)
-                                .Text(FText::FromString(GetMaliOCPluginFolderPath()))
-                                .ToolTipText((LOCTEXT("TabGenWrapperOpenFolderTooltip", "Open this folder using the system file explorer")))
-                                .OnNavigate_Lambda(OpenMaliOCFolder)
-                            ]
+                            SNew(SHyperlink)
+                            .Text(FText::FromString(FCompilerManager::GetOfflineCompilerDownloadName()))
+                            .ToolTipText(FText::FromString(FCompilerManager::GetOfflineCompilerDownloadURL()))
+                            .OnNavigate_Lambda(LaunchDownloadURL)
                         ]
-                    + SVerticalBox::Slot()
-                        .AutoHeight()
+                    ]
+                + SVerticalBox::Slot()
+                    .AutoHeight()
+                    [
+                        SNew(STextBlock)
+                        .Text(FText::Format(LOCTEXT("TabGenWrapperExtract", "And extract the {0} folder from the archive into:"), FText::FromString(FCompilerManager::GetOfflineCompilerFolderToExtract())))
+                        .AutoWrapText(true)
+                        .MinDesiredWidth(10000.0f)
+                        .Margin(10.0f)
+                    ]
+                + SVerticalBox::Slot()
+                    .AutoHeight()
+                    .HAlign(HAlign_Center)
+                    [
+                        SNew(SHorizontalBox)
+                        + SHorizontalBox::Slot()
+                        .Padding(10.0f)
+                        .AutoWidth()
                         [
-                            SNew(STextBlock)
-                            .Text(FText::Format(LOCTEXT("TabGenWrapperFinishedOldDLLExists", "When you've done this correctly, there will be a {0} folder inside the above folder, and this message will automatically be replaced by the Mali Offline Compiler Plugin."), FText::FromString(FCompilerManager::GetOfflineCompilerFolderToExtract())))
-                            .AutoWrapText(true)
-                            .MinDesiredWidth(10000.0f)
-                            .Margin(10.0f)
+                            SNew(SHyperlink)
+                            .Text(FText::FromString(GetMaliOCPluginFolderPath()))
+                            .ToolTipText((LOCTEXT("TabGenWrapperOpenFolderTooltip", "Open this folder using the system file explorer")))
+                            .OnNavigate_Lambda(OpenMaliOCFolder)
                         ]
-                ]
+                    ]
+                + SVerticalBox::Slot()
+                    .AutoHeight()
+                    [
+                        SNew(STextBlock)
+                        .Text(FText::Format(LOCTEXT("TabGenWrapperFinishedOldDLLExists", "When you've done this correctly, there will be a {0} folder inside the above folder, and this message will automatically be replaced by the Mali Offline Compiler Plugin."), FText::FromString(FCompilerManager::GetOfflineCompilerFolderToExtract())))
+                        .AutoWrapText(true)
+                        .MinDesiredWidth(10000.0f)
+                        .Margin(10.0f)
+                    ]
+            ];
+
+        bIsShowingDownloadPrompt = !FAsyncCompiler::IsInitializing();
+
+        ExtensionTab =
+            SNew(SHorizontalBox)
+            + SHorizontalBox::Slot()
+            .FillWidth(1.0f)
+            .VAlign(VAlign_Center)
+            .HAlign(HAlign_Center)
+            [
+                bIsShowingDownloadPrompt ? DownloadPrompt.ToSharedRef() : GenerateLoadingMessage()
             ];
     }
-    END_SLATE_FUNCTION_BUILD_OPTIMIZATION;
 
-    virtual bool IsTickable() const override
+    /* Make the message shown while the compilers are being enumerated */
+    static TSharedRef<SWidget> GenerateLoadingMessage()
     {
-        return true;
+        return SNew(STextBlock)
+            .Text(LOCTEXT("TabGenWrapperLoading", "Loading the Mali Offline Compiler..."))
+            .AutoWrapText(true)
+            .MinDesiredWidth(10000.0f)
+            .Justification(ETextJustify::Center)
+            .Margin(10.0f);
     }
+    END_SLATE_FUNCTION_BUILD_OPTIMIZATION;
 
-    virtual void Tick(float DeltaTime) override
+    /* Called whenever the async compiler finishes initializing, which happens in the background, or again once the user has extracted the compiler manager */
+    void OnInitializationFinished(bool bSucceeded)
     {
-        lastInitAttempt += DeltaTime;
-        if (lastInitAttempt < InitializationPeriod)
+        if (WrappedGenerator.IsValid())
         {
             return;
         }
-        lastInitAttempt = 0;
 
-        // Each frame, check if the compiler manager has loaded
-        // If it has, create the actual tab generator and pass it through
-        if (!WrappedGenerator.IsValid())
+        // If the compiler manager has loaded, create the actual tab generator and pass it through
+        if (bSucceeded)
         {
-            if (FAsyncCompiler::Get() == nullptr)
-            {
-                FAsyncCompiler::Initialize(true);
-            }
-
-            if (FAsyncCompiler::Get() != nullptr)
-            {
-                auto ME = MaterialEditor.Pin();
-                check(ME.IsValid());
-                WrappedGenerator = FMaterialEditorTabGeneratorImpl::create(ME.ToSharedRef());
-                ExtensionTab->ClearChildren();
-                ExtensionTab->AddSlot().AttachWidget(WrappedGenerator->GetExtensionTab());
-            }
+            auto ME = MaterialEditor.Pin();
+            check(ME.IsValid());
+            WrappedGenerator = FMaterialEditorTabGeneratorImpl::create(ME.ToSharedRef());
+            ExtensionTab->ClearChildren();
+            ExtensionTab->AddSlot().AttachWidget(WrappedGenerator->GetExtensionTab());
+            return;
         }
-    }
 
-    virtual TStatId GetStatId() const override
-    {
-        RETURN_QUICK_DECLARE_CYCLE_STAT(FMaterialEditorTabGeneratorImplWrapper, STATGROUP_Tickables);
+        // Loading failed, so the user needs to download the compiler manager
+        if (!bIsShowingDownloadPrompt)
+        {
+            ExtensionTab->ClearChildren();
+            ExtensionTab->AddSlot()
+                .FillWidth(1.0f)
+                .VAlign(VAlign_Center)
+                .HAlign(HAlign_Center)
+                [
+                    DownloadPrompt.ToSharedRef()
+                ];
+            bIsShowingDownloadPrompt = true;
+        }
     }
 };
 
@@ -749,10 +945,18 @@ private:
     END_SLATE_FUNCTION_BUILD_OPTIMIZATION;
 };
 
+int32 FMaterialEditorTabGeneratorImpl::NumLiveTabs = 0;
+
+int32 FMaterialEditorTabGenerator::GetNumLiveTabs()
+{
+    return FMaterialEditorTabGeneratorImpl::NumLiveTabs;
+}
+
 TSharedRef<ITabGenerator> FMaterialEditorTabGenerator::create(TSharedRef<IMaterialEditor> editor)
 {
-    if (FAsyncCompiler::Get() == nullptr)
+    if (FAsyncCompiler::IsInitializing() || FAsyncCompiler::Get() == nullptr)
     {
+        // If the compiler is still loading, create a wrapper that shows a loading message until it's ready
         // If the compiler isn't loaded, that probably means we couldn't find the compiler manager + libs
         // Create a wrapper that will prompt the user to download the compiler manager
         // Once the compiler manager is loaded, the wrapper will just be a pass through for the regular tab generator
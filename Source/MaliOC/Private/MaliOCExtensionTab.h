@@ -41,6 +41,9 @@ public:
     * @return a tab generator for a Material Editor or a Material Instance Editor
     */
     static TSharedRef<ITabGenerator> create(TSharedRef<IMaterialEditor> Editor);
+
+    /** Game thread only. @return the number of Material Editor tabs showing the compiler selection, each of which refers to its selected core, revision, driver and platform */
+    static int32 GetNumLiveTabs();
 };
 
 class FMaterialFunctionEditorTabGenerator final
@@ -0,0 +1,170 @@
+/*
+* Copyright 2015 ARM Limited
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+
+#include "MaliOCPrivatePCH.h"
+#include "MaliOCPermutationFilter.h"
+
+static TAutoConsoleVariable<FString> CVarPermutationFilter(
+    TEXT("MaliOC.PermutationFilter"),
+    TEXT(""),
+    TEXT("Restricts batch runs to some shader permutations, e.g. \"VertexFactory=FLocalVertexFactory;Frequency=Pixel;Type=TBasePass*\". Empty (default) compiles everything."),
+    ECVF_Default);
+
+/** Frequency names accepted by the filter, indexed by EShaderFrequency */
+static const TCHAR* const FrequencyNames[] =
+{
+    TEXT("Vertex"),
+    TEXT("Hull"),
+    TEXT("Domain"),
+    TEXT("Pixel"),
+    TEXT("Geometry"),
+    TEXT("Compute"),
+};
+static_assert(ARRAY_COUNT(FrequencyNames) == SF_NumFrequencies, "FrequencyNames must have one entry per shader frequency");
+
+bool FMaliOCPermutationFilter::IsEmpty() const
+{
+    return VertexFactoryTypes.Num() == 0 && FrequencyMask == 0 && ShaderTypePatterns.Num() == 0;
+}
+
+bool FMaliOCPermutationFilter::ShouldCompileVertexFactory(const FVertexFactoryType* VertexFactoryType) const
+{
+    if (VertexFactoryType == nullptr || VertexFactoryTypes.Num() == 0)
+    {
+        return true;
+    }
+
+    return VertexFactoryTypes.Contains(FName(VertexFactoryType->GetName()));
+}
+
+bool FMaliOCPermutationFilter::ShouldCompile(const FShaderType* ShaderType, const FVertexFactoryType* VertexFactoryType) const
+{
+    // Shaders without a vertex factory are only excluded by the other criteria
+    if (VertexFactoryType != nullptr && !ShouldCompileVertexFactory(VertexFactoryType))
+    {
+        return false;
+    }
+
+    if (FrequencyMask != 0 && (FrequencyMask & (1u << ShaderType->GetFrequency())) == 0)
+    {
+        return false;
+    }
+
+    if (ShaderTypePatterns.Num() > 0)
+    {
+        const FString shaderTypeName = ShaderType->GetName();
+        bool bMatched = false;
+        for (const FString& pattern : ShaderTypePatterns)
+        {
+            if (shaderTypeName.MatchesWildcard(pattern))
+            {
+                bMatched = true;
+                break;
+            }
+        }
+
+        if (!bMatched)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool FMaliOCPermutationFilter::Parse(const FString& FilterString, FMaliOCPermutationFilter& OutFilter, FString& OutError)
+{
+    OutFilter = FMaliOCPermutationFilter();
+
+    TArray<FString> criteria;
+    FilterString.ParseIntoArray(criteria, TEXT(";"), true);
+
+    for (const FString& criterion : criteria)
+    {
+        FString key;
+        FString value;
+        if (!criterion.Split(TEXT("="), &key, &value))
+        {
+            OutError = FString::Printf(TEXT("Expected Key=Value, got \"%s\""), *criterion);
+            return false;
+        }
+
+        key = key.Trim().TrimTrailing();
+        value = value.Trim().TrimTrailing();
+
+        TArray<FString> values;
+        value.ParseIntoArray(values, TEXT("|"), true);
+
+        if (key.Equals(TEXT("VertexFactory"), ESearchCase::IgnoreCase))
+        {
+            for (const FString& vertexFactory : values)
+            {
+                OutFilter.VertexFactoryTypes.AddUnique(FName(*vertexFactory.Trim().TrimTrailing()));
+            }
+        }
+        else if (key.Equals(TEXT("Frequency"), ESearchCase::IgnoreCase))
+        {
+            for (const FString& frequency : values)
+            {
+                int32 index = INDEX_NONE;
+                for (int32 i = 0; i < ARRAY_COUNT(FrequencyNames); i++)
+                {
+                    if (frequency.Trim().TrimTrailing().Equals(FrequencyNames[i], ESearchCase::IgnoreCase))
+                    {
+                        index = i;
+                        break;
+                    }
+                }
+
+                if (index == INDEX_NONE)
+                {
+                    OutError = FString::Printf(TEXT("Unknown shader frequency \"%s\""), *frequency);
+                    return false;
+                }
+                OutFilter.FrequencyMask |= 1u << index;
+            }
+        }
+        else if (key.Equals(TEXT("Type"), ESearchCase::IgnoreCase))
+        {
+            for (const FString& pattern : values)
+            {
+                OutFilter.ShaderTypePatterns.AddUnique(pattern.Trim().TrimTrailing());
+            }
+        }
+        else
+        {
+            OutError = FString::Printf(TEXT("Unknown filter key \"%s\". Expected VertexFactory, Frequency or Type"), *key);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+FMaliOCPermutationFilter FMaliOCPermutationFilter::GetConsoleVariableFilter()
+{
+    FMaliOCPermutationFilter filter;
+    FString error;
+
+    if (!Parse(CVarPermutationFilter.GetValueOnGameThread(), filter, error))
+    {
+        UE_LOG(MaliOfflineCompiler, Warning, TEXT("Ignoring MaliOC.PermutationFilter: %s"), *error);
+        return FMaliOCPermutationFilter();
+    }
+
+    return filter;
+}
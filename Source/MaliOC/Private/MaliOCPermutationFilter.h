@@ -0,0 +1,64 @@
+/*
+* Copyright 2015 ARM Limited
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+
+#pragma once
+#include "MaliOCPrivatePCH.h"
+
+/**
+ * Selects which shader permutations of a material get compiled.
+ * A permutation is kept if it passes every criterion that is set. An empty filter keeps everything.
+ */
+struct FMaliOCPermutationFilter
+{
+    /** Names of the vertex factory types to keep (e.g. FLocalVertexFactory). Empty keeps all of them */
+    TArray<FName> VertexFactoryTypes;
+    /** Shader frequencies to keep, one bit per EShaderFrequency. 0 keeps all of them */
+    uint32 FrequencyMask = 0;
+    /** Wildcard patterns (* and ?), one of which the shader type name must match. Empty keeps all of them */
+    TArray<FString> ShaderTypePatterns;
+
+    /** @return true if the filter keeps every permutation */
+    bool IsEmpty() const;
+
+    /**
+     * @param VertexFactoryType the vertex factory type, or nullptr for shaders without one
+     * @return true if any permutation of this vertex factory type can pass the filter. Shaders without a vertex factory always can.
+     */
+    bool ShouldCompileVertexFactory(const FVertexFactoryType* VertexFactoryType) const;
+
+    /**
+     * Thread safe.
+     * @param ShaderType the shader type
+     * @param VertexFactoryType the vertex factory type, or nullptr for shaders without one
+     * @return true if the permutation passes the filter
+     */
+    bool ShouldCompile(const FShaderType* ShaderType, const FVertexFactoryType* VertexFactoryType) const;
+
+    /**
+     * Parse a filter from a string of semicolon separated Key=Value criteria, where lists of values are separated by |
+     * e.g. "VertexFactory=FLocalVertexFactory|FInstancedStaticMeshVertexFactory;Frequency=Pixel;Type=TBasePass*"
+     * Keys are VertexFactory, Frequency (Vertex, Pixel, Hull, Domain, Geometry, Compute) and Type.
+     * @param FilterString the string to parse
+     * @param OutFilter the parsed filter
+     * @param OutError description of the problem if parsing failed
+     * @return true on success
+     */
+    static bool Parse(const FString& FilterString, FMaliOCPermutationFilter& OutFilter, FString& OutError);
+
+    /** @return the filter set by the MaliOC.PermutationFilter console variable, which is how batch runs choose a filter */
+    static FMaliOCPermutationFilter GetConsoleVariableFilter();
+};
@@ -72,7 +72,7 @@ Generator(ReportGenerator)
 }
 
 /* Convert a string array into a list of strings widget */
-TSharedRef<SWidget> GenerateFStringListView(const TArray<TSharedRef<FString>>& StringArray)
+TSharedRef<SWidget> GenerateFStringListView(const TArray<FString>& StringArray)
 {
     TSharedRef<SVerticalBox> verticalBox = SNew(SVerticalBox);
     for (const auto& string : StringArray)
@@ -81,7 +81,7 @@ TSharedRef<SWidget> GenerateFStringListView(const TArray<TSharedRef<FString>>& S
             .AutoHeight()
             [
                 SNew(SRichTextBlock)
-                .Text(FText::FromString(*string))
+                .Text(FText::FromString(string))
                 .TextStyle(FMaliOCStyle::Get(), "Text.Normal")
                 .DecoratorStyleSet(FMaliOCStyle::Get().Get())
                 .AutoWrapText(true)
@@ -91,13 +91,31 @@ TSharedRef<SWidget> GenerateFStringListView(const TArray<TSharedRef<FString>>& S
     return verticalBox;
 }
 
-/* Add the source code box to any vertical box*/
-void AddSourceCodeToVerticalBox(TSharedPtr<SVerticalBox>& VerticalBox, const FString& SourceCode)
+/* Convert an array of interned lines into a list of strings widget */
+TSharedRef<SWidget> GenerateFNameListView(const TArray<FName>& NameArray)
 {
-    if (SourceCode.Len() > 0)
+    TSharedRef<SVerticalBox> verticalBox = SNew(SVerticalBox);
+    for (const auto& name : NameArray)
+    {
+        verticalBox->AddSlot()
+            .AutoHeight()
+            [
+                SNew(SRichTextBlock)
+                .Text(FText::FromName(name))
+                .TextStyle(FMaliOCStyle::Get(), "Text.Normal")
+                .DecoratorStyleSet(FMaliOCStyle::Get().Get())
+                .AutoWrapText(true)
+            ];
+    }
+
+    return verticalBox;
+}
+
+/* Add a titled, expandable list of strings (such as errors or warnings) to a vertical box */
+void AddStringListToVerticalBox(TSharedRef<SVerticalBox>& VerticalBox, const FString& Title, const TArray<FString>& StringArray)
+{
+    if (StringArray.Num() > 0)
     {
-        // Replace tabs with two spaces for display in the widget, as the rich text block doesn't support tabs
-        FString spacedSource = SourceCode.Replace(TEXT("\t"), TEXT("  "));
         VerticalBox->AddSlot()
             .AutoHeight()
             [
@@ -107,110 +125,75 @@ void AddSourceCodeToVerticalBox(TSharedPtr<SVerticalBox>& VerticalBox, const FSt
             .AutoHeight()
             [
                 SNew(SExpandableArea)
-                .AreaTitle(FText::FromString(TEXT("Source Code")))
+                .AreaTitle(FText::FromString(Title))
                 .AreaTitleFont(FEditorStyle::GetFontStyle(TEXT("DetailsView.CategoryFontStyle")))
-                .InitiallyCollapsed(true)
+                .InitiallyCollapsed(false)
                 .Padding(WidgetPadding)
                 .BodyContent()
                 [
-                    SNew(SRichTextBlock)
-                    .Text(FText::FromString(spacedSource))
-                    .TextStyle(FMaliOCStyle::Get(), "Text.Normal")
-                    .AutoWrapText(true)
+                    GenerateFStringListView(StringArray)
                 ]
             ];
     }
 }
 
-/* Construct the error widget from an array of errors*/
-TSharedRef<SWidget> ConstructErrorWidget(const TArray<TSharedRef<FMaliOCReport::FErrorReport>>& Errors)
+/* Get the limiting pipe on Midgard for a set of cycle counts */
+const TCHAR* GetMidgardBoundPipe(float Arithmetic, float LoadStore, float Texture)
 {
-    TSharedRef<SVerticalBox> errorBox = SNew(SVerticalBox);
+    float max = FMath::Max3(Arithmetic, LoadStore, Texture);
 
-    for (const auto& error : Errors)
+    if (max == Arithmetic)
     {
-        TSharedPtr<SVerticalBox> errorWarningBox = nullptr;
-
-        errorBox->AddSlot()
-            .Padding(WidgetPadding)
-            .AutoHeight()
-            [
-                SNew(SExpandableArea)
-                .AreaTitle(FText::FromString(error->TitleName))
-                .AreaTitleFont(FEditorStyle::GetFontStyle(TEXT("DetailsView.CategoryFontStyle")))
-                .InitiallyCollapsed(false)
-                .Padding(WidgetPadding)
-                .BodyContent()
-                [
-                    SAssignNew(errorWarningBox, SVerticalBox)
-                ]
-            ];
+        return TEXT("Arithmetic");
+    }
+    if (max == LoadStore)
+    {
+        return TEXT("Load/Store");
+    }
+    return TEXT("Texture");
+}
 
-        // Print the details of the shader (such as frequency)
-        errorWarningBox->AddSlot()
-            .AutoHeight()
-            [
-                GenerateFStringListView(error->Details)
-            ];
+/* Generate a Midgard stats table. The numbers are only formatted here, when the row is displayed */
+TSharedRef<SVerticalBox> GenerateMidgardStatsTable(const FMaliOCReport::FMidgardReport::FRenderTarget& RenderTarget)
+{
+    const auto AsText = [](float Value) -> FText
+    {
+        return FText::FromString(FString::Printf(TEXT("%.4g"), Value));
+    };
 
-        if (error->Errors.Num() > 0)
+    // Four rows, 5 columns
+    const FText statsTable[4][5] =
+    {
+        // Header line
+        { FText::GetEmpty(), FText::FromString(TEXT("A")), FText::FromString(TEXT("L/S")), FText::FromString(TEXT("T")), FText::FromString(TEXT("Bound")) },
+        // Shortest Path
         {
-            errorWarningBox->AddSlot()
-                .AutoHeight()
-                [
-                    SNew(SSeparator)
-                ];
-            errorWarningBox->AddSlot()
-                .AutoHeight()
-                [
-                    SNew(SExpandableArea)
-                    .AreaTitle(FText::FromString(TEXT("Errors")))
-                    .AreaTitleFont(FEditorStyle::GetFontStyle(TEXT("DetailsView.CategoryFontStyle")))
-                    .InitiallyCollapsed(false)
-                    .Padding(WidgetPadding)
-                    .BodyContent()
-                    [
-                        GenerateFStringListView(error->Errors)
-                    ]
-                ];
-        }
-
-        if (error->Warnings.Num() > 0)
+            FText::FromString(TEXT("Shortest Path (Cycles)")),
+            AsText(RenderTarget.arithmetic_shortest_path),
+            AsText(RenderTarget.load_store_shortest_path),
+            AsText(RenderTarget.texture_shortest_path),
+            FText::FromString(GetMidgardBoundPipe(RenderTarget.arithmetic_shortest_path, RenderTarget.load_store_shortest_path, RenderTarget.texture_shortest_path))
+        },
+        // Longest Path
         {
-            errorWarningBox->AddSlot()
-                .AutoHeight()
-                [
-                    SNew(SSeparator)
-                ];
-            errorWarningBox->AddSlot()
-                .AutoHeight()
-                [
-                    SNew(SExpandableArea)
-                    .AreaTitle(FText::FromString(TEXT("Warnings")))
-                    .AreaTitleFont(FEditorStyle::GetFontStyle(TEXT("DetailsView.CategoryFontStyle")))
-                    .InitiallyCollapsed(false)
-                    .Padding(WidgetPadding)
-                    .BodyContent()
-                    [
-                        GenerateFStringListView(error->Warnings)
-                    ]
-                ];
-        }
-
-        AddSourceCodeToVerticalBox(errorWarningBox, error->SourceCode);
-    }
-
-    return errorBox;
-}
+            FText::FromString(TEXT("Longest Path (Cycles)")),
+            AsText(RenderTarget.arithmetic_longest_path),
+            AsText(RenderTarget.load_store_longest_path),
+            AsText(RenderTarget.texture_longest_path),
+            FText::FromString(GetMidgardBoundPipe(RenderTarget.arithmetic_longest_path, RenderTarget.load_store_longest_path, RenderTarget.texture_longest_path))
+        },
+        // Instructions Emitted line
+        {
+            FText::FromString(TEXT("Instructions Emitted")),
+            AsText(RenderTarget.arithmetic_cycles),
+            AsText(RenderTarget.load_store_cycles),
+            AsText(RenderTarget.texture_cycles),
+            FText::GetEmpty()
+        },
+    };
 
-/* Generate a Midgard stats table */
-TSharedRef<SVerticalBox> GenerateMidgardStatsTable(const TSharedRef<FMaliOCReport::FMidgardReport::FRenderTarget>& RenderTarget)
-{
     TSharedRef<SVerticalBox> rtBox = SNew(SVerticalBox);
 
-    int index = 0;
-
-    // Four rows, 5 columns
     for (int i = 0; i < 4; i++)
     {
         TSharedPtr<SHorizontalBox> curRow = nullptr;
@@ -231,13 +214,18 @@ TSharedRef<SVerticalBox> GenerateMidgardStatsTable(const TSharedRef<FMaliOCRepor
                 .MaxWidth(columnWidths[j] * widthScaleFactor)
                 [
                     SNew(STextBlock)
-                    .Text(*RenderTarget->StatsTable[index])
+                    .Text(statsTable[i][j])
                     .Font(FEditorStyle::GetFontStyle(TEXT("PropertyWindow.NormalFont")))
                 ];
-            index++;
         }
     }
 
+    // Register and spilling info
+    TArray<FString> extraDetails;
+    extraDetails.Add(FString::Printf(TEXT("%d work registers used"), RenderTarget.work_registers_used));
+    extraDetails.Add(FString::Printf(TEXT("%d uniform registers used"), RenderTarget.uniform_registers_used));
+    extraDetails.Add(RenderTarget.spilling_used ? TEXT("<Text.Warning>Register spilling used</>") : TEXT("Register spilling not used"));
+
     rtBox->AddSlot()
         .AutoHeight()
         [
@@ -247,338 +235,571 @@ TSharedRef<SVerticalBox> GenerateMidgardStatsTable(const TSharedRef<FMaliOCRepor
     rtBox->AddSlot()
         .AutoHeight()
         [
-            GenerateFStringListView(RenderTarget->ExtraDetails)
+            GenerateFStringListView(extraDetails)
         ];
 
     return rtBox;
 };
 
-/* Make the Midgard dump widget (where we dump the statistics for Midgard compilation) */
-TSharedRef<SWidget> ConstructMidgardDumpWidget(const TArray<TSharedRef<FMaliOCReport::FMidgardReport>>& Reports, bool DumpSourceCode)
+/* Make the widget showing the statistics estimated from a sample of the permutations */
+TSharedRef<SWidget> GenerateSamplingDetails(const FMaliOCSamplingSummary& Sampling)
 {
-    TSharedRef<SVerticalBox> midgardBox = SNew(SVerticalBox);
+    TArray<FString> summary;
+    summary.Add(FString::Printf(TEXT("Estimated from %u of %u shader permutations"), Sampling.NumSampled, Sampling.NumPermutations));
+    summary.Add(Sampling.bFlagged ? TEXT("<Text.Warning>A full compile is recommended</>") : TEXT("A full compile is not needed"));
 
-    for (const auto& report : Reports)
-    {
-        TSharedPtr<SVerticalBox> reportWarningBox = nullptr;
+    TSharedRef<SVerticalBox> samplingBox = SNew(SVerticalBox)
+        + SVerticalBox::Slot()
+        .AutoHeight()
+        [
+            GenerateFStringListView(summary)
+        ];
 
-        midgardBox->AddSlot()
-            .Padding(WidgetPadding)
+    if (Sampling.Estimates.Num() > 0)
+    {
+        samplingBox->AddSlot()
             .AutoHeight()
             [
-                SNew(SExpandableArea)
-                .AreaTitle(FText::FromString(report->TitleName))
-                .AreaTitleFont(FEditorStyle::GetFontStyle(TEXT("DetailsView.CategoryFontStyle")))
-                .ToolTipText(FText::FromString(report->TitleName))
-                .InitiallyCollapsed(false)
-                .Padding(WidgetPadding)
-                .BodyContent()
-                [
-                    SAssignNew(reportWarningBox, SVerticalBox)
-                ]
+                SNew(SSeparator)
             ];
 
-        // Print the details of the shader (such as frequency)
-        reportWarningBox->AddSlot()
-            .AutoHeight()
-            [
-                GenerateFStringListView(report->Details)
-            ];
+        const float columnWidths[] = { 3.0f, 1.0f, 2.0f, 1.0f, 2.0f };
+        const float widthScaleFactor = 50.0f;
 
-        // If there's only one render target, don't make an expandable area
-        if (report->RenderTargets.Num() == 1)
+        const auto AddRow = [&](const FString (&Columns)[5])
         {
-            reportWarningBox->AddSlot()
+            TSharedPtr<SHorizontalBox> row = nullptr;
+            samplingBox->AddSlot()
                 .AutoHeight()
                 [
-                    SNew(SSeparator)
+                    SAssignNew(row, SHorizontalBox)
                 ];
 
-            reportWarningBox->AddSlot()
-                .AutoHeight()
-                [
-                    GenerateMidgardStatsTable(report->RenderTargets[0])
-                ];
-        }
-        else
-        {
-            for (const auto& rt : report->RenderTargets)
+            for (int32 i = 0; i < 5; i++)
             {
-                reportWarningBox->AddSlot()
-                    .AutoHeight()
-                    [
-                        SNew(SSeparator)
-                    ];
-
-                reportWarningBox->AddSlot()
-                    .AutoHeight()
+                row->AddSlot()
+                    .FillWidth(columnWidths[i])
+                    .MaxWidth(columnWidths[i] * widthScaleFactor)
                     [
-                        SNew(SExpandableArea)
-                        .AreaTitle(FText::FromString(FString::Printf(TEXT("Render Target %u"), rt->Index)))
-                        .AreaTitleFont(FEditorStyle::GetFontStyle(TEXT("DetailsView.CategoryFontStyle")))
-                        .InitiallyCollapsed(false)
-                        .Padding(WidgetPadding)
-                        .BodyContent()
-                        [
-                            GenerateMidgardStatsTable(rt)
-                        ]
+                        SNew(STextBlock)
+                        .Text(FText::FromString(Columns[i]))
+                        .Font(FEditorStyle::GetFontStyle(TEXT("PropertyWindow.NormalFont")))
                     ];
             }
-        }
+        };
 
-        // Dump the warnings
-        if (report->Warnings.Num() > 0)
-        {
-            reportWarningBox->AddSlot()
-                .AutoHeight()
-                [
-                    SNew(SSeparator)
-                ];
-            reportWarningBox->AddSlot()
-                .AutoHeight()
-                [
-                    SNew(SExpandableArea)
-                    .AreaTitle(FText::FromString(TEXT("Warnings")))
-                    .AreaTitleFont(FEditorStyle::GetFontStyle(TEXT("DetailsView.CategoryFontStyle")))
-                    .InitiallyCollapsed(false)
-                    .Padding(WidgetPadding)
-                    .BodyContent()
-                    [
-                        GenerateFStringListView(report->Warnings)
-                    ]
-                ];
-        }
+        const FString header[5] = { TEXT(""), TEXT("Mean"), TEXT("95% Bounds"), TEXT("Std Dev"), TEXT("Sampled Range") };
+        AddRow(header);
 
-        if (DumpSourceCode)
+        for (int32 metric = 0; metric < Sampling.Estimates.Num(); metric++)
         {
-            AddSourceCodeToVerticalBox(reportWarningBox, report->SourceCode);
+            const FMaliOCSampledEstimate& estimate = Sampling.Estimates[metric];
+            const FString columns[5] =
+            {
+                GetSampledMetricName((EMaliOCSampledMetric)metric),
+                FString::Printf(TEXT("%.4g"), estimate.Mean),
+                estimate.bHasConfidenceInterval ? FString::Printf(TEXT("%.4g - %.4g"), estimate.LowerBound, estimate.UpperBound) : FString(TEXT("Unknown")),
+                FString::Printf(TEXT("%.4g"), estimate.StandardDeviation),
+                FString::Printf(TEXT("%.4g - %.4g"), estimate.Min, estimate.Max)
+            };
+            AddRow(columns);
         }
     }
 
-    return midgardBox;
+    AddStringListToVerticalBox(samplingBox, TEXT("Reasons for a Full Compile"), Sampling.FlagReasons);
+
+    return samplingBox;
 }
 
-/* Make the Utgard dump widget (where we dump the statistics for Utgard compilation) */
-TSharedRef<SWidget> ConstructUtgardDumpWidget(const TArray<TSharedRef<FMaliOCReport::FUtgardReport>>& Reports, bool DumpSourceCode)
+/* Make the details widget for an error report */
+TSharedRef<SWidget> GenerateErrorDetails(const TSharedRef<FMaliOCReport::FErrorReport>& Error)
 {
-    TSharedRef<SVerticalBox> utgardBox = SNew(SVerticalBox);
+    TSharedRef<SVerticalBox> errorWarningBox = SNew(SVerticalBox);
 
-    for (const auto& report : Reports)
-    {
-        TSharedPtr<SVerticalBox> reportWarningBox = nullptr;
+    // Print the details of the shader (such as frequency)
+    errorWarningBox->AddSlot()
+        .AutoHeight()
+        [
+            GenerateFNameListView(Error->Details)
+        ];
 
-        utgardBox->AddSlot()
-            .Padding(WidgetPadding)
+    AddStringListToVerticalBox(errorWarningBox, TEXT("Errors"), Error->Errors);
+    AddStringListToVerticalBox(errorWarningBox, TEXT("Warnings"), Error->Warnings);
+
+    return errorWarningBox;
+}
+
+/* Make the details widget for a Midgard report (where we dump the statistics for Midgard compilation) */
+TSharedRef<SWidget> GenerateMidgardDetails(const TSharedRef<FMaliOCReport::FMidgardReport>& Report)
+{
+    TSharedRef<SVerticalBox> reportWarningBox = SNew(SVerticalBox);
+
+    // Print the details of the shader (such as frequency)
+    reportWarningBox->AddSlot()
+        .AutoHeight()
+        [
+            GenerateFNameListView(Report->Details)
+        ];
+
+    // If there's only one render target, don't make an expandable area
+    if (Report->RenderTargets.Num() == 1)
+    {
+        reportWarningBox->AddSlot()
             .AutoHeight()
             [
-                SNew(SExpandableArea)
-                .AreaTitle(FText::FromString(report->TitleName))
-                .AreaTitleFont(FEditorStyle::GetFontStyle(TEXT("DetailsView.CategoryFontStyle")))
-                .ToolTipText(FText::FromString(report->TitleName))
-                .InitiallyCollapsed(false)
-                .Padding(WidgetPadding)
-                .BodyContent()
-                [
-                    SAssignNew(reportWarningBox, SVerticalBox)
-                    + SVerticalBox::Slot()
-                    .AutoHeight()
-                    [
-                        GenerateFStringListView(report->Details)
-                    ]
-                    + SVerticalBox::Slot()
-                        .AutoHeight()
-                        [
-                            SNew(SSeparator)
-                        ]
-                    + SVerticalBox::Slot()
-                        .AutoHeight()
-                        [
-                            GenerateFStringListView(report->ExtraDetails)
-                        ]
-                ]
+                SNew(SSeparator)
             ];
 
-        // Dump the warnings
-        if (report->Warnings.Num() > 0)
+        reportWarningBox->AddSlot()
+            .AutoHeight()
+            [
+                GenerateMidgardStatsTable(Report->RenderTargets[0])
+            ];
+    }
+    else
+    {
+        for (const auto& rt : Report->RenderTargets)
         {
             reportWarningBox->AddSlot()
                 .AutoHeight()
                 [
                     SNew(SSeparator)
                 ];
+
             reportWarningBox->AddSlot()
                 .AutoHeight()
                 [
                     SNew(SExpandableArea)
-                    .AreaTitle(FText::FromString(TEXT("Warnings")))
+                    .AreaTitle(FText::FromString(FString::Printf(TEXT("Render Target %d"), rt.render_target)))
                     .AreaTitleFont(FEditorStyle::GetFontStyle(TEXT("DetailsView.CategoryFontStyle")))
                     .InitiallyCollapsed(false)
                     .Padding(WidgetPadding)
                     .BodyContent()
                     [
-                        GenerateFStringListView(report->Warnings)
+                        GenerateMidgardStatsTable(rt)
                     ]
                 ];
         }
+    }
+
+    AddStringListToVerticalBox(reportWarningBox, TEXT("Warnings"), Report->Warnings);
 
-        if (DumpSourceCode)
+    return reportWarningBox;
+}
+
+/* Make the details widget for an Utgard report (where we dump the statistics for Utgard compilation) */
+TSharedRef<SWidget> GenerateUtgardDetails(const TSharedRef<FMaliOCReport::FUtgardReport>& Report)
+{
+    TArray<FString> extraDetails;
+    extraDetails.Add(FString::Printf(TEXT("Number of instruction words emitted: %d"), Report->NumInstructionWords));
+    extraDetails.Add(FString::Printf(TEXT("Number of cycles for shortest code path: %d"), Report->MinNumberOfCycles));
+    extraDetails.Add(FString::Printf(TEXT("Number of cycles for longest code path: %d"), Report->MaxNumberOfCycles));
+
+    TSharedRef<SVerticalBox> reportWarningBox = SNew(SVerticalBox)
+        + SVerticalBox::Slot()
+        .AutoHeight()
+        [
+            GenerateFNameListView(Report->Details)
+        ]
+        + SVerticalBox::Slot()
+            .AutoHeight()
+            [
+                SNew(SSeparator)
+            ]
+        + SVerticalBox::Slot()
+            .AutoHeight()
+            [
+                GenerateFStringListView(extraDetails)
+            ];
+
+    AddStringListToVerticalBox(reportWarningBox, TEXT("Warnings"), Report->Warnings);
+
+    return reportWarningBox;
+}
+
+/* Make the widget which displays a block of source code */
+TSharedRef<SWidget> GenerateSourceCodeView(const FString& SourceCode)
+{
+    // Replace tabs with two spaces for display in the widget, as the rich text block doesn't support tabs
+    FString spacedSource = SourceCode.Replace(TEXT("\t"), TEXT("  "));
+    return SNew(SRichTextBlock)
+        .Text(FText::FromString(spacedSource))
+        .TextStyle(FMaliOCStyle::Get(), "Text.Normal")
+        .AutoWrapText(true);
+}
+END_SLATE_FUNCTION_BUILD_OPTIMIZATION;
+
+/** Width of each quality level column */
+static const float QualityLevelColumnWidth = 60.0f;
+
+/**
+ * Make the quality level columns for a row.
+ * @param ReportQualityLevels all the quality levels in the report. Single quality reports have no columns.
+ * @param RowQualityLevels the quality levels the row applies to. Columns for other levels are left blank.
+ */
+TArray<FString> MakeQualityLevelColumns(FMaliOCQualityLevelMask ReportQualityLevels, FMaliOCQualityLevelMask RowQualityLevels)
+{
+    TArray<FString> columns;
+
+    // No columns unless there's more than one level
+    if ((ReportQualityLevels & (ReportQualityLevels - 1)) == 0)
+    {
+        return columns;
+    }
+
+    // The engine's enum isn't in order of quality, so list the levels explicitly
+    static const EMaterialQualityLevel::Type levels[] = { EMaterialQualityLevel::Low, EMaterialQualityLevel::Medium, EMaterialQualityLevel::High };
+    static const TCHAR* const levelNames[] = { TEXT("Low"), TEXT("Medium"), TEXT("High") };
+
+    for (int32 i = 0; i < ARRAY_COUNT(levels); i++)
+    {
+        const FMaliOCQualityLevelMask mask = QualityLevelToMask(levels[i]);
+        if (ReportQualityLevels & mask)
         {
-            AddSourceCodeToVerticalBox(reportWarningBox, report->SourceCode);
+            columns.Add((RowQualityLevels & mask) ? levelNames[i] : TEXT(""));
         }
     }
 
-    return utgardBox;
+    return columns;
 }
 
-/* Create the top level report widget */
-TSharedPtr<SWidget> ConstructReportWidget(const FAsyncReportGenerator& Generator)
+/**
+ * A row in the report tree view.
+ * Rows are cheap to create and only hold references into the report. Widgets are only generated for rows that are scrolled into view,
+ * and a row's children are only created the first time the tree asks for them.
+ */
+class FReportTreeItem : public TSharedFromThis<FReportTreeItem>
 {
-    TSharedPtr<SVerticalBox> Widget = nullptr;
+public:
+    virtual ~FReportTreeItem() = default;
 
-    TSharedPtr<SWidget> ReportWidget =
-        SNew(SScrollBox)
-        + SScrollBox::Slot()
-        [
-            SAssignNew(Widget, SVerticalBox)
-        ];
+    /** @return the widget for this row. Only called when the row becomes visible */
+    virtual TSharedRef<SWidget> GenerateWidget() const = 0;
 
-    auto Report = Generator.GetReport();
+    /** @return true if the row should be expanded the first time its parent is expanded */
+    virtual bool IsInitiallyExpanded() const
+    {
+        return false;
+    }
 
-    // First show any errors, if there are any
-    if (Report->ErrorList.Num() > 0)
+    /** @return the children of this row, creating them on first use */
+    const TArray<TSharedPtr<FReportTreeItem>>& GetChildren()
     {
-        Widget->AddSlot()
-            .Padding(WidgetPadding)
-            .AutoHeight()
-            [
-                SNew(SExpandableArea)
-                .AreaTitle(FText::FromString(TEXT("Error Summary")))
-                .AreaTitleFont(FEditorStyle::GetFontStyle(TEXT("DetailsView.CategoryFontStyle")))
-                .InitiallyCollapsed(false)
-                .BorderBackgroundColor(FLinearColor(0.5f, 0.5f, 0.5f, 1.0f))
-                .Padding(WidgetPadding)
-                .BodyContent()
-                [
-                    ConstructErrorWidget(Report->ErrorList)
-                ]
-            ];
+        if (!bHasCreatedChildren)
+        {
+            CreateChildren(Children);
+            bHasCreatedChildren = true;
+        }
+        return Children;
     }
 
-    // Next show Midgard reports if there are any
-    if (Report->MidgardReports.Num() > 0)
+    /** Set when the row has been expanded for the first time, so we only apply the initial expansion state once */
+    bool bHasBeenExpanded = false;
+
+protected:
+    /** Create the children of this row. Must not create any widgets */
+    virtual void CreateChildren(TArray<TSharedPtr<FReportTreeItem>>& OutChildren)
     {
-        Widget->AddSlot()
-            .Padding(WidgetPadding)
-            .AutoHeight()
+    }
+
+private:
+    bool bHasCreatedChildren = false;
+    TArray<TSharedPtr<FReportTreeItem>> Children;
+};
+
+/** A row with a title that can be expanded to show more rows */
+class FReportTreeSection final : public FReportTreeItem
+{
+public:
+    typedef TFunction<void(TArray<TSharedPtr<FReportTreeItem>>&)> FCreateChildren;
+
+    /**
+     * @param SectionTitle the title of the row
+     * @param bSectionIsCategory true if this is a top level category, which is drawn highlighted
+     * @param bSectionInitiallyExpanded true if the section should be expanded the first time it is shown
+     * @param SectionChildren function that creates the rows inside this section
+     * @param SectionColumns fixed width columns drawn after the title (used for the quality levels of a multi quality report)
+     */
+    FReportTreeSection(const FString& SectionTitle, bool bSectionIsCategory, bool bSectionInitiallyExpanded, FCreateChildren&& SectionChildren, TArray<FString>&& SectionColumns = TArray<FString>()) :
+        Title(SectionTitle),
+        bIsCategory(bSectionIsCategory),
+        bInitiallyExpanded(bSectionInitiallyExpanded),
+        ChildFactory(MoveTemp(SectionChildren)),
+        Columns(MoveTemp(SectionColumns))
+    {
+    }
+
+    virtual TSharedRef<SWidget> GenerateWidget() const override
+    {
+        TSharedRef<SHorizontalBox> titleBox = SNew(SHorizontalBox)
+            + SHorizontalBox::Slot()
+            .FillWidth(1.0f)
             [
-                SNew(SExpandableArea)
-                .AreaTitle(FText::FromString(TEXT("Statistics Summary")))
-                .AreaTitleFont(FEditorStyle::GetFontStyle(TEXT("DetailsView.CategoryFontStyle")))
-                .InitiallyCollapsed(false)
-                .BorderBackgroundColor(FLinearColor(0.5f, 0.5f, 0.5f, 1.0f))
-                .Padding(WidgetPadding)
-                .BodyContent()
+                SNew(STextBlock)
+                .Text(FText::FromString(Title))
+                .ToolTipText(FText::FromString(Title))
+                .Font(FEditorStyle::GetFontStyle(TEXT("DetailsView.CategoryFontStyle")))
+            ];
+
+        for (const auto& column : Columns)
+        {
+            titleBox->AddSlot()
+                .AutoWidth()
                 [
-                    SNew(SVerticalBox)
-                    + SVerticalBox::Slot()
-                    .Padding(WidgetPadding)
-                    .AutoHeight()
+                    SNew(SBox)
+                    .WidthOverride(QualityLevelColumnWidth)
                     [
-                        GenerateFStringListView(Report->ShaderSummaryStrings)
+                        SNew(STextBlock)
+                        .Text(FText::FromString(column))
+                        .Font(FEditorStyle::GetFontStyle(TEXT("PropertyWindow.NormalFont")))
                     ]
-                    + SVerticalBox::Slot()
-                        .AutoHeight()
-                        [
-                            ConstructMidgardDumpWidget(Report->MidgardSummaryReports, false)
-                        ]
-                ]
+                ];
+        }
+
+        return SNew(SBorder)
+            .BorderImage(FEditorStyle::GetBrush(bIsCategory ? "DetailsView.CategoryTop" : "NoBorder"))
+            .BorderBackgroundColor(FLinearColor(0.5f, 0.5f, 0.5f, 1.0f))
+            .Padding(WidgetPadding)
+            [
+                titleBox
             ];
+    }
+
+    virtual bool IsInitiallyExpanded() const override
+    {
+        return bInitiallyExpanded;
+    }
+
+protected:
+    virtual void CreateChildren(TArray<TSharedPtr<FReportTreeItem>>& OutChildren) override
+    {
+        ChildFactory(OutChildren);
+    }
+
+private:
+    const FString Title;
+    const bool bIsCategory;
+    const bool bInitiallyExpanded;
+    FCreateChildren ChildFactory;
+    const TArray<FString> Columns;
+};
+
+/** A leaf row whose content widget is created on demand */
+class FReportTreeContent final : public FReportTreeItem
+{
+public:
+    typedef TFunction<TSharedRef<SWidget>()> FCreateWidget;
+
+    FReportTreeContent(FCreateWidget&& ContentWidget) :
+        WidgetFactory(MoveTemp(ContentWidget))
+    {
+    }
+
+    virtual TSharedRef<SWidget> GenerateWidget() const override
+    {
+        return WidgetFactory();
+    }
+
+private:
+    FCreateWidget WidgetFactory;
+};
 
-        // Dump the rest of the shaders by vertex factory name
-        TMap<FString, TArray<TSharedRef<FMaliOCReport::FMidgardReport>>> VertexFactoryNames;
-        for (auto& report : Report->MidgardReports)
+/* Add a collapsed "Source Code" section to a list of rows, if there is any source code to show */
+void AddSourceCodeSection(TArray<TSharedPtr<FReportTreeItem>>& OutChildren, const FMaliOCShaderSourceRef& SourceCode)
+{
+    if (SourceCode.IsValid() && SourceCode->GetUncompressedSize() > 0)
+    {
+        // The source is only decompressed and turned into a widget when the section is expanded
+        OutChildren.Add(MakeShareable(new FReportTreeSection(TEXT("Source Code"), false, false, [SourceCode](TArray<TSharedPtr<FReportTreeItem>>& OutSourceRows)
+        {
+            OutSourceRows.Add(MakeShareable(new FReportTreeContent([SourceCode]() { return GenerateSourceCodeView(SourceCode->Decompress()); })));
+        })));
+    }
+}
+
+/* Make the row for an error report */
+TSharedPtr<FReportTreeItem> MakeErrorRow(const TSharedRef<FMaliOCReport::FErrorReport>& Error, FMaliOCQualityLevelMask ReportQualityLevels)
+{
+    return MakeShareable(new FReportTreeSection(Error->TitleName.ToString(), false, true, [Error](TArray<TSharedPtr<FReportTreeItem>>& OutChildren)
+    {
+        OutChildren.Add(MakeShareable(new FReportTreeContent([Error]() { return GenerateErrorDetails(Error); })));
+        AddSourceCodeSection(OutChildren, Error->SourceCode);
+    }, MakeQualityLevelColumns(ReportQualityLevels, Error->QualityLevelMask)));
+}
+
+/* Make the row for a Midgard report */
+TSharedPtr<FReportTreeItem> MakeMidgardRow(const TSharedRef<FMaliOCReport::FMidgardReport>& Report, FMaliOCQualityLevelMask ReportQualityLevels, bool bInitiallyExpanded, bool bDumpSourceCode)
+{
+    return MakeShareable(new FReportTreeSection(Report->TitleName.ToString(), false, bInitiallyExpanded, [Report, bDumpSourceCode](TArray<TSharedPtr<FReportTreeItem>>& OutChildren)
+    {
+        OutChildren.Add(MakeShareable(new FReportTreeContent([Report]() { return GenerateMidgardDetails(Report); })));
+        if (bDumpSourceCode)
         {
-            VertexFactoryNames.FindOrAdd(report->VertexFactoryName).Add(report);
+            AddSourceCodeSection(OutChildren, Report->SourceCode);
         }
+    }, MakeQualityLevelColumns(ReportQualityLevels, Report->QualityLevelMask)));
+}
 
-        for (const auto& name : VertexFactoryNames)
+/* Make the row for an Utgard report */
+TSharedPtr<FReportTreeItem> MakeUtgardRow(const TSharedRef<FMaliOCReport::FUtgardReport>& Report, FMaliOCQualityLevelMask ReportQualityLevels, bool bInitiallyExpanded, bool bDumpSourceCode)
+{
+    return MakeShareable(new FReportTreeSection(Report->TitleName.ToString(), false, bInitiallyExpanded, [Report, bDumpSourceCode](TArray<TSharedPtr<FReportTreeItem>>& OutChildren)
+    {
+        OutChildren.Add(MakeShareable(new FReportTreeContent([Report]() { return GenerateUtgardDetails(Report); })));
+        if (bDumpSourceCode)
         {
-            Widget->AddSlot()
-                .Padding(WidgetPadding)
-                .AutoHeight()
-                [
-                    SNew(SExpandableArea)
-                    .AreaTitle(FText::FromString(FString::Printf(TEXT("All %s"), *name.Key)))
-                    .AreaTitleFont(FEditorStyle::GetFontStyle(TEXT("DetailsView.CategoryFontStyle")))
-                    .InitiallyCollapsed(true)
-                    .BorderBackgroundColor(FLinearColor(0.5f, 0.5f, 0.5f, 1.0f))
-                    .Padding(WidgetPadding)
-                    .BodyContent()
-                    [
-                        ConstructMidgardDumpWidget(name.Value, true)
-                    ]
-                ];
+            AddSourceCodeSection(OutChildren, Report->SourceCode);
         }
+    }, MakeQualityLevelColumns(ReportQualityLevels, Report->QualityLevelMask)));
+}
+
+/* Make the summary category and one category per vertex factory for a list of Midgard or Utgard reports */
+template <typename ReportType, typename MakeRowFunction>
+void MakeStatisticsRows(TArray<TSharedPtr<FReportTreeItem>>& OutRoots, const TSharedRef<const FMaliOCReport>& Report, const TArray<TSharedRef<ReportType>>& SummaryReports, const TArray<TSharedRef<ReportType>>& Reports, MakeRowFunction MakeRow)
+{
+    TArray<TSharedRef<ReportType>> summaryReports = SummaryReports;
+    OutRoots.Add(MakeShareable(new FReportTreeSection(TEXT("Statistics Summary"), true, true, [Report, summaryReports, MakeRow](TArray<TSharedPtr<FReportTreeItem>>& OutChildren)
+    {
+        OutChildren.Add(MakeShareable(new FReportTreeContent([Report]() { return GenerateFStringListView(Report->ShaderSummaryStrings); })));
+        for (const auto& summary : summaryReports)
+        {
+            OutChildren.Add(MakeRow(summary, Report->QualityLevelMask, true, false));
+        }
+    }, MakeQualityLevelColumns(Report->QualityLevelMask, Report->QualityLevelMask))));
+
+    // Dump the rest of the shaders by vertex factory name. Names are interned, so grouping only hashes and compares IDs
+    TMap<FName, TArray<TSharedRef<ReportType>>> VertexFactoryNames;
+    for (const auto& report : Reports)
+    {
+        VertexFactoryNames.FindOrAdd(report->VertexFactoryName).Add(report);
+    }
+
+    for (auto& name : VertexFactoryNames)
+    {
+        // Individual shaders start collapsed, so expanding a category with thousands of shaders only makes one row per shader
+        TArray<TSharedRef<ReportType>> categoryReports = MoveTemp(name.Value);
+        const FMaliOCQualityLevelMask qualityLevels = Report->QualityLevelMask;
+        OutRoots.Add(MakeShareable(new FReportTreeSection(FString::Printf(TEXT("All %s"), *name.Key.ToString()), true, false, [categoryReports, MakeRow, qualityLevels](TArray<TSharedPtr<FReportTreeItem>>& OutChildren)
+        {
+            for (const auto& report : categoryReports)
+            {
+                OutChildren.Add(MakeRow(report, qualityLevels, false, true));
+            }
+        }, MakeQualityLevelColumns(qualityLevels, qualityLevels))));
+    }
+}
+
+void FReportWidgetGenerator::CreateReportTreeRoots()
+{
+    auto Report = Generator->GetReport();
+
+    // First show any errors, if there are any
+    if (Report->ErrorList.Num() > 0)
+    {
+        ReportTreeRoots.Add(MakeShareable(new FReportTreeSection(TEXT("Error Summary"), true, true, [Report](TArray<TSharedPtr<FReportTreeItem>>& OutChildren)
+        {
+            for (const auto& error : Report->ErrorList)
+            {
+                OutChildren.Add(MakeErrorRow(error, Report->QualityLevelMask));
+            }
+        }, MakeQualityLevelColumns(Report->QualityLevelMask, Report->QualityLevelMask))));
+    }
+
+    // If only a sample was compiled, say so before any of the sampled statistics
+    if (Report->Sampling.NumPermutations > 0)
+    {
+        ReportTreeRoots.Add(MakeShareable(new FReportTreeSection(TEXT("Sampling Estimate"), true, true, [Report](TArray<TSharedPtr<FReportTreeItem>>& OutChildren)
+        {
+            OutChildren.Add(MakeShareable(new FReportTreeContent([Report]() { return GenerateSamplingDetails(Report->Sampling); })));
+        })));
+    }
+
+    // Then list the permutations which only cross compiled after retrying (or not at all)
+    if (Report->CrossCompileRetries.Num() > 0)
+    {
+        ReportTreeRoots.Add(MakeShareable(new FReportTreeSection(TEXT("Cross Compilation Retries"), true, false, [Report](TArray<TSharedPtr<FReportTreeItem>>& OutChildren)
+        {
+            for (const auto& retry : Report->CrossCompileRetries)
+            {
+                const FString title = retry.VertexFactoryName.IsNone() ? FString(TEXT("Shaders without a vertex factory")) : retry.VertexFactoryName.ToString();
+                const FString outcome = FString::Printf(TEXT("%s after %u %s"), retry.bSucceeded ? TEXT("Succeeded") : TEXT("<Text.Warning>Failed</>"), retry.NumRetries, retry.NumRetries == 1 ? TEXT("retry") : TEXT("retries"));
+
+                OutChildren.Add(MakeShareable(new FReportTreeSection(title, false, true, [outcome](TArray<TSharedPtr<FReportTreeItem>>& OutRetryRows)
+                {
+                    TArray<FString> lines;
+                    lines.Add(outcome);
+                    OutRetryRows.Add(MakeShareable(new FReportTreeContent([lines]() { return GenerateFStringListView(lines); })));
+                }, MakeQualityLevelColumns(Report->QualityLevelMask, retry.QualityLevelMask))));
+            }
+        }, MakeQualityLevelColumns(Report->QualityLevelMask, Report->QualityLevelMask))));
+    }
+
+    // Next show Midgard reports if there are any
+    if (Report->MidgardReports.Num() > 0)
+    {
+        MakeStatisticsRows(ReportTreeRoots, Report, Report->MidgardSummaryReports, Report->MidgardReports, &MakeMidgardRow);
     }
 
     // Next show Utgard reports, if there are any. These should be mutually exclusive with Midgard reports
     if (Report->UtgardReports.Num() > 0)
     {
-        Widget->AddSlot()
-            .Padding(WidgetPadding)
-            .AutoHeight()
-            [
-                SNew(SExpandableArea)
-                .AreaTitle(FText::FromString(TEXT("Statistics Summary")))
-                .AreaTitleFont(FEditorStyle::GetFontStyle(TEXT("DetailsView.CategoryFontStyle")))
-                .InitiallyCollapsed(false)
-                .BorderBackgroundColor(FLinearColor(0.5f, 0.5f, 0.5f, 1.0f))
-                .Padding(WidgetPadding)
-                .BodyContent()
-                [
-                    SNew(SVerticalBox)
-                    + SVerticalBox::Slot()
-                    .Padding(WidgetPadding)
-                    .AutoHeight()
-                    [
-                        GenerateFStringListView(Report->ShaderSummaryStrings)
-                    ]
-                    + SVerticalBox::Slot()
-                        .AutoHeight()
-                        [
-                            ConstructUtgardDumpWidget(Report->UtgardSummaryReports, false)
-                        ]
-                ]
-            ];
+        MakeStatisticsRows(ReportTreeRoots, Report, Report->UtgardSummaryReports, Report->UtgardReports, &MakeUtgardRow);
+    }
+}
 
-        // Dump the rest of the shaders by vertex factory name
-        TMap<FString, TArray<TSharedRef<FMaliOCReport::FUtgardReport>>> VertexFactoryNames;
-        for (auto& report : Report->UtgardReports)
+TSharedRef<ITableRow> FReportWidgetGenerator::OnGenerateReportRow(TSharedPtr<FReportTreeItem> Item, const TSharedRef<STableViewBase>& OwnerTable)
+{
+    return SNew(STableRow<TSharedPtr<FReportTreeItem>>, OwnerTable)
+        .Padding(WidgetPadding)
+        [
+            Item->GenerateWidget()
+        ];
+}
+
+void FReportWidgetGenerator::OnGetReportChildren(TSharedPtr<FReportTreeItem> Item, TArray<TSharedPtr<FReportTreeItem>>& OutChildren)
+{
+    OutChildren = Item->GetChildren();
+}
+
+void FReportWidgetGenerator::OnReportExpansionChanged(TSharedPtr<FReportTreeItem> Item, bool bExpanded)
+{
+    // The first time a row is expanded, expand any children which want to start expanded
+    if (!bExpanded || Item->bHasBeenExpanded)
+    {
+        return;
+    }
+    Item->bHasBeenExpanded = true;
+
+    for (const auto& child : Item->GetChildren())
+    {
+        if (child->IsInitiallyExpanded())
         {
-            VertexFactoryNames.FindOrAdd(report->VertexFactoryName).Add(report);
+            ReportTree->SetItemExpansion(child, true);
         }
+    }
+}
+
+BEGIN_SLATE_FUNCTION_BUILD_OPTIMIZATION;
+TSharedRef<SWidget> FReportWidgetGenerator::ConstructReportWidget()
+{
+    CreateReportTreeRoots();
+
+    SAssignNew(ReportTree, STreeView<TSharedPtr<FReportTreeItem>>)
+        .TreeItemsSource(&ReportTreeRoots)
+        .SelectionMode(ESelectionMode::None)
+        .OnGenerateRow(this, &FReportWidgetGenerator::OnGenerateReportRow)
+        .OnGetChildren(this, &FReportWidgetGenerator::OnGetReportChildren)
+        .OnExpansionChanged(this, &FReportWidgetGenerator::OnReportExpansionChanged);
 
-        for (const auto& name : VertexFactoryNames)
+    for (const auto& root : ReportTreeRoots)
+    {
+        if (root->IsInitiallyExpanded())
         {
-            Widget->AddSlot()
-                .Padding(WidgetPadding)
-                .AutoHeight()
-                [
-                    SNew(SExpandableArea)
-                    .AreaTitle(FText::FromString(FString::Printf(TEXT("All %s"), *name.Key)))
-                    .AreaTitleFont(FEditorStyle::GetFontStyle(TEXT("DetailsView.CategoryFontStyle")))
-                    .InitiallyCollapsed(true)
-                    .BorderBackgroundColor(FLinearColor(0.5f, 0.5f, 0.5f, 1.0f))
-                    .Padding(WidgetPadding)
-                    .BodyContent()
-                    [
-                        ConstructUtgardDumpWidget(name.Value, true)
-                    ]
-                ];
+            ReportTree->SetItemExpansion(root, true);
         }
     }
 
-    return ReportWidget;
+    return ReportTree.ToSharedRef();
 }
 END_SLATE_FUNCTION_BUILD_OPTIMIZATION;
 
@@ -591,7 +812,7 @@ TSharedRef<SWidget> FReportWidgetGenerator::GetWidget()
         if (!CachedReportWidget.IsValid())
         {
             // Make the widget once then cache it
-            CachedReportWidget = ConstructReportWidget(Generator.Get());
+            CachedReportWidget = ConstructReportWidget();
         }
 
         return CachedReportWidget.ToSharedRef();
@@ -604,6 +825,11 @@ TSharedRef<SWidget> FReportWidgetGenerator::GetWidget()
             ThrobberTextLine1->SetText(FText::FromString(TEXT("Compiling HLSL to GLSL")));
             ThrobberTextLine2->SetText(FText());
         }
+        else if (progress == FAsyncReportGenerator::EProgress::REPORT_GENERATION_IN_PROGRESS)
+        {
+            ThrobberTextLine1->SetText(FText::FromString(TEXT("Generating Report")));
+            ThrobberTextLine2->SetText(FText());
+        }
         else
         {
             check(progress == FAsyncReportGenerator::EProgress::MALIOC_COMPILATION_IN_PROGRESS);
@@ -616,3 +842,144 @@ TSharedRef<SWidget> FReportWidgetGenerator::GetWidget()
         return ThrobberWidget.ToSharedRef();
     }
 }
+
+BEGIN_SLATE_FUNCTION_BUILD_OPTIMIZATION;
+FCostAttributionWidgetGenerator::FCostAttributionWidgetGenerator(TSharedRef<FMaliOCCostAttribution> CostAttribution) :
+Attribution(CostAttribution)
+{
+    ThrobberWidget = SNew(SVerticalBox)
+        + SVerticalBox::Slot()
+        .VAlign(VAlign_Center)
+        .HAlign(HAlign_Center)
+        [
+            SNew(SVerticalBox)
+            + SVerticalBox::Slot()
+            .Padding(WidgetPadding)
+            .VAlign(VAlign_Center)
+            .HAlign(HAlign_Center)
+            .AutoHeight()
+            [
+                SNew(SThrobber)
+                .NumPieces(7)
+            ]
+            + SVerticalBox::Slot()
+                .Padding(WidgetPadding)
+                .VAlign(VAlign_Center)
+                .HAlign(HAlign_Center)
+                .AutoHeight()
+                [
+                    SAssignNew(ThrobberText, SRichTextBlock)
+                    .TextStyle(FMaliOCStyle::Get(), "Text.Normal")
+                    .Justification(ETextJustify::Type::Center)
+                ]
+        ];
+}
+END_SLATE_FUNCTION_BUILD_OPTIMIZATION;
+
+bool FCostAttributionWidgetGenerator::IsAttributionComplete() const
+{
+    return Attribution->IsComplete();
+}
+
+BEGIN_SLATE_FUNCTION_BUILD_OPTIMIZATION;
+TSharedRef<SWidget> FCostAttributionWidgetGenerator::ConstructCostWidget()
+{
+    TSharedRef<SVerticalBox> costBox = SNew(SVerticalBox);
+
+    const TArray<FString>& errors = Attribution->GetErrors();
+    if (errors.Num() != 0)
+    {
+        AddStringListToVerticalBox(costBox, TEXT("Errors"), errors);
+        return SNew(SScrollBox) + SScrollBox::Slot()[costBox];
+    }
+
+    const FMaliOCSummaryCycles& baseline = Attribution->GetBaselineCycles();
+
+    TArray<FString> explanation;
+    explanation.Add(FString::Printf(TEXT("<Text.Bold>Summary shaders: %.4g cycles on the bound pipes (A %.4g, L/S %.4g, T %.4g), longest path</>"),
+        baseline.Bound, baseline.Arithmetic, baseline.LoadStore, baseline.Texture));
+    explanation.Add(TEXT("Cycles saved when each node's output is replaced with a constant, most expensive first. A node's cost includes the nodes before it that nothing else uses."));
+
+    costBox->AddSlot()
+        .AutoHeight()
+        .Padding(WidgetPadding)
+        [
+            GenerateFStringListView(explanation)
+        ];
+
+    costBox->AddSlot()
+        .AutoHeight()
+        [
+            SNew(SSeparator)
+        ];
+
+    const auto AsText = [](float Value) -> FText
+    {
+        return FText::FromString(FString::Printf(TEXT("%.4g"), Value));
+    };
+
+    const float columnWidths[] = { 4.0f, 1.0f, 1.0f, 1.0f, 1.0f };
+    const float widthScaleFactor = 50.0f;
+
+    const auto AddRow = [&](const FText(&Columns)[5])
+    {
+        TSharedPtr<SHorizontalBox> row = nullptr;
+
+        costBox->AddSlot()
+            .AutoHeight()
+            .Padding(WidgetPadding)
+            [
+                SAssignNew(row, SHorizontalBox)
+            ];
+
+        // The node column takes whatever width is left
+        for (int32 i = 0; i < 5; i++)
+        {
+            row->AddSlot()
+                .FillWidth(columnWidths[i])
+                .MaxWidth(i == 0 ? 0.0f : columnWidths[i] * widthScaleFactor)
+                [
+                    SNew(STextBlock)
+                    .Text(Columns[i])
+                    .Font(FEditorStyle::GetFontStyle(TEXT("PropertyWindow.NormalFont")))
+                ];
+        }
+    };
+
+    const FText header[5] = { FText::FromString(TEXT("Node")), FText::FromString(TEXT("Bound")), FText::FromString(TEXT("A")), FText::FromString(TEXT("L/S")), FText::FromString(TEXT("T")) };
+    AddRow(header);
+
+    for (const FMaliOCExpressionCost& cost : Attribution->GetCosts())
+    {
+        if (cost.bCompiled)
+        {
+            const FText columns[5] = { FText::FromString(cost.Caption), AsText(cost.Savings.Bound), AsText(cost.Savings.Arithmetic), AsText(cost.Savings.LoadStore), AsText(cost.Savings.Texture) };
+            AddRow(columns);
+        }
+        else
+        {
+            const FText columns[5] = { FText::FromString(cost.Caption), FText::FromString(TEXT("Did not compile")), FText::GetEmpty(), FText::GetEmpty(), FText::GetEmpty() };
+            AddRow(columns);
+        }
+    }
+
+    return SNew(SScrollBox) + SScrollBox::Slot()[costBox];
+}
+END_SLATE_FUNCTION_BUILD_OPTIMIZATION;
+
+TSharedRef<SWidget> FCostAttributionWidgetGenerator::GetWidget()
+{
+    if (Attribution->IsComplete())
+    {
+        if (!CachedCostWidget.IsValid())
+        {
+            // Make the widget once then cache it
+            CachedCostWidget = ConstructCostWidget();
+        }
+
+        return CachedCostWidget.ToSharedRef();
+    }
+
+    ThrobberText->SetText(FText::FromString(FString::Printf(TEXT("Compiling material variants: %d / %d"), Attribution->GetNumCompiledVariants(), Attribution->GetNumVariants())));
+    return ThrobberWidget.ToSharedRef();
+}
@@ -17,7 +17,11 @@
 #pragma once
 #include "MaliOCPrivatePCH.h"
 #include "MaliOCAsyncReportGenerator.h"
+#include "MaliOCCostAttribution.h"
 #include "SThrobber.h"
+#include "STreeView.h"
+
+class FReportTreeItem;
 
 /** Generates a report widget using the output from a report generator */
 class FReportWidgetGenerator : public TSharedFromThis < FReportWidgetGenerator >
@@ -54,4 +58,54 @@ private:
 
     /** Cached report widget we return after generation is complete */
     TSharedPtr<SWidget> CachedReportWidget = nullptr;
+
+    /** Top level rows of the report tree. Rows below these are created when they are first expanded */
+    TArray<TSharedPtr<FReportTreeItem>> ReportTreeRoots;
+    /** Tree view displaying the report. Only the rows which are scrolled into view have widgets */
+    TSharedPtr<STreeView<TSharedPtr<FReportTreeItem>>> ReportTree = nullptr;
+
+    /** Create the report tree and return it */
+    TSharedRef<SWidget> ConstructReportWidget();
+    /** Fill ReportTreeRoots from the finished report */
+    void CreateReportTreeRoots();
+    /** Tree view callback that makes the widget for a row */
+    TSharedRef<ITableRow> OnGenerateReportRow(TSharedPtr<FReportTreeItem> Item, const TSharedRef<STableViewBase>& OwnerTable);
+    /** Tree view callback that gets the children of a row */
+    void OnGetReportChildren(TSharedPtr<FReportTreeItem> Item, TArray<TSharedPtr<FReportTreeItem>>& OutChildren);
+    /** Tree view callback used to apply the initial expansion state of child rows */
+    void OnReportExpansionChanged(TSharedPtr<FReportTreeItem> Item, bool bExpanded);
+};
+
+/** Generates a ranked list of expression costs from a cost attribution */
+class FCostAttributionWidgetGenerator : public TSharedFromThis < FCostAttributionWidgetGenerator >
+{
+public:
+    /** @return a loading widget with the number of variants compiled if attribution is not yet finished, else the list of costs */
+    TSharedRef<SWidget> GetWidget();
+
+    /** @return true if attribution has completed */
+    bool IsAttributionComplete() const;
+
+    /** @param CostAttribution the attribution that we want to generate the widget for */
+    FCostAttributionWidgetGenerator(TSharedRef<FMaliOCCostAttribution> CostAttribution);
+    ~FCostAttributionWidgetGenerator() = default;
+    FCostAttributionWidgetGenerator(const FCostAttributionWidgetGenerator&) = delete;
+    FCostAttributionWidgetGenerator(FCostAttributionWidgetGenerator&&) = delete;
+    FCostAttributionWidgetGenerator& operator=(const FCostAttributionWidgetGenerator&) = delete;
+    FCostAttributionWidgetGenerator& operator=(FCostAttributionWidgetGenerator&&) = delete;
+
+private:
+    /** Attribution we make the widget for */
+    TSharedRef<FMaliOCCostAttribution> Attribution;
+
+    /** Throbber we show while the variants are compiling */
+    TSharedPtr<SWidget> ThrobberWidget = nullptr;
+    /** Text that accompanies the throbber */
+    TSharedPtr<SRichTextBlock> ThrobberText = nullptr;
+
+    /** Cached list widget we return after attribution is complete */
+    TSharedPtr<SWidget> CachedCostWidget = nullptr;
+
+    /** Create the list of costs and return it */
+    TSharedRef<SWidget> ConstructCostWidget();
 };
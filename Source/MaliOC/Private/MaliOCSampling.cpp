@@ -0,0 +1,331 @@
+/*
+* Copyright 2015 ARM Limited
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+
+#include "MaliOCPrivatePCH.h"
+#include "MaliOCSampling.h"
+#include "MaliOCAsyncCompiler.h"
+
+static TAutoConsoleVariable<int32> CVarSamplesPerStratum(
+    TEXT("MaliOC.Sampling.SamplesPerStratum"),
+    0,
+    TEXT("Number of permutations batch runs compile per vertex factory and shader frequency. 0 (default) compiles every permutation."),
+    ECVF_Default);
+
+static TAutoConsoleVariable<float> CVarFlagCycleThreshold(
+    TEXT("MaliOC.Sampling.CycleThreshold"),
+    0.0f,
+    TEXT("Sampled materials whose estimated bound pipe cycles could exceed this are flagged for a full compile. 0 (default) disables the check."),
+    ECVF_Default);
+
+FMaliOCSamplingOptions FMaliOCSamplingOptions::GetConsoleVariableOptions()
+{
+    FMaliOCSamplingOptions options;
+    options.SamplesPerStratum = FMath::Max(CVarSamplesPerStratum.GetValueOnGameThread(), 0);
+    options.FlagCycleThreshold = FMath::Max(CVarFlagCycleThreshold.GetValueOnGameThread(), 0.0f);
+    return options;
+}
+
+void SelectStratumSample(const TArray<const FShaderType*>& ShaderTypes, const TMap<FName, FString>& RepresentativeShaderTypes, uint32 SamplesPerStratum, TArray<const FShaderType*>& OutSample)
+{
+    const int32 numTypes = ShaderTypes.Num();
+    if ((uint32)numTypes <= SamplesPerStratum)
+    {
+        OutSample.Append(ShaderTypes);
+        return;
+    }
+
+    TArray<bool> chosen;
+    chosen.AddZeroed(numTypes);
+    uint32 numChosen = 0;
+
+    // Representative shaders are the ones the summary shows, so they're always compiled exactly
+    for (int32 i = 0; i < numTypes; i++)
+    {
+        if (RepresentativeShaderTypes.Contains(FName(ShaderTypes[i]->GetName())))
+        {
+            chosen[i] = true;
+            numChosen++;
+        }
+    }
+
+    // Spread the rest of the sample evenly through the stratum, skipping over anything already chosen
+    const uint32 numToChoose = SamplesPerStratum > numChosen ? SamplesPerStratum - numChosen : 0;
+    for (uint32 sample = 0; sample < numToChoose; sample++)
+    {
+        int32 index = (int32)(((uint64)sample * numTypes) / numToChoose);
+        while (chosen[index])
+        {
+            index = (index + 1) % numTypes;
+        }
+        chosen[index] = true;
+    }
+
+    for (int32 i = 0; i < numTypes; i++)
+    {
+        if (chosen[i])
+        {
+            OutSample.Add(ShaderTypes[i]);
+        }
+    }
+}
+
+const TCHAR* GetSampledMetricName(EMaliOCSampledMetric Metric)
+{
+    switch (Metric)
+    {
+    case EMaliOCSampledMetric::BoundPipeLongestPathCycles:
+        return TEXT("Longest Path, Bound Pipe (Cycles)");
+    case EMaliOCSampledMetric::ArithmeticLongestPathCycles:
+        return TEXT("Longest Path, A (Cycles)");
+    case EMaliOCSampledMetric::LoadStoreLongestPathCycles:
+        return TEXT("Longest Path, L/S (Cycles)");
+    case EMaliOCSampledMetric::TextureLongestPathCycles:
+        return TEXT("Longest Path, T (Cycles)");
+    case EMaliOCSampledMetric::WorkRegisters:
+        return TEXT("Work Registers");
+    case EMaliOCSampledMetric::UniformRegisters:
+        return TEXT("Uniform Registers");
+    default:
+        check(false);
+        return TEXT("");
+    }
+}
+
+/** @return the value of every metric for one render target */
+static TStaticArray<float, (uint32)EMaliOCSampledMetric::Num> GetMetrics(const FMaliOCRawCompilerOutput::FMidgardOutput::FRenderTarget& RenderTarget)
+{
+    TStaticArray<float, (uint32)EMaliOCSampledMetric::Num> metrics;
+    metrics[(uint32)EMaliOCSampledMetric::BoundPipeLongestPathCycles] = FMath::Max3(RenderTarget.arithmetic_longest_path, RenderTarget.load_store_longest_path, RenderTarget.texture_longest_path);
+    metrics[(uint32)EMaliOCSampledMetric::ArithmeticLongestPathCycles] = RenderTarget.arithmetic_longest_path;
+    metrics[(uint32)EMaliOCSampledMetric::LoadStoreLongestPathCycles] = RenderTarget.load_store_longest_path;
+    metrics[(uint32)EMaliOCSampledMetric::TextureLongestPathCycles] = RenderTarget.texture_longest_path;
+    metrics[(uint32)EMaliOCSampledMetric::WorkRegisters] = RenderTarget.work_registers_used;
+    metrics[(uint32)EMaliOCSampledMetric::UniformRegisters] = RenderTarget.uniform_registers_used;
+    return metrics;
+}
+
+double GetStudentTQuantile(double DegreesOfFreedom)
+{
+    // Two sided 95% critical values for 1 to 30 degrees of freedom
+    static const double Table[] =
+    {
+        12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+        2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+        2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042,
+    };
+
+    const int32 index = FMath::FloorToInt(DegreesOfFreedom) - 1;
+    if (index < ARRAY_COUNT(Table))
+    {
+        return Table[FMath::Max(index, 0)];
+    }
+
+    // Beyond the table, expand around the normal quantile. This is within 0.001 from 30 degrees of freedom up
+    const double z = 1.959964;
+    const double z3 = z * z * z;
+    const double z5 = z3 * z * z;
+    return z + (z3 + z) / (4.0 * DegreesOfFreedom) + (5.0 * z5 + 16.0 * z3 + 3.0 * z) / (96.0 * FMath::Square(DegreesOfFreedom));
+}
+
+FMaliOCSamplingSummary EstimateFromSample(const FMaliOCRawCompilerOutput& Output, const TMap<FMaliOCSamplingStratum, uint32>& StratumSizes, const FMaliOCSamplingOptions& Options)
+{
+    const uint32 numMetrics = (uint32)EMaliOCSampledMetric::Num;
+
+    FMaliOCSamplingSummary summary;
+    summary.NumSampled = Output.ErrorOutput.Num() + Output.MidgardOutput.Num() + Output.UtgardOutput.Num();
+
+    for (const auto& stratum : StratumSizes)
+    {
+        summary.NumPermutations += stratum.Value;
+    }
+
+    if (Output.ErrorOutput.Num() > 0)
+    {
+        summary.bFlagged = true;
+        summary.FlagReasons.Add(FString::Printf(TEXT("%d sampled permutations failed to compile"), Output.ErrorOutput.Num()));
+    }
+
+    // Gather the sample values of each stratum. Shaders with several render targets contribute their most expensive one.
+    TMap<FMaliOCSamplingStratum, TArray<TStaticArray<float, numMetrics>>> samples;
+    uint32 numSpilling = 0;
+
+    for (const auto& output : Output.MidgardOutput)
+    {
+        if (output.RenderTargets.Num() == 0)
+        {
+            continue;
+        }
+
+        TStaticArray<float, numMetrics> values = GetMetrics(output.RenderTargets[0]);
+        bool bSpilling = output.RenderTargets[0].spilling_used;
+        for (int32 rt = 1; rt < output.RenderTargets.Num(); rt++)
+        {
+            const TStaticArray<float, numMetrics> rtValues = GetMetrics(output.RenderTargets[rt]);
+            for (uint32 metric = 0; metric < numMetrics; metric++)
+            {
+                values[metric] = FMath::Max(values[metric], rtValues[metric]);
+            }
+            bSpilling = bSpilling || output.RenderTargets[rt].spilling_used;
+        }
+
+        if (bSpilling)
+        {
+            numSpilling++;
+        }
+
+        const FMaliOCSamplingStratum stratum = { output.CommonOutput.VertexFactoryName, output.CommonOutput.Frequency };
+        samples.FindOrAdd(stratum).Add(values);
+    }
+
+    if (numSpilling > 0)
+    {
+        summary.bFlagged = true;
+        summary.FlagReasons.Add(FString::Printf(TEXT("%u sampled permutations use register spilling"), numSpilling));
+    }
+
+    if (samples.Num() == 0)
+    {
+        return summary;
+    }
+
+    // Only strata we have samples for can be estimated. Their weights are renormalised to cover the whole material.
+    double totalWeight = 0.0;
+    for (const auto& stratumSamples : samples)
+    {
+        const uint32* stratumSize = StratumSizes.Find(stratumSamples.Key);
+        totalWeight += FMath::Max<double>(stratumSize != nullptr ? *stratumSize : 0, stratumSamples.Value.Num());
+    }
+
+    summary.Estimates.SetNum(numMetrics);
+
+    for (uint32 metric = 0; metric < numMetrics; metric++)
+    {
+        // Stratified estimator: the mean is the weighted mean of the stratum means, and the variance of the mean
+        // sums each stratum's variance of the mean, with the finite population correction as we sample without replacement
+        double mean = 0.0;
+        double varianceOfMean = 0.0;
+        float sampleMin = MAX_flt;
+        float sampleMax = -MAX_flt;
+        bool bHasConfidenceInterval = true;
+
+        TArray<double> stratumMeans;
+        TArray<double> stratumVariances;
+        TArray<double> stratumWeights;
+        TArray<double> stratumSampleSizes;
+        TArray<double> stratumSizes;
+
+        // Within-stratum variance pooled over every stratum with more than one sample
+        double pooledSumOfSquares = 0.0;
+        double pooledDegreesOfFreedom = 0.0;
+
+        for (const auto& stratumSamples : samples)
+        {
+            const TArray<TStaticArray<float, numMetrics>>& values = stratumSamples.Value;
+            const uint32* stratumSizePtr = StratumSizes.Find(stratumSamples.Key);
+            const double n = values.Num();
+            const double size = FMath::Max<double>(stratumSizePtr != nullptr ? *stratumSizePtr : 0, n);
+            const double weight = size / totalWeight;
+
+            double stratumMean = 0.0;
+            for (const auto& value : values)
+            {
+                stratumMean += value[metric];
+                sampleMin = FMath::Min(sampleMin, value[metric]);
+                sampleMax = FMath::Max(sampleMax, value[metric]);
+            }
+            stratumMean /= n;
+
+            double stratumVariance = 0.0;
+            if (n > 1)
+            {
+                for (const auto& value : values)
+                {
+                    stratumVariance += FMath::Square(value[metric] - stratumMean);
+                }
+                pooledSumOfSquares += stratumVariance;
+                pooledDegreesOfFreedom += n - 1;
+                stratumVariance /= (n - 1);
+            }
+
+            mean += weight * stratumMean;
+
+            stratumMeans.Add(stratumMean);
+            stratumVariances.Add(stratumVariance);
+            stratumWeights.Add(weight);
+            stratumSampleSizes.Add(n);
+            stratumSizes.Add(size);
+        }
+
+        const double pooledVariance = pooledDegreesOfFreedom > 0.0 ? pooledSumOfSquares / pooledDegreesOfFreedom : 0.0;
+
+        for (int32 i = 0; i < stratumMeans.Num(); i++)
+        {
+            const double n = stratumSampleSizes[i];
+            const double size = stratumSizes[i];
+
+            // A single sample says nothing about its stratum's spread. Rather than treat it as exact, borrow the variance of the other strata
+            if (n == 1.0 && size > n)
+            {
+                if (pooledDegreesOfFreedom > 0.0)
+                {
+                    stratumVariances[i] = pooledVariance;
+                }
+                else
+                {
+                    bHasConfidenceInterval = false;
+                }
+            }
+
+            varianceOfMean += FMath::Square(stratumWeights[i]) * (1.0 - n / size) * stratumVariances[i] / n;
+        }
+
+        // Variance over all permutations is the within-stratum variance plus the spread of the stratum means
+        double populationVariance = 0.0;
+        for (int32 i = 0; i < stratumMeans.Num(); i++)
+        {
+            populationVariance += stratumWeights[i] * (stratumVariances[i] + FMath::Square(stratumMeans[i] - mean));
+        }
+
+        // The variances are estimated from a handful of samples, so the interval is widened with Student's t rather than the normal 1.96.
+        // Without any degrees of freedom every sampled stratum was compiled exactly and varianceOfMean is 0
+        const double quantile = pooledDegreesOfFreedom > 0.0 ? GetStudentTQuantile(pooledDegreesOfFreedom) : 0.0;
+        const double halfInterval = bHasConfidenceInterval ? quantile * FMath::Sqrt(varianceOfMean) : 0.0;
+
+        FMaliOCSampledEstimate& estimate = summary.Estimates[metric];
+        estimate.Mean = mean;
+        estimate.LowerBound = mean - halfInterval;
+        estimate.UpperBound = mean + halfInterval;
+        estimate.bHasConfidenceInterval = bHasConfidenceInterval;
+        estimate.StandardDeviation = FMath::Sqrt(populationVariance);
+        estimate.Min = sampleMin;
+        estimate.Max = sampleMax;
+    }
+
+    const FMaliOCSampledEstimate& cycles = summary.Estimates[(uint32)EMaliOCSampledMetric::BoundPipeLongestPathCycles];
+    if (Options.FlagCycleThreshold > 0.0f && (cycles.UpperBound > Options.FlagCycleThreshold || cycles.Max > Options.FlagCycleThreshold))
+    {
+        summary.bFlagged = true;
+        summary.FlagReasons.Add(FString::Printf(TEXT("Bound pipe cycles may exceed %.4g"), Options.FlagCycleThreshold));
+    }
+    else if (Options.FlagCycleThreshold > 0.0f && !cycles.bHasConfidenceInterval)
+    {
+        summary.bFlagged = true;
+        summary.FlagReasons.Add(FString::Printf(TEXT("Too few permutations were sampled to tell whether bound pipe cycles exceed %.4g"), Options.FlagCycleThreshold));
+    }
+
+    return summary;
+}
@@ -0,0 +1,134 @@
+/*
+* Copyright 2015 ARM Limited
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+
+#pragma once
+#include "MaliOCPrivatePCH.h"
+
+struct FMaliOCRawCompilerOutput;
+
+/** Options for compiling a sample of a material's permutations instead of all of them */
+struct FMaliOCSamplingOptions
+{
+    /** Number of samples per stratum the material editor uses when sampling is switched on */
+    enum { DefaultSamplesPerStratum = 4 };
+
+    /** Number of permutations to compile per stratum (vertex factory and shader frequency). 0 compiles every permutation */
+    uint32 SamplesPerStratum = 0;
+    /** A sampled material is flagged for a full compile if the upper bound of its bound pipe cycles is above this. 0 disables the check */
+    float FlagCycleThreshold = 0.0f;
+
+    bool IsEnabled() const
+    {
+        return SamplesPerStratum > 0;
+    }
+
+    /** @return the options set by the MaliOC.Sampling.* console variables, which is how batch runs switch sampling on. Game thread only */
+    static FMaliOCSamplingOptions GetConsoleVariableOptions();
+};
+
+/** A group of permutations that is sampled independently: all the permutations of one vertex factory and shader frequency */
+struct FMaliOCSamplingStratum
+{
+    /** Pretty vertex factory name, as in FMaliOCRawCompilerOutput::FCommonOutput */
+    FName VertexFactoryName;
+    EShaderFrequency Frequency;
+
+    bool operator==(const FMaliOCSamplingStratum& Other) const
+    {
+        return VertexFactoryName == Other.VertexFactoryName && Frequency == Other.Frequency;
+    }
+
+    friend uint32 GetTypeHash(const FMaliOCSamplingStratum& Stratum)
+    {
+        return HashCombine(GetTypeHash(Stratum.VertexFactoryName), (uint32)Stratum.Frequency);
+    }
+};
+
+/**
+ * Choose the permutations of one stratum to compile.
+ * Representative shaders are always chosen. The rest of the sample is spread evenly through ShaderTypes, so the choice is deterministic.
+ * @param ShaderTypes every shader type of the stratum, in a stable order
+ * @param RepresentativeShaderTypes names of the material's representative shader types
+ * @param SamplesPerStratum number of shader types to choose, not counting any representative shaders beyond that number
+ * @param OutSample the chosen shader types are appended to this
+ */
+void SelectStratumSample(const TArray<const FShaderType*>& ShaderTypes, const TMap<FName, FString>& RepresentativeShaderTypes, uint32 SamplesPerStratum, TArray<const FShaderType*>& OutSample);
+
+/** Midgard statistics which are estimated for a sampled material */
+enum class EMaliOCSampledMetric : uint8
+{
+    BoundPipeLongestPathCycles,
+    ArithmeticLongestPathCycles,
+    LoadStoreLongestPathCycles,
+    TextureLongestPathCycles,
+    WorkRegisters,
+    UniformRegisters,
+    Num
+};
+
+/** @return the display name of a metric */
+const TCHAR* GetSampledMetricName(EMaliOCSampledMetric Metric);
+
+/** Estimate of the distribution of a statistic over every permutation of the material */
+struct FMaliOCSampledEstimate
+{
+    /** Stratified estimate of the mean */
+    float Mean = 0.0f;
+    /** 95% confidence bounds of the mean. Both equal the mean if there's no confidence interval */
+    float LowerBound = 0.0f;
+    float UpperBound = 0.0f;
+    /**
+     * False if a stratum with permutations left uncompiled had a single sample, and no stratum had more than one to borrow a variance from.
+     * The spread of such a stratum is unknown, so the mean can't be bounded.
+     */
+    bool bHasConfidenceInterval = true;
+    /** Estimated standard deviation over all permutations */
+    float StandardDeviation = 0.0f;
+    /** Extremes of the sample */
+    float Min = 0.0f;
+    float Max = 0.0f;
+};
+
+/** Result of compiling a sample of a material's permutations */
+struct FMaliOCSamplingSummary
+{
+    /** Number of permutations that were compiled. 0 if the material wasn't sampled */
+    uint32 NumSampled = 0;
+    /** Number of permutations the sample was drawn from */
+    uint32 NumPermutations = 0;
+    /** Estimates, indexed by EMaliOCSampledMetric. Empty if there was no Midgard output to estimate from */
+    TArray<FMaliOCSampledEstimate> Estimates;
+    /** True if the sample suggests the material deserves a full compile */
+    bool bFlagged = false;
+    /** Why the material was flagged */
+    TArray<FString> FlagReasons;
+};
+
+/**
+ * The 97.5th percentile of Student's t distribution, which bounds a 95% confidence interval of a mean estimated from few samples.
+ * @param DegreesOfFreedom the degrees of freedom of the variance estimate. Must be at least 1
+ * @return e.g. 3.182 for 3 degrees of freedom, tending to 1.96 as DegreesOfFreedom grows
+ */
+double GetStudentTQuantile(double DegreesOfFreedom);
+
+/**
+ * Estimate the statistics of every permutation from the compiled sample. Thread safe.
+ * @param Output raw compiler output of the sampled permutations
+ * @param StratumSizes total number of permutations in each stratum
+ * @param Options the options the sample was drawn with
+ */
+FMaliOCSamplingSummary EstimateFromSample(const FMaliOCRawCompilerOutput& Output, const TMap<FMaliOCSamplingStratum, uint32>& StratumSizes, const FMaliOCSamplingOptions& Options);
@@ -0,0 +1,152 @@
+/*
+* Copyright 2015 ARM Limited
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+
+#include "MaliOCPrivatePCH.h"
+#include "MaliOCShaderSource.h"
+
+static TAutoConsoleVariable<int32> CVarRetainShaderSource(
+    TEXT("MaliOC.RetainShaderSource"),
+    1,
+    TEXT("1 (default) keeps the compressed source code of compiled shaders so it can be shown in the report. 0 drops it to save memory."),
+    ECVF_Default);
+
+/** Content addressed store of all live shader sources. Entries are weak, so a source is freed as soon as no report references it */
+class FMaliOCShaderSourceStore final
+{
+public:
+    static FMaliOCShaderSourceStore& Get()
+    {
+        static FMaliOCShaderSourceStore Store;
+        return Store;
+    }
+
+    FMaliOCShaderSourceRef FindOrAdd(const ANSICHAR* Source)
+    {
+        const int32 sourceSize = FCStringAnsi::Strlen(Source);
+
+        FSHAHash hash;
+        FSHA1::HashBuffer(Source, sourceSize, hash.Hash);
+
+        // Hashing doesn't need the lock, so only take it to look up the store
+        {
+            FScopeLock lock(&StoreLock);
+            FMaliOCShaderSourceRef existing = Sources.FindRef(hash).Pin();
+            if (existing.IsValid())
+            {
+                return existing;
+            }
+        }
+
+        // Compress outside of the lock, as this is the expensive part
+        TArray<uint8> compressed;
+        int32 compressedSize = FCompression::CompressMemoryBound(COMPRESS_ZLIB, sourceSize);
+        compressed.AddUninitialized(compressedSize);
+        if (FCompression::CompressMemory(COMPRESS_ZLIB, compressed.GetData(), compressedSize, Source, sourceSize) && compressedSize < sourceSize)
+        {
+            compressed.SetNum(compressedSize, false);
+        }
+        else
+        {
+            // Tiny sources can grow when compressed. Just keep those as they are.
+            compressed.Reset();
+            compressed.Append((const uint8*)Source, sourceSize);
+        }
+        compressed.Shrink();
+
+        FMaliOCShaderSourceRef newSource = MakeShareable(new FMaliOCShaderSource(hash, MoveTemp(compressed), sourceSize));
+
+        FScopeLock lock(&StoreLock);
+
+        // Another thread may have stored the same source while we were compressing it
+        FMaliOCShaderSourceRef existing = Sources.FindRef(hash).Pin();
+        if (existing.IsValid())
+        {
+            return existing;
+        }
+
+        // Occasionally sweep out entries for sources which have been freed, so the store doesn't grow forever
+        if (Sources.Num() >= NextPruneSize)
+        {
+            for (auto it = Sources.CreateIterator(); it; ++it)
+            {
+                if (!it.Value().IsValid())
+                {
+                    it.RemoveCurrent();
+                }
+            }
+            NextPruneSize = FMath::Max(Sources.Num() * 2, MinPruneSize);
+        }
+
+        Sources.Add(hash, newSource);
+        return newSource;
+    }
+
+private:
+    FMaliOCShaderSourceStore() = default;
+
+    static const int32 MinPruneSize = 1024;
+
+    FCriticalSection StoreLock;
+    TMap<FSHAHash, TWeakPtr<const FMaliOCShaderSource, ESPMode::ThreadSafe>> Sources;
+    int32 NextPruneSize = MinPruneSize;
+};
+
+FMaliOCShaderSourceRef FMaliOCShaderSource::Create(const ANSICHAR* Source)
+{
+    return FMaliOCShaderSourceStore::Get().FindOrAdd(Source);
+}
+
+FMaliOCShaderSource::FMaliOCShaderSource(const FSHAHash& SourceHash, TArray<uint8>&& SourceCompressedData, int32 SourceUncompressedSize) :
+Hash(SourceHash),
+CompressedData(MoveTemp(SourceCompressedData)),
+UncompressedSize(SourceUncompressedSize)
+{
+}
+
+FString FMaliOCShaderSource::Decompress() const
+{
+    TArray<ANSICHAR> source;
+    source.AddZeroed(UncompressedSize + 1);
+
+    if (CompressedData.Num() == UncompressedSize)
+    {
+        // Stored uncompressed
+        FMemory::Memcpy(source.GetData(), CompressedData.GetData(), UncompressedSize);
+    }
+    else
+    {
+        const bool success = FCompression::UncompressMemory(COMPRESS_ZLIB, source.GetData(), UncompressedSize, CompressedData.GetData(), CompressedData.Num());
+        check(success);
+    }
+
+    return ANSI_TO_TCHAR(source.GetData());
+}
+
+int32 FMaliOCShaderSource::GetUncompressedSize() const
+{
+    return UncompressedSize;
+}
+
+int32 FMaliOCShaderSource::GetCompressedSize() const
+{
+    return CompressedData.Num();
+}
+
+bool ShouldRetainShaderSource()
+{
+    return !IsRunningCommandlet() && CVarRetainShaderSource.GetValueOnGameThread() != 0;
+}
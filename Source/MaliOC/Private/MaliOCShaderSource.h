@@ -0,0 +1,70 @@
+/*
+* Copyright 2015 ARM Limited
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+
+#pragma once
+#include "MaliOCPrivatePCH.h"
+
+class FMaliOCShaderSource;
+
+/** Shared handle to a block of shader source. Safe to copy between threads */
+typedef TSharedPtr<const FMaliOCShaderSource, ESPMode::ThreadSafe> FMaliOCShaderSourceRef;
+
+/**
+ * Shader source code, stored compressed.
+ * Sources are content addressed, so identical sources (such as the same shader appearing in several reports) share a single compressed blob.
+ * The source is only decompressed when somebody actually wants to look at it.
+ */
+class FMaliOCShaderSource final
+{
+public:
+    /**
+     * Compress the given source, or find an identical source that has already been stored. Thread safe.
+     * @param Source null terminated shader source
+     * @return a handle to the stored source
+     */
+    static FMaliOCShaderSourceRef Create(const ANSICHAR* Source);
+
+    /** @return the decompressed source code */
+    FString Decompress() const;
+
+    /** @return the size of the source code in bytes when decompressed */
+    int32 GetUncompressedSize() const;
+
+    /** @return the number of bytes used to store the compressed source code */
+    int32 GetCompressedSize() const;
+
+    FMaliOCShaderSource(const FSHAHash& SourceHash, TArray<uint8>&& SourceCompressedData, int32 SourceUncompressedSize);
+    ~FMaliOCShaderSource() = default;
+    FMaliOCShaderSource(const FMaliOCShaderSource&) = delete;
+    FMaliOCShaderSource(FMaliOCShaderSource&&) = delete;
+    FMaliOCShaderSource& operator=(const FMaliOCShaderSource&) = delete;
+    FMaliOCShaderSource& operator=(FMaliOCShaderSource&&) = delete;
+
+private:
+    /** SHA1 of the uncompressed source. Used as the key into the shared store */
+    const FSHAHash Hash;
+    /** ZLib compressed ANSI source. If compression didn't help, this is the uncompressed source */
+    const TArray<uint8> CompressedData;
+    /** Size of the ANSI source, not including the null terminator */
+    const int32 UncompressedSize;
+};
+
+/**
+ * @return true if compile jobs should keep the source code of the shaders they compile.
+ * Source is dropped for commandlets, or when MaliOC.RetainShaderSource is 0, as batch runs never display it.
+ */
+bool ShouldRetainShaderSource();
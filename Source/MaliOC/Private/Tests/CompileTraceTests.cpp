@@ -0,0 +1,216 @@
+/*
+* Copyright 2015 ARM Limited
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+
+#include "../MaliOCPrivatePCH.h"
+#include "../MaliOCCompileTrace.h"
+#include "AutomationTest.h"
+
+/** @return true if two lists of compiler strings are the same */
+static bool AreStringListsEqual(char* const* A, char* const* B, unsigned int Num)
+{
+    for (unsigned int i = 0; i < Num; i++)
+    {
+        if (FCStringAnsi::Strcmp(A[i], B[i]) != 0)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FMaliOCCompileTraceRoundTripTest, "MaliOC.CompileTrace.RoundTrip", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+// Record a compile, write the trace out, load it back and check that replaying gives the recorded outputs
+bool FMaliOCCompileTraceRoundTripTest::RunTest(const FString& Parameters)
+{
+    if (FMaliOCCompileTrace::GetActive().IsValid())
+    {
+        AddError(TEXT("Stop the active compile trace before running this test"));
+        return false;
+    }
+
+    const FString path = FPaths::Combine(*FPaths::GameSavedDir(), TEXT("MaliOC"), TEXT("CompileTraceRoundTrip.bin"));
+    const FString identity = TEXT("Mali-T600 r0p0 Mali-T600_r0p0-00rel0");
+    const ANSICHAR* const source = "void main() { gl_FragColor = vec4(1.0); }";
+
+    // Outputs shaped like a Midgard compile with a warning and one render target
+    char warning[] = "Warning: unused variable";
+    char key[] = "render_target";
+    char value[] = "0";
+    char* warnings[] = { warning };
+    char* entries[] = { key, value };
+    malioc_key_value_pairs flexibleOutput;
+    flexibleOutput.number_of_entries = ARRAY_COUNT(entries);
+    flexibleOutput.list = entries;
+
+    malioc_outputs outputs;
+    FMemory::Memzero(outputs);
+    outputs.number_of_warnings = ARRAY_COUNT(warnings);
+    outputs.warnings = warnings;
+    outputs.number_of_flexible_outputs = 1;
+    outputs.flexible_outputs = &flexibleOutput;
+
+    FMaliOCCompileTrace::BeginRecording(path);
+    FMaliOCCompileTrace::GetActive()->Add(identity, "fragment", source, true, outputs);
+    FMaliOCCompileTrace::GetActive()->Add(identity, "vertex", source, false, outputs);
+    FMaliOCCompileTrace::Stop();
+
+    const bool bLoaded = FMaliOCCompileTrace::BeginReplay(path);
+    TestTrue(TEXT("The recorded trace must load"), bLoaded);
+    if (bLoaded)
+    {
+        TSharedPtr<FMaliOCCompileTrace, ESPMode::ThreadSafe> trace = FMaliOCCompileTrace::GetActive();
+
+        const FMaliOCCompileTraceRecord* record = trace->Find(identity, "fragment", source);
+        TestTrue(TEXT("The recorded compile must be found"), record != nullptr);
+        if (record != nullptr)
+        {
+            malioc_outputs replayed;
+            TestTrue(TEXT("The compiler ran for the recorded compile"), record->GetOutputs(replayed));
+            TestEqual(TEXT("Replayed errors"), (int32)replayed.number_of_errors, 0);
+            TestTrue(TEXT("Replayed warnings"), replayed.number_of_warnings == outputs.number_of_warnings && AreStringListsEqual(replayed.warnings, outputs.warnings, outputs.number_of_warnings));
+            TestTrue(TEXT("Replayed flexible outputs"), replayed.number_of_flexible_outputs == 1 && replayed.flexible_outputs[0].number_of_entries == flexibleOutput.number_of_entries &&
+                AreStringListsEqual(replayed.flexible_outputs[0].list, flexibleOutput.list, flexibleOutput.number_of_entries));
+        }
+
+        const FMaliOCCompileTraceRecord* failedRecord = trace->Find(identity, "vertex", source);
+        malioc_outputs failedOutputs;
+        TestTrue(TEXT("A compile where the compiler didn't run is replayed as such"), failedRecord != nullptr && !failedRecord->GetOutputs(failedOutputs));
+
+        TestTrue(TEXT("A compile that wasn't recorded must not be found"), trace->Find(identity, "fragment", "void main() {}") == nullptr);
+    }
+
+    FMaliOCCompileTrace::Stop();
+    IFileManager::Get().Delete(*path);
+
+    return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FMaliOCCompileTraceValidationTest, "MaliOC.CompileTrace.Validation", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+// Records loaded from a trace must be rejected unless they are consistent, as traces may come from anywhere
+bool FMaliOCCompileTraceValidationTest::RunTest(const FString& Parameters)
+{
+    const auto makeString = [](const ANSICHAR* String)
+    {
+        TArray<ANSICHAR> string;
+        string.Append(String, FCStringAnsi::Strlen(String) + 1);
+        return string;
+    };
+
+    FMaliOCCompileTraceRecord valid;
+    valid.ShaderType = makeString("fragment");
+    valid.Source = makeString("void main() {}");
+    valid.bCompilerRan = true;
+    valid.Strings.Add(makeString("error"));
+    valid.Strings.Add(makeString("key"));
+    valid.Strings.Add(makeString("value"));
+    valid.NumErrors = 1;
+    valid.FlexibleOutputSizes.Add(2);
+    TestTrue(TEXT("A consistent record is accepted"), valid.FinishLoading());
+
+    FMaliOCCompileTraceRecord tooFewStrings = valid;
+    tooFewStrings.NumWarnings = 1;
+    TestFalse(TEXT("Counts that add up to more strings than there are are rejected"), tooFewStrings.FinishLoading());
+
+    FMaliOCCompileTraceRecord wrappingCount = valid;
+    wrappingCount.NumErrors = MAX_uint32;
+    wrappingCount.NumWarnings = 2;
+    TestFalse(TEXT("Counts that only add up when they wrap around are rejected"), wrappingCount.FinishLoading());
+
+    FMaliOCCompileTraceRecord emptySource = valid;
+    emptySource.Source.Empty();
+    TestFalse(TEXT("An empty source is rejected"), emptySource.FinishLoading());
+
+    FMaliOCCompileTraceRecord emptyShaderType = valid;
+    emptyShaderType.ShaderType.Empty();
+    TestFalse(TEXT("An empty shader type is rejected"), emptyShaderType.FinishLoading());
+
+    FMaliOCCompileTraceRecord unterminatedString = valid;
+    unterminatedString.Strings[1].Pop();
+    TestFalse(TEXT("A string without a null terminator is rejected"), unterminatedString.FinishLoading());
+
+    return true;
+}
+
+/** Write a trace file around UncompressedRecords, with the header claiming UncompressedSize bytes */
+static void WriteTraceFile(const FString& Path, TArray<uint8>& UncompressedRecords, int32 UncompressedSize)
+{
+    TArray<uint8> bytes;
+    FMemoryWriter writer(bytes);
+    uint32 magic = 0x4D4F4354; // "MOCT"
+    uint32 version = 1;
+    writer << magic;
+    writer << version;
+    writer << UncompressedSize;
+
+    const int32 headerSize = bytes.Num();
+    int32 compressedSize = FCompression::CompressMemoryBound(COMPRESS_ZLIB, UncompressedRecords.Num());
+    bytes.AddUninitialized(compressedSize);
+    FCompression::CompressMemory(COMPRESS_ZLIB, bytes.GetData() + headerSize, compressedSize, UncompressedRecords.GetData(), UncompressedRecords.Num());
+    bytes.SetNum(headerSize + compressedSize, false);
+
+    FFileHelper::SaveArrayToFile(bytes, *Path);
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FMaliOCCompileTraceCorruptFileTest, "MaliOC.CompileTrace.CorruptFile", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+// Sizes and counts in a trace file must be checked against the file before anything is allocated for them
+bool FMaliOCCompileTraceCorruptFileTest::RunTest(const FString& Parameters)
+{
+    if (FMaliOCCompileTrace::GetActive().IsValid())
+    {
+        AddError(TEXT("Stop the active compile trace before running this test"));
+        return false;
+    }
+
+    const FString path = FPaths::Combine(*FPaths::GameSavedDir(), TEXT("MaliOC"), TEXT("CompileTraceCorrupt.bin"));
+
+    // One record with an empty identity, whose shader type claims to be almost 2GB
+    TArray<uint8> records;
+    FMemoryWriter recordWriter(records);
+    int32 numRecords = 1;
+    FString identity;
+    int32 shaderTypeCount = MAX_int32;
+    recordWriter << numRecords;
+    recordWriter << identity;
+    recordWriter << shaderTypeCount;
+
+    WriteTraceFile(path, records, MAX_int32);
+    TestFalse(TEXT("A trace claiming to uncompress to far more than it could must not load"), FMaliOCCompileTrace::BeginReplay(path));
+    FMaliOCCompileTrace::Stop();
+
+    WriteTraceFile(path, records, records.Num());
+    TestFalse(TEXT("A record with a count larger than the rest of the trace must not load"), FMaliOCCompileTrace::BeginReplay(path));
+    FMaliOCCompileTrace::Stop();
+
+    // The same record with a negative count
+    TArray<uint8> negativeRecords;
+    FMemoryWriter negativeWriter(negativeRecords);
+    shaderTypeCount = -1;
+    negativeWriter << numRecords;
+    negativeWriter << identity;
+    negativeWriter << shaderTypeCount;
+
+    WriteTraceFile(path, negativeRecords, negativeRecords.Num());
+    TestFalse(TEXT("A record with a negative count must not load"), FMaliOCCompileTrace::BeginReplay(path));
+    FMaliOCCompileTrace::Stop();
+
+    IFileManager::Get().Delete(*path);
+
+    return true;
+}
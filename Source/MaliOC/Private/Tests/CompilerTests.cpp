@@ -18,8 +18,10 @@
 #include "../MaliOCCompilerManager.h"
 #include "../MaliOCAsyncCompiler.h"
 #include "../MaliOCAsyncReportGenerator.h"
+#include "../MaliOCCompilerConcurrency.h"
 #include "AutomationTest.h"
 #include "ShaderCompiler.h"
+#include "ParallelFor.h"
 
 IMPLEMENT_SIMPLE_AUTOMATION_TEST(FMaliOCBlockUntilAllShaderCompilationCompleteTest, "MaliOC.BlockUntilAllShaderCompilationComplete", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
 
@@ -36,6 +38,10 @@ IMPLEMENT_SIMPLE_AUTOMATION_TEST(FMaliOCCompilerManagerTest, "MaliOC.CompilerMan
 // Test all the functionality of Compiler Manager wrapper which isn't already tested in the Async compiler tests
 bool FMaliOCCompilerManagerTest::RunTest(const FString& Parameters)
 {
+    // The compiler list is built in the background when the module starts, and usually comes from a cache without loading the compiler manager.
+    // Wait for the list, then make sure the compiler manager is loaded the way a compile would load it.
+    FAsyncCompiler::FinishInitialization();
+    TestTrue(TEXT("The compiler libraries must load"), FAsyncCompiler::LoadCompilerLibraries());
     auto* cm = FCompilerManager::Get();
 
     TestNotNull(TEXT("FCompilerManager::Get() must return a valid pointer"), cm);
@@ -54,7 +60,7 @@ IMPLEMENT_SIMPLE_AUTOMATION_TEST(FMaliOCCompilerLoadingTest, "MaliOC.CompilerLoa
 // It doesn't make sense to test it twice
 bool FMaliOCCompilerLoadingTest::RunTest(const FString& Parameters)
 {
-    if (FCompilerManager::Get() == nullptr)
+    if (FAsyncCompiler::Get() == nullptr || !FAsyncCompiler::LoadCompilerLibraries())
     {
         return false;
     }
@@ -80,13 +86,25 @@ bool FMaliOCCompilerLoadingTest::RunTest(const FString& Parameters)
 
                 TestTrue(TEXT("Each driver must support at least GLES2"), dri->GetMaxAPI() >= 100);
 
-                unsigned int maxVersion = FCompilerManager::Get()->_malicm_get_highest_api_version(dri->GetCompiler());
-                TestEqual(TEXT("Each driver's compiler must be valid"), dri->GetMaxAPI(), maxVersion);
+                // The cached catalogue must agree with the compiler libraries
+                malicm_compiler compiler;
+                const bool bHasCompiler = dri->GetCompiler(compiler);
+                TestTrue(TEXT("Each driver must have a compiler"), bHasCompiler);
+                if (bHasCompiler)
+                {
+                    unsigned int maxVersion = FCompilerManager::Get()->_malicm_get_highest_api_version(compiler);
+                    TestEqual(TEXT("Each driver's compiler must be valid"), dri->GetMaxAPI(), maxVersion);
+                }
 
                 for (const auto& pla : dri->GetPlatforms())
                 {
                     TestTrue(TEXT("Each platform must have a valid name"), pla->GetName().Len() > 0);
                     TestEqual(TEXT("Each platform must point back to its revision"), &pla->GetDriver(), &dri.Get());
+
+                    FMaliPlatformId id;
+                    const bool bIsIdValid = FMaliPlatformId::Parse(pla->GetId().ToString(), id);
+                    TestTrue(TEXT("Each platform ID must survive being written out"), bIsIdValid);
+                    TestEqual(TEXT("Each platform must be found by its ID"), FAsyncCompiler::Get()->FindPlatform(id), &pla.Get());
                 }
             }
         }
@@ -95,14 +113,194 @@ bool FMaliOCCompilerLoadingTest::RunTest(const FString& Parameters)
     return true;
 }
 
-struct FMaliOCAsyncReportGenerationParams
+/** Shader the concurrency test compiles. Valid for every driver, as all of them support GLES2 */
+static const ANSICHAR* const ConcurrencyTestShader =
+    "#version 100\n"
+    "precision mediump float;\n"
+    "uniform sampler2D Texture;\n"
+    "varying vec2 TexCoord;\n"
+    "void main()\n"
+    "{\n"
+    "    gl_FragColor = texture2D(Texture, TexCoord * 2.0) + texture2D(Texture, TexCoord);\n"
+    "}\n";
+
+/** Compile the concurrency test shader, taking whatever locks the reentrancy level calls for. @return everything the compiler returned, or an empty string if it didn't run */
+static FString CompileConcurrencyTestShader(const FCompilerManager& CompilerManager, malicm_compiler Compiler)
 {
-    int32 core;
-    int32 rev;
-    int32 dri;
-    int32 plat;
-    EMaterialShadingModel model;
-};
+    FMaliOCCompileInput input;
+    input.Source = ConcurrencyTestShader;
+    input.ShaderType = "fragment";
+
+    FMaliOCCompileOutputBuffer buffer;
+    CompilerManager.CompileBatch(Compiler, &input, 1, buffer);
+
+    malioc_outputs outputs;
+    if (!buffer.GetOutputs(0, outputs))
+    {
+        return FString();
+    }
+
+    FString result = TEXT("Compiled\n");
+    for (unsigned int i = 0; i < outputs.number_of_errors; i++)
+    {
+        result += FString::Printf(TEXT("Error: %s\n"), ANSI_TO_TCHAR(outputs.errors[i]));
+    }
+    for (unsigned int i = 0; i < outputs.number_of_warnings; i++)
+    {
+        result += FString::Printf(TEXT("Warning: %s\n"), ANSI_TO_TCHAR(outputs.warnings[i]));
+    }
+    for (unsigned int i = 0; i < outputs.number_of_flexible_outputs; i++)
+    {
+        for (unsigned int j = 0; j < outputs.flexible_outputs[i].number_of_entries; j++)
+        {
+            result += FString::Printf(TEXT("%u: %s\n"), i, ANSI_TO_TCHAR(outputs.flexible_outputs[i].list[j]));
+        }
+    }
+    return result;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FMaliOCCompilerConcurrencyTest, "MaliOC.CompilerConcurrency", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+// Run the concurrency self-test on every compiler, then check that compiling concurrently at the level it found gives the same results as compiling serially
+bool FMaliOCCompilerConcurrencyTest::RunTest(const FString& Parameters)
+{
+    if (FAsyncCompiler::Get() == nullptr || !FAsyncCompiler::LoadCompilerLibraries())
+    {
+        return false;
+    }
+
+    // Nothing else may compile while the self-test runs unless the libraries are known to allow it
+    FAsyncCompiler::Get()->FinishCompilation();
+
+    TArray<malicm_compiler> compilers;
+    for (const FMaliPlatform* plat : FAsyncCompiler::Get()->GetPlatforms())
+    {
+        malicm_compiler compiler;
+        if (plat->GetDriver().GetCompiler(compiler))
+        {
+            compilers.AddUnique(compiler);
+        }
+    }
+
+    EMaliOCCompilerReentrancy reentrancy;
+    const bool bCompiled = FMaliOCCompilerConcurrency::RunSelfTest(compilers, 8, reentrancy);
+    TestTrue(TEXT("Every compiler must compile the self-test shader"), bCompiled);
+
+    AddLogItem(FString::Printf(TEXT("The compiler libraries are safe to use at the %s level"), GetCompilerReentrancyName(reentrancy)));
+    if (!bCompiled)
+    {
+        return false;
+    }
+
+    const FCompilerManager* cm = FCompilerManager::Get();
+    TArray<FString> references;
+    for (malicm_compiler compiler : compilers)
+    {
+        references.Add(CompileConcurrencyTestShader(*cm, compiler));
+        TestFalse(TEXT("Every compiler must compile the concurrency test shader"), references.Last().IsEmpty());
+    }
+
+    // Lock at the detected level. Each compiler is compiled several times over, so at the Reentrant level the same compiler runs on several threads at once
+    IConsoleVariable* reentrancyVariable = IConsoleManager::Get().FindConsoleVariable(TEXT("MaliOC.CompilerReentrancy"));
+    const int32 previousReentrancy = reentrancyVariable->GetInt();
+    reentrancyVariable->Set((int32)reentrancy);
+
+    const int32 compilesPerCompiler = 4;
+    TArray<FString> results;
+    results.SetNum(compilers.Num() * compilesPerCompiler);
+    ParallelFor(results.Num(), [&](int32 Index)
+    {
+        results[Index] = CompileConcurrencyTestShader(*cm, compilers[Index % compilers.Num()]);
+    });
+
+    reentrancyVariable->Set(previousReentrancy);
+
+    for (int32 i = 0; i < results.Num(); i++)
+    {
+        TestTrue(FString::Printf(TEXT("Concurrent compile %d must match the serial compile at the %s level"), i, GetCompilerReentrancyName(reentrancy)),
+            results[i].Equals(references[i % compilers.Num()], ESearchCase::CaseSensitive));
+    }
+
+    return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FMaliOCCrossCompilePartitionsTest, "MaliOC.CrossCompilePartitions", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+// Check when a cross compile finishes, given the states of its partitions
+bool FMaliOCCrossCompilePartitionsTest::RunTest(const FString& Parameters)
+{
+    typedef EMaliOCPartitionState S;
+    const S allSucceeded[] = { S::Succeeded, S::Succeeded };
+    const S oneCompiling[] = { S::Succeeded, S::Compiling };
+    const S oneRetrying[] = { S::Succeeded, S::Retrying };
+    const S failedAndCompiling[] = { S::Failed, S::Compiling };
+    const S failedAndRetrying[] = { S::Failed, S::Retrying };
+    const S retryingBeforeFailed[] = { S::Retrying, S::Succeeded, S::Failed };
+
+    bool bFailed = false;
+    TestTrue(TEXT("Every partition succeeding finishes the cross compile"), ResolveCrossCompilePartitions(TArray<S>(allSucceeded, ARRAY_COUNT(allSucceeded)), bFailed) && !bFailed);
+    TestFalse(TEXT("A partition still compiling holds the cross compile up"), ResolveCrossCompilePartitions(TArray<S>(oneCompiling, ARRAY_COUNT(oneCompiling)), bFailed));
+    TestFalse(TEXT("A partition that will be retried holds the cross compile up"), ResolveCrossCompilePartitions(TArray<S>(oneRetrying, ARRAY_COUNT(oneRetrying)), bFailed));
+    TestFalse(TEXT("A failed cross compile waits for the partitions still compiling"), ResolveCrossCompilePartitions(TArray<S>(failedAndCompiling, ARRAY_COUNT(failedAndCompiling)), bFailed));
+
+    // Nothing is retried once a partition has failed for good, so a partition waiting for a retry mustn't keep the cross compile going forever
+    bFailed = false;
+    TestTrue(TEXT("A partition failing with errors while another needs a retry fails the cross compile"), ResolveCrossCompilePartitions(TArray<S>(failedAndRetrying, ARRAY_COUNT(failedAndRetrying)), bFailed) && bFailed);
+    bFailed = false;
+    TestTrue(TEXT("The order of the partitions doesn't matter"), ResolveCrossCompilePartitions(TArray<S>(retryingBeforeFailed, ARRAY_COUNT(retryingBeforeFailed)), bFailed) && bFailed);
+
+    return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FMaliOCPlatformIdTest, "MaliOC.PlatformId", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+// Check platform IDs survive a round trip through a string, whatever their names contain
+bool FMaliOCPlatformIdTest::RunTest(const FString& Parameters)
+{
+    FMaliPlatformId id;
+    id.CoreName = TEXT("Mali-T760");
+    id.RevisionName = TEXT("r0p0");
+    id.DriverName = TEXT("Mali-T760_r5p0-00rel0");
+    id.PlatformName = TEXT("OpenGL ES 2.0");
+    TestEqual(TEXT("Plain names are written as they are"), id.ToString(), FString(TEXT("Mali-T760/r0p0/Mali-T760_r5p0-00rel0/OpenGL ES 2.0")));
+
+    FMaliPlatformId parsed;
+    TestTrue(TEXT("A plain ID round trips"), FMaliPlatformId::Parse(id.ToString(), parsed) && parsed == id);
+
+    id.DriverName = TEXT("Mali-T760_r5p0/100%");
+    id.PlatformName = TEXT("OpenGL ES 3.1/AEP %2F");
+    TestTrue(TEXT("Names containing the separator and escapes round trip"), FMaliPlatformId::Parse(id.ToString(), parsed) && parsed == id);
+
+    TestFalse(TEXT("Too few names are rejected"), FMaliPlatformId::Parse(TEXT("Mali-T760/r0p0/OpenGL ES 2.0"), parsed));
+    TestFalse(TEXT("Too many names are rejected"), FMaliPlatformId::Parse(TEXT("Mali-T760/r0p0/Mali/T760_r5p0-00rel0/OpenGL ES 2.0"), parsed));
+    TestFalse(TEXT("Unknown escapes are rejected"), FMaliPlatformId::Parse(TEXT("Mali-T760/r0p0/Mali-T760_r5p0-00rel0/OpenGL%20ES 2.0"), parsed));
+
+    return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FMaliOCCompilerShaderTypesTest, "MaliOC.CompilerShaderTypes", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+// Check each shader frequency maps to the offline compiler's shader type
+bool FMaliOCCompilerShaderTypesTest::RunTest(const FString& Parameters)
+{
+    const EShaderFrequency frequencies[] = { SF_Vertex, SF_Hull, SF_Domain, SF_Pixel, SF_Geometry, SF_Compute };
+    const TCHAR* const compilerTypes[] = { TEXT("vertex"), TEXT("tessellation_control"), TEXT("tessellation_evaluation"), TEXT("fragment"), TEXT("geometry"), TEXT("compute") };
+    static_assert(ARRAY_COUNT(frequencies) == ARRAY_COUNT(compilerTypes), "Each frequency needs a shader type");
+
+    for (int32 i = 0; i < ARRAY_COUNT(frequencies); i++)
+    {
+        const char* compilerType = GetCompilerShaderType(frequencies[i]);
+        TestTrue(FString::Printf(TEXT("Frequency %d must be supported"), (int32)frequencies[i]), compilerType != nullptr);
+        if (compilerType != nullptr)
+        {
+            TestEqual(FString::Printf(TEXT("Frequency %d must map to %s"), (int32)frequencies[i], compilerTypes[i]), FString(ANSI_TO_TCHAR(compilerType)), FString(compilerTypes[i]));
+        }
+    }
+
+    TestTrue(TEXT("An unknown frequency must be unsupported"), GetCompilerShaderType(SF_NumFrequencies) == nullptr);
+
+    return true;
+}
 
 // Remove spaces and periods - the test harness uses periods as delimiters
 FString SanitiseTestString(const FString& string)
@@ -138,6 +336,12 @@ FString PrettyPrintCompilerTestName(const FMaliPlatform& plat, EMaterialShadingM
     return FString::Printf(TEXT("%s.%s.%s.%s.%s"), *SanitiseTestString(GetShadingModelString(model)), *SanitiseTestString(core.GetName()), *SanitiseTestString(rev.GetName()), *SanitiseTestString(dri.GetName()), *SanitiseTestString(plat.GetName()));
 }
 
+/** The command is the shading model followed by the platform ID, so it still names the same platform if the bundle changes between listing and running the tests */
+static FString MakeCompilationReportTestCommand(const FMaliPlatform& Platform, EMaterialShadingModel Model)
+{
+    return FString::Printf(TEXT("%d %s"), (int32)Model, *Platform.GetId().ToString());
+}
+
 void EncodeCompilationReportParamsAsStrings(TArray<FString>& OutBeautifiedNames, TArray<FString>& OutTestCommands, EMaterialShadingModel model)
 {
     if (FAsyncCompiler::Get() == nullptr)
@@ -145,36 +349,26 @@ void EncodeCompilationReportParamsAsStrings(TArray<FString>& OutBeautifiedNames,
         return;
     }
 
-    const auto& cores = FAsyncCompiler::Get()->GetCores();
-    for (int i = 0; i < cores.Num(); i++)
+    for (const FMaliPlatform* plat : FAsyncCompiler::Get()->GetPlatforms())
     {
-        const auto& core = cores[i];
-        const auto& revs = core->GetRevisions();
-        for (int j = 0; j < revs.Num(); j++)
-        {
-            const auto& rev = revs[j];
-            const auto& drivers = rev->GetDrivers();
-            for (int k = 0; k < drivers.Num(); k++)
-            {
-                const auto& dri = drivers[k];
-                const auto& platforms = dri->GetPlatforms();
-                for (int l = 0; l < platforms.Num(); l++)
-                {
-                    const auto& plat = platforms[l];
-                    OutBeautifiedNames.Add(PrettyPrintCompilerTestName(plat.Get(), model));
-
-                    FMaliOCAsyncReportGenerationParams params;
-                    params.core = i;
-                    params.rev = j;
-                    params.dri = k;
-                    params.plat = l;
-                    params.model = model;
+        OutBeautifiedNames.Add(PrettyPrintCompilerTestName(*plat, model));
+        OutTestCommands.Add(MakeCompilationReportTestCommand(*plat, model));
+    }
+}
 
-                    OutTestCommands.Add(FString::FromBlob((uint8*)&params, sizeof(params)));
-                }
-            }
-        }
+bool DecodeCompilationReportParams(const FString& TestCommand, const FMaliPlatform*& OutPlatform, EMaterialShadingModel& OutModel)
+{
+    FString modelString;
+    FString idString;
+    FMaliPlatformId id;
+    if (!TestCommand.Split(TEXT(" "), &modelString, &idString) || !modelString.IsNumeric() || !FMaliPlatformId::Parse(idString, id))
+    {
+        return false;
     }
+
+    OutModel = (EMaterialShadingModel)FCString::Atoi(*modelString);
+    OutPlatform = FAsyncCompiler::Get()->FindPlatform(id);
+    return OutPlatform != nullptr;
 }
 
 IMPLEMENT_COMPLEX_AUTOMATION_TEST(FMaliOCCompilationReportTest, "MaliOC.CompilationReport", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
@@ -189,19 +383,87 @@ struct FMaliOCCompilationReportTestData
 {
     FMaliOCCompilationReportTest* test;
     TSharedRef<FAsyncReportGenerator> reportGenerator;
+    /* Needed to run a full compile if a sampled compile flags the material */
+    UMaterial* material;
+    const FMaliPlatform* platform;
+    FCompileJobOptions options;
 };
 
 DEFINE_LATENT_AUTOMATION_COMMAND_ONE_PARAMETER(FMaliOCCompilationReportTest_WaitForCompilationToComplete, FMaliOCCompilationReportTestData, testData);
 
+// Create a material which uses every vertex factory, so it compiles the most permutations
+UMaterial* CreateStressTestMaterial(EMaterialShadingModel Model)
+{
+    UMaterial* material = NewObject<UMaterial>();
+    material->SetShadingModel(Model);
+    // Enabled all the options for a proper stress test
+    material->bUsedWithSkeletalMesh = true;
+    material->bUsedWithEditorCompositing = true;
+    material->bUsedWithLandscape = true;
+    material->bUsedWithParticleSprites = true;
+    material->bUsedWithBeamTrails = true;
+    material->bUsedWithMeshParticles = true;
+    material->bUsedWithStaticLighting = true;
+    material->bUsedWithFluidSurfaces = true;
+    material->bUsedWithMorphTargets = true;
+    material->bUsedWithSplineMeshes = true;
+    material->bUsedWithInstancedStaticMeshes = true;
+    material->bUsedWithClothing = true;
+    // Should speed up tests a little
+    material->CancelOutstandingCompilation();
+    return material;
+}
+
+/**
+ * Get the test material for a shading model, creating it the first time.
+ * Every platform's test uses the same material, so platforms with the same shader platform share its cross compile.
+ */
+static UMaterial* GetCompilationReportTestMaterial(EMaterialShadingModel Model)
+{
+    static TMap<int32, UMaterial*> Materials;
+
+    UMaterial*& material = Materials.FindOrAdd((int32)Model);
+    if (material == nullptr)
+    {
+        // The tests run over many frames, with garbage collection in between
+        material = CreateStressTestMaterial(Model);
+        material->AddToRoot();
+    }
+
+    return material;
+}
+
+static TAutoConsoleVariable<int32> CVarPrefetchReports(
+    TEXT("MaliOC.Tests.PrefetchReports"),
+    0,
+    TEXT("Set to 1 when every MaliOC.CompilationReport test is being run, as the test scripts do, so that each test starts the next platforms' compiles ahead of time. ")
+    TEXT("Leave at 0 (default) for filtered runs, where compiles for tests that aren't in the run would be wasted."),
+    ECVF_Default);
+
+/**
+ * Report generators started ahead of their tests, by test command. Each test removes its own once it has checked the report.
+ * Emptied after the last platform's test and by FAsyncReportGenerator::ReleaseSharedGenerators(), so none outlive the async compiler.
+ */
+static TMap<FString, TSharedRef<FAsyncReportGenerator>> PrefetchedReportGenerators;
+
+static void ReleasePrefetchedReportGenerators()
+{
+    PrefetchedReportGenerators.Empty();
+}
+
+/** Maximum number of report generators started ahead of their tests. Enough to keep every compile job busy, without holding every platform's shaders at once */
+static const int32 MaxPrefetchedReportGenerators = 16;
+
 bool FMaliOCCompilationReportTest::RunTest(const FString& Parameters)
 {
-    if (FCompilerManager::Get() == nullptr)
+    if (FAsyncCompiler::Get() == nullptr)
     {
         return false;
     }
 
-    FMaliOCAsyncReportGenerationParams params;
-    bool success = FString::ToBlob(Parameters, (uint8*)&params, sizeof(params));
+    const FMaliPlatform* platformPtr = nullptr;
+    EMaterialShadingModel model = MSM_Unlit;
+    bool success = DecodeCompilationReportParams(Parameters, platformPtr, model);
 
     TestTrue("Invalid parameters", success);
 
@@ -210,33 +472,52 @@ bool FMaliOCCompilationReportTest::RunTest(const FString& Parameters)
         return false;
     }
 
-    const auto& platform = FAsyncCompiler::Get()->GetCores()[params.core]->GetRevisions()[params.rev]->GetDrivers()[params.dri]->GetPlatforms()[params.plat].Get();
+    const auto& platform = *platformPtr;
 
-    AddLogItem(FString::Printf(TEXT("Testing %s"), *PrettyPrintCompilerTestName(platform, params.model)));
+    AddLogItem(FString::Printf(TEXT("Testing %s"), *PrettyPrintCompilerTestName(platform, model)));
 
-    // Create a temporary material for testing
-    UMaterial* Material = NewObject<UMaterial>();
-    Material->SetShadingModel(params.model);
-    // Enabled all the options for a proper stress test
-    Material->bUsedWithSkeletalMesh = true;
-    Material->bUsedWithEditorCompositing = true;
-    Material->bUsedWithLandscape = true;
-    Material->bUsedWithParticleSprites = true;
-    Material->bUsedWithBeamTrails = true;
-    Material->bUsedWithMeshParticles = true;
-    Material->bUsedWithStaticLighting = true;
-    Material->bUsedWithFluidSurfaces = true;
-    Material->bUsedWithMorphTargets = true;
-    Material->bUsedWithSplineMeshes = true;
-    Material->bUsedWithInstancedStaticMeshes = true;
-    Material->bUsedWithClothing = true;
-    // Should speed up tests a little
-    Material->CancelOutstandingCompilation();
+    UMaterial* Material = GetCompilationReportTestMaterial(model);
+
+    // Batch runs choose which permutations to compile with MaliOC.PermutationFilter, and whether to sample them with MaliOC.Sampling.*
+    FCompileJobOptions options;
+    options.Filter = FMaliOCPermutationFilter::GetConsoleVariableFilter();
+    options.Sampling = FMaliOCSamplingOptions::GetConsoleVariableOptions();
 
-    TSharedRef<FAsyncReportGenerator> reportGenerator = MakeShareable(new FAsyncReportGenerator(Material, platform));
+    TSharedRef<FAsyncReportGenerator> reportGenerator = FAsyncReportGenerator::FindOrCreate(Material, platform, options);
+    PrefetchedReportGenerators.Remove(Parameters);
+
+    static bool bIsReleaseRegistered = false;
+    if (!bIsReleaseRegistered)
+    {
+        FAsyncReportGenerator::OnReleaseSharedGenerators().AddStatic(&ReleasePrefetchedReportGenerators);
+        bIsReleaseRegistered = true;
+    }
+
+    // Anything still prefetched after the last platform's test, or when prefetching is off, is for a test that isn't going to run
+    const TArray<const FMaliPlatform*>& platforms = FAsyncCompiler::Get()->GetPlatforms();
+    const int32 platformIndex = platforms.IndexOfByKey(platformPtr);
+    const bool bPrefetch = CVarPrefetchReports.GetValueOnGameThread() != 0;
+    if (!bPrefetch || platformIndex == platforms.Num() - 1)
+    {
+        ReleasePrefetchedReportGenerators();
+    }
+
+    // When every test is being run, they run one after another, so start the next platforms' compiles now for them to run alongside this one.
+    // Their tests then attach to the running generators.
+    for (int32 nextIndex = platformIndex + 1; bPrefetch && nextIndex < platforms.Num() && PrefetchedReportGenerators.Num() < MaxPrefetchedReportGenerators; nextIndex++)
+    {
+        const FString nextCommand = MakeCompilationReportTestCommand(*platforms[nextIndex], model);
+        if (!PrefetchedReportGenerators.Contains(nextCommand))
+        {
+            PrefetchedReportGenerators.Add(nextCommand, FAsyncReportGenerator::FindOrCreate(Material, *platforms[nextIndex], options));
+        }
+    }
+
+    // An identical request must attach to the running generator rather than compile everything again
+    TestTrue(TEXT("Identical requests must share a report generator"), &FAsyncReportGenerator::FindOrCreate(Material, platform, options).Get() == &reportGenerator.Get());
 
     // Pass the report generator and this test object to the latent command
-    FMaliOCCompilationReportTestData testData = { this, reportGenerator };
+    FMaliOCCompilationReportTestData testData = { this, reportGenerator, Material, &platform, options };
 
     // Checks each frame to see if compilation is complete, and when it is ensures output is as expected
     ADD_LATENT_AUTOMATION_COMMAND(FMaliOCCompilationReportTest_WaitForCompilationToComplete(testData));
@@ -258,6 +539,15 @@ bool FMaliOCCompilationReportTest_WaitForCompilationToComplete::Update()
 
     auto report = testData.reportGenerator->GetReport();
 
+    // Only materials the sample flags get a full compile
+    if (report->Sampling.bFlagged)
+    {
+        testData.test->AddLogItem(TEXT("Sampled compile flagged the material, running a full compile"));
+        testData.options.Sampling = FMaliOCSamplingOptions();
+        testData.reportGenerator = FAsyncReportGenerator::FindOrCreate(testData.material, *testData.platform, testData.options);
+        return false;
+    }
+
     testData.test->TestEqual(TEXT("We should have no errors after compiling the basic material"), report->ErrorList.Num(), 0);
 
     if (report->ErrorList.Num() == 0)
@@ -0,0 +1,339 @@
+/*
+* Copyright 2015 ARM Limited
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include "../MaliOCPrivatePCH.h"
+#include "../MaliOCAsyncCompiler.h"
+#include "../MaliOCAsyncReportGenerator.h"
+#include "../MaliOCCompilerCatalogue.h"
+#include "../MaliOCReportWidgetGenerator.h"
+#include "../MaliOCExtensionTab.h"
+#include "AutomationTest.h"
+
+// Each MaliOC.Perf test measures the wall time and peak memory of one scenario, and fails if either has regressed past the baseline.
+// Baselines are checked in under Resources/PerfBaselines, one file per host platform, as wall times depend on the machine.
+// Every run writes what it measured to Saved/MaliOC/PerfResults in the same format, so new baselines are recorded by copying that file over,
+// or by running with -MaliOCRecordPerfBaselines (see Scripts/RecordPerfBaselines.sh), which writes the measurements straight into the baseline file.
+
+// Defined in CompilerTests.cpp
+UMaterial* CreateStressTestMaterial(EMaterialShadingModel Model);
+
+static TAutoConsoleVariable<float> CVarPerfTolerance(
+    TEXT("MaliOC.Perf.Tolerance"),
+    0.2f,
+    TEXT("Fraction by which a MaliOC.Perf test may exceed its baseline before it fails. Baselines can override it per scenario."),
+    ECVF_Default);
+
+/** Regressions smaller than these are noise, however small the baseline is */
+static const double MinWallTimeSlackSeconds = 0.05;
+static const double MinPeakMemorySlackMB = 8.0;
+
+static const double BytesPerMB = 1024.0 * 1024.0;
+
+static FString GetPerfBaselinePath()
+{
+    return FPaths::Combine(*GetMaliOCPluginFolderPath(), TEXT("Resources"), TEXT("PerfBaselines"), *FString::Printf(TEXT("%s.ini"), ANSI_TO_TCHAR(FPlatformProperties::IniPlatformName())));
+}
+
+static FString GetPerfResultsPath()
+{
+    if (FParse::Param(FCommandLine::Get(), TEXT("MaliOCRecordPerfBaselines")))
+    {
+        return GetPerfBaselinePath();
+    }
+    return FPaths::Combine(*FPaths::GameSavedDir(), TEXT("MaliOC"), TEXT("PerfResults"), *FString::Printf(TEXT("%s.ini"), ANSI_TO_TCHAR(FPlatformProperties::IniPlatformName())));
+}
+
+struct FMaliOCPerfResult
+{
+    double WallTimeSeconds = 0.0;
+    double PeakMemoryMB = 0.0;
+};
+
+/**
+ * Measures a scenario from construction until Finish().
+ * Peak memory is how far the process's used physical memory rose above where it started. The OS only tracks the process's peak,
+ * so if the scenario doesn't raise that, its own peak is unknown and the memory still in use at the end is used instead.
+ */
+class FMaliOCPerfMeasurement final
+{
+public:
+    FMaliOCPerfMeasurement()
+    {
+        const FPlatformMemoryStats stats = FPlatformMemory::GetStats();
+        StartUsedPhysical = stats.UsedPhysical;
+        StartPeakUsedPhysical = stats.PeakUsedPhysical;
+        StartTime = FPlatformTime::Seconds();
+    }
+
+    FMaliOCPerfResult Finish() const
+    {
+        FMaliOCPerfResult result;
+        result.WallTimeSeconds = FPlatformTime::Seconds() - StartTime;
+
+        const FPlatformMemoryStats stats = FPlatformMemory::GetStats();
+        const uint64 peakUsedPhysical = stats.PeakUsedPhysical > StartPeakUsedPhysical ? stats.PeakUsedPhysical : stats.UsedPhysical;
+        result.PeakMemoryMB = peakUsedPhysical > StartUsedPhysical ? (peakUsedPhysical - StartUsedPhysical) / BytesPerMB : 0.0;
+        return result;
+    }
+
+private:
+    double StartTime = 0.0;
+    uint64 StartUsedPhysical = 0;
+    uint64 StartPeakUsedPhysical = 0;
+};
+
+/** @return false if the measurement exceeds the baseline by more than the tolerance */
+static bool CheckPerfValue(FAutomationTestBase& Test, const FString& Scenario, const TCHAR* Name, double Measured, double Baseline, double Tolerance, double MinSlack)
+{
+    const double limit = Baseline + FMath::Max(Baseline * Tolerance, MinSlack);
+    if (Measured > limit)
+    {
+        Test.AddError(FString::Printf(TEXT("%s regressed: %s was %.3f, the baseline is %.3f (limit %.3f)"), *Scenario, Name, Measured, Baseline, limit));
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Log the measurement, save it to the results file, and compare it with the scenario's baseline.
+ * A scenario without a baseline fails, so a perf run can't pass without checking anything. Its result is still saved, to be copied in as the baseline.
+ * @return false if the scenario has regressed or has no baseline
+ */
+static bool CheckPerfResult(FAutomationTestBase& Test, const FString& Scenario, const FMaliOCPerfResult& Result)
+{
+    Test.AddLogItem(FString::Printf(TEXT("%s took %.3f s, with a peak of %.1f MB"), *Scenario, Result.WallTimeSeconds, Result.PeakMemoryMB));
+
+    FConfigFile results;
+    results.Read(GetPerfResultsPath());
+    FConfigSection& resultSection = results.FindOrAdd(Scenario);
+    resultSection.Empty();
+    resultSection.Add(TEXT("WallTimeSeconds"), FString::Printf(TEXT("%.3f"), Result.WallTimeSeconds));
+    resultSection.Add(TEXT("PeakMemoryMB"), FString::Printf(TEXT("%.1f"), Result.PeakMemoryMB));
+    results.Dirty = true;
+    results.Write(GetPerfResultsPath());
+
+    FConfigFile baselines;
+    baselines.Read(GetPerfBaselinePath());
+
+    FString wallTimeBaseline;
+    FString peakMemoryBaseline;
+    if (!baselines.GetString(*Scenario, TEXT("WallTimeSeconds"), wallTimeBaseline) || !baselines.GetString(*Scenario, TEXT("PeakMemoryMB"), peakMemoryBaseline))
+    {
+        Test.AddError(FString::Printf(TEXT("%s has no baseline in %s. Copy it from %s to record one"), *Scenario, *GetPerfBaselinePath(), *GetPerfResultsPath()));
+        return false;
+    }
+
+    double tolerance = CVarPerfTolerance.GetValueOnGameThread();
+    FString toleranceString;
+    if (baselines.GetString(*Scenario, TEXT("Tolerance"), toleranceString))
+    {
+        tolerance = FCString::Atod(*toleranceString);
+    }
+
+    bool success = CheckPerfValue(Test, Scenario, TEXT("wall time (s)"), Result.WallTimeSeconds, FCString::Atod(*wallTimeBaseline), tolerance, MinWallTimeSlackSeconds);
+    success = CheckPerfValue(Test, Scenario, TEXT("peak memory (MB)"), Result.PeakMemoryMB, FCString::Atod(*peakMemoryBaseline), tolerance, MinPeakMemorySlackMB) && success;
+    return success;
+}
+
+/** @return the platform the compile scenarios use. The baseline file names it, so it stays the same if the bundle grows; otherwise the first platform */
+static const FMaliPlatform* GetPerfTestPlatform()
+{
+    FConfigFile baselines;
+    baselines.Read(GetPerfBaselinePath());
+
+    FString idString;
+    FMaliPlatformId id;
+    if (baselines.GetString(TEXT("Settings"), TEXT("Platform"), idString) && FMaliPlatformId::Parse(idString, id))
+    {
+        const FMaliPlatform* platform = FAsyncCompiler::Get()->FindPlatform(id);
+        if (platform != nullptr)
+        {
+            return platform;
+        }
+    }
+
+    const auto& platforms = FAsyncCompiler::Get()->GetPlatforms();
+    return platforms.Num() > 0 ? platforms[0] : nullptr;
+}
+
+/** @return a full compile of a material, without any sharing, so every stage is run */
+static TSharedRef<FAsyncReportGenerator> CreatePerfTestReportGenerator(UMaterial* Material, const FMaliPlatform& Platform)
+{
+    return MakeShareable(new FAsyncReportGenerator(Material, Platform));
+}
+
+/** Material the cached scenarios compile. It has been compiled once before any of them measure anything, so the engine's shader caches are warm */
+static UMaterial* GetCachedPerfTestMaterial(const FMaliPlatform& Platform)
+{
+    static UMaterial* material = nullptr;
+    if (material == nullptr)
+    {
+        material = CreateStressTestMaterial(MSM_DefaultLit);
+        material->AddToRoot();
+        CreatePerfTestReportGenerator(material, Platform)->FinishReportGeneration();
+    }
+    return material;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FMaliOCPerfLargeMaterialCompileTest, "MaliOC.Perf.LargeMaterialCompile", EAutomationTestFlags::EditorContext | EAutomationTestFlags::PerfFilter)
+
+// Cross compile, offline compile and build the report of a material nothing has compiled before
+bool FMaliOCPerfLargeMaterialCompileTest::RunTest(const FString& Parameters)
+{
+    if (FAsyncCompiler::Get() == nullptr)
+    {
+        return false;
+    }
+
+    const FMaliPlatform* platform = GetPerfTestPlatform();
+    TestNotNull(TEXT("There must be a platform to compile for"), platform);
+    if (platform == nullptr)
+    {
+        return false;
+    }
+
+    // Nothing else may be compiling, or it would be measured too
+    FAsyncCompiler::Get()->FinishCompilation();
+    UMaterial* material = CreateStressTestMaterial(MSM_DefaultLit);
+
+    FMaliOCPerfMeasurement measurement;
+    TSharedRef<FAsyncReportGenerator> generator = CreatePerfTestReportGenerator(material, *platform);
+    generator->FinishReportGeneration();
+    const FMaliOCPerfResult result = measurement.Finish();
+
+    TestEqual(TEXT("The material must compile without errors"), generator->GetReport()->ErrorList.Num(), 0);
+    return CheckPerfResult(*this, TEXT("LargeMaterialCompile"), result);
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FMaliOCPerfCachedRecompileTest, "MaliOC.Perf.CachedRecompile", EAutomationTestFlags::EditorContext | EAutomationTestFlags::PerfFilter)
+
+// Compile a material again from scratch, as happens when a material editor is reopened. Its cross compiled shaders come from the engine's caches.
+bool FMaliOCPerfCachedRecompileTest::RunTest(const FString& Parameters)
+{
+    if (FAsyncCompiler::Get() == nullptr)
+    {
+        return false;
+    }
+
+    const FMaliPlatform* platform = GetPerfTestPlatform();
+    TestNotNull(TEXT("There must be a platform to compile for"), platform);
+    if (platform == nullptr)
+    {
+        return false;
+    }
+
+    UMaterial* material = GetCachedPerfTestMaterial(*platform);
+    FAsyncCompiler::Get()->FinishCompilation();
+
+    FMaliOCPerfMeasurement measurement;
+    TSharedRef<FAsyncReportGenerator> generator = CreatePerfTestReportGenerator(material, *platform);
+    generator->FinishReportGeneration();
+    const FMaliOCPerfResult result = measurement.Finish();
+
+    TestEqual(TEXT("The material must compile without errors"), generator->GetReport()->ErrorList.Num(), 0);
+    return CheckPerfResult(*this, TEXT("CachedRecompile"), result);
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FMaliOCPerfReportBuildTest, "MaliOC.Perf.ReportBuild", EAutomationTestFlags::EditorContext | EAutomationTestFlags::PerfFilter)
+
+// Build the report from the offline compiler's output
+bool FMaliOCPerfReportBuildTest::RunTest(const FString& Parameters)
+{
+    if (FAsyncCompiler::Get() == nullptr)
+    {
+        return false;
+    }
+
+    const FMaliPlatform* platform = GetPerfTestPlatform();
+    TestNotNull(TEXT("There must be a platform to compile for"), platform);
+    if (platform == nullptr)
+    {
+        return false;
+    }
+
+    TSharedRef<FAsyncReportGenerator> generator = CreatePerfTestReportGenerator(GetCachedPerfTestMaterial(*platform), *platform);
+    generator->FinishCompilation();
+
+    FMaliOCPerfMeasurement measurement;
+    generator->FinishReportGeneration();
+    const FMaliOCPerfResult result = measurement.Finish();
+
+    TestEqual(TEXT("The material must compile without errors"), generator->GetReport()->ErrorList.Num(), 0);
+    return CheckPerfResult(*this, TEXT("ReportBuild"), result);
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FMaliOCPerfWidgetBuildTest, "MaliOC.Perf.WidgetBuild", EAutomationTestFlags::EditorContext | EAutomationTestFlags::PerfFilter)
+
+// Build the report widget the material editor tab shows
+bool FMaliOCPerfWidgetBuildTest::RunTest(const FString& Parameters)
+{
+    if (FAsyncCompiler::Get() == nullptr)
+    {
+        return false;
+    }
+
+    const FMaliPlatform* platform = GetPerfTestPlatform();
+    TestNotNull(TEXT("There must be a platform to compile for"), platform);
+    if (platform == nullptr)
+    {
+        return false;
+    }
+
+    TSharedRef<FAsyncReportGenerator> generator = CreatePerfTestReportGenerator(GetCachedPerfTestMaterial(*platform), *platform);
+    generator->FinishReportGeneration();
+
+    FMaliOCPerfMeasurement measurement;
+    TSharedRef<FReportWidgetGenerator> widgetGenerator = MakeShareable(new FReportWidgetGenerator(generator));
+    widgetGenerator->GetWidget();
+    const FMaliOCPerfResult result = measurement.Finish();
+
+    return CheckPerfResult(*this, TEXT("WidgetBuild"), result);
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FMaliOCPerfColdStartupTest, "MaliOC.Perf.ColdStartup", EAutomationTestFlags::EditorContext | EAutomationTestFlags::PerfFilter)
+
+// Initialize the async compiler the way the first session after installing or updating the offline compiler does, without a compiler catalogue cache.
+// The async compiler is torn down to do this, which frees every platform, so the test refuses to run while anything still refers to one.
+bool FMaliOCPerfColdStartupTest::RunTest(const FString& Parameters)
+{
+    if (FAsyncCompiler::Get() == nullptr)
+    {
+        return false;
+    }
+
+    FAsyncCompiler::Get()->FinishCompilation();
+    FAsyncReportGenerator::ReleaseSharedGenerators();
+
+    const int32 numLiveGenerators = FAsyncReportGenerator::GetNumLiveGenerators();
+    const int32 numLiveTabs = FMaterialEditorTabGenerator::GetNumLiveTabs();
+    if (numLiveGenerators > 0 || numLiveTabs > 0)
+    {
+        AddError(FString::Printf(TEXT("ColdStartup can't tear down the async compiler while %d report generators and %d Material Editor tabs refer to its platforms. Close every material editor and run it on its own"),
+            numLiveGenerators, numLiveTabs));
+        return false;
+    }
+
+    FAsyncCompiler::Deinitialize();
+    IFileManager::Get().Delete(*FMaliOCCompilerCatalogue::GetCacheFilePath(), false, false, true);
+
+    FMaliOCPerfMeasurement measurement;
+    FAsyncCompiler::BeginInitialize();
+    const bool success = FAsyncCompiler::FinishInitialization() && FAsyncCompiler::LoadCompilerLibraries();
+    const FMaliOCPerfResult result = measurement.Finish();
+
+    TestTrue(TEXT("The async compiler must initialize again"), success);
+    return CheckPerfResult(*this, TEXT("ColdStartup"), result) && success;
+}
@@ -0,0 +1,71 @@
+/*
+* Copyright 2015 ARM Limited
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+
+#include "../MaliOCPrivatePCH.h"
+#include "../MaliOCPermutationFilter.h"
+#include "AutomationTest.h"
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FMaliOCPermutationFilterTypeTest, "MaliOC.PermutationFilter.Type", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+// Check that Type takes a | separated list of wildcard patterns, like the other keys
+bool FMaliOCPermutationFilterTypeTest::RunTest(const FString& Parameters)
+{
+    TArray<const FShaderType*> shaderTypes;
+    for (TLinkedList<FShaderType*>::TIterator shaderTypeIt(FShaderType::GetTypeList()); shaderTypeIt && shaderTypes.Num() < 3; shaderTypeIt.Next())
+    {
+        // Skip types a wildcard on an earlier type's name would also match
+        const FString name = (*shaderTypeIt)->GetName();
+        if (!shaderTypes.ContainsByPredicate([&name](const FShaderType* Other) { return name.StartsWith(Other->GetName()) || FString(Other->GetName()).StartsWith(name); }))
+        {
+            shaderTypes.Add(*shaderTypeIt);
+        }
+    }
+
+    TestEqual(TEXT("There are enough shader types to filter"), shaderTypes.Num(), 3);
+    if (shaderTypes.Num() != 3)
+    {
+        return false;
+    }
+
+    const FString first = shaderTypes[0]->GetName();
+    const FString second = shaderTypes[1]->GetName();
+
+    FMaliOCPermutationFilter filter;
+    FString error;
+    TestTrue(TEXT("A list of exact names parses"), FMaliOCPermutationFilter::Parse(FString::Printf(TEXT("Type=%s|%s"), *first, *second), filter, error));
+    TestEqual(TEXT("Each name is its own pattern"), filter.ShaderTypePatterns.Num(), 2);
+    TestTrue(TEXT("The first listed type passes"), filter.ShouldCompile(shaderTypes[0], nullptr));
+    TestTrue(TEXT("The second listed type passes"), filter.ShouldCompile(shaderTypes[1], nullptr));
+    TestFalse(TEXT("An unlisted type is filtered out"), filter.ShouldCompile(shaderTypes[2], nullptr));
+
+    // Wildcards built from prefixes of each name, with spaces around the separator
+    const FString firstPrefix = first.Left(FMath::Max(1, first.Len() - 2));
+    const FString secondPrefix = second.Left(FMath::Max(1, second.Len() - 2));
+    TestTrue(TEXT("A list of wildcards parses"), FMaliOCPermutationFilter::Parse(FString::Printf(TEXT("Type=%s* | %s*"), *firstPrefix, *secondPrefix), filter, error));
+    TestEqual(TEXT("Patterns are trimmed"), filter.ShaderTypePatterns.Num() > 1 ? filter.ShaderTypePatterns[1] : FString(), secondPrefix + TEXT("*"));
+    TestTrue(TEXT("A type matching the first wildcard passes"), filter.ShouldCompile(shaderTypes[0], nullptr));
+    TestTrue(TEXT("A type matching the second wildcard passes"), filter.ShouldCompile(shaderTypes[1], nullptr));
+
+    TestTrue(TEXT("A single pattern still parses"), FMaliOCPermutationFilter::Parse(FString::Printf(TEXT("Type=%s"), *first), filter, error));
+    TestTrue(TEXT("A single pattern keeps its type"), filter.ShouldCompile(shaderTypes[0], nullptr));
+    TestFalse(TEXT("A single pattern filters out other types"), filter.ShouldCompile(shaderTypes[1], nullptr));
+
+    TestTrue(TEXT("An empty string parses"), FMaliOCPermutationFilter::Parse(TEXT(""), filter, error));
+    TestTrue(TEXT("An empty filter keeps everything"), filter.IsEmpty() && filter.ShouldCompile(shaderTypes[2], nullptr));
+
+    return true;
+}
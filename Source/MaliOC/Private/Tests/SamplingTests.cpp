@@ -0,0 +1,186 @@
+/*
+* Copyright 2015 ARM Limited
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+
+#include "../MaliOCPrivatePCH.h"
+#include "../MaliOCAsyncCompiler.h"
+#include "../MaliOCSampling.h"
+#include "AutomationTest.h"
+
+/** Add a sampled permutation whose bound pipe cycles are Cycles */
+static void AddSampledPermutation(FMaliOCRawCompilerOutput& Output, FName VertexFactoryName, float Cycles)
+{
+    FMaliOCRawCompilerOutput::FMidgardOutput midgard;
+    midgard.CommonOutput.VertexFactoryName = VertexFactoryName;
+    midgard.CommonOutput.Frequency = SF_Pixel;
+
+    FMaliOCRawCompilerOutput::FMidgardOutput::FRenderTarget renderTarget;
+    renderTarget.arithmetic_longest_path = Cycles;
+    midgard.RenderTargets.Add(renderTarget);
+
+    Output.MidgardOutput.Add(MoveTemp(midgard));
+}
+
+/** Stratum of the permutations added by AddSampledPermutation() */
+static FMaliOCSamplingStratum MakePixelStratum(FName VertexFactoryName)
+{
+    const FMaliOCSamplingStratum stratum = { VertexFactoryName, SF_Pixel };
+    return stratum;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FMaliOCSampledEstimateTest, "MaliOC.Sampling.Estimate", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+// Check the stratified estimator against values worked out by hand
+bool FMaliOCSampledEstimateTest::RunTest(const FString& Parameters)
+{
+    const FName vertexFactoryA(TEXT("A"));
+    const FName vertexFactoryB(TEXT("B"));
+
+    FMaliOCSamplingOptions options;
+    options.SamplesPerStratum = 4;
+    options.FlagCycleThreshold = 100.0f;
+
+    // Stratum A has four samples, stratum B only one, out of ten permutations each.
+    // B borrows A's variance of 5/3, so the variance of the mean is 0.25 * 0.6 * (5/3) / 4 + 0.25 * 0.9 * (5/3) = 0.4375.
+    // A gives 3 degrees of freedom, so the interval uses t = 3.182
+    {
+        FMaliOCRawCompilerOutput output;
+        AddSampledPermutation(output, vertexFactoryA, 1.0f);
+        AddSampledPermutation(output, vertexFactoryA, 2.0f);
+        AddSampledPermutation(output, vertexFactoryA, 3.0f);
+        AddSampledPermutation(output, vertexFactoryA, 4.0f);
+        AddSampledPermutation(output, vertexFactoryB, 10.0f);
+
+        TMap<FMaliOCSamplingStratum, uint32> stratumSizes;
+        stratumSizes.Add(MakePixelStratum(vertexFactoryA), 10);
+        stratumSizes.Add(MakePixelStratum(vertexFactoryB), 10);
+
+        const FMaliOCSamplingSummary summary = EstimateFromSample(output, stratumSizes, options);
+        TestEqual(TEXT("Every metric is estimated"), summary.Estimates.Num(), (int32)EMaliOCSampledMetric::Num);
+        if (summary.Estimates.Num() != (int32)EMaliOCSampledMetric::Num)
+        {
+            return false;
+        }
+
+        const FMaliOCSampledEstimate& cycles = summary.Estimates[(uint32)EMaliOCSampledMetric::BoundPipeLongestPathCycles];
+        const float halfInterval = 3.182f * FMath::Sqrt(0.4375f);
+        TestTrue(TEXT("The mean weights each stratum by its size"), FMath::IsNearlyEqual(cycles.Mean, 6.25f, 1e-4f));
+        TestTrue(TEXT("The single sampled stratum borrows the pooled variance"), cycles.bHasConfidenceInterval);
+        TestTrue(TEXT("The lower bound uses the pooled variance"), FMath::IsNearlyEqual(cycles.LowerBound, 6.25f - halfInterval, 1e-4f));
+        TestTrue(TEXT("The upper bound uses the pooled variance"), FMath::IsNearlyEqual(cycles.UpperBound, 6.25f + halfInterval, 1e-4f));
+        TestTrue(TEXT("The sampled range covers every sample"), cycles.Min == 1.0f && cycles.Max == 10.0f);
+        TestFalse(TEXT("A bounded estimate well under the threshold isn't flagged"), summary.bFlagged);
+    }
+
+    // With only single samples there's no variance to borrow, so the bounds mustn't collapse to a confident point estimate
+    {
+        FMaliOCRawCompilerOutput output;
+        AddSampledPermutation(output, vertexFactoryA, 2.0f);
+        AddSampledPermutation(output, vertexFactoryB, 3.0f);
+
+        TMap<FMaliOCSamplingStratum, uint32> stratumSizes;
+        stratumSizes.Add(MakePixelStratum(vertexFactoryA), 10);
+        stratumSizes.Add(MakePixelStratum(vertexFactoryB), 10);
+
+        const FMaliOCSamplingSummary summary = EstimateFromSample(output, stratumSizes, options);
+        const FMaliOCSampledEstimate& cycles = summary.Estimates[(uint32)EMaliOCSampledMetric::BoundPipeLongestPathCycles];
+        TestFalse(TEXT("Single samples of larger strata give no confidence interval"), cycles.bHasConfidenceInterval);
+        TestTrue(TEXT("An estimate without a confidence interval is flagged"), summary.bFlagged);
+    }
+
+    // A stratum with a single permutation was compiled exactly, so it needs no variance
+    {
+        FMaliOCRawCompilerOutput output;
+        AddSampledPermutation(output, vertexFactoryA, 2.0f);
+
+        TMap<FMaliOCSamplingStratum, uint32> stratumSizes;
+        stratumSizes.Add(MakePixelStratum(vertexFactoryA), 1);
+
+        const FMaliOCSamplingSummary summary = EstimateFromSample(output, stratumSizes, options);
+        const FMaliOCSampledEstimate& cycles = summary.Estimates[(uint32)EMaliOCSampledMetric::BoundPipeLongestPathCycles];
+        TestTrue(TEXT("A fully compiled stratum has a confidence interval"), cycles.bHasConfidenceInterval);
+        TestTrue(TEXT("A fully compiled stratum's bounds are its value"), cycles.LowerBound == 2.0f && cycles.UpperBound == 2.0f);
+        TestFalse(TEXT("A fully compiled stratum under the threshold isn't flagged"), summary.bFlagged);
+    }
+
+    return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FMaliOCStudentTQuantileTest, "MaliOC.Sampling.StudentTQuantile", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+// Check the t quantile against published values, and that it narrows smoothly to the normal quantile past the end of the table
+bool FMaliOCStudentTQuantileTest::RunTest(const FString& Parameters)
+{
+    TestTrue(TEXT("1 degree of freedom"), FMath::IsNearlyEqual(GetStudentTQuantile(1.0), 12.706, 1e-3));
+    TestTrue(TEXT("3 degrees of freedom"), FMath::IsNearlyEqual(GetStudentTQuantile(3.0), 3.182, 1e-3));
+    TestTrue(TEXT("30 degrees of freedom"), FMath::IsNearlyEqual(GetStudentTQuantile(30.0), 2.042, 1e-3));
+    TestTrue(TEXT("60 degrees of freedom"), FMath::IsNearlyEqual(GetStudentTQuantile(60.0), 2.000, 1e-3));
+    TestTrue(TEXT("120 degrees of freedom"), FMath::IsNearlyEqual(GetStudentTQuantile(120.0), 1.980, 1e-3));
+    TestTrue(TEXT("Many degrees of freedom tend to the normal quantile"), FMath::IsNearlyEqual(GetStudentTQuantile(1e6), 1.960, 1e-3));
+
+    bool bDecreasing = true;
+    for (int32 degreesOfFreedom = 2; degreesOfFreedom < 200; degreesOfFreedom++)
+    {
+        bDecreasing = bDecreasing && GetStudentTQuantile(degreesOfFreedom) < GetStudentTQuantile(degreesOfFreedom - 1);
+    }
+    TestTrue(TEXT("More degrees of freedom always narrow the interval"), bDecreasing);
+
+    return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FMaliOCStratumSampleTest, "MaliOC.Sampling.StratumSample", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+// Check that stratum samples are the right size, deterministic, and always include the representative shaders
+bool FMaliOCStratumSampleTest::RunTest(const FString& Parameters)
+{
+    TArray<const FShaderType*> shaderTypes;
+    for (TLinkedList<FShaderType*>::TIterator shaderTypeIt(FShaderType::GetTypeList()); shaderTypeIt && shaderTypes.Num() < 20; shaderTypeIt.Next())
+    {
+        shaderTypes.Add(*shaderTypeIt);
+    }
+
+    TestEqual(TEXT("There are enough shader types to sample from"), shaderTypes.Num(), 20);
+    if (shaderTypes.Num() != 20)
+    {
+        return false;
+    }
+
+    const TMap<FName, FString> noRepresentatives;
+
+    TArray<const FShaderType*> everything;
+    SelectStratumSample(shaderTypes, noRepresentatives, 20, everything);
+    TestEqual(TEXT("A sample as large as the stratum takes all of it"), everything.Num(), shaderTypes.Num());
+
+    TArray<const FShaderType*> sample;
+    SelectStratumSample(shaderTypes, noRepresentatives, 5, sample);
+    TestEqual(TEXT("The sample has the requested size"), sample.Num(), 5);
+    TestEqual(TEXT("The sample is spread evenly, starting from the first shader type"), sample.Num() > 0 ? sample[0] : nullptr, shaderTypes[0]);
+
+    TArray<const FShaderType*> sampleAgain;
+    SelectStratumSample(shaderTypes, noRepresentatives, 5, sampleAgain);
+    TestTrue(TEXT("The sample is deterministic"), sample == sampleAgain);
+
+    // The representative shader counts towards the sample size, and the evenly spread ones fill the rest
+    TMap<FName, FString> representatives;
+    representatives.Add(FName(shaderTypes[7]->GetName()), TEXT("Representative"));
+
+    TArray<const FShaderType*> representativeSample;
+    SelectStratumSample(shaderTypes, representatives, 5, representativeSample);
+    TestTrue(TEXT("Representative shaders are always sampled"), representativeSample.Contains(shaderTypes[7]));
+    TestEqual(TEXT("Representative shaders count towards the sample size"), representativeSample.Num(), 5);
+
+    return true;
+}
@@ -0,0 +1,611 @@
+/*
+* Copyright 2015 ARM Limited
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+
+// A standalone Linux tool, not a UE4 module: Scripts/BuildAnalyzer.sh builds it with the system compiler, and it needs no engine.
+// It loads the compiler manager through the same function table as FCompilerManager, and parses with the same parser as the plugin.
+
+#include "../MaliOC/Private/Core/MaliOCCompilerFunctions.h"
+#include "../MaliOC/Private/Core/MaliOCOutputParser.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <dirent.h>
+#include <dlfcn.h>
+#include <limits.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/** The folder the plugin extracts the offline compiler to, relative to the plugin folder */
+static const char* const OfflineCompilerFolder = "Mali_Offline_Compiler_v5.3.0";
+static const char* const DLLName = "libcompiler_manager.so";
+
+/** glibc has 16 linker namespaces, and the default one is already taken */
+static const unsigned int MaxLinkerNamespaces = 15;
+
+/** A shader file extension, and what the offline compiler calls that type of shader */
+struct FShaderType
+{
+    const char* Extension;
+    const char* CompilerType;
+};
+
+static const FShaderType ShaderTypes[] =
+{
+    { ".vert", "vertex" },
+    { ".tesc", "tessellation_control" },
+    { ".tese", "tessellation_evaluation" },
+    { ".geom", "geometry" },
+    { ".frag", "fragment" },
+    { ".comp", "compute" },
+};
+
+struct FOptions
+{
+    /** A directory, or a .tar, .tar.gz, .tgz or .zip archive, searched recursively for shaders */
+    std::string Input;
+    /** The extracted offline compiler. Defaults to the one the plugin downloads */
+    std::string CompilerPath;
+    /** Only compile with cores whose names contain this. Every core if empty */
+    std::string CoreFilter;
+    /** Write the metrics of every compile to this CSV file. Only printed if empty */
+    std::string OutputPath;
+    /** Number of compiling threads. Defaults to the number of hardware threads */
+    unsigned int NumJobs = 0;
+};
+
+/** One shader in the corpus */
+struct FShaderFile
+{
+    /** Relative to the analyzed directory */
+    std::string RelativePath;
+    const FShaderType* Type;
+};
+
+/** A compiler, by the names that identify it across copies of the compiler manager */
+struct FCompilerIdentity
+{
+    std::string Core;
+    std::string Revision;
+    std::string Driver;
+};
+
+/** The outputs of one compiler for one shader */
+struct FResult
+{
+    const FShaderFile* File = nullptr;
+    const FCompilerIdentity* Compiler = nullptr;
+    FMaliOCParsedOutputs Parsed;
+};
+
+/** One loaded copy of the compiler manager */
+class FCompilerLibrary final
+{
+public:
+    /**
+     * @param bIsolated load the library into a new linker namespace, so it shares no state with any other copy
+     * @return the copy, or nullptr if it couldn't be loaded
+     */
+    static FCompilerLibrary* Load(const std::string& CompilerPath, bool bIsolated)
+    {
+        const std::string dllPath = CompilerPath + "/" + DLLName;
+        void* handle = bIsolated ? dlmopen(LM_ID_NEWLM, dllPath.c_str(), RTLD_NOW | RTLD_LOCAL) : dlopen(dllPath.c_str(), RTLD_NOW | RTLD_LOCAL);
+        if (handle == nullptr)
+        {
+            return nullptr;
+        }
+
+        FCompilerLibrary* library = new FCompilerLibrary(handle);
+        const bool allLoadedSuccessfully = library->Functions.LoadFunctions([handle](const char* Name)
+        {
+            return dlsym(handle, Name);
+        });
+
+        if (!allLoadedSuccessfully || !library->Functions._malicm_initialize_libraries(CompilerPath.c_str()))
+        {
+            delete library;
+            return nullptr;
+        }
+        library->bAreLibrariesInitialized = true;
+
+        if (!library->Functions.IsExpectedVersion())
+        {
+            delete library;
+            return nullptr;
+        }
+
+        return library;
+    }
+
+    ~FCompilerLibrary()
+    {
+        if (bAreLibrariesInitialized)
+        {
+            Functions._malicm_release_libraries();
+        }
+        dlclose(Handle);
+    }
+
+    /** @return true if this copy has the compiler */
+    bool FindCompiler(const FCompilerIdentity& Identity, malicm_compiler& OutCompiler) const
+    {
+        malicm_compiler* compilers;
+        unsigned int numCompilers = 0;
+        Functions._malicm_get_compilers(&compilers, &numCompilers, Identity.Driver.c_str(), Identity.Core.c_str(), Identity.Revision.c_str(), "openglessl", nullptr, 0);
+
+        const bool bFound = numCompilers > 0;
+        if (bFound)
+        {
+            OutCompiler = compilers[0];
+        }
+
+        Functions._malicm_release_compilers(&compilers, numCompilers);
+        return bFound;
+    }
+
+    FMaliOCCompilerFunctions Functions;
+
+private:
+    explicit FCompilerLibrary(void* InHandle) :
+        Handle(InHandle)
+    {
+    }
+
+    void* Handle;
+    /** Whether _malicm_initialize_libraries succeeded, so _malicm_release_libraries needs calling */
+    bool bAreLibrariesInitialized = false;
+};
+
+static void PrintUsage(const char* Program)
+{
+    fprintf(stderr,
+        "Usage: %s [options] <directory or archive>\n"
+        "Compiles every .vert, .frag, .tesc, .tese, .geom and .comp file in a directory, or in a .tar, .tar.gz, .tgz or .zip archive, with every Mali Offline Compiler.\n"
+        "  --compiler <directory>  the extracted offline compiler (default: %s in the plugin folder)\n"
+        "  --core <name>           only compile with cores whose names contain this\n"
+        "  --output <file.csv>     write the metrics of every compile to a CSV file\n"
+        "  --jobs <n>              number of compiling threads (default: one per hardware thread)\n",
+        Program, OfflineCompilerFolder);
+}
+
+static bool ParseOptions(int argc, char** argv, FOptions& OutOptions)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        const std::string arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+
+        if (arg == "--compiler" && hasValue)
+        {
+            OutOptions.CompilerPath = argv[++i];
+        }
+        else if (arg == "--core" && hasValue)
+        {
+            OutOptions.CoreFilter = argv[++i];
+        }
+        else if (arg == "--output" && hasValue)
+        {
+            OutOptions.OutputPath = argv[++i];
+        }
+        else if (arg == "--jobs" && hasValue)
+        {
+            OutOptions.NumJobs = (unsigned int)atoi(argv[++i]);
+        }
+        else if (arg.compare(0, 2, "--") != 0 && OutOptions.Input.empty())
+        {
+            OutOptions.Input = arg;
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    if (OutOptions.CompilerPath.empty())
+    {
+        // Scripts/BuildAnalyzer.sh puts us in Binaries/Linux inside the plugin folder
+        char executable[PATH_MAX];
+        const ssize_t length = readlink("/proc/self/exe", executable, sizeof(executable) - 1);
+        if (length > 0)
+        {
+            executable[length] = 0;
+            std::string folder = executable;
+            folder = folder.substr(0, folder.rfind('/'));
+            OutOptions.CompilerPath = folder + "/../../" + OfflineCompilerFolder;
+        }
+    }
+
+    return !OutOptions.Input.empty();
+}
+
+/** Run a program and wait for it, without going through a shell. @return true if it exited with 0 */
+static bool RunProcess(const std::vector<std::string>& Args)
+{
+    const pid_t pid = fork();
+    if (pid == 0)
+    {
+        std::vector<char*> argv;
+        for (const std::string& arg : Args)
+        {
+            argv.push_back(const_cast<char*>(arg.c_str()));
+        }
+        argv.push_back(nullptr);
+        execvp(argv[0], argv.data());
+        _exit(127);
+    }
+
+    int status = 0;
+    return pid > 0 && waitpid(pid, &status, 0) == pid && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+static bool EndsWith(const std::string& String, const char* Suffix)
+{
+    const size_t length = strlen(Suffix);
+    return String.size() >= length && String.compare(String.size() - length, length, Suffix) == 0;
+}
+
+/**
+ * Extract an archive into a new temporary directory with tar or unzip.
+ * @return false if Path isn't an archive we know, or it couldn't be extracted
+ */
+static bool ExtractArchive(const std::string& Path, std::string& OutDirectory)
+{
+    const bool isZip = EndsWith(Path, ".zip");
+    if (!isZip && !EndsWith(Path, ".tar") && !EndsWith(Path, ".tar.gz") && !EndsWith(Path, ".tgz"))
+    {
+        return false;
+    }
+
+    const char* tempRoot = getenv("TMPDIR");
+    std::string pattern = std::string(tempRoot != nullptr ? tempRoot : "/tmp") + "/MaliOCAnalyzer.XXXXXX";
+    if (mkdtemp(&pattern[0]) == nullptr)
+    {
+        return false;
+    }
+    OutDirectory = pattern;
+
+    return isZip ? RunProcess({ "unzip", "-q", Path, "-d", OutDirectory }) : RunProcess({ "tar", "-xf", Path, "-C", OutDirectory });
+}
+
+/** Add every shader under Directory to OutFiles, with paths relative to Root. Symbolic links to directories aren't followed, so a link loop can't recurse forever */
+static void FindShaders(const std::string& Root, const std::string& Directory, std::vector<FShaderFile>& OutFiles)
+{
+    DIR* dir = opendir((Root + "/" + Directory).c_str());
+    if (dir == nullptr)
+    {
+        return;
+    }
+
+    while (const dirent* entry = readdir(dir))
+    {
+        const std::string name = entry->d_name;
+        if (name == "." || name == "..")
+        {
+            continue;
+        }
+
+        const std::string relativePath = Directory.empty() ? name : Directory + "/" + name;
+        const std::string path = Root + "/" + relativePath;
+        struct stat info;
+        if (lstat(path.c_str(), &info) != 0)
+        {
+            continue;
+        }
+
+        // Linked shaders are still analysed, but only if the link leads to a file
+        if (S_ISLNK(info.st_mode) && (stat(path.c_str(), &info) != 0 || !S_ISREG(info.st_mode)))
+        {
+            continue;
+        }
+
+        if (S_ISDIR(info.st_mode))
+        {
+            FindShaders(Root, relativePath, OutFiles);
+            continue;
+        }
+
+        for (const FShaderType& type : ShaderTypes)
+        {
+            if (EndsWith(name, type.Extension))
+            {
+                OutFiles.push_back(FShaderFile{ relativePath, &type });
+                break;
+            }
+        }
+    }
+
+    closedir(dir);
+}
+
+/** Escape a field for the CSV output */
+static std::string EscapeCsvField(const std::string& Field)
+{
+    if (Field.find_first_of(",\"\n") == std::string::npos)
+    {
+        return Field;
+    }
+
+    std::string escaped = "\"";
+    for (char c : Field)
+    {
+        escaped += c;
+        if (c == '"')
+        {
+            escaped += '"';
+        }
+    }
+    return escaped + "\"";
+}
+
+/**
+ * Compile every shader with every compiler on NumJobs threads.
+ * Each thread loads a copy of the compiler manager into its own linker namespace, as the compiler libraries may not be reentrant.
+ * Threads that can't get a copy share the one in the default namespace, one at a time.
+ * @param OutResults every compile, in order of compiler and then file
+ */
+static void CompileAll(const FOptions& Options, const std::string& Directory, const std::vector<FShaderFile>& Files, const std::vector<FCompilerIdentity>& Compilers, FCompilerLibrary& SharedLibrary, unsigned int NumJobs, std::vector<FResult>& OutResults)
+{
+    OutResults.resize(Compilers.size() * Files.size());
+
+    std::atomic<size_t> nextResult(0);
+    std::mutex sharedLibraryMutex;
+
+    auto worker = [&]()
+    {
+        FCompilerLibrary* isolatedLibrary = FCompilerLibrary::Load(Options.CompilerPath, true);
+        FCompilerLibrary& library = isolatedLibrary != nullptr ? *isolatedLibrary : SharedLibrary;
+
+        const FCompilerIdentity* lastIdentity = nullptr;
+        malicm_compiler compiler = 0;
+        bool bHasCompiler = false;
+
+        for (size_t index = nextResult++; index < OutResults.size(); index = nextResult++)
+        {
+            FResult& result = OutResults[index];
+            result.Compiler = &Compilers[index / Files.size()];
+            result.File = &Files[index % Files.size()];
+
+            std::ifstream stream(Directory + "/" + result.File->RelativePath, std::ios::binary);
+            std::stringstream source;
+            source << stream.rdbuf();
+            if (!stream)
+            {
+                result.Parsed.Errors.push_back("Could not read the file");
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(sharedLibraryMutex, std::defer_lock);
+            if (isolatedLibrary == nullptr)
+            {
+                lock.lock();
+            }
+
+            // Compiler handles aren't shared between copies of the compiler manager, so each copy has to look its own up
+            if (result.Compiler != lastIdentity)
+            {
+                lastIdentity = result.Compiler;
+                bHasCompiler = library.FindCompiler(*lastIdentity, compiler);
+            }
+
+            if (!bHasCompiler)
+            {
+                result.Parsed.Errors.push_back("Compiler could not be run");
+                continue;
+            }
+
+            malioc_outputs outputs;
+            const bool ran = library.Functions._malicm_compile(&outputs, source.str().c_str(), result.File->Type->CompilerType, nullptr, 0, false, false, nullptr, 0, compiler);
+            FMaliOCOutputParser::Parse(ran, outputs, result.Parsed);
+            if (ran)
+            {
+                library.Functions._malicm_release_compiler_outputs(&outputs);
+            }
+        }
+
+        delete isolatedLibrary;
+    };
+
+    std::vector<std::thread> threads;
+    for (unsigned int i = 0; i < NumJobs; i++)
+    {
+        threads.push_back(std::thread(worker));
+    }
+    for (std::thread& thread : threads)
+    {
+        thread.join();
+    }
+}
+
+/** Print the metrics of each result, and write them to Options.OutputPath if it's set. @return the number of failed compiles */
+static size_t WriteResults(const FOptions& Options, const std::vector<FResult>& Results)
+{
+    // One row per render target of Midgard shaders, and one per Utgard shader or error. Columns that don't apply to a row are left empty
+    std::string csv = "File,Core,Revision,Driver,RenderTarget,WorkRegisters,UniformRegisters,ArithmeticCycles,LoadStoreCycles,TextureCycles,"
+        "ArithmeticShortestPath,LoadStoreShortestPath,TextureShortestPath,ArithmeticLongestPath,LoadStoreLongestPath,TextureLongestPath,Spilling,"
+        "MinCycles,MaxCycles,InstructionWords,Error\n";
+
+    size_t numErrors = 0;
+    char line[1024];
+    for (const FResult& result : Results)
+    {
+        const FCompilerIdentity& identity = *result.Compiler;
+        const char* file = result.File->RelativePath.c_str();
+        const std::string compiler = identity.Core + " " + identity.Revision + " " + identity.Driver;
+        const std::string prefix = EscapeCsvField(result.File->RelativePath) + "," + EscapeCsvField(identity.Core) + "," + EscapeCsvField(identity.Revision) + "," + EscapeCsvField(identity.Driver);
+
+        switch (result.Parsed.Result)
+        {
+        case FMaliOCParsedOutputs::EResult::Error:
+        {
+            const std::string message = result.Parsed.Errors.empty() ? std::string() : result.Parsed.Errors[0];
+            printf("%s (%s): %s\n", file, compiler.c_str(), message.c_str());
+            csv += prefix + ",,,,,,,,,,,,,,,,," + EscapeCsvField(message) + "\n";
+            numErrors++;
+            break;
+        }
+        case FMaliOCParsedOutputs::EResult::Midgard:
+        {
+            for (const FMaliOCMidgardRenderTarget& rt : result.Parsed.RenderTargets)
+            {
+                printf("%s (%s) RT%d: %d work registers, %d uniform registers, longest path A %.2f LS %.2f T %.2f%s\n",
+                    file, compiler.c_str(), rt.render_target, rt.work_registers_used, rt.uniform_registers_used,
+                    rt.arithmetic_longest_path, rt.load_store_longest_path, rt.texture_longest_path, rt.spilling_used ? ", spilling" : "");
+                snprintf(line, sizeof(line), ",%d,%d,%d,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f,%d,,,,\n",
+                    rt.render_target, rt.work_registers_used, rt.uniform_registers_used,
+                    rt.arithmetic_cycles, rt.load_store_cycles, rt.texture_cycles,
+                    rt.arithmetic_shortest_path, rt.load_store_shortest_path, rt.texture_shortest_path,
+                    rt.arithmetic_longest_path, rt.load_store_longest_path, rt.texture_longest_path,
+                    rt.spilling_used ? 1 : 0);
+                csv += prefix + line;
+            }
+            break;
+        }
+        case FMaliOCParsedOutputs::EResult::Utgard:
+        {
+            const FMaliOCUtgardStatistics& utgard = result.Parsed.Utgard;
+            printf("%s (%s): %d to %d cycles, %d instruction words\n",
+                file, compiler.c_str(), utgard.min_number_of_cycles, utgard.max_number_of_cycles, utgard.n_instruction_words);
+            snprintf(line, sizeof(line), ",,,,,,,,,,,,,,%d,%d,%d,\n", utgard.min_number_of_cycles, utgard.max_number_of_cycles, utgard.n_instruction_words);
+            csv += prefix + line;
+            break;
+        }
+        }
+    }
+
+    if (!Options.OutputPath.empty())
+    {
+        std::ofstream output(Options.OutputPath, std::ios::binary);
+        output << csv;
+        if (output)
+        {
+            fprintf(stderr, "Wrote the metrics to %s\n", Options.OutputPath.c_str());
+        }
+        else
+        {
+            fprintf(stderr, "Could not write the metrics to %s\n", Options.OutputPath.c_str());
+        }
+    }
+
+    return numErrors;
+}
+
+int main(int argc, char** argv)
+{
+    FOptions options;
+    if (!ParseOptions(argc, argv, options))
+    {
+        PrintUsage(argv[0]);
+        return 2;
+    }
+
+    std::string directory = options.Input;
+    std::string extractedDirectory;
+    struct stat info;
+    if (stat(options.Input.c_str(), &info) != 0)
+    {
+        fprintf(stderr, "%s does not exist\n", options.Input.c_str());
+        return 1;
+    }
+    if (!S_ISDIR(info.st_mode))
+    {
+        if (!ExtractArchive(options.Input, extractedDirectory))
+        {
+            fprintf(stderr, "%s is not a directory, or a .tar, .tar.gz, .tgz or .zip archive that could be extracted\n", options.Input.c_str());
+            if (!extractedDirectory.empty())
+            {
+                RunProcess({ "rm", "-rf", extractedDirectory });
+            }
+            return 1;
+        }
+        directory = extractedDirectory;
+    }
+
+    std::vector<FShaderFile> files;
+    FindShaders(directory, std::string(), files);
+    std::sort(files.begin(), files.end(), [](const FShaderFile& A, const FShaderFile& B)
+    {
+        return A.RelativePath < B.RelativePath;
+    });
+
+    int exitCode = 1;
+    FCompilerLibrary* sharedLibrary = nullptr;
+
+    if (files.empty())
+    {
+        fprintf(stderr, "Found no .vert, .frag, .tesc, .tese, .geom or .comp files in %s\n", options.Input.c_str());
+    }
+    else if ((sharedLibrary = FCompilerLibrary::Load(options.CompilerPath, false)) == nullptr)
+    {
+        fprintf(stderr, "Could not load the Mali Offline Compiler %s from %s\n", DLLName, options.CompilerPath.c_str());
+    }
+    else
+    {
+        std::vector<FCompilerIdentity> compilers;
+        malicm_compiler* handles;
+        unsigned int numHandles = 0;
+        sharedLibrary->Functions._malicm_get_compilers(&handles, &numHandles, nullptr, nullptr, nullptr, "openglessl", nullptr, 0);
+        for (unsigned int i = 0; i < numHandles; i++)
+        {
+            FCompilerIdentity identity;
+            identity.Core = sharedLibrary->Functions._malicm_get_core_name(handles[i]);
+            identity.Revision = sharedLibrary->Functions._malicm_get_core_revision(handles[i]);
+            identity.Driver = sharedLibrary->Functions._malicm_get_driver_name(handles[i]);
+            if (identity.Core.find(options.CoreFilter) != std::string::npos)
+            {
+                compilers.push_back(identity);
+            }
+        }
+        sharedLibrary->Functions._malicm_release_compilers(&handles, numHandles);
+
+        if (compilers.empty())
+        {
+            fprintf(stderr, "No offline compiler matches core filter \"%s\"\n", options.CoreFilter.c_str());
+        }
+        else
+        {
+            // No more threads than there are linker namespaces, as every thread beyond that would only wait for the shared copy
+            unsigned int numJobs = options.NumJobs != 0 ? options.NumJobs : std::max(1u, std::thread::hardware_concurrency());
+            numJobs = std::min(numJobs, MaxLinkerNamespaces);
+
+            fprintf(stderr, "Compiling %zu shaders from %s with %zu compilers on %u threads\n", files.size(), options.Input.c_str(), compilers.size(), numJobs);
+
+            std::vector<FResult> results;
+            CompileAll(options, directory, files, compilers, *sharedLibrary, numJobs, results);
+            const size_t numErrors = WriteResults(options, results);
+
+            fprintf(stderr, "%zu of %zu compiles failed\n", numErrors, results.size());
+            exitCode = 0;
+        }
+    }
+
+    delete sharedLibrary;
+    if (!extractedDirectory.empty())
+    {
+        RunProcess({ "rm", "-rf", extractedDirectory });
+    }
+    return exitCode;
+}